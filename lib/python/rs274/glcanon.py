@@ -40,15 +40,19 @@ limiticon = array.array('B',
 
 class GLCanon(Translated, ArcsToSegmentsMixin):
     lineno = -1
+    # seconds between calls to check_abort while gcode.parse runs
+    update_interval = .25
     def __init__(self, colors, geometry, is_foam=0):
+        # These are gcode.previewbuffers, which gcode.parse fills in C
+        # without calling the motion methods below.
         # traverse list - [line number, [start position], [end position], [tlo x, tlo y, tlo z]]
-        self.traverse = []; self.traverse_append = self.traverse.append
+        self.traverse = gcode.previewbuffer(gcode.PREVIEW_TRAVERSE); self.traverse_append = self.traverse.append
         # feed list - [line number, [start position], [end position], feedrate, [tlo x, tlo y, tlo z]]
-        self.feed = []; self.feed_append = self.feed.append
+        self.feed = gcode.previewbuffer(gcode.PREVIEW_FEED); self.feed_append = self.feed.append
         # arcfeed list - [line number, [start position], [end position], feedrate, [tlo x, tlo y, tlo z]]
-        self.arcfeed = []; self.arcfeed_append = self.arcfeed.append
+        self.arcfeed = gcode.previewbuffer(gcode.PREVIEW_FEED); self.arcfeed_append = self.arcfeed.append
         # dwell list - [line number, color, pos x, pos y, pos z, plane]
-        self.dwells = []; self.dwells_append = self.dwells.append
+        self.dwells = gcode.previewbuffer(gcode.PREVIEW_DWELL); self.dwells_append = self.dwells.append
         self.choice = None
         self.feedrate = 1
         self.lo = (0,) * 9
@@ -87,6 +91,10 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
         self.foam_w = 1.5
         self.notify = 0
         self.notify_message = ""
+        # called from check_abort to show the program read so far
+        self.partial_update = None
+        # linuxcnc.linebuffers for the lists above, by (id, geometry)
+        self.linebuffers = {}
 
     def comment(self, arg):
         if arg.startswith("AXIS,"):
@@ -119,14 +127,30 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
 
     def message(self, message): pass
 
-    def check_abort(self): pass
+    def check_abort(self):
+        if self.partial_update: self.partial_update()
 
     def next_line(self, st):
         self.state = st
         self.lineno = self.state.sequence_number
 
+    def linebuffer(self, lines, geometry=None):
+        geometry = geometry or self.geometry
+        key = id(lines), geometry
+        buf = self.linebuffers.get(key)
+        if buf is None or buf.count > len(lines):
+            # a shorter list under the same id is a new list, not more
+            # lines for the old one
+            buf = self.linebuffers[key] = linuxcnc.linebuffer(geometry, lines)
+        elif buf.count != len(lines):
+            buf.update(lines)
+        return buf
+
     def draw_lines(self, lines, for_selection, j=0, geometry=None):
-        return linuxcnc.draw_lines(geometry or self.geometry, lines, for_selection)
+        # selection needs a name for each line, so it stays immediate mode
+        if for_selection:
+            return linuxcnc.draw_lines(geometry or self.geometry, lines, for_selection)
+        self.linebuffer(lines, geometry).draw()
 
     def colored_lines(self, color, lines, for_selection, j=0):
         if self.is_foam:
@@ -245,26 +269,12 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
         glLineWidth(3)
         c = self.colors['selected']
         glColor3f(*c)
-        glBegin(GL_LINES)
         coords = []
-        for line in self.traverse:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
-        for line in self.arcfeed:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
-        for line in self.feed:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
-        glEnd()
-        for line in self.dwells:
-            if line[0] != lineno: continue
+        for lines in self.traverse, self.arcfeed, self.feed:
+            buf = self.linebuffer(lines, geometry)
+            buf.draw(lineno)
+            coords.extend(buf.coords(lineno))
+        for line in self.dwells.find(lineno):
             self.draw_dwells([(line[0], c) + line[2:]], 2, 0)
             coords.append(line[2:5])
         glLineWidth(1)
@@ -283,7 +293,7 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
     def color(self, name):
         glColor3f(*self.colors[name])
 
-    def draw(self, for_selection=0, no_traverse=True):
+    def draw(self, for_selection=0, no_traverse=True, dwells=True):
         if not no_traverse:
             glEnable(GL_LINE_STIPPLE)
             self.colored_lines('traverse', self.traverse, for_selection)
@@ -293,9 +303,13 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
 
             self.colored_lines('arc_feed', self.arcfeed, for_selection, len(self.traverse) + len(self.feed))
 
-            glLineWidth(2)
-            self.draw_dwells(self.dwells, self.colors.get('dwell_alpha', 1/3.), for_selection, len(self.traverse) + len(self.feed) + len(self.arcfeed))
-            glLineWidth(1)
+            if dwells:
+                self.draw_all_dwells(for_selection)
+
+    def draw_all_dwells(self, for_selection=0):
+        glLineWidth(2)
+        self.draw_dwells(self.dwells, self.colors.get('dwell_alpha', 1/3.), for_selection, len(self.traverse) + len(self.feed) + len(self.arcfeed))
+        glLineWidth(1)
 
 def with_context(f):
     def inner(self, *args, **kw):
@@ -925,9 +939,13 @@ class GlCanonDraw:
                 glEnable(GL_BLEND)
                 glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA)
 
-            if self.get_show_rapids():
-                glCallList(self.dlist('program_rapids', gen=self.make_main_list))
-            glCallList(self.dlist('program_norapids', gen=self.make_main_list))
+            # the lines are drawn from the canon's linebuffers; only the
+            # dwells are worth a display list
+            if self.canon:
+                if self.get_show_rapids():
+                    self.canon.draw(0, False)
+                self.canon.draw(0, True, False)
+            glCallList(self.dlist('program_dwells', gen=self.make_main_list))
             glCallList(self.dlist('highlight'))
 
             if self.get_program_alpha():
@@ -1578,27 +1596,41 @@ class GlCanonDraw:
         glEndList()
 
     def make_main_list(self, unused=None):
-        program = self.dlist('program_norapids')
-        rapids = self.dlist('program_rapids')
-        glNewList(program, GL_COMPILE)
-        if self.canon: self.canon.draw(0, True)
+        dwells = self.dlist('program_dwells')
+        glNewList(dwells, GL_COMPILE)
+        if self.canon: self.canon.draw_all_dwells()
         glEndList()
 
-        glNewList(rapids, GL_COMPILE)
-        if self.canon: self.canon.draw(0, False)
-        glEndList()
+    def stale_program_dlists(self):
+        self.stale_dlist('program_dwells')
+        self.stale_dlist('select_rapids')
+        self.stale_dlist('select_norapids')
+
+    def show_partial_preview(self):
+        # Redraw only once the program has doubled since the last time, so
+        # that showing a big file while it loads costs at most as much as
+        # drawing it once more at the end.
+        canon = self.canon
+        n = len(canon.traverse) + len(canon.feed) + len(canon.arcfeed)
+        if n == 0 or n < 2 * self.partial_moves: return
+        self.partial_moves = n
+        canon.calc_extents()
+        self.stale_program_dlists()
+        self._redraw()
 
     def load_preview(self, f, canon, unitcode, initcode, interpname=""):
         self.set_canon(canon)
-        result, seq = gcode.parse(f, canon, unitcode, initcode, interpname)
+        self.partial_moves = 0
+        canon.partial_update = self.show_partial_preview
+        try:
+            result, seq = gcode.parse(f, canon, unitcode, initcode, interpname)
+        finally:
+            canon.partial_update = None
 
         if result <= gcode.MIN_ERROR:
             self.canon.progress.nextphase(1)
             canon.calc_extents()
-            self.stale_dlist('program_rapids')
-            self.stale_dlist('program_norapids')
-            self.stale_dlist('select_rapids')
-            self.stale_dlist('select_norapids')
+            self.stale_program_dlists()
 
         return result, seq
 
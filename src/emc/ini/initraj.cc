@@ -42,6 +42,8 @@ extern value_inihal_data old_inihal_data;
   MAX_VELOCITY <float>          max velocity
   MAX_ACCELERATION <float>      max acceleration
   DEFAULT_ACCELERATION <float>  default acceleration
+  MAX_JERK <float>              max jerk, 0 for no jerk limit
+  LOOKAHEAD <int>               number of moves to plan velocities over
   HOME <float> ...              world coords of home, in X Y Z R P W
 
   calls:
@@ -53,6 +55,8 @@ extern value_inihal_data old_inihal_data;
   emcTrajSetAcceleration(double acc);
   emcTrajSetMaxVelocity(double vel);
   emcTrajSetMaxAcceleration(double acc);
+  emcTrajSetMaxJerk(double jerk);
+  emcTrajSetLookahead(int depth);
   emcTrajSetHome(EmcPose home);
   */
 
@@ -162,6 +166,26 @@ static int loadTraj(EmcIniFile *trajInifile)
             return -1;
         }
         old_inihal_data.traj_max_acceleration = acc;
+
+        double jerk = 0.0; // by default, trapezoidal profiles
+        trajInifile->Find(&jerk, "MAX_JERK", "TRAJ");
+
+        if (0 != emcTrajSetMaxJerk(jerk)) {
+            if (emc_debug & EMC_DEBUG_CONFIG) {
+                rcs_print("bad return value from emcTrajSetMaxJerk\n");
+            }
+            return -1;
+        }
+
+        int lookahead = 0; // by default, every move stops or blends
+        trajInifile->Find(&lookahead, "LOOKAHEAD", "TRAJ");
+
+        if (0 != emcTrajSetLookahead(lookahead)) {
+            if (emc_debug & EMC_DEBUG_CONFIG) {
+                rcs_print("bad return value from emcTrajSetLookahead\n");
+            }
+            return -1;
+        }
     }
 
     catch(EmcIniFile::Exception &e){
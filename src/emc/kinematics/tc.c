@@ -21,6 +21,7 @@
 #include "rtapi.h"		/* rtapi_print_msg */
 #include "posemath.h"
 #include "emcpos.h"
+#include "emcmotcfg.h"		/* EMCMOT_COMMAND_RING_SIZE */
 #include "tc.h"
 
 PmCartesian tcGetStartingUnitVector(TC_STRUCT *tc) {
@@ -371,8 +372,9 @@ TC_STRUCT *tcqItem(TC_QUEUE_STRUCT * tcq, int n, long period)
 /*! 
  * \def TC_QUEUE_MARGIN
  * sets up a margin at the end of the queue, to reduce effects of race conditions
+ * and to leave room for motions still sitting in the task->motion command ring
  */
-#define TC_QUEUE_MARGIN 10
+#define TC_QUEUE_MARGIN (EMCMOT_COMMAND_RING_SIZE + 10)
 
 /*! tcqFull() function
  *
@@ -72,9 +72,11 @@ typedef struct {
     double target;          // segment length
     double reqvel;          // vel requested by F word, calc'd by task
     double maxaccel;        // accel calc'd by task
+    double maxjerk;         // jerk limit, 0 for a trapezoidal profile
     double feed_override;   // feed override requested by user
     double maxvel;          // max possible vel (feed override stops here)
     double currentvel;      // keep track of current step (vel * cycle_time)
+    double currentaccel;    // accel of the last step, for the jerk limit
     
     int id;                 // segment's serial number
 
@@ -95,6 +97,13 @@ typedef struct {
     double blend_vel;       // velocity below which we should start blending
     double tolerance;       // during the blend at the end of this move, 
                             // stay within this distance from the path.
+    double kink_vel;        // lookahead: velocity this move may carry into
+                            // the next one without blending, 0 if it can't
+    double finalvel;        // lookahead: planned velocity at the end of
+                            // this move, 0 to stop or blend
+    double backvel;         // lookahead: highest final velocity the moves
+                            // after this one allow, before the forward trim
+    double term_vel;        // velocity to end this move at, this cycle
     int synchronized;       // spindle sync required for this move
     int velocity_mode;	    // TRUE if spindle sync is in velocity mode, FALSE if in position mode
     double uu_per_rev;      // for sync, user units per rev (e.g. 0.0625 for 16tpi)
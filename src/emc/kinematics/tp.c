@@ -112,10 +112,12 @@ int tpInit(TP_STRUCT * tp)
     tp->vLimit = 0.0;
     tp->vScale = 1.0;
     tp->aMax = 0.0;
+    tp->jMax = 0.0;
     tp->vMax = 0.0;
     tp->ini_maxvel = 0.0;
     tp->wMax = 0.0;
     tp->wDotMax = 0.0;
+    tp->lookahead = 0;
 
     ZERO_EMC_POSE(tp->currentPos);
     
@@ -183,6 +185,37 @@ int tpSetAmax(TP_STRUCT * tp, double aMax)
     return 0;
 }
 
+// Set max jerk.  With a jerk limit, moves get an S-curve velocity
+// profile instead of a trapezoidal one; 0 turns the limit off.  This
+// applies to subsequent moves until changed.
+
+int tpSetJmax(TP_STRUCT * tp, double jMax)
+{
+    if (0 == tp || jMax < 0.0) {
+	return -1;
+    }
+
+    tp->jMax = jMax;
+
+    return 0;
+}
+
+// Set the number of queued moves the lookahead looks over when it
+// works out how fast each move may end.  0 turns lookahead off and
+// every move ends by stopping or blending with the next one.  At most
+// TP_MAX_LOOKAHEAD, which bounds the work done each time a move is added.
+
+int tpSetLookahead(TP_STRUCT * tp, int depth)
+{
+    if (0 == tp || depth < 0 || depth > TP_MAX_LOOKAHEAD) {
+	return -1;
+    }
+
+    tp->lookahead = depth;
+
+    return 0;
+}
+
 /*
   tpSetId() sets the id that will be used for the next appended motions.
   nextId is incremented so that the next time a motion is appended its id
@@ -258,6 +291,221 @@ int tpSetPos(TP_STRUCT * tp, EmcPose pos)
     return 0;
 }
 
+// The quickest stop from velocity v and acceleration a0 when the
+// acceleration may change by at most j per second and never go beyond
+// amax: ramp down to -ap, hold it, and ramp back up to 0 just as the
+// velocity reaches 0.  Follows the stop for time t, leaving the velocity
+// and acceleration then in *vt and *at, and returns the distance covered.
+// Pass a long enough t to get the whole stopping distance.
+
+static double tcJerkStop(double v, double a0, double amax, double j, double t,
+        double *vt, double *at) {
+    double ap, t1, t2, t3, h, d = 0.0;
+
+    if(v <= 0.0) {
+        *vt = *at = 0.0;
+        return 0.0;
+    }
+    if(a0 < 0.0 && 2.0 * j * v <= a0 * a0) {
+        // already braking harder than needed: even easing off as fast
+        // as the jerk allows, the velocity reaches 0 after t3
+        t1 = t2 = 0.0;
+        t3 = (-a0 - pmSqrt(a0 * a0 - 2.0 * j * v)) / j;
+    } else {
+        ap = pmSqrt(j * v + 0.5 * a0 * a0);
+        t2 = 0.0;
+        if(ap > amax) {
+            ap = amax;
+            t2 = (v + 0.5 * a0 * a0 / j - ap * ap / j) / ap;
+        }
+        t1 = (a0 + ap) / j;
+        t3 = ap / j;
+    }
+
+    h = t < t1 ? t : t1;
+    d += v * h + 0.5 * a0 * h * h - j * h * h * h / 6.0;
+    v += a0 * h - 0.5 * j * h * h;
+    a0 -= j * h;
+    t -= h;
+
+    h = t < t2 ? t : t2;
+    d += v * h + 0.5 * a0 * h * h;
+    v += a0 * h;
+    t -= h;
+
+    h = t < t3 ? t : t3;
+    d += v * h + 0.5 * a0 * h * h + j * h * h * h / 6.0;
+    v += a0 * h + 0.5 * j * h * h;
+    a0 += j * h;
+    t -= h;
+
+    if(t > 0.0) {
+        // stopped
+        v = a0 = 0.0;
+    }
+    *vt = v;
+    *at = a0;
+    return d;
+}
+
+static double tcJerkStopDist(double v, double a0, double amax, double j) {
+    double vt, at;
+
+    return tcJerkStop(v, a0, amax, j, 1e9, &vt, &at);
+}
+
+// Lookahead only joins moves that are purely in xyz, since the unit
+// vectors used to find the corner angle don't know about abc or uvw.
+
+static int tpIsXyzOnly(TC_STRUCT *tc) {
+    if(tc->motion_type == TC_LINEAR)
+        return !tc->coords.line.xyz.tmag_zero &&
+            tc->coords.line.abc.tmag_zero && tc->coords.line.uvw.tmag_zero;
+    if(tc->motion_type == TC_CIRCULAR)
+        return tc->coords.circle.abc.tmag_zero &&
+            tc->coords.circle.uvw.tmag_zero;
+    return 0;
+}
+
+// The acceleration and jerk the lookahead may plan with.  Moves that
+// blend have both halved when they become active, so until then assume
+// they will be.
+
+static double tpPlanAccel(TC_STRUCT *tc) {
+    return tc->active ? tc->maxaccel : tc->maxaccel / 2.0;
+}
+
+static double tpPlanJerk(TC_STRUCT *tc) {
+    return tc->active ? tc->maxjerk : tc->maxjerk / 2.0;
+}
+
+// The highest velocity at which tc can start and still slow down to
+// endvel by its end.  With a jerk limit the trapezoid formula is too
+// optimistic, so search for the velocity whose S-curve stop needs no
+// more room than the move has, on top of the stop from endvel.
+
+static double tpPlanStartVel(TC_STRUCT *tc, double endvel) {
+    double acc = tpPlanAccel(tc), jerk = tpPlanJerk(tc);
+    double dist = tc->target - tc->progress;
+    double lo, hi, mid, room;
+    int i;
+
+    hi = pmSqrt(pmSq(endvel) + 2.0 * acc * dist);
+    if(jerk <= 0.0) return hi;
+    room = dist + tcJerkStopDist(endvel, 0.0, acc, jerk);
+    lo = endvel;
+    for(i = 0; i < 16; i++) {
+        mid = 0.5 * (lo + hi);
+        if(tcJerkStopDist(mid, 0.0, acc, jerk) > room)
+            hi = mid;
+        else
+            lo = mid;
+    }
+    return lo;
+}
+
+// Find how fast the corner between prev and tc may be passed without
+// a parabolic blend.  The change of direction has to fit in one cycle
+// at half the acceleration (the other half is left for speeding up and
+// slowing down along the path).  With a jerk limit that one cycle of
+// sideways acceleration comes and goes within two cycles, so it may be
+// no more than half the jerk times the cycle time.  The path goes right through the corner
+// so the blend tolerance is always met.  Returns 0 if the moves can't
+// be joined, or if a blend would get around the corner faster.
+
+static double tpKinkVel(TP_STRUCT *tp, TC_STRUCT *prev, TC_STRUCT *tc) {
+    PmCartesian v1, v2;
+    double dot, sin_half, acc, jerk, vel, kink_vel;
+
+    if(!prev->blend_with_next || tc->atspeed ||
+       prev->synchronized || tc->synchronized ||
+       prev->indexrotary != -1 || tc->indexrotary != -1 ||
+       !tpIsXyzOnly(prev) || !tpIsXyzOnly(tc))
+        return 0.0;
+
+    vel = prev->reqvel;
+    if(tc->reqvel < vel) vel = tc->reqvel;
+    if(prev->maxvel < vel) vel = prev->maxvel;
+    if(tc->maxvel < vel) vel = tc->maxvel;
+
+    acc = prev->maxaccel < tc->maxaccel ? prev->maxaccel : tc->maxaccel;
+    acc /= 2.0;
+    jerk = prev->maxjerk < tc->maxjerk ? prev->maxjerk : tc->maxjerk;
+    jerk /= 2.0;
+
+    v1 = tcGetEndingUnitVector(prev);
+    v2 = tcGetStartingUnitVector(tc);
+    pmCartCartDot(v1, v2, &dot);
+    if(dot > 1.0) dot = 1.0;
+    if(dot < -1.0) dot = -1.0;
+    sin_half = pmSqrt(0.5 * (1.0 - dot));
+    if(sin_half < TP_ANGLE_EPSILON)
+        return vel;
+
+    kink_vel = acc * tp->cycleTime / (2.0 * sin_half);
+    if(jerk > 0.0 && jerk * tp->cycleTime < acc)
+        kink_vel = jerk * pmSq(tp->cycleTime) / (2.0 * sin_half);
+    if(kink_vel >= vel)
+        return vel;
+
+    // can't keep the feed through this corner; still join the moves if
+    // that is faster than the blend velocity the tolerance would allow
+    if(prev->tolerance) {
+        double theta = acos(-dot)/2.0;
+        if(cos(theta) > 0.001 &&
+           kink_vel >= 2.0 * pmSqrt(acc * prev->tolerance / cos(theta)))
+            return kink_vel;
+    }
+    return 0.0;
+}
+
+// The lookahead planner.  The backward pass walks from the newest move
+// over the last tp->lookahead queued moves and gives each one the highest
+// final velocity from which all later moves can still be followed, with
+// a stop at the end of the newest move.  The forward pass then trims
+// final velocities that can't be reached from the move before.  This is
+// rerun every time a move is added, so the plan always ends in a stop.
+//
+// Adding a move only ever raises the backward velocities (the old newest
+// move no longer has to stop), so the backward pass stops at the first
+// move it can't raise: the moves before it are planned against values
+// that haven't changed.  Only the moves it did raise need trimming again.
+// In a long run of short moves that is still the whole stopping distance,
+// so the window is capped at TP_MAX_LOOKAHEAD.
+
+static void tpRunLookahead(TP_STRUCT *tp) {
+    TC_STRUCT *tc, *next;
+    int len, first, i;
+    double vel;
+
+    len = tcqLen(&tp->queue);
+    if(len == 0) return;
+    first = len - 1 - tp->lookahead;
+    if(first < 0) first = 0;
+
+    next = tcqItem(&tp->queue, len - 1, 0);
+    next->backvel = next->finalvel = 0.0;
+    for(i = len - 2; i >= first; i--) {
+        tc = tcqItem(&tp->queue, i, 0);
+        vel = tpPlanStartVel(next, next->backvel);
+        if(vel > tc->kink_vel) vel = tc->kink_vel;
+        if(vel <= tc->backvel + TP_VEL_EPSILON)
+            break;
+        tc->backvel = vel;
+        next = tc;
+    }
+
+    for(i = i + 1; i < len - 1; i++) {
+        tc = tcqItem(&tp->queue, i, 0);
+        if(i > 0)
+            vel = tcqItem(&tp->queue, i - 1, 0)->finalvel;
+        else
+            vel = tc->active ? tc->currentvel : 0.0;
+        vel = tpPlanStartVel(tc, vel);
+        tc->finalvel = vel < tc->backvel ? vel : tc->backvel;
+    }
+}
+
 int tpAddRigidTap(TP_STRUCT *tp, EmcPose end, double vel, double ini_maxvel, 
                   double acc, unsigned char enables) {
     TC_STRUCT tc;
@@ -302,6 +550,7 @@ int tpAddRigidTap(TP_STRUCT *tp, EmcPose end, double vel, double ini_maxvel,
     tc.progress = 0.0;
     tc.reqvel = vel;
     tc.maxaccel = acc;
+    tc.maxjerk = tp->jMax;
     tc.feed_override = 0.0;
     tc.maxvel = ini_maxvel;
     tc.id = tp->nextId;
@@ -309,9 +558,14 @@ int tpAddRigidTap(TP_STRUCT *tp, EmcPose end, double vel, double ini_maxvel,
     tc.atspeed = 1;
 
     tc.currentvel = 0.0;
+    tc.currentaccel = 0.0;
     tc.blending = 0;
     tc.blend_vel = 0.0;
     tc.vel_at_blend_start = 0.0;
+    tc.kink_vel = 0.0;
+    tc.finalvel = 0.0;
+    tc.backvel = 0.0;
+    tc.term_vel = 0.0;
 
     tc.coords.rigidtap.xyz = line_xyz;
     tc.coords.rigidtap.abc = abc;
@@ -419,6 +673,7 @@ int tpAddLine(TP_STRUCT * tp, EmcPose end, int type, double vel, double ini_maxv
     tc.progress = 0.0;
     tc.reqvel = vel;
     tc.maxaccel = acc;
+    tc.maxjerk = tp->jMax;
     tc.feed_override = 0.0;
     tc.maxvel = ini_maxvel;
     tc.id = tp->nextId;
@@ -426,9 +681,14 @@ int tpAddLine(TP_STRUCT * tp, EmcPose end, int type, double vel, double ini_maxv
     tc.atspeed = atspeed;
 
     tc.currentvel = 0.0;
+    tc.currentaccel = 0.0;
     tc.blending = 0;
     tc.blend_vel = 0.0;
     tc.vel_at_blend_start = 0.0;
+    tc.kink_vel = 0.0;
+    tc.finalvel = 0.0;
+    tc.backvel = 0.0;
+    tc.term_vel = 0.0;
 
     tc.coords.line.xyz = line_xyz;
     tc.coords.line.uvw = line_uvw;
@@ -452,11 +712,18 @@ int tpAddLine(TP_STRUCT * tp, EmcPose end, int type, double vel, double ini_maxv
     }
 
 
+    if (tp->lookahead) {
+        TC_STRUCT *prev = tcqItem(&tp->queue, tcqLen(&tp->queue) - 1, 0);
+        if (prev) prev->kink_vel = tpKinkVel(tp, prev, &tc);
+    }
+
     if (tcqPut(&tp->queue, tc) == -1) {
         rtapi_print_msg(RTAPI_MSG_ERR, "tcqPut failed.\n");
 	return -1;
     }
 
+    if (tp->lookahead) tpRunLookahead(tp);
+
     tp->goalPos = end;      // remember the end of this move, as it's
                             // the start of the next one.
     tp->done = 0;
@@ -530,6 +797,7 @@ int tpAddCircle(TP_STRUCT * tp, EmcPose end,
     tc.progress = 0.0;
     tc.reqvel = vel;
     tc.maxaccel = acc;
+    tc.maxjerk = tp->jMax;
     tc.feed_override = 0.0;
     tc.maxvel = ini_maxvel;
     tc.id = tp->nextId;
@@ -537,9 +805,14 @@ int tpAddCircle(TP_STRUCT * tp, EmcPose end,
     tc.atspeed = atspeed;
 
     tc.currentvel = 0.0;
+    tc.currentaccel = 0.0;
     tc.blending = 0;
     tc.blend_vel = 0.0;
     tc.vel_at_blend_start = 0.0;
+    tc.kink_vel = 0.0;
+    tc.finalvel = 0.0;
+    tc.backvel = 0.0;
+    tc.term_vel = 0.0;
 
     tc.coords.circle.xyz = circle;
     tc.coords.circle.uvw = line_uvw;
@@ -563,10 +836,17 @@ int tpAddCircle(TP_STRUCT * tp, EmcPose end,
     }
 
 
+    if (tp->lookahead) {
+        TC_STRUCT *prev = tcqItem(&tp->queue, tcqLen(&tp->queue) - 1, 0);
+        if (prev) prev->kink_vel = tpKinkVel(tp, prev, &tc);
+    }
+
     if (tcqPut(&tp->queue, tc) == -1) {
 	return -1;
     }
 
+    if (tp->lookahead) tpRunLookahead(tp);
+
     tp->goalPos = end;
     tp->done = 0;
     tp->depth = tcqLen(&tp->queue);
@@ -575,12 +855,139 @@ int tpAddCircle(TP_STRUCT * tp, EmcPose end,
     return 0;
 }
 
+// Move the acceleration from a0 toward a as fast as the jerk allows
+// for time t, holding it once it gets there.  Leaves the velocity and
+// acceleration then in *vt and *at, and returns the distance covered.
+
+static double tcJerkStep(double v0, double a0, double a, double j, double t,
+        double *vt, double *at) {
+    double r = fabs(a - a0) / j, h, v1;
+
+    if(r > t) r = t;
+    if(a < a0) j = -j;
+    v1 = v0 + a0 * r + 0.5 * j * r * r;
+    *at = a0 + j * r;
+    h = t - r;
+    *vt = v1 + *at * h;
+    return v0 * r + 0.5 * a0 * r * r + j * r * r * r / 6.0 + v1 * h + 0.5 * *at * h * h;
+}
+
+// S-curve version of the profile in tcRunCycle.  Each cycle steer the
+// velocity toward the limit, changing the acceleration by no more than
+// the jerk allows, until the quickest stop from where that leaves us
+// would take us past the end of the move (or, when the move ends at
+// term_vel, past the point where a stop from term_vel would end).  Then
+// steer only until the stop needs just the distance that is left, part
+// way through the cycle, and follow the stop from there.  Following it
+// exactly is what makes the move end at its target, with the velocity
+// and acceleration reaching 0 together and the jerk kept in bounds.
+
+static void tcRunCycleJerk(TP_STRUCT *tp, TC_STRUCT *tc, double *v, int *on_final_decel) {
+    double dt = tc->cycle_time;
+    double amax = tc->maxaccel, j = tc->maxjerk;
+    double v0 = tc->currentvel, a0 = tc->currentaccel;
+    double dist, vlim, lo, hi, mid, midvel, midaccel, step;
+    double newaccel, newvel;
+    int braking = 0, i;
+
+    dist = tc->target - tc->progress;
+    if(tc->term_vel > 0.0)
+        dist += tcJerkStopDist(tc->term_vel, 0.0, amax, j);
+
+    vlim = tc->reqvel * tc->feed_override;
+    if(vlim > tc->maxvel) vlim = tc->maxvel;
+    if(!(tc->motion_type == TC_LINEAR && tc->coords.line.xyz.tmag_zero && tc->coords.line.uvw.tmag_zero)) {
+        if((!tc->synchronized || tc->velocity_mode) && vlim > tp->vLimit) {
+            vlim = tp->vLimit;
+        }
+    }
+
+    // steer toward vlim: the acceleration after which ramping it back
+    // to 0 brings the velocity to vlim
+    lo = a0 - j * dt;
+    if(lo < -amax) lo = -amax;
+    hi = a0 + j * dt;
+    if(hi > amax) hi = amax;
+    for(i = 0; i < 40; i++) {
+        mid = 0.5 * (lo + hi);
+        tcJerkStep(v0, a0, mid, j, dt, &midvel, &midaccel);
+        if(midvel + 0.5 * mid * fabs(mid) / j > vlim)
+            hi = mid;
+        else
+            lo = mid;
+    }
+    newaccel = lo;
+    step = tcJerkStep(v0, a0, newaccel, j, dt, &newvel, &midaccel);
+
+    // near enough is handled as a stop too, so that the stop that ends
+    // the move isn't left a hair short of the target
+    if(tcJerkStopDist(newvel, newaccel, amax, j) > dist - step - TP_VEL_EPSILON * dt) {
+        // brake: find how long we can keep steering before the stop
+        // needs all the distance that is left
+        double t = 0.0, tmax = dt;
+
+        braking = 1;
+        if(tcJerkStopDist(v0, a0, amax, j) < dist) {
+            for(i = 0; i < 40; i++) {
+                mid = 0.5 * (t + tmax);
+                step = tcJerkStep(v0, a0, newaccel, j, mid, &midvel, &midaccel);
+                if(tcJerkStopDist(midvel, midaccel, amax, j) > dist - step)
+                    tmax = mid;
+                else
+                    t = mid;
+            }
+        }
+        step = tcJerkStep(v0, a0, newaccel, j, t, &midvel, &midaccel);
+        step += tcJerkStop(midvel, midaccel, amax, j, dt - t, &newvel, &newaccel);
+    }
+
+    if(braking && tc->finalvel == 0.0 && newvel == 0.0) {
+        // the stop ended during this cycle
+        tc->progress = tc->target;
+    } else {
+        if(newvel < 0.0) {
+            // only when told to stop (vlim 0), which the steering gets
+            // to with the acceleration reaching 0 at the same time
+            newvel = newaccel = 0.0;
+        }
+        tc->progress += step;
+        if(tc->progress > tc->target && tc->finalvel == 0.0) {
+            // should never happen: means we've overshot the target
+            newvel = newaccel = 0.0;
+            tc->progress = tc->target;
+        }
+    }
+    tc->currentvel = newvel;
+    tc->currentaccel = newaccel;
+    if(v) *v = newvel;
+    if(on_final_decel) *on_final_decel = braking;
+}
+
 void tcRunCycle(TP_STRUCT *tp, TC_STRUCT *tc, double *v, int *on_final_decel) {
     double discr, maxnewvel, newvel, newaccel=0;
+    double dist;
     if(!tc->blending) tc->vel_at_blend_start = tc->currentvel;
 
-    discr = 0.5 * tc->cycle_time * tc->currentvel - (tc->target - tc->progress);
-    if(discr > 0.0) {
+    // position synced moves have to follow the spindle, so they keep
+    // the trapezoidal profile
+    if(tc->maxjerk > 0.0 && !tc->synchronized) {
+        tcRunCycleJerk(tp, tc, v, on_final_decel);
+        return;
+    }
+
+    // when lookahead lets us end this move at term_vel, plan to stop
+    // that much further along, where slowing on from term_vel would end
+    dist = tc->target - tc->progress;
+    if(tc->term_vel > 0.0)
+        dist += pmSq(tc->term_vel) / (2.0 * tc->maxaccel);
+
+    discr = 0.5 * tc->cycle_time * tc->currentvel - dist;
+    if(discr > 0.0 && tc->finalvel > 0.0) {
+        // too fast to end at term_vel (it dropped, say for feed
+        // override).  lookahead planned the following moves so we can
+        // slow down in them instead, so just brake as hard as we may.
+        newvel = maxnewvel = tc->currentvel - tc->maxaccel * tc->cycle_time;
+    } else if(discr > 0.0) {
         // should never happen: means we've overshot the target
         newvel = maxnewvel = 0.0;
     } else {
@@ -624,6 +1031,7 @@ void tcRunCycle(TP_STRUCT *tp, TC_STRUCT *tc, double *v, int *on_final_decel) {
         tc->progress += (newvel + tc->currentvel) * 0.5 * tc->cycle_time;
     }
     tc->currentvel = newvel;
+    tc->currentaccel = newaccel;
     if(v) *v = newvel;
     if(on_final_decel) *on_final_decel = fabs(maxnewvel - newvel) < 0.001;
 }
@@ -679,9 +1087,10 @@ int tpRunCycle(TP_STRUCT * tp, long period)
     static double spindleoffset;
     static int waiting_for_index = MOTION_INVALID_ID;
     static int waiting_for_atspeed = MOTION_INVALID_ID;
-    double save_vel;
+    double save_vel, save_accel;
     static double revs;
     EmcPose target;
+    double overshoot;
 
     emcmotStatus->tcqlen = tcqLen(&tp->queue);
     emcmotStatus->requested_vel = 0.0;
@@ -722,17 +1131,36 @@ int tpRunCycle(TP_STRUCT * tp, long period)
                 return 0;
         }
 
-        // done with this move
+        // done with this move.  if lookahead let it end at speed, the
+        // next move starts at that speed.
+        save_vel = tc->finalvel > 0.0 ? tc->currentvel : 0.0;
+        save_accel = tc->finalvel > 0.0 ? tc->currentaccel : 0.0;
         tcqRemove(&tp->queue, 1);
 
         // so get next move
         tc = tcqItem(&tp->queue, 0, period);
         if(!tc) return 0;
+        if(!tc->active) {
+            tc->currentvel = save_vel;
+            tc->currentaccel = save_accel;
+        }
     }
 
     // now we have the active tc.  get the upcoming one, if there is one.
     // it's not an error if there isn't another one - we just don't
     // do blending.  This happens in MDI for instance.
+    // single stepping stops at the end of every move, whatever speed
+    // the lookahead planned to end it at.  The lookahead only guarantees
+    // a stop at the end of the newest move, so a move in the middle of
+    // the queue may be planned to end at speed, and without this it would
+    // run into the next move when stepping is on and nexttc isn't used.
+    // If stepping is turned on late in such a move, there may no longer
+    // be room to slow down to 0: tcRunCycle brakes as hard as it may and
+    // then clamps to the end of the move, so the last cycle steps the
+    // velocity down to 0.
+    if(emcmotDebug->stepping)
+        tc->finalvel = 0.0;
+
     if(!emcmotDebug->stepping && tc->blend_with_next) 
         nexttc = tcqItem(&tp->queue, 1, period);
     else
@@ -830,15 +1258,17 @@ int tpRunCycle(TP_STRUCT * tp, long period)
         }
 
         tc->active = 1;
-        tc->currentvel = 0;
+        // currentvel is 0 unless the move before handed on its speed
         tp->depth = tp->activeDepth = 1;
         tp->motionType = tc->canon_motion_type;
         tc->blending = 0;
 
         // honor accel constraint in case we happen to make an acute angle
-        // with the next segment.
-        if(tc->blend_with_next) 
+        // with the next segment.  the jerk adds up the same way.
+        if(tc->blend_with_next) {
             tc->maxaccel /= 2.0;
+            tc->maxjerk /= 2.0;
+        }
 
         if(tc->synchronized) {
             if(!tc->velocity_mode && !emcmotStatus->spindleSync) {
@@ -933,14 +1363,17 @@ int tpRunCycle(TP_STRUCT * tp, long period)
         // this means this tc is being read for the first time.
 
         nexttc->currentvel = 0;
+        nexttc->currentaccel = 0;
         tp->depth = tp->activeDepth = 1;
         nexttc->active = 1;
         nexttc->blending = 0;
 
         // honor accel constraint if we happen to make an acute angle with the
         // above segment or the following one
-        if(tc->blend_with_next || nexttc->blend_with_next)
+        if(tc->blend_with_next || nexttc->blend_with_next) {
             nexttc->maxaccel /= 2.0;
+            nexttc->maxjerk /= 2.0;
+        }
     }
 
 
@@ -1028,10 +1461,20 @@ int tpRunCycle(TP_STRUCT * tp, long period)
         }
     }
 
+    // lookahead: end at the planned velocity, or slower if that's all
+    // the next move may have right now.  joined moves don't blend.
+    tc->term_vel = 0.0;
+    if(nexttc && tc->finalvel > 0.0) {
+        tc->term_vel = tc->finalvel;
+        if(tc->term_vel > nexttc->reqvel * nexttc->feed_override)
+            tc->term_vel = nexttc->reqvel * nexttc->feed_override;
+        tc->blend_vel = 0.0;
+    }
+
     // calculate the approximate peak velocity the nexttc will hit.
     // we know to start blending it in when the current tc goes below
     // this velocity...
-    if(nexttc && nexttc->maxaccel) {
+    if(nexttc && nexttc->maxaccel && tc->finalvel == 0.0) {
         tc->blend_vel = nexttc->maxaccel * 
             pmSqrt(nexttc->target / nexttc->maxaccel);
         if(tc->blend_vel > nexttc->reqvel * nexttc->feed_override) {
@@ -1077,6 +1520,13 @@ int tpRunCycle(TP_STRUCT * tp, long period)
 
     primary_before = tcGetPos(tc);
     tcRunCycle(tp, tc, &primary_vel, &on_final_decel);
+    overshoot = 0.0;
+    if(tc->finalvel > 0.0 && tc->progress > tc->target) {
+        // ran off the end at speed; the rest of this cycle's distance
+        // is made in the next move below
+        overshoot = tc->progress - tc->target;
+        tc->progress = tc->target;
+    }
     primary_after = tcGetPos(tc);
     pmCartCartSub(primary_after.tran, primary_before.tran, 
             &primary_displacement.tran);
@@ -1149,6 +1599,23 @@ int tpRunCycle(TP_STRUCT * tp, long period)
         tp->currentPos.u += primary_displacement.u + secondary_displacement.u;
         tp->currentPos.v += primary_displacement.v + secondary_displacement.v;
         tp->currentPos.w += primary_displacement.w + secondary_displacement.w;
+    } else if(nexttc && tc->finalvel > 0.0 && tc->progress == tc->target &&
+              tc->currentvel > 0.0) {
+        // lookahead joined this move to the next one and we reached the
+        // end at speed: hand the speed and leftover distance to nexttc
+        nexttc->currentvel = tc->currentvel;
+        nexttc->currentaccel = tc->currentaccel;
+        nexttc->progress = overshoot < nexttc->target ? overshoot : nexttc->target;
+	tpToggleDIOs(nexttc); //check and do DIO changes
+        target = tcGetEndpoint(nexttc);
+        tp->motionType = nexttc->canon_motion_type;
+	emcmotStatus->distance_to_go = nexttc->target - nexttc->progress;
+        tp->currentPos = tcGetPos(nexttc);
+        emcmotStatus->current_vel = nexttc->currentvel;
+        emcmotStatus->requested_vel = nexttc->reqvel;
+	emcmotStatus->enables_queued = nexttc->enables;
+	// report our line number to the guis
+	tp->execId = nexttc->id;
     } else {
 	tpToggleDIOs(tc); //check and do DIO changes
         target = tcGetEndpoint(tc);
@@ -19,6 +19,9 @@
 
 #define TP_DEFAULT_QUEUE_SIZE 32
 
+/* most queued moves the lookahead may plan over */
+#define TP_MAX_LOOKAHEAD 500
+
 /* closeness to zero, for determining if a move is pure rotation */
 #define TP_PURE_ROTATION_EPSILON 1e-6
 
@@ -26,6 +29,10 @@
 #define TP_VEL_EPSILON 1e-6
 #define TP_ACCEL_EPSILON 1e-6
 
+/* closeness to zero of sin(half the angle between two moves), for
+   determining if they are collinear */
+#define TP_ANGLE_EPSILON 1e-6
+
 typedef struct {
     TC_QUEUE_STRUCT queue;
     int queueSize;
@@ -36,6 +43,7 @@ typedef struct {
                                    subsequent moves */
     double vScale;		/* feed override value */
     double aMax;
+    double jMax;		/* jerk limit for subsequent moves, 0 = none */
     double vLimit;		/* absolute upper limit on all vels */
     double wMax;		/* rotational velocity max */
     double wDotMax;		/* rotational accelleration max */
@@ -57,6 +65,8 @@ typedef struct {
     int velocity_mode; 	        /* TRUE if spindle sync is in velocity mode,
 				   FALSE if in position mode */
     double uu_per_rev;          /* user units per spindle revolution */
+    int lookahead;		/* number of queued motions to plan final
+				   velocities over, 0 = no lookahead */
 } TP_STRUCT;
 
 extern int tpCreate(TP_STRUCT * tp, int _queueSize, TC_STRUCT * tcSpace);
@@ -67,6 +77,8 @@ extern int tpSetCycleTime(TP_STRUCT * tp, double secs);
 extern int tpSetVmax(TP_STRUCT * tp, double vmax, double ini_maxvel);
 extern int tpSetVlimit(TP_STRUCT * tp, double limit);
 extern int tpSetAmax(TP_STRUCT * tp, double amax);
+extern int tpSetJmax(TP_STRUCT * tp, double jmax);
+extern int tpSetLookahead(TP_STRUCT * tp, int depth);
 extern int tpSetId(TP_STRUCT * tp, int id);
 extern int tpGetExecId(TP_STRUCT * tp);
 extern int tpSetTermCond(TP_STRUCT * tp, int cond, double tolerance);
@@ -0,0 +1,306 @@
+/********************************************************************
+* Description: tpsim.c
+*   Run the trajectory planner offline, outside the motion module.
+*
+*   Reads the canonical commands printed by the rs274 standalone
+*   interpreter, feeds the moves to tp.c and runs the servo loop as
+*   fast as it will go.  Reports the machining time, the peak tool tip
+*   acceleration (and jerk, when limited), how many times the tool came
+*   to a stop, where it ended up and how long each tpRunCycle call took,
+*   and optionally writes per-cycle position/velocity/acceleration as CSV.
+*
+*     rs274 -g part.ngc | tpsim -v 2 -a 20 -o part.csv
+*
+* License: GPL Version 2
+* System: Linux
+*
+* Copyright (c) 2026 All rights reserved.
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include "rtapi.h"
+#include "posemath.h"
+#include "emcpos.h"
+#include "tc.h"
+#include "tp.h"
+#include "motion.h"
+#include "hal.h"
+#include "mot_priv.h"
+#include "motion_debug.h"
+#include "motion_types.h"
+
+/* what tp.c expects to find in the motion module */
+static emcmot_status_t simStatus;
+static emcmot_debug_t simDebug;
+emcmot_status_t *emcmotStatus = &simStatus;
+emcmot_debug_t *emcmotDebug = &simDebug;
+int num_dio = EMCMOT_MAX_DIO;
+int num_aio = EMCMOT_MAX_AIO;
+
+void emcmotDioWrite(int index, char value) { }
+void emcmotAioWrite(int index, double value) { }
+void emcmotSetRotaryUnlock(int axis, int unlock) { }
+int emcmotGetRotaryIsUnlocked(int axis) { return 1; }
+
+/* keep about this many moves queued, like task does */
+#define TPSIM_QUEUE_FILL 200
+
+static TP_STRUCT *tp = &simDebug.queue;
+static double vmax = 1.0, amax = 10.0, cycle_time = 0.001;
+static double feed = 0.0;
+static int plane = 1;		/* 1 = XY, 2 = YZ, 3 = XZ */
+static int moves = 0, lineno = 0;
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+	"usage: %s [-c cycle_time] [-v max_velocity] [-a max_acceleration]\n"
+	"       [-j max_jerk] [-l lookahead] [-o output.csv] [canon.txt]\n"
+	"Reads rs274 canonical output (stdin by default) and runs the\n"
+	"trajectory planner on it.  Units are those of the program, per\n"
+	"second; limits apply to the tool tip as [TRAJ] limits do.\n", name);
+}
+
+/* feed one line of rs274 output to the planner; returns -1 when the
+   planner rejects a move */
+static int canon_line(char *line)
+{
+    EmcPose end;
+    PmCartesian center, normal;
+    double x, y, z, a, b, c, fe, se, fa, sa, ae, tol;
+    int rot, retval = 0;
+    char *p;
+
+    lineno++;
+    if ((p = strstr(line, "STRAIGHT_TRAVERSE(")) &&
+	sscanf(p + 18, "%lf, %lf, %lf, %lf, %lf, %lf",
+	    &x, &y, &z, &a, &b, &c) == 6) {
+	ZERO_EMC_POSE(end);
+	end.tran.x = x; end.tran.y = y; end.tran.z = z;
+	end.a = a; end.b = b; end.c = c;
+	tpSetId(tp, lineno);
+	retval = tpAddLine(tp, end, EMC_MOTION_TYPE_TRAVERSE, vmax, vmax,
+	    amax, 0, 0, -1);
+	moves++;
+    } else if ((p = strstr(line, "STRAIGHT_FEED(")) &&
+	sscanf(p + 14, "%lf, %lf, %lf, %lf, %lf, %lf",
+	    &x, &y, &z, &a, &b, &c) == 6) {
+	ZERO_EMC_POSE(end);
+	end.tran.x = x; end.tran.y = y; end.tran.z = z;
+	end.a = a; end.b = b; end.c = c;
+	tpSetId(tp, lineno);
+	retval = tpAddLine(tp, end, EMC_MOTION_TYPE_FEED, feed, vmax,
+	    amax, 0, 0, -1);
+	moves++;
+    } else if ((p = strstr(line, "ARC_FEED(")) &&
+	sscanf(p + 9, "%lf, %lf, %lf, %lf, %d, %lf, %lf, %lf, %lf",
+	    &fe, &se, &fa, &sa, &rot, &ae, &a, &b, &c) == 9) {
+	// same mapping emccanon.cc uses for the three planes
+	ZERO_EMC_POSE(end);
+	end.a = a; end.b = b; end.c = c;
+	normal.x = normal.y = normal.z = 0.0;
+	if (plane == 2) {
+	    end.tran.y = fe; end.tran.z = se; end.tran.x = ae;
+	    center.y = fa; center.z = sa; center.x = ae;
+	    normal.x = 1.0;
+	} else if (plane == 3) {
+	    end.tran.z = fe; end.tran.x = se; end.tran.y = ae;
+	    center.z = fa; center.x = sa; center.y = ae;
+	    normal.y = 1.0;
+	} else {
+	    end.tran.x = fe; end.tran.y = se; end.tran.z = ae;
+	    center.x = fa; center.y = sa; center.z = ae;
+	    normal.z = 1.0;
+	}
+	tpSetId(tp, lineno);
+	retval = tpAddCircle(tp, end, center, normal,
+	    rot > 0 ? rot - 1 : rot, EMC_MOTION_TYPE_ARC, feed, vmax,
+	    amax, 0, 0);
+	moves++;
+    } else if ((p = strstr(line, "SET_FEED_RATE("))) {
+	// canon feed rates are per minute
+	feed = strtod(p + 14, NULL) / 60.0;
+    } else if ((p = strstr(line, "SELECT_PLANE(CANON_PLANE_"))) {
+	p += 25;
+	plane = !strncmp(p, "YZ", 2) ? 2 : !strncmp(p, "XZ", 2) ? 3 : 1;
+    } else if ((p = strstr(line, "SET_MOTION_CONTROL_MODE("))) {
+	if (sscanf(p + 24, "CANON_CONTINUOUS, %lf", &tol) == 1) {
+	    tpSetTermCond(tp, TC_TERM_COND_BLEND, tol);
+	} else {
+	    tpSetTermCond(tp, TC_TERM_COND_STOP, 0.0);
+	}
+    }
+    if (retval) {
+	fprintf(stderr, "tpsim: planner rejected move on line %d: %s",
+	    lineno, line);
+	return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in = stdin, *out = NULL;
+    char line[1024];
+    double jmax = 0.0, t, dx, dy, dz, vx, vy, vz, vel, acc;
+    double last_vx = 0.0, last_vy = 0.0, last_vz = 0.0, peak_acc = 0.0;
+    double ax, ay, az, jerk;
+    double last_ax = 0.0, last_ay = 0.0, last_az = 0.0, peak_jerk = 0.0;
+    long long start, ns, total_ns = 0, max_ns = 0;
+    long cycles = 0, over = 0, jerk_over = 0, stops = 0;
+    long period;
+    int lookahead = 0, eof = 0, stopped = 1, opt;
+    int head_id = -1, head_stops = 0;
+    TC_STRUCT *head;
+    EmcPose pos, last;
+
+    while ((opt = getopt(argc, argv, "c:v:a:j:l:o:h")) != -1) {
+	switch (opt) {
+	case 'c': cycle_time = atof(optarg); break;
+	case 'v': vmax = atof(optarg); break;
+	case 'a': amax = atof(optarg); break;
+	case 'j': jmax = atof(optarg); break;
+	case 'l': lookahead = atoi(optarg); break;
+	case 'o':
+	    if (!(out = fopen(optarg, "w"))) {
+		perror(optarg);
+		return 1;
+	    }
+	    break;
+	default:
+	    usage(argv[0]);
+	    return opt != 'h';
+	}
+    }
+    if (optind < argc && !(in = fopen(argv[optind], "r"))) {
+	perror(argv[optind]);
+	return 1;
+    }
+    if (cycle_time <= 0.0 || vmax <= 0.0 || amax <= 0.0) {
+	usage(argv[0]);
+	return 1;
+    }
+    period = (long) (cycle_time * 1e9 + 0.5);
+
+    simStatus.net_feed_scale = 1.0;
+    simStatus.spindle_is_atspeed = 1;
+    if (-1 == tpCreate(tp, DEFAULT_TC_QUEUE_SIZE, simDebug.queueTcSpace)) {
+	fprintf(stderr, "tpsim: failed to create the planner\n");
+	return 1;
+    }
+    tpSetCycleTime(tp, cycle_time);
+    tpSetVmax(tp, vmax, vmax);
+    tpSetVlimit(tp, vmax);
+    tpSetAmax(tp, amax);
+    tpSetJmax(tp, jmax);
+    tpSetLookahead(tp, lookahead);
+    last = tpGetPos(tp);
+
+    if (out)
+	fprintf(out, "time,x,y,z,vel,acc\n");
+
+    while (!eof || !tpIsDone(tp)) {
+	while (!eof && tpQueueDepth(tp) < TPSIM_QUEUE_FILL) {
+	    if (!fgets(line, sizeof(line), in)) {
+		eof = 1;
+	    } else if (canon_line(line)) {
+		return 1;
+	    }
+	}
+
+	start = now_ns();
+	tpRunCycle(tp, period);
+	ns = now_ns() - start;
+	total_ns += ns;
+	if (ns > max_ns)
+	    max_ns = ns;
+	cycles++;
+
+	// tool tip velocity and acceleration from the commanded positions
+	pos = tpGetPos(tp);
+	dx = pos.tran.x - last.tran.x;
+	dy = pos.tran.y - last.tran.y;
+	dz = pos.tran.z - last.tran.z;
+	vx = dx / cycle_time;
+	vy = dy / cycle_time;
+	vz = dz / cycle_time;
+	vel = sqrt(vx * vx + vy * vy + vz * vz);
+	ax = (vx - last_vx) / cycle_time;
+	ay = (vy - last_vy) / cycle_time;
+	az = (vz - last_vz) / cycle_time;
+	acc = sqrt(ax * ax + ay * ay + az * az);
+	jerk = sqrt((ax - last_ax) * (ax - last_ax) +
+	    (ay - last_ay) * (ay - last_ay) +
+	    (az - last_az) * (az - last_az)) / cycle_time;
+	if (acc > peak_acc)
+	    peak_acc = acc;
+	if (jerk > peak_jerk)
+	    peak_jerk = jerk;
+	// allow for rounding in the discrete differences
+	if (acc > amax * (1.0 + 1e-6))
+	    over++;
+	if (jmax > 0.0 && jerk > jmax * (1.0 + 1e-3))
+	    jerk_over++;
+	// count each time the tool slows to (nearly) nothing, whether at
+	// a corner, the end, or somewhere it shouldn't.  An exact stop
+	// starts the next move in the same cycle the last one ends, so
+	// the tool never sits still for a whole cycle; count a move that
+	// ended at 0 without blending into the next one as a stop too.
+	head = tcqItem(&tp->queue, 0, 0);
+	if ((!head || head->id != head_id) && head_id != -1 && head_stops) {
+	    if (!stopped)
+		stops++;
+	    stopped = 1;
+	} else if (vel < vmax * 1e-3) {
+	    if (!stopped)
+		stops++;
+	    stopped = 1;
+	} else {
+	    stopped = 0;
+	}
+	head_id = head ? head->id : -1;
+	head_stops = head && head->finalvel == 0.0 && !head->blending;
+	last = pos;
+	last_vx = vx;
+	last_vy = vy;
+	last_vz = vz;
+	last_ax = ax;
+	last_ay = ay;
+	last_az = az;
+
+	if (out) {
+	    t = cycles * cycle_time;
+	    fprintf(out, "%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+		t, pos.tran.x, pos.tran.y, pos.tran.z, vel, acc);
+	}
+    }
+
+    if (out)
+	fclose(out);
+    printf("moves: %d\n", moves);
+    printf("cycles: %ld\n", cycles);
+    printf("machining time: %.3f s\n", cycles * cycle_time);
+    printf("peak acceleration: %.3f (limit %.3f), %ld cycles over\n",
+	peak_acc, amax, over);
+    if (jmax > 0.0)
+	printf("peak jerk: %.3f (limit %.3f), %ld cycles over\n",
+	    peak_jerk, jmax, jerk_over);
+    printf("stops: %ld\n", stops);
+    printf("end: %.6f %.6f %.6f\n", last.tran.x, last.tran.y, last.tran.z);
+    printf("tpRunCycle: %.0f ns average, %lld ns max\n",
+	cycles ? (double) total_ns / cycles : 0.0, max_ns);
+    return 0;
+}
@@ -61,6 +61,7 @@
 #include <float.h>
 #include "posemath.h"
 #include "rtapi.h"
+#include "rtapi_bitops.h"
 #include "hal.h"
 #include "motion.h"
 #include "motion_debug.h"
@@ -343,10 +344,10 @@ static int is_feed_type(int motion_type)
 }
 
 /*
-  emcmotCommandHandler() is called each main cycle to read the
-  shared memory buffer
+  emcmotCommandExecute() executes the command emcmotCommand points to,
+  which is the oldest unread slot of the command ring
   */
-void emcmotCommandHandler(void *arg, long period)
+static void emcmotCommandExecute(void)
 {
     int joint_num;
     int n;
@@ -357,15 +358,10 @@ void emcmotCommandHandler(void *arg, long period)
     
 check_stuff ( "before command_handler()" );
 
-    /* check for split read */
-    if (emcmotCommand->head != emcmotCommand->tail) {
-	emcmotDebug->split++;
-	return;			/* not really an error */
-    }
     if (emcmotCommand->commandNum != emcmotStatus->commandNumEcho) {
-	/* increment head count-- we'll be modifying emcmotStatus */
-	emcmotStatus->head++;
-	emcmotDebug->head++;
+	/* readers retry while we modify emcmotStatus */
+	EMCMOT_SEQ_BEGIN(emcmotStatus);
+	EMCMOT_SEQ_BEGIN(emcmotDebug);
 
 	/* got a new command-- echo command and number... */
 	emcmotStatus->commandEcho = emcmotCommand->command;
@@ -424,6 +420,8 @@ check_stuff ( "before command_handler()" );
 		}
 	    }
             SET_MOTION_ERROR_FLAG(0);
+	    /* task has seen the refused move, so take moves again */
+	    emcmotStatus->queueFailNum = 0;
 	    /* clear joint errors (regardless of mode */	    
 	    for (joint_num = 0; joint_num < num_joints; joint_num++) {
 		/* point to joint struct */
@@ -868,7 +866,11 @@ check_stuff ( "before command_handler()" );
 	    /* emcmotDebug->queue up a linear move */
 	    /* requires coordinated mode, enable off, not on limits */
 	    rtapi_print_msg(RTAPI_MSG_DBG, "SET_LINE");
-	    if (!GET_MOTION_COORD_FLAG() || !GET_MOTION_ENABLE_FLAG()) {
+	    if (emcmotStatus->queueFailNum) {
+		/* the rest of the program went after a refused move */
+		emcmotStatus->commandStatus = EMCMOT_COMMAND_BAD_EXEC;
+		break;
+	    } else if (!GET_MOTION_COORD_FLAG() || !GET_MOTION_ENABLE_FLAG()) {
 		reportError
 		    (_("need to be enabled, in coord mode for linear move"));
 		emcmotStatus->commandStatus = EMCMOT_COMMAND_INVALID_COMMAND;
@@ -917,7 +919,11 @@ check_stuff ( "before command_handler()" );
 	    /* emcmotDebug->queue up a circular move */
 	    /* requires coordinated mode, enable on, not on limits */
 	    rtapi_print_msg(RTAPI_MSG_DBG, "SET_CIRCLE");
-	    if (!GET_MOTION_COORD_FLAG() || !GET_MOTION_ENABLE_FLAG()) {
+	    if (emcmotStatus->queueFailNum) {
+		/* the rest of the program went after a refused move */
+		emcmotStatus->commandStatus = EMCMOT_COMMAND_BAD_EXEC;
+		break;
+	    } else if (!GET_MOTION_COORD_FLAG() || !GET_MOTION_ENABLE_FLAG()) {
 		reportError
 		    (_("need to be enabled, in coord mode for circular move"));
 		emcmotStatus->commandStatus = EMCMOT_COMMAND_INVALID_COMMAND;
@@ -1010,6 +1016,27 @@ check_stuff ( "before command_handler()" );
 	    tpSetAmax(&emcmotDebug->queue, emcmotStatus->acc);
 	    break;
 
+	case EMCMOT_SET_JERK:
+	    /* set the max jerk for subsequent moves */
+	    /* can do it at any time */
+	    rtapi_print_msg(RTAPI_MSG_DBG, "SET_JERK");
+	    if (-1 == tpSetJmax(&emcmotDebug->queue, emcmotCommand->jerk)) {
+		emcmotStatus->commandStatus = EMCMOT_COMMAND_INVALID_PARAMS;
+	    }
+	    break;
+
+	case EMCMOT_SET_LOOKAHEAD:
+	    /* set the number of queued moves to plan velocities over */
+	    /* can do it at any time */
+	    rtapi_print_msg(RTAPI_MSG_DBG, "SET_LOOKAHEAD");
+	    if (emcmotCommand->axis < 0 ||
+		emcmotCommand->axis > TP_MAX_LOOKAHEAD) {
+		emcmotStatus->commandStatus = EMCMOT_COMMAND_INVALID_PARAMS;
+		break;
+	    }
+	    tpSetLookahead(&emcmotDebug->queue, emcmotCommand->axis);
+	    break;
+
 	case EMCMOT_PAUSE:
 	    /* pause the motion */
 	    /* can happen at any time */
@@ -1203,7 +1230,7 @@ check_stuff ( "before command_handler()" );
 	    if (emcmotStatus->motion_state != EMCMOT_MOTION_FREE) {
 		/* can't home unless in free mode */
 		reportError(_("must be in joint mode to home"));
-		return;
+		goto command_done;
 	    }
 	    if (!GET_MOTION_ENABLE_FLAG()) {
 		break;
@@ -1253,7 +1280,7 @@ check_stuff ( "before command_handler()" );
             
             if ((emcmotStatus->motion_state != EMCMOT_MOTION_FREE) && (emcmotStatus->motion_state != EMCMOT_MOTION_DISABLED)) {
                 reportError(_("must be in joint mode or disabled to unhome"));
-                return;
+                goto command_done;
             }
 
             if (joint_num < 0) {
@@ -1265,11 +1292,11 @@ check_stuff ( "before command_handler()" );
                     if(GET_JOINT_ACTIVE_FLAG(joint)) {
                         if (GET_JOINT_HOMING_FLAG(joint)) {
                             reportError(_("Cannot unhome while homing, joint %d"), n);
-                            return;
+                            goto command_done;
                         }
                         if (!GET_JOINT_INPOS_FLAG(joint)) {
                             reportError(_("Cannot unhome while moving, joint %d"), n);
-                            return;
+                            goto command_done;
                         }
                     }
                 }
@@ -1288,11 +1315,11 @@ check_stuff ( "before command_handler()" );
                 if(GET_JOINT_ACTIVE_FLAG(joint)) {
                     if (GET_JOINT_HOMING_FLAG(joint)) {
                         reportError(_("Cannot unhome while homing, joint %d"), joint_num);
-                        return;
+                        goto command_done;
                     }
                     if (!GET_JOINT_INPOS_FLAG(joint)) {
                         reportError(_("Cannot unhome while moving, joint %d"), joint_num);
-                        return;
+                        goto command_done;
                     }
                     SET_JOINT_HOMED_FLAG(joint, 0);
                 } else {
@@ -1301,7 +1328,7 @@ check_stuff ( "before command_handler()" );
             } else {
                 /* invalid joint number specified */
                 reportError(_("Cannot unhome invalid joint %d (max %d)"), joint_num, (num_joints-1));
-                return;
+                goto command_done;
             }
 
             break;
@@ -1628,15 +1655,30 @@ check_stuff ( "before command_handler()" );
 	    break;
 
 	}			/* end of: command switch */
+    command_done:
+	/* every command, even one refused part way through, ends here so
+	   the structs opened above are closed again */
 	if (emcmotStatus->commandStatus != EMCMOT_COMMAND_OK) {
 	    rtapi_print_msg(RTAPI_MSG_DBG, "ERROR: %d",
 		emcmotStatus->commandStatus);
+	    /* task doesn't wait to hear how queued moves went, so keep
+	       the first refusal until it aborts */
+	    if ((emcmotCommand->command == EMCMOT_SET_LINE ||
+		    emcmotCommand->command == EMCMOT_SET_CIRCLE) &&
+		0 == emcmotStatus->queueFailNum) {
+		emcmotStatus->queueFailNum = emcmotCommand->commandNum;
+	    }
 	}
 	rtapi_print_msg(RTAPI_MSG_DBG, "\n");
-	/* synch tail count */
-	emcmotStatus->tail = emcmotStatus->head;
-	emcmotConfig->tail = emcmotConfig->head;
-	emcmotDebug->tail = emcmotDebug->head;
+	/* queued motions are picked up from the ring before the status is
+	   next updated, so refresh the depth task sees along with the echo */
+	emcmotStatus->depth = tpQueueDepth(&emcmotDebug->queue);
+	/* publish the changes */
+	if (EMCMOT_SEQ_BUSY(emcmotConfig)) {
+	    EMCMOT_SEQ_END(emcmotConfig);
+	}
+	EMCMOT_SEQ_END(emcmotDebug);
+	EMCMOT_SEQ_END(emcmotStatus);
 
     }
     /* end of: if-new-command */
@@ -1644,3 +1686,34 @@ check_stuff ( "after command_handler()" );
 
     return;
 }
+
+/*
+  emcmotCommandHandler() is called each main cycle to drain the
+  shared memory command ring.  It executes the queued commands in
+  order until the ring is empty or its share of the period is used up.
+  */
+void emcmotCommandHandler(void *arg, long period)
+{
+    emcmot_command_ring_t *ring = &emcmotStruct->commands;
+    long long int start = rtapi_get_time();
+
+    while (ring->tail != ring->head) {
+	/* don't look at the slot until the writes to it are visible */
+	rtapi_smp_mb();
+	emcmotCommand = &ring->command[ring->tail % EMCMOT_COMMAND_RING_SIZE];
+	/* check for split read */
+	if (emcmotCommand->head != emcmotCommand->tail) {
+	    EMCMOT_SEQ_BEGIN(emcmotDebug);
+	    emcmotDebug->split++;
+	    EMCMOT_SEQ_END(emcmotDebug);
+	    return;		/* not really an error */
+	}
+	emcmotCommandExecute();
+	/* finish with the slot before handing it back to task */
+	rtapi_smp_mb();
+	ring->tail++;
+	if (rtapi_get_time() - start > period / EMCMOT_COMMAND_BUDGET_DIV) {
+	    break;
+	}
+    }
+}
@@ -15,6 +15,7 @@
 
 #include "posemath.h"
 #include "rtapi.h"
+#include "rtapi_bitops.h"
 #include "hal.h"
 #include "emcmotglb.h"
 #include "motion.h"
@@ -306,8 +307,9 @@ void emcmotController(void *arg, long period)
     /* calculate servo frequency for calcs like vel = Dpos / period */
     /* it's faster to do vel = Dpos * freq */
     servo_freq = 1.0 / servo_period;
-    /* increment head count to indicate work in progress */
-    emcmotStatus->head++;
+    /* readers retry while the status and debug structs are changing */
+    EMCMOT_SEQ_BEGIN(emcmotStatus);
+    EMCMOT_SEQ_BEGIN(emcmotDebug);
     /* here begins the core of the controller */
 
 check_stuff ( "before process_inputs()" );
@@ -337,8 +339,12 @@ check_stuff ( "after output_to_hal()" );
 check_stuff ( "after update_status()" );
     /* here ends the core of the controller */
     emcmotStatus->heartbeat++;
-    /* set tail to head, to indicate work complete */
-    emcmotStatus->tail = emcmotStatus->head;
+    /* publish the changes, including a new cycle time in the config */
+    if (EMCMOT_SEQ_BUSY(emcmotConfig)) {
+	EMCMOT_SEQ_END(emcmotConfig);
+    }
+    EMCMOT_SEQ_END(emcmotDebug);
+    EMCMOT_SEQ_END(emcmotStatus);
     /* clear init flag */
     first_pass = 0;
 
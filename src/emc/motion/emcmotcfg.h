@@ -60,6 +60,16 @@
  * about a megabyte.  */
 #define DEFAULT_TC_QUEUE_SIZE 2000
 
+/* number of slots in the command ring between task and motion; must
+   be a power of two.  Queued motions that are posted into the ring but
+   not yet seen by the planner are covered by the tc queue margin, see
+   TC_QUEUE_MARGIN in tc.c */
+#define EMCMOT_COMMAND_RING_SIZE 64
+
+/* the command handler stops draining the command ring once it has
+   used 1/EMCMOT_COMMAND_BUDGET_DIV of the servo period */
+#define EMCMOT_COMMAND_BUDGET_DIV 10
+
 /* max following error */
 #define DEFAULT_MAX_FERROR 100
 
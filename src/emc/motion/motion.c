@@ -13,6 +13,7 @@
 #include "rtapi.h"		/* RTAPI realtime OS API */
 #include "rtapi_app.h"		/* RTAPI realtime module decls */
 #include "rtapi_string.h"       /* memset */
+#include "rtapi_bitops.h"	/* rtapi_smp_mb() */
 #include "hal.h"		/* decls for HAL implementation */
 #include "emcmotglb.h"
 #include "motion.h"
@@ -87,7 +88,8 @@ int kinType = 0;
 
   emcmotStruct is ptr to this memory.
 
-  emcmotCommand points to emcmotStruct->command,
+  emcmotCommand points to the slot of emcmotStruct->commands that is
+  being executed,
   emcmotStatus points to emcmotStruct->status,
   emcmotError points to emcmotStruct->error, and
  */
@@ -143,10 +145,12 @@ static int setServoCycleTime(double secs);
 
 void emcmot_config_change(void)
 {
-    if (emcmotConfig->head == emcmotConfig->tail) {
+    /* the first change since the config was last published starts a
+       new version of it, which the servo thread publishes when done */
+    if (!EMCMOT_SEQ_BUSY(emcmotConfig)) {
+	EMCMOT_SEQ_BEGIN(emcmotConfig);
 	emcmotConfig->config_num++;
 	emcmotStatus->config_num = emcmotConfig->config_num;
-	emcmotConfig->head++;
     }
 }
 
@@ -854,7 +858,7 @@ static int init_comm_buffers(void)
     memset(emcmotStruct, 0, sizeof(emcmot_struct_t));
 
     /* we'll reference emcmotStruct directly */
-    emcmotCommand = &emcmotStruct->command;
+    emcmotCommand = &emcmotStruct->commands.command[0];
     emcmotStatus = &emcmotStruct->status;
     emcmotConfig = &emcmotStruct->config;
     emcmotDebug = &emcmotStruct->debug;
@@ -864,7 +868,9 @@ static int init_comm_buffers(void)
     /* init error struct */
     emcmotErrorInit(emcmotError);
 
-    /* init command struct */
+    /* init command ring and first command struct */
+    emcmotStruct->commands.head = 0;
+    emcmotStruct->commands.tail = 0;
     emcmotCommand->head = 0;
     emcmotCommand->command = 0;
     emcmotCommand->commandNum = 0;
@@ -872,15 +878,16 @@ static int init_comm_buffers(void)
     emcmotCommand->spindlesync = 0.0;
 
     /* init status struct */
-    emcmotStatus->head = 0;
+    emcmotStatus->seq = 0;
     emcmotStatus->commandEcho = 0;
     emcmotStatus->commandNumEcho = 0;
     emcmotStatus->commandStatus = 0;
+    emcmotStatus->queueFailNum = 0;
 
     /* init more stuff */
 
-    emcmotDebug->head = 0;
-    emcmotConfig->head = 0;
+    emcmotDebug->seq = 0;
+    emcmotConfig->seq = 0;
 
     emcmotStatus->motionFlag = 0;
     SET_MOTION_ERROR_FLAG(0);
@@ -1041,8 +1048,6 @@ static int init_comm_buffers(void)
     tpSetVmax(&emcmotDebug->queue, emcmotStatus->vel, emcmotStatus->vel);
     tpSetAmax(&emcmotDebug->queue, emcmotStatus->acc);
 
-    emcmotStatus->tail = 0;
-
     rtapi_print_msg(RTAPI_MSG_INFO, "MOTION: init_comm_buffers() complete\n");
     return 0;
 }
@@ -174,6 +174,8 @@ extern "C" {
 	EMCMOT_SET_MOTOR_OFFSET,	/* set the offset between joint and motor */
 	EMCMOT_SET_JOINT_COMP,	/* set a compensation triplet for a joint (nominal, forw., rev.) */
         EMCMOT_SET_OFFSET, /* set tool offsets */
+	EMCMOT_SET_LOOKAHEAD,	/* set the number of moves to look ahead */
+	EMCMOT_SET_JERK,	/* set the max jerk for moves (tooltip) */
     } cmd_code_t;
 
 /* this enum lists the possible results of a command */
@@ -214,6 +216,7 @@ extern "C" {
         int motion_type;        /* this move is because of traverse, feed, arc, or toolchange */
         double spindlesync;     /* user units per spindle revolution, 0 = no sync */
 	double acc;		/* max acceleration */
+	double jerk;		/* max jerk, 0 for none */
 	double backlash;	/* amount of backlash */
 	int id;			/* id for motion */
 	int termCond;		/* termination condition */
@@ -247,6 +250,31 @@ extern "C" {
 	unsigned char tail;	/* flag count for mutex detect */
     } emcmot_command_t;
 
+/* This is the command ring.  There is one of these in shared memory.
+   Task is the only producer: it fills command[head % size] and then
+   advances 'head'.  The command handler in the servo thread is the only
+   consumer: it executes command[tail % size] and then advances 'tail'.
+   Each index is written by one side only, so no lock is needed, just
+   a memory barrier before each index update.  This lets task post many
+   queued motions without waiting a servo period for each one.
+*/
+    typedef struct emcmot_command_ring_t {
+	volatile unsigned int head;	/* next slot to fill, written by task */
+	volatile unsigned int tail;	/* next slot to run, written by motion */
+	emcmot_command_t command[EMCMOT_COMMAND_RING_SIZE];
+    } emcmot_command_ring_t;
+
+/* The status, config and debug structs are published with a sequence
+   lock.  The servo thread, the only writer, makes 'seq' odd before it
+   changes a struct and even again when it is done.  A reader copies
+   what it needs between two reads of 'seq' and keeps the copy only if
+   both saw the same even value, so motion never waits for user space
+   and a reader only retries when its copy overlapped an update.
+*/
+#define EMCMOT_SEQ_BEGIN(s) do { (s)->seq++; rtapi_smp_mb(); } while (0)
+#define EMCMOT_SEQ_END(s) do { rtapi_smp_mb(); (s)->seq++; } while (0)
+#define EMCMOT_SEQ_BUSY(s) ((s)->seq & 1)
+
 /*! \todo FIXME - these packed bits might be replaced with chars
    memory is cheap, and being able to access them without those
    damn macros would be nice
@@ -598,11 +626,13 @@ Suggestion: Split this in to an Error and a Status flag register..
 */
 
     typedef struct emcmot_status_t {
-	unsigned char head;	/* flag count for mutex detect */
-	/* these three are updated only when a new command is handled */
+	volatile unsigned int seq;	/* odd while motion updates it */
+	/* these four are updated only when a new command is handled */
 	cmd_code_t commandEcho;	/* echo of input command */
 	int commandNumEcho;	/* echo of input command number */
 	cmd_status_t commandStatus;	/* result of most recent command */
+	int queueFailNum;	/* number of the first queued move refused
+				   since the last abort, 0 if none */
 	/* these are config info, updated when a command changes them */
 	double feed_scale;	/* velocity scale factor for all motion */
 	double spindle_scale;	/* velocity scale factor for spindle speed */
@@ -679,8 +709,6 @@ Suggestion: Split this in to an Error and a Status flag register..
         EmcPose tool_offset;
         int atspeed_next_feed;  /* at next feed move, wait for spindle to be at speed  */
         int spindle_is_atspeed; /* hal input */
-	unsigned char tail;	/* flag count for mutex detect */
-        
     } emcmot_status_t;
 
 /*********************************
@@ -707,7 +735,7 @@ Suggestion: Split this in to an Error and a Status flag register..
    evaluated - either they move up, or they go away.
 */
     typedef struct emcmot_config_t {
-	unsigned char head;	/* flag count for mutex detect */
+	volatile unsigned int seq;	/* odd while motion updates it */
 
 /*! \todo FIXME - all structure members beyond this point are in limbo */
 
@@ -730,7 +758,6 @@ Suggestion: Split this in to an Error and a Status flag register..
 	double limitVel;	/* scalar upper limit on vel */
 	KINEMATICS_TYPE kinematics_type;
 	int debug;		/* copy of DEBUG, from .ini file */
-	unsigned char tail;	/* flag count for mutex detect */
     } emcmot_config_t;
 
 /*********************************
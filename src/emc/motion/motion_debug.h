@@ -41,7 +41,7 @@
 /*! \todo FIXME - this has become a dumping ground for all kinds of stuff */
 
     typedef struct emcmot_debug_t {
-	unsigned char head;	/* flag count for mutex detect */
+	volatile unsigned int seq;	/* odd while motion updates it */
 
 /*! \todo FIXME - all structure members beyond this point are in limbo */
 
@@ -103,7 +103,6 @@
 	double running_time;
 	double cur_time;
 	double last_time;
-	unsigned char tail;	/* flag count for mutex detect */
     } emcmot_debug_t;
 
 #endif // MOTION_DEBUG_H
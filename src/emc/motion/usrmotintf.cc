@@ -33,15 +33,22 @@
 
 #define READ_TIMEOUT_SEC 0	/* seconds for timeout */
 #define READ_TIMEOUT_USEC 100000	/* microseconds for timeout */
+#define SEQ_READ_TIMEOUT 0.01	/* seconds to retry a status read */
+
+/* the part of the status that answers a command */
+#define ECHO_START offsetof(emcmot_status_t, commandEcho)
+#define ECHO_SIZE (offsetof(emcmot_status_t, commandStatus) + \
+		   sizeof(cmd_status_t) - ECHO_START)
 
 #include "rtapi.h"
+#include "rtapi_bitops.h"
 
 #include "dbuf.h"
 #include "stashf.h"
 
 static int inited = 0;		/* flag if inited */
 
-static emcmot_command_t *emcmotCommand = 0;
+static emcmot_command_ring_t *emcmotCommandRing = 0;
 static emcmot_status_t *emcmotStatus = 0;
 static emcmot_config_t *emcmotConfig = 0;
 static emcmot_debug_t *emcmotDebug = 0;
@@ -74,36 +81,78 @@ int usrmotIniLoad(const char *filename)
     return 0;
 }
 
-/* writes command from c */
-int usrmotWriteEmcmotCommand(emcmot_command_t * c)
+/* number of commands posted to the ring but not yet taken by motion,
+   sampled just before the last status read so that commands in flight
+   are counted either here or in the status, never in neither */
+static unsigned int pendingCommands = 0;
+
+/* places c in the next free slot of the command ring, waiting for
+   motion to free one if the ring is full.  Sets *num to the number
+   given to the command. */
+static int postEmcmotCommand(emcmot_command_t * c, int *num)
 {
-    emcmot_status_t s;
     static int commandNum = 0;
     static unsigned char headCount = 0;
+    emcmot_command_t *slot;
     double end;
 
     if (!MOTION_ID_VALID(c->id)) {
         rcs_print("USRMOT: ERROR: invalid motion id: %d\n",c->id);
 	return EMCMOT_COMM_INVALID_MOTION_ID;
     }
-    c->head = ++headCount;
-    c->tail = c->head;
-    c->commandNum = ++commandNum;
 
     /* check for mapped mem still around */
-    if (0 == emcmotCommand) {
+    if (0 == emcmotCommandRing) {
         rcs_print("USRMOT: ERROR: can't connect to shared memory\n");
 	return EMCMOT_COMM_ERROR_CONNECT;
     }
+    /* wait for a free slot, now + timeout */
+    end = etime() + EMCMOT_COMM_TIMEOUT;
+    while (emcmotCommandRing->head - emcmotCommandRing->tail >=
+	   EMCMOT_COMMAND_RING_SIZE) {
+	if (etime() >= end) {
+	    rcs_print("USRMOT: ERROR: command ring full\n");
+	    return EMCMOT_COMM_ERROR_TIMEOUT;
+	}
+	esleep(25e-6);
+    }
+    /* make sure motion is done with the slot before overwriting it */
+    rtapi_smp_mb();
+
+    c->head = ++headCount;
+    c->tail = c->head;
+    c->commandNum = ++commandNum;
+    *num = commandNum;
+
     /* copy entire command structure to shared memory */
-    *emcmotCommand = *c;
+    slot = &emcmotCommandRing->command[emcmotCommandRing->head %
+				       EMCMOT_COMMAND_RING_SIZE];
+    *slot = *c;
+    /* publish it only after the copy is visible */
+    rtapi_smp_mb();
+    emcmotCommandRing->head++;
+    return EMCMOT_COMM_OK;
+}
+
+/* writes command from c */
+int usrmotWriteEmcmotCommand(emcmot_command_t * c)
+{
+    emcmot_status_t s;
+    int commandNum;
+    int retval;
+    double end;
+
+    retval = postEmcmotCommand(c, &commandNum);
+    if (retval != EMCMOT_COMM_OK) {
+	return retval;
+    }
     /* poll for receipt of command */
     /* set timeout for comm failure, now + timeout */
     end = etime() + EMCMOT_COMM_TIMEOUT;
     /* now check to see if it got it */
     while (etime() < end) {
-	/* update status */
-	if (( usrmotReadEmcmotStatus(&s) == 0 ) && ( s.commandNumEcho == commandNum )) {
+	/* read just the command echo */
+	if (( usrmotReadEmcmotStatusPart(&s, ECHO_START, ECHO_SIZE) == 0 ) && ( s.commandNumEcho == commandNum )) {
 	    /* now check emcmot status flag */
 	    if (s.commandStatus == EMCMOT_COMMAND_OK) {
 		return EMCMOT_COMM_OK;
@@ -118,75 +167,106 @@ int usrmotWriteEmcmotCommand(emcmot_command_t * c)
     return EMCMOT_COMM_ERROR_TIMEOUT;
 }
 
+/* queues command from c without waiting for it to be executed */
+int usrmotQueueEmcmotCommand(emcmot_command_t * c)
+{
+    int commandNum;
+
+    return postEmcmotCommand(c, &commandNum);
+}
+
+/* returns the number of commands motion had not taken from the ring
+   as of the last status read */
+int usrmotPendingEmcmotCommands(void)
+{
+    return pendingCommands;
+}
+
+/* reads that had to be retried because motion was updating the struct */
+static unsigned long readContention = 0;
+
+/* copies len bytes at offset in one of the structs motion publishes to
+   the same place in dest, retrying while motion is changing it */
+static int readEmcmotStruct(void *dest, const void *src,
+			    volatile unsigned int *seq, size_t offset,
+			    size_t len)
+{
+    unsigned int before;
+    double end = 0.0;
+
+    while (1) {
+	before = *seq;
+	rtapi_smp_mb();
+	if (!(before & 1)) {
+	    memcpy((char *) dest + offset, (const char *) src + offset, len);
+	    rtapi_smp_mb();
+	    if (*seq == before) {
+		return EMCMOT_COMM_OK;
+	    }
+	}
+	readContention++;
+	/* motion finishes an update within a servo period */
+	if (end == 0.0) {
+	    end = etime() + SEQ_READ_TIMEOUT;
+	} else if (etime() >= end) {
+	    return EMCMOT_COMM_SPLIT_READ_TIMEOUT;
+	}
+	esleep(10e-6);
+    }
+}
+
 /* copies status to s */
 int usrmotReadEmcmotStatus(emcmot_status_t * s)
 {
-    int split_read_count;
-    
     /* check for shmem still around */
     if (0 == emcmotStatus) {
 	return EMCMOT_COMM_ERROR_CONNECT;
     }
-    split_read_count = 0;
-    do {
-	/* copy status struct from shmem to local memory */
-	memcpy(s, emcmotStatus, sizeof(emcmot_status_t));
-	/* got it, now check head-tail matche */
-	if (s->head == s->tail) {
-	    /* head and tail match, done */
-	    return EMCMOT_COMM_OK;
-	}
-	/* inc counter and try again, max three times */
-    } while ( ++split_read_count < 3 );
-    return EMCMOT_COMM_SPLIT_READ_TIMEOUT;
+    if (0 != emcmotCommandRing) {
+	pendingCommands = emcmotCommandRing->head - emcmotCommandRing->tail;
+	rtapi_smp_mb();
+    }
+    return readEmcmotStruct(s, emcmotStatus, &emcmotStatus->seq, 0,
+			    sizeof(emcmot_status_t));
+}
+
+/* copies len bytes of the status at offset to the same place in s */
+int usrmotReadEmcmotStatusPart(emcmot_status_t * s, size_t offset, size_t len)
+{
+    /* check for shmem still around */
+    if (0 == emcmotStatus) {
+	return EMCMOT_COMM_ERROR_CONNECT;
+    }
+    return readEmcmotStruct(s, emcmotStatus, &emcmotStatus->seq, offset,
+			    len);
 }
 
 /* copies config to s */
 int usrmotReadEmcmotConfig(emcmot_config_t * s)
 {
-    int split_read_count;
-    
     /* check for shmem still around */
     if (0 == emcmotConfig) {
 	return EMCMOT_COMM_ERROR_CONNECT;
     }
-    split_read_count = 0;
-    do {
-	/* copy config struct from shmem to local memory */
-	memcpy(s, emcmotConfig, sizeof(emcmot_config_t));
-	/* got it, now check head-tail matches */
-	if (s->head == s->tail) {
-	    /* head and tail match, done */
-	    return EMCMOT_COMM_OK;
-	}
-	/* inc counter and try again, max three times */
-    } while ( ++split_read_count < 3 );
-printf("ReadEmcmotConfig COMM_SPLIT_READ_TIMEOUT\n" );
-    return EMCMOT_COMM_SPLIT_READ_TIMEOUT;
+    return readEmcmotStruct(s, emcmotConfig, &emcmotConfig->seq, 0,
+			    sizeof(emcmot_config_t));
 }
 
 /* copies debug to s */
 int usrmotReadEmcmotDebug(emcmot_debug_t * s)
 {
-    int split_read_count;
-    
     /* check for shmem still around */
     if (0 == emcmotDebug) {
 	return EMCMOT_COMM_ERROR_CONNECT;
     }
-    split_read_count = 0;
-    do {
-	/* copy debug struct from shmem to local memory */
-	memcpy(s, emcmotDebug, sizeof(emcmot_debug_t));
-	/* got it, now check head-tail matches */
-	if (s->head == s->tail) {
-	    /* head and tail match, done */
-	    return EMCMOT_COMM_OK;
-	}
-	/* inc counter and try again, max three times */
-    } while ( ++split_read_count < 3 );
-printf("ReadEmcmotDebug COMM_SPLIT_READ_TIMEOUT\n" );
-    return EMCMOT_COMM_SPLIT_READ_TIMEOUT;
+    return readEmcmotStruct(s, emcmotDebug, &emcmotDebug->seq, 0,
+			    sizeof(emcmot_debug_t));
+}
+
+/* returns the number of status, config and debug reads retried so far */
+unsigned long usrmotReadContention(void)
+{
+    return readContention;
 }
 
 /* copies error to s */
@@ -278,6 +358,7 @@ void usrmotPrintEmcmotDebug(emcmot_debug_t *d, int which)
     switch (which) {
     case 0:
 	printf("split:        \t%d\n", d->split);
+	printf("read retries: \t%lu\n", usrmotReadContention());
 	printf("teleop desiredVel: \t%f\t%f\t%f\t%f\t%f\t%f\n",
 	    d->teleop_data.desiredVel.tran.x,
 	    d->teleop_data.desiredVel.tran.y,
@@ -704,7 +785,7 @@ int usrmotInit(const char *modname)
 	return -1;
     }
     /* got it */
-    emcmotCommand = &(emcmotStruct->command);
+    emcmotCommandRing = &(emcmotStruct->commands);
     emcmotStatus = &(emcmotStruct->status);
     emcmotDebug = &(emcmotStruct->debug);
     emcmotConfig = &(emcmotStruct->config);
@@ -723,7 +804,7 @@ int usrmotExit(void)
     }
 
     emcmotStruct = 0;
-    emcmotCommand = 0;
+    emcmotCommandRing = 0;
     emcmotStatus = 0;
     emcmotError = 0;
 /*! \todo Another #if 0 */
@@ -35,6 +35,12 @@ extern "C" {
    the emcmot controller and puts it in arg */
     extern int usrmotReadEmcmotStatus(emcmot_status_t * s);
 
+/* usrmotReadEmcmotStatusPart() copies only the len bytes of the status
+   at offset, to the same place in arg, for readers that need a few
+   fields */
+    extern int usrmotReadEmcmotStatusPart(emcmot_status_t * s,
+	size_t offset, size_t len);
+
 /* usrmotReadEmcmotConfig() gets the config info out of
    the emcmot controller and puts it in arg */
     extern int usrmotReadEmcmotConfig(emcmot_config_t * s);
@@ -43,6 +49,10 @@ extern "C" {
    the emcmot controller and puts it in arg */
     extern int usrmotReadEmcmotDebug(emcmot_debug_t * s);
 
+/* usrmotReadContention() returns how many of the reads above had to be
+   retried because motion was updating the struct */
+    extern unsigned long usrmotReadContention(void);
+
 /* usrmotReadEmcmotError() gets the earliest queued error string out of
    the emcmot controller and puts it in arg */
     extern int usrmotReadEmcmotError(char *e);
@@ -72,6 +82,18 @@ extern "C" {
    Return values are as per the #defines above */
     extern int usrmotWriteEmcmotCommand(emcmot_command_t * c);
 
+/* usrmotQueueEmcmotCommand() posts the command to the emcmot process
+   without waiting for it to be executed.  Commands are executed in the
+   order they are written or queued; errors from queued commands are
+   reported through the emcmot error buffer.  Return values are as per
+   the #defines above */
+    extern int usrmotQueueEmcmotCommand(emcmot_command_t * c);
+
+/* usrmotPendingEmcmotCommands() returns the number of commands that
+   had not been taken by the emcmot process when the status was last
+   read */
+    extern int usrmotPendingEmcmotCommands(void);
+
 /* usrmotInit() initializes communication with the emcmot process */
     extern int usrmotInit(const char *name);
 
@@ -17,20 +17,48 @@
 
 
 #include <string.h>		/* memcpy() */
+#include <stdlib.h>		/* malloc(), free() */
 
-#include "rcs.hh"		// LinkedList
+#include "rcs.hh"
 #include "interpl.hh"		// these decls
 #include "emc.hh"
+#include "emc_nml.hh"		// EMC_TRAJ_CIRCULAR_MOVE
 #include "emcglb.h"
-#include "linklist.hh"
 #include "nmlmsg.hh"            /* class NMLmsg */
 #include "rcs_print.hh"
 
 NML_INTERP_LIST interp_list;	/* NML Union, for interpreter */
 
+/* Bytes a command of msg_size takes up on the list.  Keeping everything
+   a multiple of the node size keeps every node and command aligned. */
+static int node_bytes(long msg_size)
+{
+    int unit = sizeof(NML_INTERP_LIST_NODE);
+
+    return unit + (int) ((msg_size + unit - 1) / unit) * unit;
+}
+
+/* Where the node at offset really is, following the mark left when a
+   command did not fit at the end of the ring. */
+static int node_offset(const char *ring, int ring_size, int offset)
+{
+    if (offset == ring_size ||
+	0 == ((NML_INTERP_LIST_NODE *) (ring + offset))->size) {
+	return 0;
+    }
+    return offset;
+}
+
 NML_INTERP_LIST::NML_INTERP_LIST()
 {
-    linked_list_ptr = new LinkedList;
+    ring = NULL;
+    old_ring = NULL;
+    ring_size = 0;
+    ring_used = 0;
+    held = 0;
+    head = 0;
+    tail = 0;
+    list_len = 0;
 
     next_line_number = 0;
     line_number = 0;
@@ -38,10 +66,10 @@ NML_INTERP_LIST::NML_INTERP_LIST()
 
 NML_INTERP_LIST::~NML_INTERP_LIST()
 {
-    if (NULL != linked_list_ptr) {
-	delete linked_list_ptr;
-	linked_list_ptr = NULL;
-    }
+    free(ring);
+    ring = NULL;
+    free(old_ring);
+    old_ring = NULL;
 }
 
 int NML_INTERP_LIST::append(NMLmsg & nml_msg)
@@ -57,8 +85,96 @@ int NML_INTERP_LIST::set_line_number(int line)
     return 0;
 }
 
+/* Finds size bytes at the tail of the ring, or returns NULL if the ring
+   is too full. */
+char *NML_INTERP_LIST::make_room(int size)
+{
+    char *where;
+
+    if (0 == ring_used) {
+	// nothing on the list, start over at the beginning
+	held = head = tail = 0;
+    }
+    if (0 == ring_used || tail > held) {
+	if (ring_size - tail < size) {
+	    if (held < size) {
+		return NULL;
+	    }
+	    // go on at the start, marking where we left off
+	    if (tail < ring_size) {
+		((NML_INTERP_LIST_NODE *) (ring + tail))->size = 0;
+	    }
+	    ring_used += ring_size - tail;
+	    tail = 0;
+	}
+    } else if (held - tail < size) {
+	return NULL;
+    }
+    where = ring + tail;
+    tail += size;
+    ring_used += size;
+    return where;
+}
+
+/* Moves the waiting commands to a bigger ring with room for size more
+   bytes.  The first ring holds [TASK]INTERP_MAX_LEN of the biggest
+   motion command, but one line of a program can queue up more than
+   that.  The command last returned by get() stays where it is until
+   the next get(). */
+int NML_INTERP_LIST::grow(int size)
+{
+    char *new_ring;
+    int new_size;
+    int queued = ring_used - (head - held);
+    int from = head;
+    int to = 0;
+    int i;
+
+    new_size = ring_size;
+    if (new_size <= 0) {
+	new_size = (emc_task_interp_max_len > 0 ?
+		    emc_task_interp_max_len + 1 : 1) *
+	    node_bytes(sizeof(EMC_TRAJ_CIRCULAR_MOVE));
+    }
+    while (new_size < queued + size) {
+	new_size *= 2;
+    }
+    new_ring = (char *) malloc(new_size);
+    if (NULL == new_ring) {
+	rcs_print_error
+	    ("NML_INTERP_LIST::append : can't allocate %d bytes.\n",
+	     new_size);
+	return -1;
+    }
+
+    for (i = 0; i < list_len; i++) {
+	NML_INTERP_LIST_NODE *node_ptr;
+
+	from = node_offset(ring, ring_size, from);
+	node_ptr = (NML_INTERP_LIST_NODE *) (ring + from);
+	memcpy(new_ring + to, node_ptr, node_ptr->size);
+	to += node_ptr->size;
+	from += node_ptr->size;
+    }
+
+    if (NULL == old_ring && held != head) {
+	old_ring = ring;
+    } else {
+	free(ring);
+    }
+    ring = new_ring;
+    ring_size = new_size;
+    held = head = 0;
+    tail = ring_used = to;
+
+    return 0;
+}
+
 int NML_INTERP_LIST::append(NMLmsg * nml_msg_ptr)
 {
+    NML_INTERP_LIST_NODE *node_ptr;
+    int size;
+
     /* check for invalid data */
     if (NULL == nml_msg_ptr) {
 	rcs_print_error
@@ -82,38 +198,26 @@ int NML_INTERP_LIST::append(NMLmsg * nml_msg_ptr)
 	    ("NML_INTERP_LIST::append : command size is invalid.");
 	return -1;
     }
-#ifdef DEBUG_INTERPL
-    if (sizeof(temp_node) < MAX_NML_COMMAND_SIZE + 4 ||
-	sizeof(temp_node) > MAX_NML_COMMAND_SIZE + 16 ||
-	((void *) &temp_node.line_number) >
-	((void *) &temp_node.command.commandbuf)) {
-	rcs_print_error
-	    ("NML_INTERP_LIST::append : assumptions about NML_INTERP_LIST_NODE have been violated.");
-	return -1;
-    }
-#endif
-
-    if (NULL == linked_list_ptr) {
-	return -1;
-    }
-    // fill in the NML_INTERP_LIST_NODE
-    temp_node.line_number = next_line_number;
-    memcpy(temp_node.command.commandbuf, nml_msg_ptr, nml_msg_ptr->size);
 
     // stick it on the list
-    linked_list_ptr->store_at_tail(&temp_node,
-				   nml_msg_ptr->size +
-				   sizeof(temp_node.line_number) +
-				   sizeof(temp_node.dummy) + 32 + (32 -
-								   nml_msg_ptr->
-								   size %
-								   32), 1);
+    size = node_bytes(nml_msg_ptr->size);
+    node_ptr = (NML_INTERP_LIST_NODE *) make_room(size);
+    if (NULL == node_ptr) {
+	if (grow(size) < 0) {
+	    return -1;
+	}
+	node_ptr = (NML_INTERP_LIST_NODE *) make_room(size);
+    }
+    node_ptr->line_number = next_line_number;
+    node_ptr->size = size;
+    memcpy(node_ptr + 1, nml_msg_ptr, nml_msg_ptr->size);
+    list_len++;
 
     if (emc_debug & EMC_DEBUG_INTERP_LIST) {
 	rcs_print
 	    ("NML_INTERP_LIST::append(nml_msg_ptr{size=%ld,type=%s}) : list_size=%d, line_number=%d\n",
 	     nml_msg_ptr->size, emc_symbol_lookup(nml_msg_ptr->type),
-	     linked_list_ptr->list_size, temp_node.line_number);
+	     list_len, node_ptr->line_number);
     }
 
     return 0;
@@ -121,66 +225,68 @@ int NML_INTERP_LIST::append(NMLmsg * nml_msg_ptr)
 
 NMLmsg *NML_INTERP_LIST::get()
 {
-    NMLmsg *ret;
     NML_INTERP_LIST_NODE *node_ptr;
+    int offset;
 
-    if (NULL == linked_list_ptr) {
-	line_number = 0;
-	return NULL;
+    // the caller is done with the last one
+    ring_used -= head - held;
+    held = head;
+    if (NULL != old_ring) {
+	free(old_ring);
+	old_ring = NULL;
     }
 
-    node_ptr = (NML_INTERP_LIST_NODE *) linked_list_ptr->retrieve_head();
-
-    if (NULL == node_ptr) {
+    if (0 == list_len) {
 	line_number = 0;
 	return NULL;
     }
+
+    offset = node_offset(ring, ring_size, head);
+    if (offset != head) {
+	ring_used -= ring_size - head;
+	held = offset;
+    }
+    node_ptr = (NML_INTERP_LIST_NODE *) (ring + offset);
+    head = offset + node_ptr->size;
+    list_len--;
+
     // save line number of this one, for use by get_line_number
     line_number = node_ptr->line_number;
 
-    // get it off the front
-    ret = (NMLmsg *) ((char *) node_ptr->command.commandbuf);
-
-    return ret;
+    return (NMLmsg *) (node_ptr + 1);
 }
 
 void NML_INTERP_LIST::clear()
 {
-    if (NULL != linked_list_ptr) {
-	linked_list_ptr->delete_members();
-    }
+    // drop what is waiting, but not the last one from get()
+    ring_used = head - held;
+    tail = head;
+    list_len = 0;
 }
 
 void NML_INTERP_LIST::print()
 {
     NMLmsg *ret;
     NML_INTERP_LIST_NODE *node_ptr;
-    int line_number;
-
-    if (NULL == linked_list_ptr) {
-	return;
-    }
-    node_ptr = (NML_INTERP_LIST_NODE *) linked_list_ptr->get_head();
+    int offset = head;
+    int i;
 
-    rcs_print("NML_INTERP_LIST::print(): list size=%d\n",linked_list_ptr->list_size);
-    while (NULL != node_ptr) {
-	line_number = node_ptr->line_number;
-	ret = (NMLmsg *) ((char *) node_ptr->command.commandbuf);
+    rcs_print("NML_INTERP_LIST::print(): list size=%d\n", list_len);
+    for (i = 0; i < list_len; i++) {
+	offset = node_offset(ring, ring_size, offset);
+	node_ptr = (NML_INTERP_LIST_NODE *) (ring + offset);
+	ret = (NMLmsg *) (node_ptr + 1);
 	rcs_print("--> type=%s,  line_number=%d\n",
 		  emc_symbol_lookup((int)ret->type),
-		  line_number);
-	node_ptr = (NML_INTERP_LIST_NODE *) linked_list_ptr->get_next();
+		  node_ptr->line_number);
+	offset += node_ptr->size;
     }
     rcs_print("\n");
 }
 
 int NML_INTERP_LIST::len()
 {
-    if (NULL == linked_list_ptr) {
-	return 0;
-    }
-
-    return ((int) linked_list_ptr->list_size);
+    return list_len;
 }
 
 int NML_INTERP_LIST::get_line_number()
@@ -19,9 +19,11 @@
 
 #define MAX_NML_COMMAND_SIZE 1000
 
-// these go on the interp list
+// each command on the interp list sits right behind one of these
 struct NML_INTERP_LIST_NODE {
     int line_number;		// line number it was on
+    int size;			// bytes taken up on the list, including
+				// this node; 0 means go back to the start
     union _dummy_union {
 	int i;
 	long l;
@@ -30,16 +32,6 @@ struct NML_INTERP_LIST_NODE {
 	long long ll;
 	long double ld;
     } dummy;			// paranoid alignment variable.
-
-    union _command_union {
-	char commandbuf[MAX_NML_COMMAND_SIZE];	// the NML command;
-	int i;
-	long l;
-	double d;
-	float f;
-	long long ll;
-	long double ld;
-    } command;
 };
 
 // here's the interp list itself
@@ -58,9 +50,20 @@ class NML_INTERP_LIST {
     int len();
 
   private:
-    class LinkedList * linked_list_ptr;
-    NML_INTERP_LIST_NODE temp_node;	// filled in and put on the list
-    int next_line_number;	// line number used to fill temp_node
+    char *make_room(int size);
+    int grow(int size);
+
+    // The commands are kept back to back in a ring.  The one last
+    // returned by get() stays put until the next get().
+    char *ring;			// the commands themselves
+    char *old_ring;		// outgrown, still holds the last get()
+    int ring_size;		// bytes in ring
+    int ring_used;		// bytes from held to tail
+    int held;			// offset of the last command from get()
+    int head;			// offset of the next command for get()
+    int tail;			// offset for the next append()
+    int list_len;		// commands waiting for get()
+    int next_line_number;	// line number used for the next append
     int line_number;		// line number of node from get()
 };
 
@@ -0,0 +1,672 @@
+/********************************************************************
+* Description: nmlperf.cc
+*   Measures what moving messages through NML costs. Writes an NML
+*   config file for one buffer, starts writers and readers on it and
+*   reports write-to-read latency, messages per second and CPU time
+*   per message.
+*
+* Author:
+* License: GPL Version 2
+* System: Linux
+*
+* Copyright (c) 2026 All rights reserved.
+*
+* Last change:
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sched.h>		// sched_yield()
+#include <pthread.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>	// getrusage()
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "rcs.hh"		// NML, NMLmsg
+#include "cms.hh"		// CMS, cms_print_queue_full_messages
+#include "emc.hh"		// emcFormat()
+#include "emc_nml.hh"		// EMC_STAT
+#include "timer.hh"		// etime(), esleep()
+#include "nml_srv.hh"		// run_nml_servers()
+
+#define NMLPERF_MSG_TYPE ((NMLTYPE) 9901)
+#define NMLPERF_MAX_PAYLOAD (1024 * 1024)
+
+/* Write times are looked up by sequence number in a ring this big, so
+   no more than this many messages can be in flight at once. */
+#define NMLPERF_SENT_RING (1 << 20)
+
+class NMLPERF_MSG:public NMLmsg {
+  public:
+    NMLPERF_MSG():NMLmsg(NMLPERF_MSG_TYPE, sizeof(NMLPERF_MSG)) {
+    };
+
+    // For internal NML/CMS use only.
+    void update(CMS * cms);
+
+    int seq;
+    int payload_length;
+    char payload[NMLPERF_MAX_PAYLOAD];
+};
+
+void NMLPERF_MSG::update(CMS * cms)
+{
+    cms->update(seq);
+    cms->update(payload_length);
+    if (payload_length < 0 || payload_length > NMLPERF_MAX_PAYLOAD) {
+	payload_length = 0;
+    }
+    cms->update(payload, payload_length);
+}
+
+static int nmlperfFormat(NMLTYPE type, void *buffer, CMS * cms)
+{
+    if (type == NMLPERF_MSG_TYPE) {
+	((NMLPERF_MSG *) buffer)->update(cms);
+	return 1;
+    }
+    return emcFormat(type, buffer, cms);
+}
+
+struct NMLPERF_ROLE {
+    NML *nml;
+    NMLmsg *msg;
+    pthread_t thread;
+    long written;
+    long fresh;
+    long errors;
+    std::vector < double >latencies;
+};
+
+static const char *transport = "shmem";
+static int num_writers = 1;
+static int num_readers = 1;
+static long payload_size = 256;	/* -1 for EMC_STAT */
+static long messages_per_writer = 10000;
+static double write_period = 0.0;
+static int queuing = 0;
+static const char *encoding = "raw";
+static int blocking = 0;
+static const char *buffer_options = "";
+static const char *process_options = "";
+static long buffer_size = 0;
+static int tcp_port = 5090;
+static int shm_key = 9090;
+static char nml_file[256];
+static int keep_file = 0;
+
+static double *sent_at = NULL;
+static volatile long next_seq = 1;
+static volatile int writers_done = 0;
+static volatile int readers_running = 0;
+
+static struct option longopts[] = {
+    {"help", 0, NULL, 'h'},
+    {"transport", 1, NULL, 't'},
+    {"writers", 1, NULL, 'w'},
+    {"readers", 1, NULL, 'r'},
+    {"size", 1, NULL, 's'},
+    {"messages", 1, NULL, 'n'},
+    {"period", 1, NULL, 'i'},
+    {"queue", 0, NULL, 'q'},
+    {"encoding", 1, NULL, 'e'},
+    {"blocking", 0, NULL, 'b'},
+    {"buffer-options", 1, NULL, 'B'},
+    {"process-options", 1, NULL, 'P'},
+    {"buffer-size", 1, NULL, 'z'},
+    {"port", 1, NULL, 'p'},
+    {"key", 1, NULL, 'k'},
+    {"file", 1, NULL, 'f'},
+    {0, 0, 0, 0}
+};
+
+static void usage(const char *pname)
+{
+    printf("Usage: %s [options]\n"
+	"  -t, --transport shmem|locmem|tcp  (default=%s)\n"
+	"  -w, --writers <n>                 (default=%d)\n"
+	"  -r, --readers <n>                 (default=%d)\n"
+	"  -s, --size <bytes>|emcstat        (default=%ld)\n"
+	"  -n, --messages <n per writer>     (default=%ld)\n"
+	"  -i, --period <seconds between writes> (default=%g)\n"
+	"  -q, --queue                       queue messages\n"
+	"  -e, --encoding raw|xdr|packed|ascii (default=%s)\n"
+	"  -b, --blocking                    readers use blocking_read()\n"
+	"  -B, --buffer-options <words>      added to the buffer line\n"
+	"  -P, --process-options <words>     added to the reader lines\n"
+	"  -z, --buffer-size <bytes>         (default: from the message size)\n"
+	"  -p, --port <tcp port>             (default=%d)\n"
+	"  -k, --key <shared memory key>     (default=%d)\n"
+	"  -f, --file <nml file>             write the config here and keep it\n",
+	pname, transport, num_writers, num_readers, payload_size,
+	messages_per_writer, write_period, encoding, tcp_port, shm_key);
+}
+
+static long message_size()
+{
+    if (payload_size < 0) {
+	return sizeof(EMC_STAT);
+    }
+    return (long) (sizeof(NMLPERF_MSG) - NMLPERF_MAX_PAYLOAD) + payload_size;
+}
+
+static NMLTYPE message_type()
+{
+    return payload_size < 0 ? EMC_STAT_TYPE : NMLPERF_MSG_TYPE;
+}
+
+static int write_config()
+{
+    FILE *fp;
+    int is_tcp = !strcmp(transport, "tcp");
+    const char *type = strcmp(transport, "locmem") ? "SHMEM" : "LOCMEM";
+    const char *where = is_tcp ? "REMOTE" : "LOCAL";
+    long size = buffer_size;
+    int neutral = strcmp(encoding, "raw") ? 1 : 0;
+    int c = 0;
+    int i;
+
+    if (size <= 0) {
+	/* xdr sends each char as 4 bytes and ascii takes more again */
+	long factor = !strcmp(encoding, "xdr") ? 4 :
+	    !strcmp(encoding, "ascii") ? 8 : 1;
+	size = message_size() * factor + 4096;
+	if (queuing) {
+	    size *= 8;
+	}
+    }
+
+    if (nml_file[0] == 0) {
+	int fd;
+	strcpy(nml_file, "/tmp/nmlperf.XXXXXX");
+	fd = mkstemp(nml_file);
+	if (fd < 0) {
+	    fprintf(stderr, "nmlperf: can't create %s: %s\n", nml_file,
+		strerror(errno));
+	    return -1;
+	}
+	close(fd);
+    }
+    fp = fopen(nml_file, "w");
+    if (NULL == fp) {
+	fprintf(stderr, "nmlperf: can't write %s: %s\n", nml_file,
+	    strerror(errno));
+	return -1;
+    }
+    fprintf(fp, "# Written by nmlperf\n");
+    fprintf(fp, "B perf %s localhost %ld %d 0 1 %d %d", type, size, neutral,
+	num_writers + num_readers + 2, shm_key);
+    if (is_tcp) {
+	fprintf(fp, " TCP=%d", tcp_port);
+    }
+    if (neutral) {
+	fprintf(fp, " %s", encoding);
+    }
+    if (queuing) {
+	fprintf(fp, " queue");
+    }
+    if (blocking) {
+	fprintf(fp, " bsem=%d", shm_key + 1);
+    }
+    fprintf(fp, " %s\n", buffer_options);
+    fprintf(fp, "P master perf LOCAL localhost RW %d 5.0 1 %d\n", is_tcp,
+	c++);
+    for (i = 0; i < num_writers; i++) {
+	fprintf(fp, "P w%d perf %s localhost W 0 5.0 0 %d\n", i, where,
+	    c++);
+    }
+    for (i = 0; i < num_readers; i++) {
+	fprintf(fp, "P r%d perf %s localhost R 0 5.0 0 %d %s\n", i, where,
+	    c++, process_options);
+    }
+    fclose(fp);
+    return 0;
+}
+
+/* Waits for the forked server to start listening. */
+static int wait_for_server(pid_t server_pid)
+{
+    struct sockaddr_in addr;
+    double start = etime();
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(tcp_port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    while (etime() - start < 10.0) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd >= 0) {
+	    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+		close(fd);
+		return 0;
+	    }
+	    close(fd);
+	}
+	if (waitpid(server_pid, NULL, WNOHANG) == server_pid) {
+	    return -1;
+	}
+	esleep(0.05);
+    }
+    return -1;
+}
+
+static void set_seq(NMLmsg * msg, long seq)
+{
+    if (msg->type == EMC_STAT_TYPE) {
+	EMC_STAT *stat = (EMC_STAT *) msg;
+	stat->task.heartbeat = seq;
+	stat->motion.traj.position.tran.x = seq * 0.001;
+    } else {
+	NMLPERF_MSG *perf = (NMLPERF_MSG *) msg;
+	perf->seq = seq;
+	if (perf->payload_length > 0) {
+	    perf->payload[seq % perf->payload_length] = (char) seq;
+	}
+    }
+}
+
+static long get_seq(NMLmsg * msg)
+{
+    if (msg->type == EMC_STAT_TYPE) {
+	/* the RCS_STAT_MSG header is not encoded, the heartbeat is */
+	return ((EMC_STAT *) msg)->task.heartbeat;
+    }
+    return ((NMLPERF_MSG *) msg)->seq;
+}
+
+static int write_one(NMLPERF_ROLE * role)
+{
+    long seq = __sync_fetch_and_add(&next_seq, 1);
+    set_seq(role->msg, seq);
+    sent_at[seq % NMLPERF_SENT_RING] = etime();
+    if (role->nml->write(role->msg) != 0) {
+	return -1;
+    }
+    role->written++;
+    return 0;
+}
+
+static NMLTYPE read_one(NMLPERF_ROLE * role)
+{
+    NMLTYPE type;
+
+    if (blocking) {
+	/* Wait as long as it takes: main() wakes us once the writers are
+	   done. */
+	type = role->nml->blocking_read(-1.0);
+    } else {
+	type = role->nml->read();
+    }
+    if (type < 0) {
+	role->errors++;
+    } else if (type == message_type()) {
+	double now = etime();
+	long seq = get_seq(role->nml->get_address());
+	if (seq <= 0) {
+	    return 0;
+	}
+	role->latencies.push_back(now - sent_at[seq % NMLPERF_SENT_RING]);
+	role->fresh++;
+    }
+    return type;
+}
+
+static void *writer_main(void *arg)
+{
+    NMLPERF_ROLE *role = (NMLPERF_ROLE *) arg;
+
+    while (role->written < messages_per_writer) {
+	if (write_one(role) < 0) {
+	    /* queue full, or the server is behind */
+	    sched_yield();
+	    continue;
+	}
+	if (write_period > 0.0) {
+	    esleep(write_period);
+	}
+    }
+    return NULL;
+}
+
+static void *reader_main(void *arg)
+{
+    NMLPERF_ROLE *role = (NMLPERF_ROLE *) arg;
+
+    while (role->errors < 100) {
+	NMLTYPE type = read_one(role);
+	if (type == 0) {
+	    if (writers_done) {
+		break;
+	    }
+	    if (!blocking) {
+		sched_yield();
+	    }
+	}
+    }
+    __sync_fetch_and_sub(&readers_running, 1);
+    return NULL;
+}
+
+/* Writes messages with no sequence number until blocked readers have
+   all noticed the writers are done. */
+static void wake_readers(NMLPERF_ROLE * role)
+{
+    set_seq(role->msg, 0);
+    while (readers_running > 0) {
+	role->nml->write(role->msg);
+	esleep(0.01);
+    }
+}
+
+static void close_roles(std::vector < NMLPERF_ROLE * >&writers,
+    std::vector < NMLPERF_ROLE * >&readers)
+{
+    size_t i;
+
+    for (i = 0; i < readers.size(); i++) {
+	delete readers[i]->nml;
+	readers[i]->nml = NULL;
+    }
+    for (i = 0; i < writers.size(); i++) {
+	delete writers[i]->nml;
+	writers[i]->nml = NULL;
+    }
+}
+
+/* LOCMEM has no locking, so its users all take turns in one thread. */
+static void run_in_turn(std::vector < NMLPERF_ROLE * >&writers,
+    std::vector < NMLPERF_ROLE * >&readers)
+{
+    size_t i;
+    int busy = 1;
+
+    while (busy) {
+	busy = 0;
+	for (i = 0; i < writers.size(); i++) {
+	    if (writers[i]->written < messages_per_writer) {
+		write_one(writers[i]);
+		busy = 1;
+	    }
+	}
+	for (i = 0; i < readers.size(); i++) {
+	    while (read_one(readers[i]) > 0 && queuing) {
+	    }
+	}
+	if (write_period > 0.0) {
+	    esleep(write_period);
+	}
+    }
+}
+
+static double cpu_seconds(int who)
+{
+    struct rusage usage;
+    getrusage(who, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+	usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static NML *open_channel(const char *process)
+{
+    NML *nml = new NML(nmlperfFormat, "perf", process, nml_file);
+    if (NULL == nml || !nml->valid()) {
+	fprintf(stderr, "nmlperf: can't open buffer perf as %s\n", process);
+	delete nml;
+	return NULL;
+    }
+    return nml;
+}
+
+static NMLmsg *new_message()
+{
+    if (payload_size < 0) {
+	return new EMC_STAT();
+    }
+    NMLPERF_MSG *msg = new NMLPERF_MSG();
+    msg->size = message_size();
+    msg->payload_length = payload_size;
+    for (long i = 0; i < payload_size; i++) {
+	msg->payload[i] = (char) i;
+    }
+    return msg;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector < NMLPERF_ROLE * >writers, readers;
+    std::vector < double >latencies;
+    pid_t server_pid = -1;
+    NML *master = NULL;
+    int is_tcp, is_locmem;
+    int opt;
+    size_t i;
+    int retval = 0;
+
+    while ((opt = getopt_long(argc, argv, "ht:w:r:s:n:i:qe:bB:P:z:p:k:f:",
+		longopts, NULL)) != -1) {
+	switch (opt) {
+	case 't':
+	    transport = optarg;
+	    break;
+	case 'w':
+	    num_writers = atoi(optarg);
+	    break;
+	case 'r':
+	    num_readers = atoi(optarg);
+	    break;
+	case 's':
+	    payload_size = strcmp(optarg, "emcstat") ? atol(optarg) : -1;
+	    break;
+	case 'n':
+	    messages_per_writer = atol(optarg);
+	    break;
+	case 'i':
+	    write_period = atof(optarg);
+	    break;
+	case 'q':
+	    queuing = 1;
+	    break;
+	case 'e':
+	    encoding = optarg;
+	    break;
+	case 'b':
+	    blocking = 1;
+	    break;
+	case 'B':
+	    buffer_options = optarg;
+	    break;
+	case 'P':
+	    process_options = optarg;
+	    break;
+	case 'z':
+	    buffer_size = atol(optarg);
+	    break;
+	case 'p':
+	    tcp_port = atoi(optarg);
+	    break;
+	case 'k':
+	    shm_key = atoi(optarg);
+	    break;
+	case 'f':
+	    strncpy(nml_file, optarg, sizeof(nml_file) - 1);
+	    keep_file = 1;
+	    break;
+	default:
+	    usage(argv[0]);
+	    exit(1);
+	}
+    }
+
+    is_tcp = !strcmp(transport, "tcp");
+    is_locmem = !strcmp(transport, "locmem");
+    if ((!is_tcp && !is_locmem && strcmp(transport, "shmem")) ||
+	num_writers < 1 || num_readers < 0 ||
+	payload_size > NMLPERF_MAX_PAYLOAD || messages_per_writer < 1 ||
+	(strcmp(encoding, "raw") && strcmp(encoding, "xdr") &&
+	    strcmp(encoding, "packed") && strcmp(encoding, "ascii"))) {
+	usage(argv[0]);
+	exit(1);
+    }
+    if (is_locmem && blocking) {
+	fprintf(stderr, "nmlperf: LOCMEM buffers can't do blocking reads\n");
+	exit(1);
+    }
+
+    sent_at = (double *) calloc(NMLPERF_SENT_RING, sizeof(double));
+    if (NULL == sent_at || write_config() < 0) {
+	exit(1);
+    }
+    cms_print_queue_full_messages = 0;
+
+    if (is_tcp) {
+	server_pid = fork();
+	if (server_pid == 0) {
+	    NML *server = new NML(nmlperfFormat, "perf", "master", nml_file);
+	    if (NULL == server || !server->valid()) {
+		_exit(1);
+	    }
+	    server->clear();
+	    run_nml_servers();
+	    _exit(0);
+	}
+	if (server_pid < 0 || wait_for_server(server_pid) < 0) {
+	    fprintf(stderr, "nmlperf: the NML server did not start\n");
+	    retval = 1;
+	    goto cleanup;
+	}
+    } else {
+	master = open_channel("master");
+	if (NULL == master) {
+	    retval = 1;
+	    goto cleanup;
+	}
+	/* don't let a reader count what an earlier run left behind */
+	master->clear();
+    }
+
+    for (int n = 0; n < num_writers + num_readers; n++) {
+	char process[16];
+	NMLPERF_ROLE *role = new NMLPERF_ROLE();
+	int is_writer = n < num_writers;
+	snprintf(process, sizeof(process), "%c%d", is_writer ? 'w' : 'r',
+	    is_writer ? n : n - num_writers);
+	role->nml = open_channel(process);
+	role->msg = is_writer ? new_message() : NULL;
+	role->written = role->fresh = role->errors = 0;
+	(is_writer ? writers : readers).push_back(role);
+	if (NULL == role->nml) {
+	    retval = 1;
+	    goto cleanup;
+	}
+    }
+
+    {
+	double cpu_start = cpu_seconds(RUSAGE_SELF);
+	double start = etime();
+	double elapsed, cpu, server_cpu = 0.0;
+	long written = 0, fresh = 0, errors = 0;
+
+	if (is_locmem) {
+	    run_in_turn(writers, readers);
+	} else {
+	    readers_running = readers.size();
+	    for (i = 0; i < readers.size(); i++) {
+		pthread_create(&readers[i]->thread, NULL, reader_main,
+		    readers[i]);
+	    }
+	    for (i = 0; i < writers.size(); i++) {
+		pthread_create(&writers[i]->thread, NULL, writer_main,
+		    writers[i]);
+	    }
+	    for (i = 0; i < writers.size(); i++) {
+		pthread_join(writers[i]->thread, NULL);
+	    }
+	    writers_done = 1;
+	    if (blocking) {
+		wake_readers(writers[0]);
+	    }
+	    for (i = 0; i < readers.size(); i++) {
+		pthread_join(readers[i]->thread, NULL);
+	    }
+	}
+	elapsed = etime() - start;
+	cpu = cpu_seconds(RUSAGE_SELF) - cpu_start;
+
+	/* Hang up before stopping the server so it can account for the
+	   time it spent on us. */
+	close_roles(writers, readers);
+	if (server_pid > 0) {
+	    esleep(0.1);
+	    kill(server_pid, SIGINT);
+	    waitpid(server_pid, NULL, 0);
+	    server_pid = -1;
+	    server_cpu = cpu_seconds(RUSAGE_CHILDREN);
+	}
+
+	for (i = 0; i < writers.size(); i++) {
+	    written += writers[i]->written;
+	}
+	for (i = 0; i < readers.size(); i++) {
+	    fresh += readers[i]->fresh;
+	    errors += readers[i]->errors;
+	    latencies.insert(latencies.end(),
+		readers[i]->latencies.begin(), readers[i]->latencies.end());
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	printf("nmlperf: %s, %d writer(s), %d reader(s), %ld byte %s, %s%s%s\n",
+	    transport, num_writers, num_readers, message_size(),
+	    payload_size < 0 ? "EMC_STAT" : "messages", encoding,
+	    queuing ? ", queued" : "", blocking ? ", blocking reads" : "");
+	printf("  written  %ld in %.3f s (%.0f msgs/s)\n", written, elapsed,
+	    written / elapsed);
+	printf("  read     %ld new (%.0f msgs/s), %ld errors\n", fresh,
+	    fresh / elapsed, errors);
+	if (!latencies.empty()) {
+	    printf("  latency  p50 %.1f us  p99 %.1f us  max %.1f us\n",
+		latencies[latencies.size() / 2] * 1e6,
+		latencies[latencies.size() * 99 / 100] * 1e6,
+		latencies.back() * 1e6);
+	}
+	printf("  cpu      %.2f us/msg", (cpu + server_cpu) * 1e6 / written);
+	if (is_tcp) {
+	    printf(" (%.2f here, %.2f in the server)", cpu * 1e6 / written,
+		server_cpu * 1e6 / written);
+	}
+	printf("\n");
+	if (errors > 0) {
+	    retval = 1;
+	}
+    }
+
+  cleanup:
+    close_roles(writers, readers);
+    for (i = 0; i < readers.size(); i++) {
+	delete readers[i];
+    }
+    for (i = 0; i < writers.size(); i++) {
+	delete writers[i]->msg;
+	delete writers[i];
+    }
+    delete master;
+    if (server_pid > 0) {
+	kill(server_pid, SIGINT);
+	waitpid(server_pid, NULL, 0);
+    }
+    if (!keep_file) {
+	unlink(nml_file);
+    }
+    free(sent_at);
+    return retval;
+}
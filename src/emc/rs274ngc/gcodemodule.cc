@@ -23,6 +23,7 @@
 #include "rs274ngc_interp.hh"
 #include "interp_return.hh"
 #include "canon.hh"
+#include "preview_buffer.hh"
 #include "config.h"		// LINELEN
 
 int _task = 0; // control preview behaviour when remapping
@@ -137,6 +138,252 @@ static PyTypeObject LineCodeType = {
     0,                      /*tp_is_gc*/
 };
 
+typedef struct {
+    PyObject_HEAD
+    int kind;
+    Py_ssize_t count, alloc;
+    char *data;
+    // extents of the start points, without and with the tool offset, kept
+    // up to date as moves arrive so calc_extents is cheap during a load
+    double min[3], max[3], min_t[3], max_t[3];
+} PreviewBuffer;
+
+static size_t PreviewBuffer_recsize(PreviewBuffer *b) {
+    return b->kind == PREVIEW_DWELL ?
+        sizeof(preview_dwell) : sizeof(preview_line);
+}
+
+// Returns space for one more record at the end of the buffer
+static void *PreviewBuffer_add(PreviewBuffer *b) {
+    size_t sz = PreviewBuffer_recsize(b);
+    if(b->count == b->alloc) {
+        Py_ssize_t alloc = b->alloc ? 2 * b->alloc : 1024;
+        char *data = (char*)PyMem_Realloc(b->data, alloc * sz);
+        if(!data) { PyErr_NoMemory(); return NULL; }
+        b->data = data;
+        b->alloc = alloc;
+    }
+    return b->data + sz * b->count++;
+}
+
+static void PreviewBuffer_extend(PreviewBuffer *b, const preview_line *l) {
+    for(int ax=0; ax<3; ax++) {
+        double p = l->start[ax], pt = p + l->tlo[ax];
+        if(p < b->min[ax]) b->min[ax] = p;
+        if(p > b->max[ax]) b->max[ax] = p;
+        if(pt < b->min_t[ax]) b->min_t[ax] = pt;
+        if(pt > b->max_t[ax]) b->max_t[ax] = pt;
+    }
+}
+
+static int PreviewBuffer_init(PyObject *_self, PyObject *args, PyObject *kw) {
+    PreviewBuffer *self = (PreviewBuffer *)_self;
+    int kind;
+    if(!PyArg_ParseTuple(args, "i:previewbuffer", &kind)) return -1;
+    if(kind != PREVIEW_TRAVERSE && kind != PREVIEW_FEED
+            && kind != PREVIEW_DWELL) {
+        PyErr_Format(PyExc_ValueError, "previewbuffer: unknown kind %d", kind);
+        return -1;
+    }
+    PyMem_Free(self->data);
+    self->data = NULL;
+    self->kind = kind;
+    self->count = self->alloc = 0;
+    for(int ax=0; ax<3; ax++) {
+        self->min[ax] = self->min_t[ax] = 9e99;
+        self->max[ax] = self->max_t[ax] = -9e99;
+    }
+    return 0;
+}
+
+static void PreviewBuffer_dealloc(PyObject *_self) {
+    PreviewBuffer *self = (PreviewBuffer *)_self;
+    PyMem_Free(self->data);
+    self->ob_type->tp_free(_self);
+}
+
+static PyObject *line9_tuple(const double p[9]) {
+    return Py_BuildValue("(ddddddddd)",
+        p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8]);
+}
+
+static PyObject *PreviewBuffer_record(PreviewBuffer *self, Py_ssize_t i) {
+    if(self->kind == PREVIEW_DWELL) {
+        preview_dwell *d = (preview_dwell*)self->data + i;
+        return Py_BuildValue("i(ddd)dddi", d->lineno,
+            d->color[0], d->color[1], d->color[2], d->x, d->y, d->z, d->plane);
+    }
+    preview_line *l = (preview_line*)self->data + i;
+    PyObject *start = line9_tuple(l->start), *end = line9_tuple(l->end);
+    if(!start || !end) {
+        Py_XDECREF(start);
+        Py_XDECREF(end);
+        return NULL;
+    }
+    if(self->kind == PREVIEW_TRAVERSE)
+        return Py_BuildValue("iNN(ddd)", l->lineno, start, end,
+            l->tlo[0], l->tlo[1], l->tlo[2]);
+    return Py_BuildValue("iNNd(ddd)", l->lineno, start, end,
+        l->feedrate, l->tlo[0], l->tlo[1], l->tlo[2]);
+}
+
+static Py_ssize_t PreviewBuffer_length(PyObject *_self) {
+    return ((PreviewBuffer *)_self)->count;
+}
+
+static PyObject *PreviewBuffer_item(PyObject *_self, Py_ssize_t i) {
+    PreviewBuffer *self = (PreviewBuffer *)_self;
+    if(i < 0 || i >= self->count) {
+        PyErr_SetString(PyExc_IndexError, "previewbuffer index out of range");
+        return NULL;
+    }
+    return PreviewBuffer_record(self, i);
+}
+
+static PyObject *PreviewBuffer_append(PyObject *_self, PyObject *o) {
+    PreviewBuffer *self = (PreviewBuffer *)_self;
+    preview_line l;
+    preview_dwell d;
+    int r;
+
+    if(self->kind == PREVIEW_DWELL)
+        r = PyArg_ParseTuple(o, "i(ddd)dddi:previewbuffer.append", &d.lineno,
+            &d.color[0], &d.color[1], &d.color[2], &d.x, &d.y, &d.z, &d.plane);
+    else if(self->kind == PREVIEW_TRAVERSE) {
+        l.feedrate = 0;
+        r = PyArg_ParseTuple(o,
+            "i(ddddddddd)(ddddddddd)(ddd):previewbuffer.append", &l.lineno,
+            &l.start[0], &l.start[1], &l.start[2], &l.start[3], &l.start[4],
+            &l.start[5], &l.start[6], &l.start[7], &l.start[8],
+            &l.end[0], &l.end[1], &l.end[2], &l.end[3], &l.end[4],
+            &l.end[5], &l.end[6], &l.end[7], &l.end[8],
+            &l.tlo[0], &l.tlo[1], &l.tlo[2]);
+    } else
+        r = PyArg_ParseTuple(o,
+            "i(ddddddddd)(ddddddddd)d(ddd):previewbuffer.append", &l.lineno,
+            &l.start[0], &l.start[1], &l.start[2], &l.start[3], &l.start[4],
+            &l.start[5], &l.start[6], &l.start[7], &l.start[8],
+            &l.end[0], &l.end[1], &l.end[2], &l.end[3], &l.end[4],
+            &l.end[5], &l.end[6], &l.end[7], &l.end[8],
+            &l.feedrate, &l.tlo[0], &l.tlo[1], &l.tlo[2]);
+    if(!r) return NULL;
+
+    void *rec = PreviewBuffer_add(self);
+    if(!rec) return NULL;
+    if(self->kind == PREVIEW_DWELL) memcpy(rec, &d, sizeof(d));
+    else {
+        memcpy(rec, &l, sizeof(l));
+        PreviewBuffer_extend(self, &l);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *PreviewBuffer_find(PyObject *_self, PyObject *args) {
+    PreviewBuffer *self = (PreviewBuffer *)_self;
+    int lineno;
+    if(!PyArg_ParseTuple(args, "i:previewbuffer.find", &lineno)) return NULL;
+    PyObject *result = PyList_New(0);
+    if(!result) return NULL;
+    size_t sz = PreviewBuffer_recsize(self);
+    for(Py_ssize_t i = 0; i < self->count; i++) {
+        // lineno is the first member of both record types
+        if(*(int*)(self->data + i * sz) != lineno) continue;
+        PyObject *item = PreviewBuffer_record(self, i);
+        if(!item || PyList_Append(result, item) < 0) {
+            Py_XDECREF(item);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(item);
+    }
+    return result;
+}
+
+static Py_ssize_t PreviewBuffer_getbuffer(PyObject *_self, Py_ssize_t segment,
+        void **ptrptr) {
+    PreviewBuffer *self = (PreviewBuffer *)_self;
+    if(ptrptr) *ptrptr = self->data;
+    return self->count * PreviewBuffer_recsize(self);
+}
+
+static Py_ssize_t PreviewBuffer_segcount(PyObject *_self, Py_ssize_t *lenp) {
+    PreviewBuffer *self = (PreviewBuffer *)_self;
+    if(lenp) *lenp = self->count * PreviewBuffer_recsize(self);
+    return 1;
+}
+
+static PySequenceMethods PreviewBuffer_as_sequence = {
+    PreviewBuffer_length,   /*sq_length*/
+    0,                      /*sq_concat*/
+    0,                      /*sq_repeat*/
+    PreviewBuffer_item,     /*sq_item*/
+};
+
+static PyBufferProcs PreviewBuffer_as_buffer = {
+    PreviewBuffer_getbuffer,
+    0,
+    PreviewBuffer_segcount,
+    NULL
+};
+
+static PyMethodDef PreviewBuffer_methods[] = {
+    {"append", PreviewBuffer_append, METH_O,
+        "Append one item in the 'rs274.glcanon' format"},
+    {"find", PreviewBuffer_find, METH_VARARGS,
+        "Return a list of the items for one line number"},
+    {NULL}
+};
+
+static PyTypeObject PreviewBufferType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                      /*ob_size*/
+    "gcode.previewbuffer",  /*tp_name*/
+    sizeof(PreviewBuffer),  /*tp_basicsize*/
+    0,                      /*tp_itemsize*/
+    /* methods */
+    PreviewBuffer_dealloc,  /*tp_dealloc*/
+    0,                      /*tp_print*/
+    0,                      /*tp_getattr*/
+    0,                      /*tp_setattr*/
+    0,                      /*tp_compare*/
+    0,                      /*tp_repr*/
+    0,                      /*tp_as_number*/
+    &PreviewBuffer_as_sequence, /*tp_as_sequence*/
+    0,                      /*tp_as_mapping*/
+    0,                      /*tp_hash*/
+    0,                      /*tp_call*/
+    0,                      /*tp_str*/
+    0,                      /*tp_getattro*/
+    0,                      /*tp_setattro*/
+    &PreviewBuffer_as_buffer, /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+    "Preview moves or dwells stored as C records", /*tp_doc*/
+    0,                      /*tp_traverse*/
+    0,                      /*tp_clear*/
+    0,                      /*tp_richcompare*/
+    0,                      /*tp_weaklistoffset*/
+    0,                      /*tp_iter*/
+    0,                      /*tp_iternext*/
+    PreviewBuffer_methods,  /*tp_methods*/
+    0,                      /*tp_members*/
+    0,                      /*tp_getset*/
+    0,                      /*tp_base*/
+    0,                      /*tp_dict*/
+    0,                      /*tp_descr_get*/
+    0,                      /*tp_descr_set*/
+    0,                      /*tp_dictoffset*/
+    PreviewBuffer_init,     /*tp_init*/
+    0,                      /*tp_alloc*/
+    PyType_GenericNew,      /*tp_new*/
+    0,                      /*tp_free*/
+    0,                      /*tp_is_gc*/
+};
+
+static bool PreviewBuffer_Check(PyObject *o, int kind) {
+    return PyObject_TypeCheck(o, &PreviewBufferType)
+        && ((PreviewBuffer*)o)->kind == kind;
+}
+
 static PyObject *callback;
 static int interp_error;
 static int last_sequence_number;
@@ -149,19 +396,349 @@ static InterpBase *pinterp;
 
 #define callmethod(o, m, f, ...) PyObject_CallMethod((o), (char*)(m), (char*)(f), ## __VA_ARGS__)
 
-static void maybe_new_line(int sequence_number=interp_new.sequence_number());
-static void maybe_new_line(int sequence_number) {
-    if(!pinterp) return;
-    if(interp_error) return;
-    if(sequence_number == last_sequence_number)
+
+// When the canon's traverse, feed, arcfeed and dwells are previewbuffers,
+// moves are translated and stored here in C the way GLCanon would have
+// done it in Python, and the canon only hears about comments, tool
+// changes and the like.  This mirrors the GLCanon attributes involved;
+// preview_store and preview_load copy them out to the canon before such
+// a callback and back in afterwards.
+static struct {
+    bool active;
+    PreviewBuffer *traverse, *feed, *arcfeed, *dwells;
+    int reported_sequence_number;
+    double lo[9];
+    bool first_move;
+    int suppress;
+    double feedrate;
+    double tlo[3];
+    int plane;
+    int g5x_index;
+    double g5x_offset[9], g92_offset[9];
+    double rotation_xy, rotation_cos, rotation_sin;
+    double dwell_time;
+    double dwell_color[3];
+    int arcdivision;
+} preview;
+
+static const char *axis_names = "xyzabcuvw";
+
+static bool get_number(PyObject *o, const char *attr_name, double *v) {
+    PyObject *attr = PyObject_GetAttrString(o, (char*)attr_name);
+    if(!attr) return false;
+    *v = PyFloat_AsDouble(attr);
+    Py_DECREF(attr);
+    return !(*v == -1 && PyErr_Occurred());
+}
+
+static bool get_number(PyObject *o, const char *attr_name, int *v) {
+    double d;
+    if(!get_number(o, attr_name, &d)) return false;
+    *v = (int)d;
+    return true;
+}
+
+static bool set_number(PyObject *o, const char *attr_name, double v) {
+    PyObject *attr = PyFloat_FromDouble(v);
+    if(!attr) return false;
+    int r = PyObject_SetAttrString(o, (char*)attr_name, attr);
+    Py_DECREF(attr);
+    return r == 0;
+}
+
+static bool set_int(PyObject *o, const char *attr_name, long v) {
+    PyObject *attr = PyInt_FromLong(v);
+    if(!attr) return false;
+    int r = PyObject_SetAttrString(o, (char*)attr_name, attr);
+    Py_DECREF(attr);
+    return r == 0;
+}
+
+static bool preview_load_offsets(const char *prefix, double *offset) {
+    char name[32];
+    for(int i=0; i<9; i++) {
+        snprintf(name, sizeof(name), "%s%c", prefix, axis_names[i]);
+        if(!get_number(callback, name, &offset[i])) return false;
+    }
+    return true;
+}
+
+static bool preview_store_offsets(const char *prefix, const double *offset) {
+    char name[32];
+    for(int i=0; i<9; i++) {
+        snprintf(name, sizeof(name), "%s%c", prefix, axis_names[i]);
+        if(!set_number(callback, name, offset[i])) return false;
+    }
+    return true;
+}
+
+static bool preview_load() {
+    PyObject *attr;
+    int first_move;
+
+    attr = PyObject_GetAttrString(callback, "lo");
+    if(!attr) return false;
+    int r = PyArg_ParseTuple(attr, "ddddddddd:preview lo",
+        &preview.lo[0], &preview.lo[1], &preview.lo[2],
+        &preview.lo[3], &preview.lo[4], &preview.lo[5],
+        &preview.lo[6], &preview.lo[7], &preview.lo[8]);
+    Py_DECREF(attr);
+    if(!r) return false;
+
+    attr = PyObject_GetAttrString(callback, "first_move");
+    if(!attr) return false;
+    first_move = PyObject_IsTrue(attr);
+    Py_DECREF(attr);
+    if(first_move < 0) return false;
+    preview.first_move = first_move;
+
+    return get_number(callback, "suppress", &preview.suppress)
+        && get_number(callback, "feedrate", &preview.feedrate)
+        && get_number(callback, "xo", &preview.tlo[0])
+        && get_number(callback, "yo", &preview.tlo[1])
+        && get_number(callback, "zo", &preview.tlo[2])
+        && get_number(callback, "plane", &preview.plane)
+        && get_number(callback, "g5x_index", &preview.g5x_index)
+        && preview_load_offsets("g5x_offset_", preview.g5x_offset)
+        && preview_load_offsets("g92_offset_", preview.g92_offset)
+        && get_number(callback, "rotation_xy", &preview.rotation_xy)
+        && get_number(callback, "dwell_time", &preview.dwell_time)
+        && get_number(callback, "arcdivision", &preview.arcdivision);
+}
+
+static bool preview_store() {
+    PyObject *lo = Py_BuildValue("(ddddddddd)",
+        preview.lo[0], preview.lo[1], preview.lo[2],
+        preview.lo[3], preview.lo[4], preview.lo[5],
+        preview.lo[6], preview.lo[7], preview.lo[8]);
+    if(!lo) return false;
+    int r = PyObject_SetAttrString(callback, "lo", lo);
+    Py_DECREF(lo);
+    if(r) return false;
+
+    return PyObject_SetAttrString(callback, "first_move",
+            preview.first_move ? Py_True : Py_False) == 0
+        && set_number(callback, "feedrate", preview.feedrate)
+        && set_int(callback, "plane", preview.plane)
+        && set_int(callback, "g5x_index", preview.g5x_index)
+        && preview_store_offsets("g5x_offset_", preview.g5x_offset)
+        && preview_store_offsets("g92_offset_", preview.g92_offset)
+        && set_number(callback, "rotation_xy", preview.rotation_xy)
+        && set_number(callback, "rotation_cos", preview.rotation_cos)
+        && set_number(callback, "rotation_sin", preview.rotation_sin)
+        && set_number(callback, "dwell_time", preview.dwell_time);
+}
+
+static PreviewBuffer *preview_buffer(const char *attr_name, int kind) {
+    PyObject *attr = PyObject_GetAttrString(callback, (char*)attr_name);
+    if(attr && PreviewBuffer_Check(attr, kind)) return (PreviewBuffer*)attr;
+    Py_XDECREF(attr);
+    return NULL;
+}
+
+static void preview_end() {
+    Py_CLEAR(preview.traverse);
+    Py_CLEAR(preview.feed);
+    Py_CLEAR(preview.arcfeed);
+    Py_CLEAR(preview.dwells);
+    preview.active = false;
+}
+
+// Use the native preview if the canon is set up for it; anything missing
+// leaves the canon to the Python callbacks as before.
+static void preview_begin() {
+    preview_end();
+    preview.traverse = preview_buffer("traverse", PREVIEW_TRAVERSE);
+    preview.feed = preview_buffer("feed", PREVIEW_FEED);
+    preview.arcfeed = preview_buffer("arcfeed", PREVIEW_FEED);
+    preview.dwells = preview_buffer("dwells", PREVIEW_DWELL);
+    if(!preview.traverse || !preview.feed || !preview.arcfeed
+            || !preview.dwells) {
+        PyErr_Clear();
+        preview_end();
         return;
+    }
+
+    PyObject *colors = PyObject_GetAttrString(callback, "colors");
+    PyObject *dwell = colors ? PyMapping_GetItemString(colors, (char*)"dwell") : NULL;
+    bool ok = dwell && PyArg_ParseTuple(dwell, "ddd",
+        &preview.dwell_color[0], &preview.dwell_color[1],
+        &preview.dwell_color[2]);
+    Py_XDECREF(dwell);
+    Py_XDECREF(colors);
+    if(!ok || !preview_load()) {
+        PyErr_Clear();
+        preview_end();
+        return;
+    }
+    preview.rotation_cos = cos(preview.rotation_xy * M_PI / 180.);
+    preview.rotation_sin = sin(preview.rotation_xy * M_PI / 180.);
+    preview.reported_sequence_number = -1;
+    preview.active = true;
+}
+
+static void unrotate(double &x, double &y, double c, double s) {
+    double tx = x * c + y * s;
+    y = -x * s + y * c;
+    x = tx;
+}
+
+static void rotate(double &x, double &y, double c, double s) {
+    double tx = x * c - y * s;
+    y = x * s + y * c;
+    x = tx;
+}
+
+// Break an arc into straight segments, passing the end of each one to emit
+// in the same coordinates as lo.  Stops early if emit returns false.
+static bool arc_segments(const double lo[9], double x1, double y1,
+        double cx, double cy, int rot, double z1,
+        double a, double b, double c, double u, double v, double w,
+        int plane, double rotation_cos, double rotation_sin,
+        const double g5xoffset[9], const double g92offset[9],
+        int max_segments, bool (*emit)(const double p[9], void *arg),
+        void *arg) {
+    double o[9], n[9];
+    int X, Y, Z;
+
+    if(plane == 1) {
+        X=0; Y=1; Z=2;
+    } else if(plane == 3) {
+        X=2; Y=0; Z=1;
+    } else {
+        X=1; Y=2; Z=0;
+    }
+    n[X] = x1;
+    n[Y] = y1;
+    n[Z] = z1;
+    n[3] = a;
+    n[4] = b;
+    n[5] = c;
+    n[6] = u;
+    n[7] = v;
+    n[8] = w;
+    for(int ax=0; ax<9; ax++) o[ax] = lo[ax] - g5xoffset[ax];
+    unrotate(o[0], o[1], rotation_cos, rotation_sin);
+    for(int ax=0; ax<9; ax++) o[ax] -= g92offset[ax];
+
+    double theta1 = atan2(o[Y]-cy, o[X]-cx);
+    double theta2 = atan2(n[Y]-cy, n[X]-cx);
+
+    if(rot < 0) {
+        while(theta2 - theta1 > -CIRCLE_FUZZ) theta2 -= 2*M_PI;
+    } else {
+        while(theta2 - theta1 < CIRCLE_FUZZ) theta2 += 2*M_PI;
+    }
+
+    // if multi-turn, add the right number of full circles
+    if(rot < -1) theta2 += 2*M_PI*(rot+1);
+    if(rot > 1) theta2 += 2*M_PI*(rot-1);
+
+    int steps = std::max(3, int(max_segments * fabs(theta1 - theta2) / M_PI));
+    double rsteps = 1. / steps;
+
+    double dtheta = theta2 - theta1;
+    double d[9] = {0, 0, 0, n[3]-o[3], n[4]-o[4], n[5]-o[5], n[6]-o[6], n[7]-o[7], n[8]-o[8]};
+    d[Z] = n[Z] - o[Z];
+
+    double tx = o[X] - cx, ty = o[Y] - cy, dc = cos(dtheta*rsteps), ds = sin(dtheta*rsteps);
+    for(int i=0; i<steps-1; i++) {
+        double f = (i+1) * rsteps;
+        double p[9];
+        rotate(tx, ty, dc, ds);
+        p[X] = tx + cx;
+        p[Y] = ty + cy;
+        p[Z] = o[Z] + d[Z] * f;
+        p[3] = o[3] + d[3] * f;
+        p[4] = o[4] + d[4] * f;
+        p[5] = o[5] + d[5] * f;
+        p[6] = o[6] + d[6] * f;
+        p[7] = o[7] + d[7] * f;
+        p[8] = o[8] + d[8] * f;
+        for(int ax=0; ax<9; ax++) p[ax] += g92offset[ax];
+        rotate(p[0], p[1], rotation_cos, rotation_sin);
+        for(int ax=0; ax<9; ax++) p[ax] += g5xoffset[ax];
+        if(!emit(p, arg)) return false;
+    }
+    for(int ax=0; ax<9; ax++) n[ax] += g92offset[ax];
+    rotate(n[0], n[1], rotation_cos, rotation_sin);
+    for(int ax=0; ax<9; ax++) n[ax] += g5xoffset[ax];
+    return emit(n, arg);
+}
+
+static void preview_translate(double p[9]) {
+    for(int ax=0; ax<9; ax++) p[ax] += preview.g92_offset[ax];
+    if(preview.rotation_xy)
+        rotate(p[0], p[1], preview.rotation_cos, preview.rotation_sin);
+    for(int ax=0; ax<9; ax++) p[ax] += preview.g5x_offset[ax];
+}
+
+static bool preview_add_line(PreviewBuffer *b,
+        const double start[9], const double end[9]) {
+    preview_line *l = (preview_line*)PreviewBuffer_add(b);
+    if(!l) { interp_error++; return false; }
+    l->lineno = last_sequence_number;
+    memcpy(l->start, start, sizeof(l->start));
+    memcpy(l->end, end, sizeof(l->end));
+    l->feedrate = b->kind == PREVIEW_FEED ? preview.feedrate : 0;
+    memcpy(l->tlo, preview.tlo, sizeof(l->tlo));
+    PreviewBuffer_extend(b, l);
+    return true;
+}
+
+static void preview_straight_traverse(double p[9]) {
+    if(preview.suppress > 0) return;
+    preview_translate(p);
+    if(!preview.first_move)
+        preview_add_line(preview.traverse, preview.lo, p);
+    memcpy(preview.lo, p, sizeof(preview.lo));
+}
+
+static void preview_straight_feed(double p[9]) {
+    if(preview.suppress > 0) return;
+    preview.first_move = false;
+    preview_translate(p);
+    preview_add_line(preview.feed, preview.lo, p);
+    memcpy(preview.lo, p, sizeof(preview.lo));
+}
+
+static void preview_rigid_tap(double x, double y, double z) {
+    if(preview.suppress > 0) return;
+    preview.first_move = false;
+    double p[9] = {x, y, z, 0, 0, 0, 0, 0, 0};
+    preview_translate(p);
+    for(int ax=3; ax<9; ax++) p[ax] = preview.lo[ax];
+    if(preview_add_line(preview.feed, preview.lo, p))
+        preview_add_line(preview.feed, p, preview.lo);
+}
+
+static bool preview_arc_segment(const double p[9], void *arg) {
+    if(!preview_add_line(preview.arcfeed, preview.lo, p)) return false;
+    memcpy(preview.lo, p, sizeof(preview.lo));
+    return true;
+}
+
+static void preview_add_dwell(double time) {
+    if(preview.suppress > 0) return;
+    preview.dwell_time += time;
+    preview_dwell *d = (preview_dwell*)PreviewBuffer_add(preview.dwells);
+    if(!d) { interp_error++; return; }
+    d->lineno = last_sequence_number;
+    d->plane = preview.plane == CANON_PLANE_XZ ? 1 :
+               preview.plane == CANON_PLANE_YZ ? 2 : 0;
+    memcpy(d->color, preview.dwell_color, sizeof(d->color));
+    d->x = preview.lo[0];
+    d->y = preview.lo[1];
+    d->z = preview.lo[2];
+}
+
+static void new_line(int sequence_number) {
     LineCode *new_line_code =
         (LineCode*)(PyObject_New(LineCode, &LineCodeType));
     interp_new.active_settings(new_line_code->settings);
     interp_new.active_g_codes(new_line_code->gcodes);
     interp_new.active_m_codes(new_line_code->mcodes);
     new_line_code->gcodes[0] = sequence_number;
-    last_sequence_number = sequence_number;
     PyObject *result = 
         callmethod(callback, "next_line", "O", new_line_code);
     Py_DECREF(new_line_code);
@@ -169,6 +746,35 @@ static void maybe_new_line(int sequence_number) {
     Py_XDECREF(result);
 }
 
+static void maybe_new_line(int sequence_number=interp_new.sequence_number());
+static void maybe_new_line(int sequence_number) {
+    if(!pinterp) return;
+    if(interp_error) return;
+    if(sequence_number == last_sequence_number)
+        return;
+    last_sequence_number = sequence_number;
+    // the native preview tells the canon about a line only when it has to
+    if(preview.active) return;
+    new_line(sequence_number);
+}
+
+// Bring the canon up to date before calling back into it in native
+// preview mode, and pick up its changes again afterwards.
+static void preview_sync() {
+    if(!preview.active || interp_error) return;
+    if(preview.reported_sequence_number != last_sequence_number) {
+        preview.reported_sequence_number = last_sequence_number;
+        new_line(last_sequence_number);
+        if(interp_error) return;
+    }
+    if(!preview_store()) interp_error++;
+}
+
+static void preview_resync() {
+    if(!preview.active || interp_error) return;
+    if(!preview_load()) interp_error++;
+}
+
 void NURBS_FEED(int line_number, std::vector<CONTROL_POINT> nurbs_control_points, unsigned int k) {
     double u = 0.0;
     unsigned int n = nurbs_control_points.size() - 1;
@@ -205,6 +811,16 @@ void ARC_FEED(int line_number,
     }
     maybe_new_line(line_number);
     if(interp_error) return;
+    if(preview.active) {
+        if(preview.suppress > 0) return;
+        preview.first_move = false;
+        arc_segments(preview.lo, first_end, second_end, first_axis,
+            second_axis, rotation, axis_end_point, a_position, b_position,
+            c_position, u_position, v_position, w_position, preview.plane,
+            preview.rotation_cos, preview.rotation_sin, preview.g5x_offset,
+            preview.g92_offset, preview.arcdivision, preview_arc_segment, 0);
+        return;
+    }
     PyObject *result =
         callmethod(callback, "arc_feed", "ffffifffffff",
                             first_end, second_end, first_axis, second_axis,
@@ -225,6 +841,11 @@ void STRAIGHT_FEED(int line_number,
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; u /= 25.4; v /= 25.4; w /= 25.4; }
     maybe_new_line(line_number);
     if(interp_error) return;
+    if(preview.active) {
+        double p[9] = {x, y, z, a, b, c, u, v, w};
+        preview_straight_feed(p);
+        return;
+    }
     PyObject *result =
         callmethod(callback, "straight_feed", "fffffffff",
                             x, y, z, a, b, c, u, v, w);
@@ -242,6 +863,11 @@ void STRAIGHT_TRAVERSE(int line_number,
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; u /= 25.4; v /= 25.4; w /= 25.4; }
     maybe_new_line(line_number);
     if(interp_error) return;
+    if(preview.active) {
+        double p[9] = {x, y, z, a, b, c, u, v, w};
+        preview_straight_traverse(p);
+        return;
+    }
     PyObject *result =
         callmethod(callback, "straight_traverse", "fffffffff",
                             x, y, z, a, b, c, u, v, w);
@@ -256,6 +882,12 @@ void SET_G5X_OFFSET(int g5x_index,
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; u /= 25.4; v /= 25.4; w /= 25.4; }
     maybe_new_line();
     if(interp_error) return;
+    if(preview.active) {
+        double offset[9] = {x, y, z, a, b, c, u, v, w};
+        preview.g5x_index = g5x_index;
+        memcpy(preview.g5x_offset, offset, sizeof(offset));
+        return;
+    }
     PyObject *result =
         callmethod(callback, "set_g5x_offset", "ifffffffff",
                             g5x_index, x, y, z, a, b, c, u, v, w);
@@ -269,6 +901,11 @@ void SET_G92_OFFSET(double x, double y, double z,
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; u /= 25.4; v /= 25.4; w /= 25.4; }
     maybe_new_line();
     if(interp_error) return;
+    if(preview.active) {
+        double offset[9] = {x, y, z, a, b, c, u, v, w};
+        memcpy(preview.g92_offset, offset, sizeof(offset));
+        return;
+    }
     PyObject *result =
         callmethod(callback, "set_g92_offset", "fffffffff",
                             x, y, z, a, b, c, u, v, w);
@@ -279,6 +916,12 @@ void SET_G92_OFFSET(double x, double y, double z,
 void SET_XY_ROTATION(double t) {
     maybe_new_line();
     if(interp_error) return;
+    if(preview.active) {
+        preview.rotation_xy = t;
+        preview.rotation_cos = cos(t * M_PI / 180.);
+        preview.rotation_sin = sin(t * M_PI / 180.);
+        return;
+    }
     PyObject *result =
         callmethod(callback, "set_xy_rotation", "f", t);
     if(result == NULL) interp_error ++;
@@ -290,6 +933,10 @@ void USE_LENGTH_UNITS(CANON_UNITS u) { metric = u == CANON_UNITS_MM; }
 void SELECT_PLANE(CANON_PLANE pl) {
     maybe_new_line();   
     if(interp_error) return;
+    if(preview.active) {
+        preview.plane = pl;
+        return;
+    }
     PyObject *result =
         callmethod(callback, "set_plane", "i", pl);
     if(result == NULL) interp_error ++;
@@ -319,10 +966,13 @@ void SET_FEED_MODE(int mode) {
 void CHANGE_TOOL(int pocket) {
     maybe_new_line();
     if(interp_error) return;
+    preview_sync();
+    if(interp_error) return;
     PyObject *result = 
         callmethod(callback, "change_tool", "i", pocket);
     if(result == NULL) interp_error ++;
     Py_XDECREF(result);
+    preview_resync();
 }
 
 void CHANGE_TOOL_NUMBER(int pocket) {
@@ -339,6 +989,10 @@ void SET_FEED_RATE(double rate) {
     maybe_new_line();   
     if(interp_error) return;
     if(metric) rate /= 25.4;
+    if(preview.active) {
+        preview.feedrate = rate / 60.;
+        return;
+    }
     PyObject *result =
         callmethod(callback, "set_feed_rate", "f", rate);
     if(result == NULL) interp_error ++;
@@ -348,6 +1002,10 @@ void SET_FEED_RATE(double rate) {
 void DWELL(double time) {
     maybe_new_line();   
     if(interp_error) return;
+    if(preview.active) {
+        preview_add_dwell(time);
+        return;
+    }
     PyObject *result =
         callmethod(callback, "dwell", "f", time);
     if(result == NULL) interp_error ++;
@@ -357,10 +1015,13 @@ void DWELL(double time) {
 void MESSAGE(char *comment) {
     maybe_new_line();   
     if(interp_error) return;
+    preview_sync();
+    if(interp_error) return;
     PyObject *result =
         callmethod(callback, "message", "s", comment);
     if(result == NULL) interp_error ++;
     Py_XDECREF(result);
+    preview_resync();
 }
 
 void LOG(char *s) {}
@@ -371,10 +1032,13 @@ void LOGCLOSE() {}
 void COMMENT(const char *comment) {
     maybe_new_line();   
     if(interp_error) return;
+    preview_sync();
+    if(interp_error) return;
     PyObject *result =
         callmethod(callback, "comment", "s", comment);
     if(result == NULL) interp_error ++;
     Py_XDECREF(result);
+    preview_resync();
 }
 
 void SET_TOOL_TABLE_ENTRY(int pocket, int toolno, EmcPose offset, double diameter,
@@ -388,10 +1052,13 @@ void USE_TOOL_LENGTH_OFFSET(EmcPose offset) {
     if(metric) {
         offset.tran.x /= 25.4; offset.tran.y /= 25.4; offset.tran.z /= 25.4;
         offset.u /= 25.4; offset.v /= 25.4; offset.w /= 25.4; }
+    preview_sync();
+    if(interp_error) return;
     PyObject *result = callmethod(callback, "tool_offset", "ddddddddd", offset.tran.x, offset.tran.y, offset.tran.z,
         offset.a, offset.b, offset.c, offset.u, offset.v, offset.w);
     if(result == NULL) interp_error ++;
     Py_XDECREF(result);
+    preview_resync();
 }
 
 void SET_FEED_REFERENCE(double reference) { }
@@ -477,6 +1144,11 @@ void STRAIGHT_PROBE(int line_number,
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; u /= 25.4; v /= 25.4; w /= 25.4; }
     maybe_new_line(line_number);
     if(interp_error) return;
+    if(preview.active) {
+        double p[9] = {x, y, z, a, b, c, u, v, w};
+        preview_straight_feed(p);
+        return;
+    }
     PyObject *result =
         callmethod(callback, "straight_probe", "fffffffff",
                             x, y, z, a, b, c, u, v, w);
@@ -489,6 +1161,10 @@ void RIGID_TAP(int line_number,
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; }
     maybe_new_line(line_number);
     if(interp_error) return;
+    if(preview.active) {
+        preview_rigid_tap(x, y, z);
+        return;
+    }
     PyObject *result =
         callmethod(callback, "rigid_tap", "fff",
             x, y, z);
@@ -548,11 +1224,14 @@ int WAIT(int index, int input_type, int wait_type, double timeout) { return 0;}
 static void user_defined_function(int num, double arg1, double arg2) {
     if(interp_error) return;
     maybe_new_line();
+    preview_sync();
+    if(interp_error) return;
     PyObject *result =
         callmethod(callback, "user_defined_function",
                             "idd", num, arg1, arg2);
     if(result == NULL) interp_error++;
     Py_XDECREF(result);
+    preview_resync();
 }
 
 void SET_FEED_REFERENCE(int ref) {}
@@ -686,10 +1365,17 @@ static PyObject *parse_file(PyObject *self, PyObject *args) {
     char *unitcode=0, *initcode=0, *interpname=0;
     int error_line_offset = 0;
     struct timeval t0, t1;
-    int wait = 1;
+    double wait = 1;
     if(!PyArg_ParseTuple(args, "sO|sss", &f, &callback, &unitcode, &initcode, &interpname))
         return NULL;
 
+    // how often to call check_abort, which is also where a canon can show
+    // the part of the program read so far
+    if(!get_number(callback, "update_interval", &wait)) {
+        PyErr_Clear();
+        wait = 1;
+    }
+
     if(pinterp) {
         delete pinterp;
         pinterp = 0;
@@ -714,6 +1400,7 @@ static PyObject *parse_file(PyObject *self, PyObject *args) {
     interp_new.init();
     interp_new.open(f);
 
+    preview_begin();
     maybe_new_line();
 
     int result = INTERP_OK;
@@ -731,8 +1418,9 @@ static PyObject *parse_file(PyObject *self, PyObject *args) {
         error_line_offset = 1;
         result = interp_new.read();
         gettimeofday(&t1, NULL);
-        if(t1.tv_sec > t0.tv_sec + wait) {
-            if(check_abort()) return NULL;
+        if(t1.tv_sec - t0.tv_sec + (t1.tv_usec - t0.tv_usec) * 1e-6 > wait) {
+            preview_sync();
+            if(check_abort()) { preview_end(); return NULL; }
             t0 = t1;
         }
         if(!RESULT_OK) break;
@@ -742,6 +1430,7 @@ static PyObject *parse_file(PyObject *self, PyObject *args) {
 out_error:
     if(pinterp) pinterp->close();
     if(interp_error) {
+        preview_end();
         if(!PyErr_Occurred()) {
             PyErr_Format(PyExc_RuntimeError,
                     "interp_error > 0 but no Python exception set");
@@ -750,7 +1439,9 @@ out_error:
     }
     PyErr_Clear();
     maybe_new_line();
+    preview_sync();
     if(PyErr_Occurred()) { interp_error = 1; goto out_error; }
+    preview_end();
     PyObject *retval = PyTuple_New(2);
     PyTuple_SetItem(retval, 0, PyInt_FromLong(result));
     PyTuple_SetItem(retval, 1, PyInt_FromLong(last_sequence_number + error_line_offset));
@@ -778,7 +1469,28 @@ static PyObject *rs274_calc_extents(PyObject *self, PyObject *args) {
         if(!si) return NULL;
         int j;
         double xs, ys, zs, xe, ye, ze, xt, yt, zt;
-        for(j=0; j<PySequence_Length(si); j++) {
+        if(PreviewBuffer_Check(si, PREVIEW_TRAVERSE)
+                || PreviewBuffer_Check(si, PREVIEW_FEED)) {
+            PreviewBuffer *b = (PreviewBuffer*)si;
+            max_x = std::max(max_x, b->max[0]);
+            max_y = std::max(max_y, b->max[1]);
+            max_z = std::max(max_z, b->max[2]);
+            min_x = std::min(min_x, b->min[0]);
+            min_y = std::min(min_y, b->min[1]);
+            min_z = std::min(min_z, b->min[2]);
+            max_xt = std::max(max_xt, b->max_t[0]);
+            max_yt = std::max(max_yt, b->max_t[1]);
+            max_zt = std::max(max_zt, b->max_t[2]);
+            min_xt = std::min(min_xt, b->min_t[0]);
+            min_yt = std::min(min_yt, b->min_t[1]);
+            min_zt = std::min(min_zt, b->min_t[2]);
+            j = b->count;
+            if(j > 0) {
+                preview_line *l = (preview_line*)b->data + j - 1;
+                xe = l->end[0]; ye = l->end[1]; ze = l->end[2];
+                xt = l->tlo[0]; yt = l->tlo[1]; zt = l->tlo[2];
+            }
+        } else for(j=0; j<PySequence_Length(si); j++) {
             PyObject *sj = PySequence_GetItem(si, j);
             PyObject *unused;
             int r;
@@ -871,24 +1583,20 @@ static bool get_attr(PyObject *o, const char *attr_name, const char *fmt, ...) {
     return result;
 }
 
-static void unrotate(double &x, double &y, double c, double s) {
-    double tx = x * c + y * s;
-    y = -x * s + y * c;
-    x = tx;
-}
-
-static void rotate(double &x, double &y, double c, double s) {
-    double tx = x * c - y * s;
-    y = x * s + y * c;
-    x = tx;
+static bool append_segment(const double p[9], void *arg) {
+    PyObject *seg = Py_BuildValue("ddddddddd",
+        p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8]);
+    if(!seg) return false;
+    int r = PyList_Append((PyObject*)arg, seg);
+    Py_DECREF(seg);
+    return r == 0;
 }
 
 static PyObject *rs274_arc_to_segments(PyObject *self, PyObject *args) {
     PyObject *canon;
     double x1, y1, cx, cy, z1, a, b, c, u, v, w;
-    double o[9], n[9], g5xoffset[9], g92offset[9];
+    double o[9], g5xoffset[9], g92offset[9];
     int rot, plane;
-    int X, Y, Z;
     double rotation_cos, rotation_sin;
     int max_segments = 128;
 
@@ -919,72 +1627,14 @@ static PyObject *rs274_arc_to_segments(PyObject *self, PyObject *args) {
     if(!get_attr(canon, "g92_offset_v", &g92offset[7])) return NULL;
     if(!get_attr(canon, "g92_offset_w", &g92offset[8])) return NULL;
 
-    if(plane == 1) {
-        X=0; Y=1; Z=2;
-    } else if(plane == 3) {
-        X=2; Y=0; Z=1;
-    } else {
-        X=1; Y=2; Z=0;
-    }
-    n[X] = x1;
-    n[Y] = y1;
-    n[Z] = z1;
-    n[3] = a;
-    n[4] = b;
-    n[5] = c;
-    n[6] = u;
-    n[7] = v;
-    n[8] = w;
-    for(int ax=0; ax<9; ax++) o[ax] -= g5xoffset[ax];
-    unrotate(o[0], o[1], rotation_cos, rotation_sin);
-    for(int ax=0; ax<9; ax++) o[ax] -= g92offset[ax];
-
-    double theta1 = atan2(o[Y]-cy, o[X]-cx);
-    double theta2 = atan2(n[Y]-cy, n[X]-cx);
-
-    if(rot < 0) {
-        while(theta2 - theta1 > -CIRCLE_FUZZ) theta2 -= 2*M_PI;
-    } else {
-        while(theta2 - theta1 < CIRCLE_FUZZ) theta2 += 2*M_PI;
-    }
-
-    // if multi-turn, add the right number of full circles
-    if(rot < -1) theta2 += 2*M_PI*(rot+1);
-    if(rot > 1) theta2 += 2*M_PI*(rot-1);
-
-    int steps = std::max(3, int(max_segments * fabs(theta1 - theta2) / M_PI));
-    double rsteps = 1. / steps;
-    PyObject *segs = PyList_New(steps);
-
-    double dtheta = theta2 - theta1;
-    double d[9] = {0, 0, 0, n[3]-o[3], n[4]-o[4], n[5]-o[5], n[6]-o[6], n[7]-o[7], n[8]-o[8]};
-    d[Z] = n[Z] - o[Z];
-
-    double tx = o[X] - cx, ty = o[Y] - cy, dc = cos(dtheta*rsteps), ds = sin(dtheta*rsteps);
-    for(int i=0; i<steps-1; i++) {
-        double f = (i+1) * rsteps;
-        double p[9];
-        rotate(tx, ty, dc, ds);
-        p[X] = tx + cx;
-        p[Y] = ty + cy;
-        p[Z] = o[Z] + d[Z] * f;
-        p[3] = o[3] + d[3] * f;
-        p[4] = o[4] + d[4] * f;
-        p[5] = o[5] + d[5] * f;
-        p[6] = o[6] + d[6] * f;
-        p[7] = o[7] + d[7] * f;
-        p[8] = o[8] + d[8] * f;
-        for(int ax=0; ax<9; ax++) p[ax] += g92offset[ax];
-        rotate(p[0], p[1], rotation_cos, rotation_sin);
-        for(int ax=0; ax<9; ax++) p[ax] += g5xoffset[ax];
-        PyList_SET_ITEM(segs, i,
-            Py_BuildValue("ddddddddd", p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8]));
+    PyObject *segs = PyList_New(0);
+    if(!segs) return NULL;
+    if(!arc_segments(o, x1, y1, cx, cy, rot, z1, a, b, c, u, v, w, plane,
+            rotation_cos, rotation_sin, g5xoffset, g92offset, max_segments,
+            append_segment, segs)) {
+        Py_DECREF(segs);
+        return NULL;
     }
-    for(int ax=0; ax<9; ax++) n[ax] += g92offset[ax];
-    rotate(n[0], n[1], rotation_cos, rotation_sin);
-    for(int ax=0; ax<9; ax++) n[ax] += g5xoffset[ax];
-    PyList_SET_ITEM(segs, steps-1,
-        Py_BuildValue("ddddddddd", n[0], n[1], n[2], n[3], n[4], n[5], n[6], n[7], n[8]));
     return segs;
 }
 
@@ -1005,6 +1655,11 @@ initgcode(void) {
                 "Interface to EMC rs274ngc interpreter");
     PyType_Ready(&LineCodeType);
     PyModule_AddObject(m, "linecode", (PyObject*)&LineCodeType);
+    PyType_Ready(&PreviewBufferType);
+    PyModule_AddObject(m, "previewbuffer", (PyObject*)&PreviewBufferType);
+    PyModule_AddIntConstant(m, "PREVIEW_TRAVERSE", PREVIEW_TRAVERSE);
+    PyModule_AddIntConstant(m, "PREVIEW_FEED", PREVIEW_FEED);
+    PyModule_AddIntConstant(m, "PREVIEW_DWELL", PREVIEW_DWELL);
     PyObject_SetAttrString(m, "MAX_ERROR", PyInt_FromLong(maxerror));
     PyObject_SetAttrString(m, "MIN_ERROR",
             PyInt_FromLong(INTERP_MIN_ERROR));
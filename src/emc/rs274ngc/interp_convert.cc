@@ -4199,6 +4199,7 @@ int Interp::convert_stop(block_pointer block,    //!< pointer to a block of RS27
       PALLET_SHUTTLE();
     PROGRAM_END();
     if (_setup.percent_flag && _setup.file_pointer) {
+      seek_text(tell_text());   // lines from the line cache leave the file behind
       line = _setup.linetext;
       for (;;) {                /* check for ending percent sign and comment if missing */
         if (fgets(line, LINELEN, _setup.file_pointer) == NULL) {
@@ -0,0 +1,461 @@
+/********************************************************************
+* Description: interp_expr.cc
+*
+*   Compiled expressions.  The readers in interp_read.cc evaluate
+*   expressions as they scan them, which is fine for a line that is
+*   executed once.  Lines in the line cache (loop bodies, subroutines)
+*   are executed again and again, so their expressions are compiled
+*   to postfix code the first time and the code is run after that.
+*
+* License: GPL Version 2
+* System: Linux
+*
+* Copyright (c) 2026 All rights reserved.
+********************************************************************/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <boost/python.hpp>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "rs274ngc.hh"
+#include "rs274ngc_return.hh"
+#include "interp_internal.hh"
+#include "rs274ngc_interp.hh"
+
+// values an expression may need on the stack at once; anything deeper
+// is left to the readers
+#define MAX_EXPR_STACK 64
+
+// as in interp_read.cc
+#define MAX_STACK 7
+
+static void emit(expr_program *prog, int code, int arg = 0,
+                 double value = 0.0, const char *name = NULL)
+{
+  expr_op op;
+
+  op.code = code;
+  op.arg = arg;
+  op.value = value;
+  op.name = name;
+  op.id = name ? param_id(name) : -1;
+  prog->ops.push_back(op);
+}
+
+/****************************************************************************/
+
+/*! compiled_expression
+
+Returned Value: expr_program *
+   The compiled code for the expression or value starting at 'counter',
+   or NULL if the line is not in the line cache or the text does not
+   compile.
+
+Side effects:
+   The expression is compiled and kept with the cached line the first
+   time it is asked for.
+
+Called by:
+   read_real_expression
+   read_real_value
+
+Only the text in _setup.blocktext of a line from the line cache is
+compiled, since that text will be read again at the same place.  A
+program starting at a left bracket is for read_real_expression and any
+other is for read_real_value, so one map keyed by position does for
+both.
+
+Compiling reads the same grammar the readers do but evaluates nothing,
+and emits the evaluation steps in the order the readers would perform
+them, so running the program gives the same values and the same errors.
+When the text does not compile, the readers are left to find and
+report what is wrong with it.
+
+*/
+
+expr_program *Interp::compiled_expression(char *line, //!< line being read
+                                          int counter) //!< where the value starts
+{
+  cached_line *cl = _setup.line_cache_line;
+  expr_program_map::iterator it;
+  expr_program *prog;
+  int end = counter;
+  int status;
+
+  if (cl == NULL || line != _setup.blocktext)
+    return NULL;
+  it = cl->exprs.find(counter);
+  if (it != cl->exprs.end())
+    return (it->second.end < 0) ? NULL : &it->second;
+
+  prog = &cl->exprs[counter];
+  prog->depth = 0;
+  if (line[counter] == '[')
+    status = compile_real_expression(line, &end, prog, 0);
+  else
+    status = compile_real_value(line, &end, prog, 0);
+  if (status != INTERP_OK || prog->depth > MAX_EXPR_STACK) {
+    prog->ops.clear();
+    prog->end = -1;
+    return NULL;
+  }
+  prog->end = end;
+  return prog;
+}
+
+/****************************************************************************/
+
+/*! compile_real_expression
+
+Returned Value: int
+   INTERP_OK, or INTERP_ERROR if the text is not a real expression.
+
+Side effects:
+   Code for the expression is added to prog and the counter is moved
+   past the closing right bracket.
+
+Called by:
+   compiled_expression
+   compile_real_value
+   compile_unary
+
+This is read_real_expression with execute_binary replaced by emitting
+an EXPR_BINARY, so the operations come out in the order
+read_real_expression carries them out.  'depth' is how many values are
+on the stack when the expression starts.
+
+*/
+
+int Interp::compile_real_expression(char *line,  //!< line being compiled
+                                    int *counter, //!< position on the line
+                                    expr_program *prog, //!< code being made
+                                    int depth)   //!< values already on the stack
+{
+  int operators[MAX_STACK];
+  int stack_index;
+
+  if (line[*counter] != '[')
+    return INTERP_ERROR;
+  *counter = (*counter + 1);
+  CHP(compile_real_value(line, counter, prog, depth));
+  CHP(read_operation(line, counter, operators));
+  stack_index = 1;
+  for (; operators[0] != RIGHT_BRACKET;) {
+    if (stack_index >= MAX_STACK)
+      return INTERP_ERROR;
+    CHP(compile_real_value(line, counter, prog, depth + stack_index));
+    CHP(read_operation(line, counter, operators + stack_index));
+    if (precedence(operators[stack_index]) >
+        precedence(operators[stack_index - 1]))
+      stack_index++;
+    else {
+      for (; precedence(operators[stack_index]) <=
+           precedence(operators[stack_index - 1]);) {
+        emit(prog, EXPR_BINARY, operators[stack_index - 1]);
+        operators[stack_index - 1] = operators[stack_index];
+        if ((stack_index > 1) &&
+            (precedence(operators[stack_index - 1]) <=
+             precedence(operators[stack_index - 2])))
+          stack_index--;
+        else
+          break;
+      }
+    }
+  }
+  return INTERP_OK;
+}
+
+/****************************************************************************/
+
+/*! compile_real_value
+
+Returned Value: int
+   INTERP_OK, or INTERP_ERROR if the text is not a real value.
+
+Side effects:
+   Code for the value is added to prog and the counter is moved past it.
+
+Called by:
+   compiled_expression
+   compile_parameter
+   compile_real_expression
+
+This follows read_real_value.  Numbers are converted here, once, with
+read_real_number.
+
+*/
+
+int Interp::compile_real_value(char *line,  //!< line being compiled
+                               int *counter, //!< position on the line
+                               expr_program *prog, //!< code being made
+                               int depth)   //!< values already on the stack
+{
+  char c, c1;
+  double value;
+
+  c = line[*counter];
+  if (c == 0)
+    return INTERP_ERROR;
+  c1 = line[*counter+1];
+  if (depth + 1 > prog->depth)
+    prog->depth = depth + 1;
+
+  if (c == '[')
+    CHP(compile_real_expression(line, counter, prog, depth));
+  else if (c == '#')
+    CHP(compile_parameter(line, counter, prog, depth, false));
+  else if (c == '+' && c1 && !isdigit(c1) && c1 != '.') {
+    (*counter)++;
+    CHP(compile_real_value(line, counter, prog, depth));
+  } else if (c == '-' && c1 && !isdigit(c1) && c1 != '.') {
+    (*counter)++;
+    CHP(compile_real_value(line, counter, prog, depth));
+    emit(prog, EXPR_NEGATE);
+  } else if ((c >= 'a') && (c <= 'z'))
+    CHP(compile_unary(line, counter, prog, depth));
+  else {
+    CHP(read_real_number(line, counter, &value));
+    // read_real_number never gives back nan or infinity
+    emit(prog, EXPR_CONST, 0, value);
+    return INTERP_OK;
+  }
+  emit(prog, EXPR_CHECK);
+  return INTERP_OK;
+}
+
+/****************************************************************************/
+
+/*! compile_parameter
+
+Returned Value: int
+   INTERP_OK, or INTERP_ERROR if the text is not a parameter.
+
+Side effects:
+   Code for the parameter (or, with check_exists, for whether it
+   exists) is added to prog and the counter is moved past it.
+
+Called by:
+   compile_real_value
+   compile_unary
+
+This follows read_parameter and read_named_parameter.  A named
+parameter is looked up by name each time the program runs, since which
+one the name means depends on the call level.  A numbered parameter
+with a constant number is fetched directly.
+
+*/
+
+int Interp::compile_parameter(char *line,  //!< line being compiled
+                              int *counter, //!< position on the line
+                              expr_program *prog, //!< code being made
+                              int depth,   //!< values already on the stack
+                              bool check_exists) //!< test for existence
+{
+  char nameBuf[LINELEN+1];
+  expr_op *last;
+  int index;
+
+  if (line[*counter] != '#')
+    return INTERP_ERROR;
+  *counter = (*counter + 1);
+
+  if (line[*counter] == '<') {
+    CHP(read_name(line, counter, nameBuf));
+    emit(prog, check_exists ? EXPR_EXISTS_NAMED : EXPR_NAMED, 0, 0.0,
+         strstore(nameBuf));
+    return INTERP_OK;
+  }
+
+  CHP(compile_real_value(line, counter, prog, depth));
+  last = &prog->ops.back();
+  if (!check_exists && last->code == EXPR_CONST) {
+    // the integer test of read_integer_value on a constant
+    index = (int) floor(last->value);
+    if ((last->value - index) > 0.9999)
+      index = (int) ceil(last->value);
+    else if ((last->value - index) > 0.0001)
+      index = -1;
+    if ((index >= 1) && (index < RS274NGC_MAX_PARAMETERS)) {
+      last->code = EXPR_PARAM;
+      last->arg = index;
+      return INTERP_OK;
+    }
+  }
+  emit(prog, check_exists ? EXPR_EXISTS_INDEX : EXPR_PARAM_INDEX);
+  return INTERP_OK;
+}
+
+/****************************************************************************/
+
+/*! compile_unary
+
+Returned Value: int
+   INTERP_OK, or INTERP_ERROR if the text is not a unary operation.
+
+Side effects:
+   Code for the operation and its argument(s) is added to prog and the
+   counter is moved past it.
+
+Called by: compile_real_value
+
+This follows read_unary, read_bracketed_parameter and read_atan.
+
+*/
+
+int Interp::compile_unary(char *line,  //!< line being compiled
+                          int *counter, //!< position on the line
+                          expr_program *prog, //!< code being made
+                          int depth)   //!< values already on the stack
+{
+  int operation;
+
+  CHP(read_operation_unary(line, counter, &operation));
+  if (line[*counter] != '[')
+    return INTERP_ERROR;
+
+  if (operation == EXISTS) {
+    *counter = (*counter + 1);
+    if (line[*counter] != '#')
+      return INTERP_ERROR;
+    CHP(compile_parameter(line, counter, prog, depth, true));
+    if (line[*counter] != ']')
+      return INTERP_ERROR;
+    *counter = (*counter + 1);
+    return INTERP_OK;
+  }
+
+  CHP(compile_real_expression(line, counter, prog, depth));
+  if (operation == ATAN) {
+    if (line[*counter] != '/')
+      return INTERP_ERROR;
+    *counter = (*counter + 1);
+    if (line[*counter] != '[')
+      return INTERP_ERROR;
+    CHP(compile_real_expression(line, counter, prog, depth + 1));
+    emit(prog, EXPR_ATAN);
+  } else
+    emit(prog, EXPR_UNARY, operation);
+  return INTERP_OK;
+}
+
+/****************************************************************************/
+
+/*! execute_expression
+
+Returned Value: int
+   If execute_binary, execute_unary or find_named_param returns an
+   error code, this returns that code.  Otherwise it returns the errors
+   the readers would give for the same text, or INTERP_OK.
+
+Side effects:
+   The value of the expression is put into what value points at.
+
+Called by:
+   read_real_expression
+   read_real_value
+
+*/
+
+int Interp::execute_expression(expr_program *prog, //!< code to run
+                               double *value,      //!< result
+                               double *parameters) //!< array of system parameters
+{
+  double stack[MAX_EXPR_STACK];
+  double *top = stack - 1;
+  expr_op *op = &prog->ops[0];
+  expr_op *end = op + prog->ops.size();
+  int index, exists;
+
+  for (; op < end; op++) {
+    switch (op->code) {
+    case EXPR_CONST:
+      *++top = op->value;
+      break;
+    case EXPR_PARAM:
+      CHKS(((op->arg >= 5420) && (op->arg <= 5428) && (_setup.cutter_comp_side)),
+           _("Cannot read current position with cutter radius compensation on"));
+      *++top = parameters[op->arg];
+      break;
+    case EXPR_PARAM_INDEX:
+    case EXPR_EXISTS_INDEX:
+      // as read_integer_value
+      index = (int) floor(*top);
+      if ((*top - index) > 0.9999) {
+        index = (int) ceil(*top);
+      } else if ((*top - index) > 0.0001)
+        ERS(NCE_NON_INTEGER_VALUE_FOR_INTEGER);
+      if (op->code == EXPR_EXISTS_INDEX) {
+        *top = index >= 1 && index < RS274NGC_MAX_PARAMETERS;
+        break;
+      }
+      CHKS(((index < 1) || (index >= RS274NGC_MAX_PARAMETERS)),
+          NCE_PARAMETER_NUMBER_OUT_OF_RANGE);
+      CHKS(((index >= 5420) && (index <= 5428) && (_setup.cutter_comp_side)),
+           _("Cannot read current position with cutter radius compensation on"));
+      *top = parameters[index];
+      break;
+    case EXPR_NAMED:
+      CHP(find_named_param(op->name, op->id, &exists, ++top));
+      if (!exists) {
+        // do not require named parameters to be defined during a
+        // subroutine definition:
+        if (_setup.defining_sub) {
+          *top = 0.0;
+          break;
+        }
+        logNP("execute_expression: referencing undefined named parameter '%s' level=%d",
+              op->name, (op->name[0] == '_') ? 0 : _setup.call_level);
+        ERS(_("Named parameter #<%s> not defined"), op->name);
+      }
+      break;
+    case EXPR_EXISTS_NAMED:
+      CHP(find_named_param(op->name, op->id, &exists, ++top));
+      *top = exists ? 1.0 : 0.0;
+      break;
+    case EXPR_NEGATE:
+      *top = -*top;
+      break;
+    case EXPR_UNARY:
+      CHP(execute_unary(top, op->arg));
+      break;
+    case EXPR_ATAN:
+      top--;
+      *top = atan2(*top, top[1]);              /* value in radians */
+      *top = ((*top * 180.0) / M_PIl);         /* convert to degrees */
+      break;
+    case EXPR_BINARY:
+      top--;
+      switch (op->arg) {
+      case PLUS:
+        *top += top[1];
+        break;
+      case MINUS:
+        *top -= top[1];
+        break;
+      case TIMES:
+        *top *= top[1];
+        break;
+      default:
+        CHP(execute_binary(top, op->arg, top + 1));
+      }
+      break;
+    case EXPR_CHECK:
+      CHKS(isnan(*top),
+              _("Calculation resulted in 'not a number'"));
+      CHKS(isinf(*top),
+              _("Calculation resulted in 'infinity'"));
+      break;
+    default:
+      ERS(NCE_BUG_UNKNOWN_OPERATION);
+    }
+  }
+  *value = *top;
+  return INTERP_OK;
+}
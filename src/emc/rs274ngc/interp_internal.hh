@@ -21,6 +21,9 @@
 #include <stdio.h>
 #include <set>
 #include <map>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
 #include <bitset>
 #include "canon.hh"
 #include "emcpos.h"
@@ -263,6 +266,12 @@ RETRACT_MODE;
 // string table - to get rid of strdup/free
 const char *strstore(const char *s);
 
+// named parameter names are interned: param_id() gives the number of a
+// name (ignoring case), adding it if it is new, and param_name() the
+// spelling it was first seen with
+int param_id(const char *name);
+const char *param_name(int id);
+
 
 // Block execution phases in execution order
 // very carefully check code for sequencing when
@@ -507,15 +516,38 @@ enum retopts { RET_NONE, RET_DOUBLE, RET_INT, RET_YIELD, RET_STOPITERATION, RET_
 
 typedef block *block_pointer;
 
-// parameters will go to a std::map<const char *,paramter_value_pointer>
 typedef struct parameter_value_struct {
     double value;
     unsigned attr;
 } parameter_value;
 
 typedef parameter_value *parameter_pointer;
-typedef std::map<const char *, parameter_value, nocase_cmp> parameter_map;
-typedef parameter_map::iterator parameter_map_iterator;
+
+typedef struct parameter_entry_struct {
+    int id;              // param_id() of the name
+    parameter_value value;
+} parameter_entry;
+
+// The named parameters of a call frame, keyed by param_id().  The
+// entries are kept in a vector in the order they were added, with an
+// open addressed index over it.  Clearing the frame when a subroutine
+// returns keeps the storage for the next call.
+class parameter_map {
+public:
+    parameter_map() : mask(0) {}
+    parameter_pointer find(int id);
+    parameter_value &operator[](int id);	// adds the entry if missing
+    void erase(int id);
+    void clear();
+    int size() const { return entries.size(); }
+    const parameter_entry &at(int i) const { return entries[i]; }
+private:
+    int slot(int id) const;
+    void rehash(int size);
+    std::vector<parameter_entry> entries;
+    std::vector<int> index;  // subscripts into entries plus one, 0 = empty
+    int mask;                // index.size() - 1
+};
 
 #define PA_READONLY	1
 #define PA_GLOBAL	2
@@ -574,6 +606,74 @@ typedef struct offset_struct {
 typedef std::map<const char *, offset, nocase_cmp> offset_map_type;
 typedef std::map<const char *, offset, nocase_cmp>::iterator offset_map_iterator;
 
+// Expressions on cached lines are compiled to postfix code the first
+// time they are read, see interp_expr.cc.
+enum expr_opcodes {
+  EXPR_CONST,          // push value
+  EXPR_PARAM,          // push #index
+  EXPR_PARAM_INDEX,    // replace the index on top with its parameter
+  EXPR_EXISTS_INDEX,   // replace the index on top with whether it exists
+  EXPR_NAMED,          // push #<name>
+  EXPR_EXISTS_NAMED,   // push whether #<name> exists
+  EXPR_NEGATE,
+  EXPR_UNARY,          // operation on top
+  EXPR_ATAN,           // atan[below]/[top]
+  EXPR_BINARY,         // below operation top
+  EXPR_CHECK,          // fail if the top is not a number or infinite
+};
+
+typedef struct expr_op_struct {
+  int code;            // one of expr_opcodes
+  int arg;             // parameter index or operation
+  double value;        // for EXPR_CONST
+  const char *name;    // for EXPR_NAMED and EXPR_EXISTS_NAMED, strstore()d
+  int id;              // and its param_id()
+} expr_op;
+
+typedef struct expr_program_struct {
+  std::vector<expr_op> ops;
+  int end;             // where reading stops on the line, -1 if no program
+  int depth;           // stack needed
+} expr_program;
+
+typedef std::map<int, expr_program> expr_program_map;
+
+// Lines which are read more than once (loop bodies, subroutines) are
+// kept after close_and_downcase, keyed by their offset in the file, so
+// going round a loop again does not reread and recase the text.
+typedef struct cached_line_struct {
+  std::string raw;     // as read, trailing white space removed
+  std::string line;    // after close_and_downcase
+  long next;           // offset of the following line
+  expr_program_map exprs;  // compiled expressions, by where they start
+} cached_line;
+
+typedef std::map<long, cached_line> cached_line_map;
+
+typedef struct line_cache_struct {
+  const char *name;    // the file name, the key in line_cache_map
+  // what the file looked like when the lines were cached
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+  long last;           // offset of the last line read
+  long high;           // furthest line start read so far, -1 if none
+  cached_line_map lines;
+} line_cache;
+
+typedef std::map<std::string, line_cache> line_cache_map;
+
+// #<_hal[...]> names resolved to the pin, signal or param value in HAL
+// shared memory.  All of them are dropped when the HAL generation
+// count changes, so pins that are removed or relinked are noticed.
+typedef struct hal_ref_struct {
+  int type;            // hal_type_t of the item
+  void *data;          // its hal_data_u in HAL shared memory
+} hal_ref;
+
+typedef std::map<std::string, hal_ref> hal_ref_map;
+
 /*
 
 The current_x, current_y, and current_z are the location of the tool
@@ -716,6 +816,13 @@ typedef struct setup_struct
   context sub_context[INTERP_SUB_ROUTINE_LEVELS];
   int call_state;                  //  enum call_states - inidicate Py handler reexecution
   offset_map_type offset_map;      // store label x name, file, line
+  line_cache_map line_caches;      // lines read more than once, per file
+  line_cache *line_cache_cur;      // the one for file_pointer, or NULL
+  FILE *line_cache_fp;             // file_pointer line_cache_cur is for
+  long line_cache_next;            // where cached lines left the file, or -1
+  cached_line *line_cache_line;    // the cached line in blocktext, or NULL
+  hal_ref_map hal_refs;            // #<_hal[...]> lookups
+  unsigned int hal_refs_generation; // HAL generation hal_refs are good for
 
   bool adaptive_feed;              // adaptive feed is enabled
   bool feed_hold;                  // feed hold is enabled
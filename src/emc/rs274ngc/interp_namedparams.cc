@@ -90,6 +90,118 @@ enum predefined_named_parameters {
     NP_TASK,
 };
 
+// the interned names: 'param_names' by id, and an open addressed
+// index over them hashed without regard to case
+static std::vector<const char *> param_names;
+static std::vector<int> param_index;	// ids plus one, 0 = empty
+
+static unsigned param_hash(const char *name)
+{
+    unsigned h = 2166136261u;	// FNV-1a
+
+    while (*name)
+	h = (h ^ (unsigned char) tolower(*name++)) * 16777619u;
+    return h;
+}
+
+int param_id(const char *name)
+{
+    unsigned mask = param_index.size() - 1;
+    unsigned n;
+
+    if (param_index.size()) {
+	for (n = param_hash(name) & mask; param_index[n]; n = (n + 1) & mask) {
+	    if (!strcasecmp(param_names[param_index[n] - 1], name))
+		return param_index[n] - 1;
+	}
+    }
+    param_names.push_back(strstore(name));
+    if (param_names.size() * 2 > param_index.size()) {
+	// keep it at most half full
+	param_index.assign(param_index.size() ? param_index.size() * 2 : 256, 0);
+	mask = param_index.size() - 1;
+	for (unsigned i = 0; i < param_names.size(); i++) {
+	    for (n = param_hash(param_names[i]) & mask; param_index[n];
+		 n = (n + 1) & mask);
+	    param_index[n] = i + 1;
+	}
+    } else {
+	param_index[n] = param_names.size();
+    }
+    return param_names.size() - 1;
+}
+
+const char *param_name(int id)
+{
+    return param_names[id];
+}
+
+// where 'id' is or would go in the index of a parameter_map
+int parameter_map::slot(int id) const
+{
+    int n;
+
+    for (n = (id * 2654435761u) & mask; index[n]; n = (n + 1) & mask) {
+	if (entries[index[n] - 1].id == id)
+	    break;
+    }
+    return n;
+}
+
+void parameter_map::rehash(int size)
+{
+    index.assign(size, 0);
+    mask = size - 1;
+    for (unsigned i = 0; i < entries.size(); i++)
+	index[slot(entries[i].id)] = i + 1;
+}
+
+parameter_pointer parameter_map::find(int id)
+{
+    int n;
+
+    if (entries.empty())
+	return NULL;
+    n = index[slot(id)];
+    return n ? &entries[n - 1].value : NULL;
+}
+
+parameter_value &parameter_map::operator[](int id)
+{
+    parameter_entry entry;
+    int n;
+
+    if (!entries.empty() && (n = index[slot(id)]))
+	return entries[n - 1].value;
+    entry.id = id;
+    entry.value.value = 0.0;
+    entry.value.attr = 0;
+    entries.push_back(entry);
+    if (entries.size() * 2 > index.size())
+	rehash(index.size() ? index.size() * 2 : 16);
+    else
+	index[slot(id)] = entries.size();
+    return entries.back().value;
+}
+
+void parameter_map::erase(int id)
+{
+    int n;
+
+    if (entries.empty() || !(n = index[slot(id)]))
+	return;
+    entries.erase(entries.begin() + n - 1);
+    rehash(index.size());
+}
+
+void parameter_map::clear()
+{
+    if (entries.empty())
+	return;
+    std::fill(index.begin(), index.end(), 0);
+    entries.clear();
+}
+
 /****************************************************************************/
 
 /*! read_named_parameter
@@ -141,7 +253,6 @@ int Interp::read_named_parameter(
     char paramNameBuf[LINELEN+1];
     int exists;
     double value;
-    parameter_map_iterator pi;
 
     CHKS((line[*counter] != '<'),
 	 NCE_BUG_FUNCTION_SHOULD_NOT_HAVE_BEEN_CALLED);
@@ -227,6 +338,7 @@ int Interp::fetch_hal_param( const char *nameBuf, int *status, double *value)
     int retval;
     int type = 0;
     hal_data_u* ptr;
+    hal_ref ref;
     char hal_name[LINELEN];
 
     *status = 0;
@@ -254,8 +366,19 @@ int Interp::fetch_hal_param( const char *nameBuf, int *status, double *value)
 	    *status = 0;
 	    ERS("%s: trailing garbage after closing bracket", nameBuf);
 	}
-	// the result of these lookups could be cached in the parameter struct, but I'm not sure
-	// this is a good idea - a removed pin/signal will not be noticed
+
+	// lookups are remembered until a pin, signal or param is added,
+	// removed, renamed, linked or unlinked
+	if (_setup.hal_refs_generation != hal_data->generation) {
+	    _setup.hal_refs.clear();
+	    _setup.hal_refs_generation = hal_data->generation;
+	}
+	hal_ref_map::iterator ri = _setup.hal_refs.find(hal_name);
+	if (ri != _setup.hal_refs.end()) {
+	    type = ri->second.type;
+	    ptr = (hal_data_u *) ri->second.data;
+	    goto assign;
+	}
 
 	// I dont think that's needed - no change in pins/sigs/params
 	// rtapi_mutex_get(&(hal_data->mutex)); 
@@ -272,25 +395,30 @@ int Interp::fetch_hal_param( const char *nameBuf, int *status, double *value)
 	    } else {
 		ptr = (hal_data_u *) &(pin->dummysig);
 	    }
-	    goto assign;
+	    goto resolved;
 	}
 	if ((sig = halpr_find_sig_by_name(hal_name)) != NULL) {
 	    if (!sig->writers) 
 		logOword("%s: signal has no writer", hal_name);
 	    type = sig->type;
 	    ptr = (hal_data_u *) SHMPTR(sig->data_ptr);
-	    goto assign;
+	    goto resolved;
 	}
 	if ((param = halpr_find_param_by_name(hal_name)) != NULL) {
 	    type = param->type;
 	    ptr = (hal_data_u *) SHMPTR(param->data_ptr);
-	    goto assign;
+	    goto resolved;
 	}
 	*status = 0;
 	ERS("Named hal parameter #<%s> not found", nameBuf);
     }
     return INTERP_OK;
 
+    resolved:
+    ref.type = type;
+    ref.data = ptr;
+    _setup.hal_refs[hal_name] = ref;
+
     assign:
     switch (type) {
     case HAL_BIT: *value = (double) (ptr->b); break;
@@ -308,17 +436,27 @@ int Interp::find_named_param(
     int *status,    //!< pointer to return status 1 => found
     double *value   //!< pointer to value of found parameter
     )
+{
+  return find_named_param(nameBuf, param_id(nameBuf), status, value);
+}
+
+int Interp::find_named_param(
+    const char *nameBuf, //!< pointer to name to be read
+    int id,         //!< param_id(nameBuf)
+    int *status,    //!< pointer to return status 1 => found
+    double *value   //!< pointer to value of found parameter
+    )
 {
   context_pointer frame;
-  parameter_map_iterator pi;
+  parameter_pointer pv;
   int level;
 
   level = (nameBuf[0] == '_') ? 0 : _setup.call_level; // determine scope
   frame = &_setup.sub_context[level];
   *status = 0;
 
-  pi = frame->named_params.find(nameBuf);
-  if (pi == frame->named_params.end()) { // not found
+  pv = frame->named_params.find(id);
+  if (pv == NULL) { // not found
       int exists = 0;
       double inivalue;
       if (FEATURE(INI_VARS) && (strncasecmp(nameBuf,"_ini[",5) == 0)) {
@@ -330,7 +468,7 @@ int Interp::find_named_param(
 	      parameter_value param;  // cache the value
 	      param.value = inivalue;
 	      param.attr = PA_GLOBAL | PA_READONLY | PA_FROM_INI;
-	      _setup.sub_context[0].named_params[strstore(nameBuf)] = param;
+	      _setup.sub_context[0].named_params[id] = param;
 	      return INTERP_OK;
 	  } 
       }
@@ -346,7 +484,6 @@ int Interp::find_named_param(
       *value = 0.0;
       *status = 0;
   } else {
-      parameter_pointer pv = &pi->second;
       if (pv->attr & PA_UNSET)
 	  logNP("warning: referencing unset variable '%s'",nameBuf);
       if (pv->attr & PA_USE_LOOKUP) {
@@ -406,17 +543,15 @@ int Interp::store_named_param(setup_pointer settings,
 {
   context_pointer frame;
   int level;
-  parameter_map_iterator pi;
+  parameter_pointer pv;
 
   level = (nameBuf[0] == '_') ? 0 : _setup.call_level; // determine scope
   frame = &settings->sub_context[level];
 
-  pi = frame->named_params.find(nameBuf);
-  if (pi == frame->named_params.end()) {
+  pv = frame->named_params.find(param_id(nameBuf));
+  if (pv == NULL) {
       ERS(_("Internal error: Could not assign #<%s>"), nameBuf);
   } else {
-      parameter_pointer pv = &pi->second;
-
       CHKS(((pv->attr & PA_GLOBAL)  && level),
 	   "BUG: variable '%s' marked global, but assigned at level %d", nameBuf, level);
 
@@ -442,10 +577,11 @@ int Interp::add_named_param(
   int findStatus;
   double value;
   int level;
+  int id = param_id(nameBuf);
   parameter_value param;
 
   // look it up to see if already exists
-  CHP(find_named_param(nameBuf, &findStatus, &value));
+  CHP(find_named_param(nameBuf, id, &findStatus, &value));
 
   if (findStatus) {
       logNP("%s: parameter:|%s| already exists", name, nameBuf);
@@ -461,7 +597,7 @@ int Interp::add_named_param(
   }
   param.value = 0.0;
   param.attr = attr;
-  _setup.sub_context[level].named_params[strstore(nameBuf)] = param;
+  _setup.sub_context[level].named_params[id] = param;
   return INTERP_OK;
 }
 
@@ -741,11 +877,11 @@ int Interp::init_python_predef_parameter(const char *name)
 	find_named_param(name, &exists, &value);
 	if (exists) {
 	    fprintf(stderr, "warning: redefining named parameter %s\n",name);
-	    _setup.sub_context[0].named_params.erase(name);
+	    _setup.sub_context[0].named_params.erase(param_id(name));
 	}
 	param.value = 0.0;
 	param.attr = PA_READONLY|PA_PYTHON|PA_GLOBAL;
-	_setup.sub_context[0].named_params[strstore(name)] = param;
+	_setup.sub_context[0].named_params[param_id(name)] = param;
     }
     return INTERP_OK;
 }
@@ -205,7 +205,7 @@ int Interp::execute_call(setup_pointer settings,
 	if (settings->file_pointer == NULL) {
 	    previous_frame->position = -1;
 	} else {
-	    previous_frame->position = ftell(settings->file_pointer);
+	    previous_frame->position = tell_text();
 	}
 
 	// save return location
@@ -410,7 +410,7 @@ int Interp::execute_return(setup_pointer settings, context_pointer current_frame
 		    settings->file_pointer = fopen(previous_frame->filename, "r");
 		    strcpy(settings->filename, previous_frame->filename);
 		}
-		fseek(settings->file_pointer, previous_frame->position, SEEK_SET);
+		seek_text(previous_frame->position);
 		settings->sequence_number = previous_frame->sequence_number;
 		logOword("endsub/return: %s:%d pos=%ld", 
 			 settings->filename,previous_frame->sequence_number,
@@ -504,8 +504,7 @@ int Interp::control_back_to( block_pointer block, // pointer to block
 	    }
 	}
 	if (settings->file_pointer) { // only seek if it was open
-	    fseek(settings->file_pointer,
-		  op->offset, SEEK_SET);
+	    seek_text(op->offset);
 	}
 	settings->sequence_number = op->sequence_number;
 	return INTERP_OK;
@@ -520,6 +519,7 @@ int Interp::control_back_to( block_pointer block, // pointer to block
 	if (settings->file_pointer)
 	    fclose(settings->file_pointer);
 	settings->file_pointer = newFP;
+	settings->line_cache_next = -1;
         strncpy(settings->filename, newFileName, sizeof(settings->filename));
         if (settings->filename[sizeof(settings->filename)-1] != '\0') {
             logOword("new filename '%s' is too long (max len %zu)\n", newFileName, sizeof(settings->filename)-1);
@@ -2513,6 +2513,9 @@ N.B.: We are now using six levels (right-bracket, logical operations,
 relational operations, plus-like operations, times-like operations, and
 power).
 
+On a line from the line cache the expression is compiled the first time
+and the compiled code is run instead (see interp_expr.cc).
+
 */
 
 #define MAX_STACK 7
@@ -2525,6 +2528,13 @@ int Interp::read_real_expression(char *line,     //!< string: line of RS274/NGC
   double values[MAX_STACK];
   int operators[MAX_STACK];
   int stack_index;
+  expr_program *prog;
+
+  if ((prog = compiled_expression(line, *counter)) != NULL) {
+    CHP(execute_expression(prog, value, parameters));
+    *counter = prog->end;
+    return INTERP_OK;
+  }
 
   CHKS((line[*counter] != '['), NCE_BUG_FUNCTION_SHOULD_NOT_HAVE_BEEN_CALLED);
   *counter = (*counter + 1);
@@ -2665,6 +2675,9 @@ index given by the counter. The value may be a number, a parameter
 value, a unary function, or an expression. It calls one of four
 other readers, depending upon the first character.
 
+On a line from the line cache the value is compiled the first time and
+the compiled code is run instead (see interp_expr.cc).
+
 */
 
 int Interp::read_real_value(char *line,  //!< string: line of RS274/NGC code being processed
@@ -2673,12 +2686,20 @@ int Interp::read_real_value(char *line,  //!< string: line of RS274/NGC code bei
                            double *parameters)  //!< array of system parameters                    
 {
   char c, c1;
+  expr_program *prog;
 
   c = line[*counter];
   CHKS((c == 0), NCE_NO_CHARACTERS_FOUND_IN_READING_REAL_VALUE);
 
   c1 = line[*counter+1];
 
+  // an expression is looked up by read_real_expression
+  if ((c != '[') && (prog = compiled_expression(line, *counter)) != NULL) {
+    CHP(execute_expression(prog, double_ptr, parameters));
+    *counter = prog->end;
+    return INTERP_OK;
+  }
+
   if (c == '[')
     CHP(read_real_expression(line, counter, double_ptr, parameters));
   else if (c == '#')
@@ -3047,6 +3068,197 @@ int Interp::read_text(
 
 /****************************************************************************/
 
+/*! find_line_cache
+
+Returned Value: line_cache *
+   The line cache for the file open on _setup.file_pointer, or NULL if
+   there is none and one can not be made.
+
+Side effects:
+   _setup.line_cache_cur and _setup.line_cache_fp are set.  If the
+   file has changed since its lines were cached, they are thrown away.
+
+Called by:  read_cached_text
+
+The file is only checked with fstat when reading moves to another file
+or backwards in the same one, which is where an edited file could hand
+back stale lines; reading straight on costs nothing extra.
+
+*/
+
+line_cache *Interp::find_line_cache(long offset) //!< where the next line starts
+{
+  line_cache *lc = _setup.line_cache_cur;
+  line_cache_map::iterator it;
+  struct stat st;
+
+  // reading straight on in the same file
+  if (lc && _setup.line_cache_fp == _setup.file_pointer &&
+      offset >= lc->last && !strcmp(lc->name, _setup.filename))
+    return lc;
+
+  _setup.line_cache_cur = NULL;
+  if (fstat(fileno(_setup.file_pointer), &st) != 0)
+    return NULL;
+  it = _setup.line_caches.find(_setup.filename);
+  if (it == _setup.line_caches.end()) {
+    it = _setup.line_caches.insert(
+        line_cache_map::value_type(_setup.filename, line_cache())).first;
+    it->second.name = it->first.c_str();
+    it->second.high = -1;
+  }
+  lc = &it->second;
+  if (lc->dev != st.st_dev || lc->ino != st.st_ino ||
+      lc->size != st.st_size || lc->mtime != st.st_mtime) {
+    if (!lc->lines.empty())
+      logDebug("line cache: %s changed, dropping %d lines",
+               _setup.filename, (int) lc->lines.size());
+    lc->lines.clear();
+    _setup.line_cache_line = NULL;
+    lc->high = -1;
+    lc->dev = st.st_dev;
+    lc->ino = st.st_ino;
+    lc->size = st.st_size;
+    lc->mtime = st.st_mtime;
+  }
+  _setup.line_cache_cur = lc;
+  _setup.line_cache_fp = _setup.file_pointer;
+  return lc;
+}
+
+/****************************************************************************/
+
+/*! read_cached_text
+
+Returned Value: int
+   The same as read_text.
+
+Side effects:
+   The same as read_text.  The line may be remembered in the line
+   cache of the current file.  _setup.line_cache_line is set to the
+   cached line if there is one.
+
+Called by:  Interp::read
+
+This does what read_text does for a line of the open file starting at
+'offset', but when that line has been read before (we are going round a
+loop or calling a subroutine again) it is taken from the line cache.
+The file is not moved on past a cached line, as an fseek costs about as
+much as reading the line; _setup.line_cache_next says where it should
+be instead, and the file is only caught up when a line has to be read
+from it (see also tell_text and seek_text).  A line is only put in the
+cache the second time it is read, so straight-through programs do not
+fill memory with lines that will never be needed again.
+
+*/
+
+int Interp::read_cached_text(long offset,  //!< where the line starts in the file
+                             char *raw_line,    //!< array to write raw input line into
+                             char *line,        //!< array for input line to be processed in
+                             int *length)       //!< a pointer to an integer to be set
+{
+  line_cache *lc;
+  cached_line_map::iterator it;
+  int status;
+
+  lc = find_line_cache(offset);
+  if (lc && offset <= lc->high) {
+    it = lc->lines.find(offset);
+    if (it != lc->lines.end()) {
+      _setup.line_cache_next = it->second.next;
+      _setup.line_cache_line = &it->second;
+      _setup.sequence_number++;
+      strcpy(raw_line, it->second.raw.c_str());
+      strcpy(line, it->second.line.c_str());
+      _setup.parameter_occurrence = 0;
+      if ((line[0] == 0) || ((line[0] == '/') && (GET_BLOCK_DELETE())))
+        *length = 0;
+      else
+        *length = it->second.line.size();
+      lc->last = offset;
+      return INTERP_OK;
+    }
+  }
+
+  if (_setup.line_cache_next >= 0) {
+    fseek(_setup.file_pointer, _setup.line_cache_next, SEEK_SET);
+    _setup.line_cache_next = -1;
+  }
+  status = read_text(NULL, _setup.file_pointer, raw_line, line, length);
+  if (lc == NULL)
+    return status;
+  if (status == INTERP_OK && offset <= lc->high) {
+    cached_line &cl = lc->lines[offset];
+    cl.raw = raw_line;
+    cl.line = line;
+    cl.next = ftell(_setup.file_pointer);
+    _setup.line_cache_line = &cl;
+  }
+  if (offset > lc->high)
+    lc->high = offset;
+  lc->last = offset;
+  return status;
+}
+
+/****************************************************************************/
+
+/*! tell_text
+
+Returned Value: long
+   Where the next line of the open file starts, like ftell.
+
+Side effects: none
+
+Called by:
+   Interp::read
+   execute_call
+   convert_stop
+
+Use this rather than ftell on _setup.file_pointer, which may not have
+been moved on past lines taken from the line cache.
+
+*/
+
+long Interp::tell_text()
+{
+  if (_setup.line_cache_next >= 0)
+    return _setup.line_cache_next;
+  return ftell(_setup.file_pointer);
+}
+
+/****************************************************************************/
+
+/*! seek_text
+
+Returned Value: int
+   What fseek returns.
+
+Side effects:
+   The open file is moved to 'offset' and any position left by the
+   line cache is forgotten.
+
+Called by:
+   Interp::open
+   Interp::unwind_call
+   control_back_to
+   execute_return
+   convert_stop
+
+Use this rather than fseek on _setup.file_pointer.  It is also the
+place where the file may have been switched under the line cache, so
+the next read checks the file again.
+
+*/
+
+int Interp::seek_text(long offset)  //!< where the next line starts
+{
+  _setup.line_cache_next = -1;
+  _setup.line_cache_cur = NULL;
+  return fseek(_setup.file_pointer, offset, SEEK_SET);
+}
+
+/****************************************************************************/
+
 /*! read_unary
 
 Returned Value: int
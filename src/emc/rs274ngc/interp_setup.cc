@@ -111,6 +111,10 @@ setup_struct::setup_struct() :
     value_returned(0),
     call_level(0),
     call_state(0),
+    line_cache_cur(NULL),
+    line_cache_fp(NULL),
+    line_cache_next(-1),
+    line_cache_line(NULL),
     adaptive_feed(0),
     feed_hold(0),
     loggingLevel(0),
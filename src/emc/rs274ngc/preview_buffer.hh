@@ -0,0 +1,45 @@
+//    This is a component of AXIS, a front-end for emc
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#ifndef PREVIEW_BUFFER_HH
+#define PREVIEW_BUFFER_HH
+
+/* Records held by gcode.previewbuffer objects.  gcode.parse fills them
+   without calling back into Python, and linuxcnc.draw_lines and
+   linuxcnc.draw_dwells read them through the buffer interface, so both
+   modules must agree on these layouts. */
+
+enum preview_kind {
+    PREVIEW_TRAVERSE,		// (lineno, start, end, tlo)
+    PREVIEW_FEED,		// (lineno, start, end, feedrate, tlo)
+    PREVIEW_DWELL		// (lineno, color, x, y, z, plane)
+};
+
+struct preview_line {
+    int lineno;
+    double start[9];
+    double end[9];
+    double feedrate;		// unused for traverses
+    double tlo[3];
+};
+
+struct preview_dwell {
+    int lineno;
+    int plane;			// 0 = XY, 1 = XZ, 2 = YZ
+    double color[3];
+    double x, y, z;
+};
+
+#endif
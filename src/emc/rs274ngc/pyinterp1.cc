@@ -31,6 +31,62 @@ static  active_settings_array saved_settings_wrapper ( context &c) {
 static params_array saved_params_wrapper ( context &c) {
     return params_array(c.saved_params);
 }
+// named_params used to be exposed through map_indexing_suite; keep
+// the same dict-like interface on top of parameter_map
+static const char *entry_key(parameter_entry &e) {
+    return param_name(e.id);
+}
+
+static parameter_value entry_data(parameter_entry &e) {
+    return e.value;
+}
+
+static bool entry_less(const parameter_entry &a, const parameter_entry &b) {
+    return strcasecmp(param_name(a.id), param_name(b.id)) < 0;
+}
+
+static int parameter_map_len(parameter_map &m) {
+    return m.size();
+}
+
+static bool parameter_map_contains(parameter_map &m, const char *name) {
+    return m.find(param_id(name)) != NULL;
+}
+
+static parameter_value parameter_map_getitem(parameter_map &m, const char *name) {
+    parameter_pointer pv = m.find(param_id(name));
+    if (pv == NULL) {
+	PyErr_SetString(PyExc_KeyError, name);
+	bp::throw_error_already_set();
+    }
+    return *pv;
+}
+
+static void parameter_map_setitem(parameter_map &m, const char *name, parameter_value &v) {
+    m[param_id(name)] = v;
+}
+
+static void parameter_map_delitem(parameter_map &m, const char *name) {
+    if (m.find(param_id(name)) == NULL) {
+	PyErr_SetString(PyExc_KeyError, name);
+	bp::throw_error_already_set();
+    }
+    m.erase(param_id(name));
+}
+
+// items sorted by name, as the std::map used to have them
+static bp::object parameter_map_iter(parameter_map &m) {
+    std::vector<parameter_entry> entries;
+    bp::list result;
+
+    for (int i = 0; i < m.size(); i++)
+	entries.push_back(m.at(i));
+    std::sort(entries.begin(), entries.end(), entry_less);
+    for (unsigned i = 0; i < entries.size(); i++)
+	result.append(entries[i]);
+    return result.attr("__iter__")();
+}
+
 static bp::object remap_str( remap_struct &r) {
     return  bp::object("Remap(%s argspec=%s modal_group=%d prolog=%s ngc=%s python=%s epilog=%s) " %
 		       bp::make_tuple(r.name,r.argspec,r.modal_group,r.prolog_func,
@@ -93,7 +149,17 @@ void export_Internals()
 	.def_readwrite("value",&parameter_value_struct::value)
 	;
 
+    class_<parameter_entry>("ParameterItem",no_init)
+	.def("key",&entry_key)
+	.def("data",&entry_data)
+	;
+
     class_<parameter_map,noncopyable>("ParameterMap",no_init)
-        .def(map_indexing_suite<parameter_map>())
+	.def("__len__",&parameter_map_len)
+	.def("__contains__",&parameter_map_contains)
+	.def("__getitem__",&parameter_map_getitem)
+	.def("__setitem__",&parameter_map_setitem)
+	.def("__delitem__",&parameter_map_delitem)
+	.def("__iter__",&parameter_map_iter)
 	;
 }
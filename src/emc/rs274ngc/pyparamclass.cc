@@ -76,10 +76,12 @@ double ParamClass::setitem(bp::object sub, double dvalue)
 
 bp::list ParamClass::namelist(context &c) const {
     bp::list result;
-    for(parameter_map::iterator it = c.named_params.begin();
-	it != c.named_params.end(); ++it) {
-	result.append( it->first);
-    }
+    std::vector<const char *> names;
+    for (int i = 0; i < c.named_params.size(); i++)
+	names.push_back(param_name(c.named_params.at(i).id));
+    std::sort(names.begin(), names.end(), nocase_cmp());
+    for (unsigned i = 0; i < names.size(); i++)
+	result.append(names[i]);
     return result;
 }
 
@@ -128,6 +128,7 @@ public:
 
     // for now, public - for boost.python access
  int find_named_param(const char *nameBuf, int *status, double *value);
+ int find_named_param(const char *nameBuf, int id, int *status, double *value);
  int store_named_param(setup_pointer settings,const char *nameBuf, double value, int override_readonly = 0);
  int add_named_param(const char *nameBuf, int attr = 0);
  int fetch_ini_param( const char *nameBuf, int *status, double *value);
@@ -440,6 +441,20 @@ public:
                   double *parameters);
  int read_text(const char *command, FILE * inport, char *raw_line,
                      char *line, int *length);
+ line_cache *find_line_cache(long offset);
+ int read_cached_text(long offset, char *raw_line, char *line, int *length);
+ long tell_text();
+ int seek_text(long offset);
+ expr_program *compiled_expression(char *line, int counter);
+ int compile_real_expression(char *line, int *counter, expr_program *prog,
+                             int depth);
+ int compile_real_value(char *line, int *counter, expr_program *prog,
+                        int depth);
+ int compile_parameter(char *line, int *counter, expr_program *prog,
+                       int depth, bool check_exists);
+ int compile_unary(char *line, int *counter, expr_program *prog, int depth);
+ int execute_expression(expr_program *prog, double *value,
+                        double *parameters);
  int read_unary(char *line, int *counter, double *double_ptr,
                       double *parameters);
  int read_u(char *line, int *counter, block_pointer block,
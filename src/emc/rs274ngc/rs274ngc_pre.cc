@@ -231,6 +231,11 @@ int Interp::close()
     _setup.file_pointer = NULL;
     _setup.percent_flag = false;
   }
+  _setup.line_caches.clear();
+  _setup.line_cache_cur = NULL;
+  _setup.line_cache_fp = NULL;
+  _setup.line_cache_next = -1;
+  _setup.line_cache_line = NULL;
   reset();
 
   return INTERP_OK;
@@ -1305,12 +1310,12 @@ int Interp::open(const char *filename) //!< string: the name of the input NC-pro
       _setup.sequence_number = 1;       // We have already read the first line
       // and we are not going back to it.
     } else {
-      fseek(_setup.file_pointer, 0, SEEK_SET);
+      seek_text(0);
       _setup.percent_flag = false;
       _setup.sequence_number = 0;       // Going back to line 0
     }
   } else {
-    fseek(_setup.file_pointer, 0, SEEK_SET);
+    seek_text(0);
     _setup.percent_flag = false;
     _setup.sequence_number = 0; // Going back to line 0
   }
@@ -1495,12 +1500,18 @@ int Interp::_read(const char *command)  //!< may be NULL or a string to read
 
   if(_setup.file_pointer)
   {
-      EXECUTING_BLOCK(_setup).offset = ftell(_setup.file_pointer);
+      EXECUTING_BLOCK(_setup).offset = tell_text();
   }
 
-  read_status =
-    read_text(command, _setup.file_pointer, _setup.linetext,
-              _setup.blocktext, &_setup.line_length);
+  _setup.line_cache_line = NULL;
+  if ((command == NULL) && _setup.file_pointer)
+    read_status =
+      read_cached_text(EXECUTING_BLOCK(_setup).offset, _setup.linetext,
+                       _setup.blocktext, &_setup.line_length);
+  else
+    read_status =
+      read_text(command, _setup.file_pointer, _setup.linetext,
+                _setup.blocktext, &_setup.line_length);
 
   if (read_status == INTERP_ERROR && _setup.skipping_to_sub) {
     _setup.skipping_to_sub = NULL;
@@ -1581,7 +1592,7 @@ int Interp::unwind_call(int status, const char *file, int line, const char *func
 			 sub->filename, sub->position);
 		strcpy(_setup.filename, sub->filename);
 	    }
-	    fseek(_setup.file_pointer, sub->position, SEEK_SET);
+	    seek_text(sub->position);
 	}
 	_setup.sequence_number = sub->sequence_number;
 	logDebug("unwind_call: setting sequence number=%d from frame %d",
@@ -769,6 +769,30 @@ int emcTrajSetMaxAcceleration(double acc)
     return 0;
 }
 
+int emcTrajSetMaxJerk(double jerk)
+{
+    if (jerk < 0.0) {
+	jerk = 0.0;
+    }
+
+    emcmotCommand.command = EMCMOT_SET_JERK;
+    emcmotCommand.jerk = jerk;
+
+    return usrmotWriteEmcmotCommand(&emcmotCommand);
+}
+
+int emcTrajSetLookahead(int depth)
+{
+    if (depth < 0) {
+	depth = 0;
+    }
+
+    emcmotCommand.command = EMCMOT_SET_LOOKAHEAD;
+    emcmotCommand.axis = depth;
+
+    return usrmotWriteEmcmotCommand(&emcmotCommand);
+}
+
 int emcTrajSetHome(EmcPose home)
 {
 #ifdef ISNAN_TRAP
@@ -961,7 +985,7 @@ int emcTrajSetSpindleSync(double fpr, bool wait_for_index)
     emcmotCommand.command = EMCMOT_SET_SPINDLESYNC;
     emcmotCommand.spindlesync = fpr;
     emcmotCommand.flags = wait_for_index;
-    return usrmotWriteEmcmotCommand(&emcmotCommand);
+    return usrmotQueueEmcmotCommand(&emcmotCommand);
 }
 
 int emcTrajSetTermCond(int cond, double tolerance)
@@ -973,7 +997,7 @@ int emcTrajSetTermCond(int cond, double tolerance)
 	 EMCMOT_TERM_COND_BLEND);
     emcmotCommand.tolerance = tolerance;
 
-    return usrmotWriteEmcmotCommand(&emcmotCommand);
+    return usrmotQueueEmcmotCommand(&emcmotCommand);
 }
 
 int emcTrajLinearMove(EmcPose end, int type, double vel, double ini_maxvel, double acc,
@@ -999,7 +1023,7 @@ int emcTrajLinearMove(EmcPose end, int type, double vel, double ini_maxvel, doub
     emcmotCommand.acc = acc;
     emcmotCommand.turn = indexrotary;
 
-    return usrmotWriteEmcmotCommand(&emcmotCommand);
+    return usrmotQueueEmcmotCommand(&emcmotCommand);
 }
 
 int emcTrajCircularMove(EmcPose end, PM_CARTESIAN center,
@@ -1036,7 +1060,7 @@ int emcTrajCircularMove(EmcPose end, PM_CARTESIAN center,
     emcmotCommand.ini_maxvel = ini_maxvel;
     emcmotCommand.acc = acc;
 
-    return usrmotWriteEmcmotCommand(&emcmotCommand);
+    return usrmotQueueEmcmotCommand(&emcmotCommand);
 }
 
 int emcTrajClearProbeTrippedFlag()
@@ -1096,7 +1120,7 @@ static double last_id_time;
 
 int emcTrajUpdate(EMC_TRAJ_STAT * stat)
 {
-    int axis, enables;
+    int axis, enables, pending;
 
     stat->axes = localEmcTrajAxes;
     stat->axis_mask = localEmcTrajAxisMask;
@@ -1126,9 +1150,12 @@ int emcTrajUpdate(EMC_TRAJ_STAT * stat)
     }
 
     stat->inpos = emcmotStatus.motionFlag & EMCMOT_MOTION_INPOS_BIT;
-    stat->queue = emcmotStatus.depth;
+    /* motions still in the command ring count as queued */
+    pending = usrmotPendingEmcmotCommands();
+    stat->queue = emcmotStatus.depth + pending;
     stat->activeQueue = emcmotStatus.activeDepth;
-    stat->queueFull = emcmotStatus.queueFull;
+    stat->queueFull = emcmotStatus.queueFull ||
+	pending >= EMCMOT_COMMAND_RING_SIZE;
     stat->id = emcmotStatus.id;
     stat->motion_type = emcmotStatus.motionType;
     stat->distance_to_go = emcmotStatus.distance_to_go;
@@ -1158,7 +1185,10 @@ int emcTrajUpdate(EMC_TRAJ_STAT * stat)
     stat->acceleration = emcmotStatus.acc;
     stat->maxAcceleration = localEmcMaxAcceleration;
 
-    if (emcmotStatus.motionFlag & EMCMOT_MOTION_ERROR_BIT) {
+    /* queued moves don't wait for motion to take them, so a refused one
+       only shows up here; RCS_ERROR makes task abort the program */
+    if ((emcmotStatus.motionFlag & EMCMOT_MOTION_ERROR_BIT) ||
+	emcmotStatus.queueFailNum) {
 	stat->status = RCS_ERROR;
     } else if (stat->inpos && (stat->queue == 0)) {
 	stat->status = RCS_DONE;
@@ -30,6 +30,7 @@
 #include "timer.hh"
 #include "nml_oi.hh"
 #include "rcs_print.hh"
+#include "preview_buffer.hh"
 
 #include <cmath>
 
@@ -79,10 +80,26 @@ struct pyIniFile {
     IniFile *i;
 };
 
+// the parts of the status poll() tells apart, see stat_sections
+enum { SECTION_TASK, SECTION_TRAJ, SECTION_AXIS, SECTION_MOTION, SECTION_IO,
+    SECTION_TOOL_TABLE, NUM_SECTIONS };
+
+// attributes whose values are kept until their section changes
+enum { CACHE_ACTUAL, CACHE_AIN, CACHE_AOUT, CACHE_DIN, CACHE_DOUT,
+    CACHE_GCODES, CACHE_HOMED, CACHE_LIMIT, CACHE_MCODES, CACHE_G5X_OFFSET,
+    CACHE_G92_OFFSET, CACHE_POSITION, CACHE_DTG, CACHE_JOINT_POSITION,
+    CACHE_JOINT_ACTUAL, CACHE_PROBED, CACHE_SETTINGS, CACHE_TOOL_OFFSET,
+    CACHE_TOOL_TABLE, NUM_CACHED };
+
 struct pyStatChannel {
     PyObject_HEAD
     RCS_STAT_CHANNEL *c;
     EMC_STAT status;
+    bool polled;
+    long token;				// of the status last read in place
+    unsigned serial[NUM_SECTIONS];	// bumped when a poll changes the section
+    PyObject *cache[NUM_CACHED];
+    unsigned cache_serial[NUM_CACHED];
 };
 
 struct pyCommandChannel {
@@ -264,7 +281,9 @@ static int Stat_init(pyStatChannel *self, PyObject *a, PyObject *k) {
 }
 
 static void Stat_dealloc(PyObject *self) {
-    delete ((pyStatChannel*)self)->c;
+    pyStatChannel *s = (pyStatChannel*)self;
+    delete s->c;
+    for(int i=0; i<NUM_CACHED; i++) Py_XDECREF(s->cache[i]);
     PyObject_Del(self);
 }
 
@@ -276,18 +295,91 @@ static bool check_stat(RCS_STAT_CHANNEL *emcStatusBuffer) {
     return true;
 }
 
-static PyObject *poll(pyStatChannel *s, PyObject *o) {
-    if(!check_stat(s->c)) return NULL;
-    if(s->c->peek() == EMC_STAT_TYPE) {
-        EMC_STAT *emcStatus = static_cast<EMC_STAT*>(s->c->get_address());
-        memcpy(&s->status, emcStatus, sizeof(EMC_STAT));
+/* Each section runs from its first member to its end, leaving out the
+   message headers: the heartbeats in them change on every cycle. */
+#define SECTION(name, first, last) { name, offsetof(EMC_STAT, first), \
+    offsetof(EMC_STAT, last) + sizeof(((EMC_STAT*)0)->last) }
+static const struct {
+    const char *name;
+    size_t start, end;
+} stat_sections[NUM_SECTIONS] = {
+    SECTION("task", task.mode, task),
+    SECTION("traj", motion.traj.linearUnits, motion.traj),
+    SECTION("axis", motion.axis[0].axisType, motion.axis),
+    SECTION("motion", motion.spindle, motion),
+    SECTION("io", io.cycleTime, io),
+    SECTION("tool_table", io.tool.toolTable, io.tool.toolTable),
+};
+#undef SECTION
+
+// takes a copy of emcStatus, returning the sections that differ from the
+// last one as bits
+static int copy_sections(pyStatChannel *s, const EMC_STAT *emcStatus) {
+    int changed = 0;
+    for(int i=0; i<NUM_SECTIONS; i++) {
+        size_t start = stat_sections[i].start;
+        if(s->polled && !memcmp((const char*)emcStatus + start,
+                    (char*)&s->status + start,
+                    stat_sections[i].end - start))
+            continue;
+        changed |= 1 << i;
+    }
+    memcpy(&s->status, emcStatus, sizeof(EMC_STAT));
+    s->polled = true;
+    return changed;
+}
+
+// returns the sections that changed as bits, or -1 on error
+static int poll_sections(pyStatChannel *s) {
+    int changed = 0;
+    const NMLmsg *msg;
+    long token;
+    if(!check_stat(s->c)) return -1;
+    // Read the status where it lies in shared memory when the buffer
+    // allows it, which saves copying it out first.  If a write raced the
+    // copy, peek() below waits for the writer and puts it right; the
+    // sections the torn copy flagged are only reported changed early.
+    NMLTYPE type = s->c->peek_in_place(&msg, &token);
+    if(type == EMC_STAT_TYPE) {
+        if(s->polled && token == s->token) return 0;
+        changed = copy_sections(s, static_cast<const EMC_STAT*>(msg));
+        if(s->c->check_in_place(token)) s->token = token;
+        else type = -1;
     }
+    if(type != EMC_STAT_TYPE && s->c->peek() == EMC_STAT_TYPE)
+        changed |= copy_sections(s,
+                static_cast<EMC_STAT*>(s->c->get_address()));
+    for(int i=0; i<NUM_SECTIONS; i++)
+        if(changed & (1 << i)) s->serial[i]++;
+    return changed;
+}
+
+static PyObject *poll(pyStatChannel *s, PyObject *o) {
+    if(poll_sections(s) < 0) return NULL;
     Py_INCREF(Py_None);
     return Py_None;
 }
 
+static PyObject *poll_changed(pyStatChannel *s, PyObject *o) {
+    int changed = poll_sections(s);
+    if(changed < 0) return NULL;
+    int n = 0;
+    for(int i=0; i<NUM_SECTIONS; i++)
+        if(changed & (1 << i)) n++;
+    PyObject *res = PyTuple_New(n);
+    if(!res) return NULL;
+    for(int i=0, j=0; i<NUM_SECTIONS; i++)
+        if(changed & (1 << i))
+            PyTuple_SET_ITEM(res, j++,
+                PyString_FromString(stat_sections[i].name));
+    return res;
+}
+
 static PyMethodDef Stat_methods[] = {
     {"poll", (PyCFunction)poll, METH_NOARGS, "Update current machine state"},
+    {"poll_changed", (PyCFunction)poll_changed, METH_NOARGS,
+        "Update current machine state and return the names of the sections "
+        "that changed"},
     {NULL}
 };
 
@@ -615,30 +707,78 @@ static PyObject *Stat_tool_table(pyStatChannel *s) {
 // XXX io.tool.toolTable
 // XXX EMC_AXIS_STAT motion.axis[]
 
+/* The tuples made for these attributes are handed out again until a poll
+   changes their section.  'axis' is left out since its dicts could be
+   changed by the caller. */
+struct stat_getter {
+    PyObject *(*get)(pyStatChannel *s);
+    int section;
+};
+
+static struct stat_getter stat_getters[NUM_CACHED] = {
+    {Stat_actual, SECTION_TRAJ},
+    {Stat_ain, SECTION_MOTION},
+    {Stat_aout, SECTION_MOTION},
+    {Stat_din, SECTION_MOTION},
+    {Stat_dout, SECTION_MOTION},
+    {Stat_activegcodes, SECTION_TASK},
+    {Stat_homed, SECTION_AXIS},
+    {Stat_limit, SECTION_AXIS},
+    {Stat_activemcodes, SECTION_TASK},
+    {Stat_g5x_offset, SECTION_TASK},
+    {Stat_g92_offset, SECTION_TASK},
+    {Stat_position, SECTION_TRAJ},
+    {Stat_dtg, SECTION_TRAJ},
+    {Stat_joint_position, SECTION_AXIS},
+    {Stat_joint_actual, SECTION_AXIS},
+    {Stat_probed, SECTION_TRAJ},
+    {Stat_activesettings, SECTION_TASK},
+    {Stat_tool_offset, SECTION_TASK},
+    {Stat_tool_table, SECTION_TOOL_TABLE},
+};
+
+static PyObject *Stat_cached(pyStatChannel *s, void *closure) {
+    struct stat_getter *g = (struct stat_getter *)closure;
+    int slot = g - stat_getters;
+    unsigned serial = s->serial[g->section];
+    if(!s->cache[slot] || s->cache_serial[slot] != serial) {
+        PyObject *res = g->get(s);
+        if(!res) return NULL;
+        Py_XDECREF(s->cache[slot]);
+        s->cache[slot] = res;
+        s->cache_serial[slot] = serial;
+    }
+    Py_INCREF(s->cache[slot]);
+    return s->cache[slot];
+}
+
+#define CACHED(name, slot) \
+    {(char*)name, (getter)Stat_cached, NULL, NULL, &stat_getters[slot]}
 static PyGetSetDef Stat_getsetlist[] = {
-    {(char*)"actual_position", (getter)Stat_actual},
-    {(char*)"ain", (getter)Stat_ain},
-    {(char*)"aout", (getter)Stat_aout},
+    CACHED("actual_position", CACHE_ACTUAL),
+    CACHED("ain", CACHE_AIN),
+    CACHED("aout", CACHE_AOUT),
     {(char*)"axis", (getter)Stat_axis},
-    {(char*)"din", (getter)Stat_din},
-    {(char*)"dout", (getter)Stat_dout},
-    {(char*)"gcodes", (getter)Stat_activegcodes},
-    {(char*)"homed", (getter)Stat_homed},
-    {(char*)"limit", (getter)Stat_limit},
-    {(char*)"mcodes", (getter)Stat_activemcodes},
-    {(char*)"g5x_offset", (getter)Stat_g5x_offset},
+    CACHED("din", CACHE_DIN),
+    CACHED("dout", CACHE_DOUT),
+    CACHED("gcodes", CACHE_GCODES),
+    CACHED("homed", CACHE_HOMED),
+    CACHED("limit", CACHE_LIMIT),
+    CACHED("mcodes", CACHE_MCODES),
+    CACHED("g5x_offset", CACHE_G5X_OFFSET),
     {(char*)"g5x_index", (getter)Stat_g5x_index},
-    {(char*)"g92_offset", (getter)Stat_g92_offset},
-    {(char*)"position", (getter)Stat_position},
-    {(char*)"dtg", (getter)Stat_dtg},
-    {(char*)"joint_position", (getter)Stat_joint_position},
-    {(char*)"joint_actual_position", (getter)Stat_joint_actual},
-    {(char*)"probed_position", (getter)Stat_probed},
-    {(char*)"settings", (getter)Stat_activesettings},
-    {(char*)"tool_offset", (getter)Stat_tool_offset},
-    {(char*)"tool_table", (getter)Stat_tool_table},
+    CACHED("g92_offset", CACHE_G92_OFFSET),
+    CACHED("position", CACHE_POSITION),
+    CACHED("dtg", CACHE_DTG),
+    CACHED("joint_position", CACHE_JOINT_POSITION),
+    CACHED("joint_actual_position", CACHE_JOINT_ACTUAL),
+    CACHED("probed_position", CACHE_PROBED),
+    CACHED("settings", CACHE_SETTINGS),
+    CACHED("tool_offset", CACHE_TOOL_OFFSET),
+    CACHED("tool_table", CACHE_TOOL_TABLE),
     {NULL}
 };
+#undef CACHED
 
 static PyTypeObject Stat_Type = {
     PyObject_HEAD_INIT(NULL)
@@ -1519,7 +1659,9 @@ static PyTypeObject Error_Type = {
     0,                      /*tp_is_gc*/
 };
 
+#define GL_GLEXT_PROTOTYPES
 #include <GL/gl.h>
+#include <algorithm>
 
 static void rotate_z(double pt[3], double a) {
     double theta = a * M_PI / 180;
@@ -1589,20 +1731,29 @@ static void glvertex9(const double pt[9], const char *geometry) {
 #define max(a,b) ((a) < (b) ? (b) : (a))
 #define max3(a,b,c) (max((a),max((b),(c))))
 
+// how many pieces to draw a move in; moves of the rotary axes are curved
+static int line9_steps(const double p1[9], const double p2[9]) {
+    if(p1[3] == p2[3] && p1[4] == p2[4] && p1[5] == p2[5]) return 1;
+    double dc = max3(
+        fabs(p2[3] - p1[3]),
+        fabs(p2[4] - p1[4]),
+        fabs(p2[5] - p1[5]));
+    return (int)ceil(max(10, dc/10));
+}
+
+static void line9_point(const double p1[9], const double p2[9], int i, int st,
+        double pt[9]) {
+    double t = i * 1.0 / st;
+    double v = 1.0 - t;
+    for(int j=0; j<9; j++) { pt[j] = t * p2[j] + v * p1[j]; }
+}
+
 static void line9(const double p1[9], const double p2[9], const char *geometry) {
-    if(p1[3] != p2[3] || p1[4] != p2[4] || p1[5] != p2[5]) {
-        double dc = max3(
-            fabs(p2[3] - p1[3]),
-            fabs(p2[4] - p1[4]),
-            fabs(p2[5] - p1[5]));
-        int st = (int)ceil(max(10, dc/10));
-        int i;
-
-        for(i=1; i<=st; i++) {
-            double t = i * 1.0 / st;
-            double v = 1.0 - t;
+    int st = line9_steps(p1, p2);
+    if(st > 1) {
+        for(int i=1; i<=st; i++) {
             double pt[9];
-            for(int j=0; j<9; j++) { pt[j] = t * p2[j] + v * p1[j]; }
+            line9_point(p1, p2, i, st, pt);
             glvertex9(pt, geometry);
         }
     } else {
@@ -1611,20 +1762,12 @@ static void line9(const double p1[9], const double p2[9], const char *geometry)
 }
 
 static void line9b(const double p1[9], const double p2[9], const char *geometry) {
+    int st = line9_steps(p1, p2);
     glvertex9(p1, geometry);
-    if(p1[3] != p2[3] || p1[4] != p2[4] || p1[5] != p2[5]) {
-        double dc = max3(
-            fabs(p2[3] - p1[3]),
-            fabs(p2[4] - p1[4]),
-            fabs(p2[5] - p1[5]));
-        int st = (int)ceil(max(10, dc/10));
-        int i;
-
-        for(i=1; i<=st; i++) {
-            double t = i * 1.0 / st;
-            double v = 1.0 - t;
+    if(st > 1) {
+        for(int i=1; i<=st; i++) {
             double pt[9];
-            for(int j=0; j<9; j++) { pt[j] = t * p2[j] + v * p1[j]; }
+            line9_point(p1, p2, i, st, pt);
             glvertex9(pt, geometry);
             if(i != st)
                 glvertex9(pt, geometry);
@@ -1667,8 +1810,26 @@ static PyObject *pyvertex9(PyObject *s, PyObject *o) {
     return Py_BuildValue("(ddd)", &pt[0], &pt[1], &pt[2]);
 }
 
+static void draw_line(int n, const double p1[9], const double p2[9],
+        double pl[9], int *first, int *nl, int for_selection,
+        const char *geometry) {
+    if(*first || memcmp(p1, pl, 9 * sizeof(double))
+            || (for_selection && n != *nl)) {
+        if(!*first) glEnd();
+        if(for_selection && n != *nl) {
+            glLoadName(n);
+            *nl = n;
+        }
+        glBegin(GL_LINE_STRIP);
+        glvertex9(p1, geometry);
+        *first = 0;
+    }
+    line9(p1, p2, geometry);
+    memcpy(pl, p2, 9 * sizeof(double));
+}
+
 static PyObject *pydraw_lines(PyObject *s, PyObject *o) {
-    PyListObject *li;
+    PyObject *li;
     int for_selection = 0;
     int i;
     int first = 1;
@@ -1676,10 +1837,28 @@ static PyObject *pydraw_lines(PyObject *s, PyObject *o) {
     double p1[9], p2[9], pl[9];
     char *geometry;
 
-    if(!PyArg_ParseTuple(o, "sO!|i:draw_lines",
-			    &geometry, &PyList_Type, &li, &for_selection))
+    if(!PyArg_ParseTuple(o, "sO|i:draw_lines",
+			    &geometry, &li, &for_selection))
         return NULL;
 
+    if(!PyList_Check(li)) {
+        // records straight from gcode.parse
+        const void *buf;
+        Py_ssize_t len;
+        if(PyObject_AsReadBuffer(li, &buf, &len) < 0) return NULL;
+        if(len % sizeof(preview_line)) {
+            PyErr_SetString(PyExc_TypeError,
+                "draw_lines: expected a list or a gcode.previewbuffer");
+            return NULL;
+        }
+        const preview_line *l = (const preview_line *)buf;
+        for(i=0; i<(int)(len / sizeof(preview_line)); i++, l++)
+            draw_line(l->lineno, l->start, l->end, pl, &first, &nl,
+                for_selection, geometry);
+        if(!first) glEnd();
+        Py_RETURN_NONE;
+    }
+
     for(i=0; i<PyList_GET_SIZE(li); i++) {
         PyObject *it = PyList_GET_ITEM(li, i);
         PyObject *dummy1, *dummy2, *dummy3;
@@ -1694,19 +1873,7 @@ static PyObject *pydraw_lines(PyObject *s, PyObject *o) {
             if(!first) glEnd();
             return NULL;
         }
-        if(first || memcmp(p1, pl, sizeof(p1))
-                || (for_selection && n != nl)) {
-            if(!first) glEnd();
-            if(for_selection && n != nl) {
-                glLoadName(n);
-                nl = n;
-            }
-            glBegin(GL_LINE_STRIP);
-            glvertex9(p1, geometry);
-            first = 0;
-        }
-        line9(p1, p2, geometry);
-        memcpy(pl, p2, sizeof(p1));
+        draw_line(n, p1, p2, pl, &first, &nl, for_selection, geometry);
     }
 
     if(!first) glEnd();
@@ -1715,68 +1882,93 @@ static PyObject *pydraw_lines(PyObject *s, PyObject *o) {
     return Py_None;
 }
 
+static void draw_dwell(int n, double red, double green, double blue,
+        double x, double y, double z, int axis, double alpha,
+        int for_selection, int is_lathe) {
+    double delta = 0.015625;
+
+    if (for_selection != 1)
+        glColor4d(red, green, blue, alpha);
+    if (for_selection == 1) {
+        glLoadName(n);
+        glBegin(GL_LINES);
+    }
+    if (is_lathe == 1)
+        axis = 1;
+
+    if (axis == 0) {
+        glVertex3f(x-delta,y-delta,z);
+        glVertex3f(x+delta,y+delta,z);
+        glVertex3f(x-delta,y+delta,z);
+        glVertex3f(x+delta,y-delta,z);
+
+        glVertex3f(x+delta,y+delta,z);
+        glVertex3f(x-delta,y-delta,z);
+        glVertex3f(x+delta,y-delta,z);
+        glVertex3f(x-delta,y+delta,z);
+    } else if (axis == 1) {
+        glVertex3f(x-delta,y,z-delta);
+        glVertex3f(x+delta,y,z+delta);
+        glVertex3f(x-delta,y,z+delta);
+        glVertex3f(x+delta,y,z-delta);
+
+        glVertex3f(x+delta,y,z+delta);
+        glVertex3f(x-delta,y,z-delta);
+        glVertex3f(x+delta,y,z-delta);
+        glVertex3f(x-delta,y,z+delta);
+    } else {
+        glVertex3f(x,y-delta,z-delta);
+        glVertex3f(x,y+delta,z+delta);
+        glVertex3f(x,y+delta,z-delta);
+        glVertex3f(x,y-delta,z+delta);
+
+        glVertex3f(x,y+delta,z+delta);
+        glVertex3f(x,y-delta,z-delta);
+        glVertex3f(x,y-delta,z+delta);
+        glVertex3f(x,y+delta,z-delta);
+    }
+    if (for_selection == 1)
+        glEnd();
+}
+
 static PyObject *pydraw_dwells(PyObject *s, PyObject *o) {
-    PyListObject *li;
+    PyObject *li;
     int for_selection = 0, is_lathe = 0, i, n;
     double alpha;
     char *geometry;
-    double delta = 0.015625;
+    const void *buf = NULL;
+    Py_ssize_t len = 0;
 
-    if(!PyArg_ParseTuple(o, "sO!dii:draw_dwells", &geometry, &PyList_Type, &li, &alpha, &for_selection, &is_lathe))
+    if(!PyArg_ParseTuple(o, "sOdii:draw_dwells", &geometry, &li, &alpha, &for_selection, &is_lathe))
         return NULL;
 
+    if(!PyList_Check(li)) {
+        // records straight from gcode.parse
+        if(PyObject_AsReadBuffer(li, &buf, &len) < 0) return NULL;
+        if(len % sizeof(preview_dwell)) {
+            PyErr_SetString(PyExc_TypeError,
+                "draw_dwells: expected a list or a gcode.previewbuffer");
+            return NULL;
+        }
+    }
+
     if (for_selection == 0)
         glBegin(GL_LINES);
 
-    for(i=0; i<PyList_GET_SIZE(li); i++) {
+    if(buf) {
+        const preview_dwell *d = (const preview_dwell *)buf;
+        for(i=0; i<(int)(len / sizeof(preview_dwell)); i++, d++)
+            draw_dwell(d->lineno, d->color[0], d->color[1], d->color[2],
+                d->x, d->y, d->z, d->plane, alpha, for_selection, is_lathe);
+    } else for(i=0; i<PyList_GET_SIZE(li); i++) {
         PyObject *it = PyList_GET_ITEM(li, i);
         double red, green, blue, x, y, z;
         int axis;
         if(!PyArg_ParseTuple(it, "i(ddd)dddi", &n, &red, &green, &blue, &x, &y, &z, &axis)) {
             return NULL;
         }
-        if (for_selection != 1)
-            glColor4d(red, green, blue, alpha);
-        if (for_selection == 1) {
-            glLoadName(n);
-            glBegin(GL_LINES);
-        }
-        if (is_lathe == 1)
-            axis = 1;
-
-        if (axis == 0) {
-            glVertex3f(x-delta,y-delta,z);
-            glVertex3f(x+delta,y+delta,z);
-            glVertex3f(x-delta,y+delta,z);
-            glVertex3f(x+delta,y-delta,z);
-
-            glVertex3f(x+delta,y+delta,z);
-            glVertex3f(x-delta,y-delta,z);
-            glVertex3f(x+delta,y-delta,z);
-            glVertex3f(x-delta,y+delta,z);
-        } else if (axis == 1) {
-            glVertex3f(x-delta,y,z-delta);
-            glVertex3f(x+delta,y,z+delta);
-            glVertex3f(x-delta,y,z+delta);
-            glVertex3f(x+delta,y,z-delta);
-
-            glVertex3f(x+delta,y,z+delta);
-            glVertex3f(x-delta,y,z-delta);
-            glVertex3f(x+delta,y,z-delta);
-            glVertex3f(x-delta,y,z+delta);
-        } else {
-            glVertex3f(x,y-delta,z-delta);
-            glVertex3f(x,y+delta,z+delta);
-            glVertex3f(x,y+delta,z-delta);
-            glVertex3f(x,y-delta,z+delta);
-
-            glVertex3f(x,y+delta,z+delta);
-            glVertex3f(x,y-delta,z-delta);
-            glVertex3f(x,y-delta,z+delta);
-            glVertex3f(x,y+delta,z-delta);
-        }
-        if (for_selection == 1)
-            glEnd();
+        draw_dwell(n, red, green, blue, x, y, z, axis, alpha,
+            for_selection, is_lathe);
     }
 
     if (for_selection == 0)
@@ -1786,6 +1978,359 @@ static PyObject *pydraw_dwells(PyObject *s, PyObject *o) {
     return Py_None;
 }
 
+/* A linebuffer holds the vertices of a list of lines in the
+   'rs274.glcanon' format (or a gcode.previewbuffer of them) as GL_LINES.
+   They are worked out once and kept by GL in a buffer object, so the
+   program is drawn with one glDrawArrays however many times the view
+   changes.  The lines for one line number are found through an index
+   sorted by line number, which is how the highlighted line is drawn. */
+struct linebuffer_record {
+    int lineno;
+    int first;			// first vertex
+    float start[3], end[3];	// untransformed, for coords()
+};
+
+typedef struct {
+    PyObject_HEAD
+    char *geometry;
+    int nrec, arec;
+    struct linebuffer_record *rec;
+    int nvert, avert;
+    float *vert;
+    int *order;			// rec by line number, NULL if out of date
+    GLuint vbo;
+    int uploaded;		// vertices copied to vbo
+} pyLineBuffer;
+
+// most vertices a buffer may hold, so that counts and the size of the
+// vertex buffer in bytes still fit in an int
+#define LINEBUFFER_MAX_VERT (INT_MAX / (3 * (int)sizeof(float)))
+
+static int have_vbo = -1;
+
+// buffer objects are GL 1.5; older GL draws from the vertices in memory
+static bool use_vbo() {
+    if(have_vbo < 0) {
+        const char *version = (const char *)glGetString(GL_VERSION);
+        int major = 0, minor = 0;
+        if(!version) return false;	// no context yet
+        sscanf(version, "%d.%d", &major, &minor);
+        have_vbo = major > 1 || (major == 1 && minor >= 5);
+    }
+    return have_vbo;
+}
+
+static bool LineBuffer_reserve(pyLineBuffer *self, int nrec, int nvert) {
+    if(nrec > self->arec) {
+        int n = max(nrec, max(1024, 2 * self->arec));
+        struct linebuffer_record *rec = (struct linebuffer_record *)
+            realloc(self->rec, n * sizeof(*rec));
+        if(!rec) return false;
+        self->rec = rec;
+        self->arec = n;
+    }
+    if(nvert > self->avert) {
+        int n = max(nvert, max(2048, 2 * self->avert));
+        if(n > LINEBUFFER_MAX_VERT) n = LINEBUFFER_MAX_VERT;
+        float *vert = (float *)realloc(self->vert, n * 3 * sizeof(float));
+        if(!vert) return false;
+        self->vert = vert;
+        self->avert = n;
+    }
+    return true;
+}
+
+// sets a Python error if the line can't be added
+static bool LineBuffer_add(pyLineBuffer *self, int lineno,
+        const double p1[9], const double p2[9]) {
+    int st = line9_steps(p1, p2);
+    if(st > (LINEBUFFER_MAX_VERT - self->nvert) / 2) {
+        PyErr_SetString(PyExc_OverflowError,
+            "linebuffer: too many vertices for the vertex buffer");
+        return false;
+    }
+    if(!LineBuffer_reserve(self, self->nrec + 1, self->nvert + 2 * st)) {
+        PyErr_NoMemory();
+        return false;
+    }
+
+    struct linebuffer_record *r = &self->rec[self->nrec++];
+    r->lineno = lineno;
+    r->first = self->nvert;
+    for(int j=0; j<3; j++) { r->start[j] = p1[j]; r->end[j] = p2[j]; }
+
+    double a[3], b[3], pt[9];
+    vertex9(p1, a, self->geometry);
+    for(int i=1; i<=st; i++) {
+        if(st > 1) {
+            line9_point(p1, p2, i, st, pt);
+            vertex9(pt, b, self->geometry);
+        } else {
+            vertex9(p2, b, self->geometry);
+        }
+        float *v = self->vert + 3 * self->nvert;
+        for(int j=0; j<3; j++) { v[j] = a[j]; v[j+3] = b[j]; a[j] = b[j]; }
+        self->nvert += 2;
+    }
+    free(self->order);
+    self->order = NULL;
+    return true;
+}
+
+// n lines have to include the ones already in the buffer, and each new
+// one takes at least two vertices
+static bool LineBuffer_check(pyLineBuffer *self, Py_ssize_t n) {
+    if(n < self->nrec) {
+        PyErr_Format(PyExc_ValueError,
+            "linebuffer: %d lines already in the buffer, only %d given",
+            self->nrec, (int)n);
+        return false;
+    }
+    if(n - self->nrec > (LINEBUFFER_MAX_VERT - self->nvert) / 2) {
+        PyErr_SetString(PyExc_OverflowError,
+            "linebuffer: too many lines for the vertex buffer");
+        return false;
+    }
+    return true;
+}
+
+// add the lines in 'li' past the ones already in the buffer
+static PyObject *LineBuffer_update(pyLineBuffer *self, PyObject *o) {
+    PyObject *li;
+    if(!PyArg_ParseTuple(o, "O:linebuffer.update", &li)) return NULL;
+
+    if(!PyList_Check(li)) {
+        const void *buf;
+        Py_ssize_t len;
+        if(PyObject_AsReadBuffer(li, &buf, &len) < 0) return NULL;
+        if(len % sizeof(preview_line)) {
+            PyErr_SetString(PyExc_TypeError,
+                "linebuffer: expected a list or a gcode.previewbuffer");
+            return NULL;
+        }
+        const preview_line *l = (const preview_line *)buf;
+        Py_ssize_t n = len / sizeof(preview_line);
+        if(!LineBuffer_check(self, n)) return NULL;
+        for(int i=self->nrec; i<n; i++)
+            if(!LineBuffer_add(self, l[i].lineno, l[i].start, l[i].end))
+                return NULL;
+        Py_RETURN_NONE;
+    }
+
+    if(!LineBuffer_check(self, PyList_GET_SIZE(li))) return NULL;
+    for(int i=self->nrec; i<PyList_GET_SIZE(li); i++) {
+        PyObject *it = PyList_GET_ITEM(li, i);
+        PyObject *dummy1, *dummy2, *dummy3;
+        double p1[9], p2[9];
+        int n;
+        if(!PyArg_ParseTuple(it, "i(ddddddddd)(ddddddddd)|OOO", &n,
+                    p1+0, p1+1, p1+2,
+                    p1+3, p1+4, p1+5,
+                    p1+6, p1+7, p1+8,
+                    p2+0, p2+1, p2+2,
+                    p2+3, p2+4, p2+5,
+                    p2+6, p2+7, p2+8,
+                    &dummy1, &dummy2, &dummy3))
+            return NULL;
+        if(!LineBuffer_add(self, n, p1, p2)) return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static int LineBuffer_init(pyLineBuffer *self, PyObject *a, PyObject *k) {
+    char *geometry;
+    PyObject *li, *result;
+    if(!PyArg_ParseTuple(a, "sO:linebuffer", &geometry, &li)) return -1;
+
+    free(self->geometry);
+    self->geometry = strdup(geometry);
+    free(self->order);
+    self->order = NULL;
+    self->nrec = self->nvert = self->uploaded = 0;
+
+    result = PyObject_CallMethod((PyObject *)self, (char *)"update",
+            (char *)"(O)", li);
+    if(!result) return -1;
+    Py_DECREF(result);
+    return 0;
+}
+
+static void LineBuffer_dealloc(pyLineBuffer *self) {
+    // leaks the buffer object if the context is not current, as
+    // display lists do
+    if(self->vbo) glDeleteBuffers(1, &self->vbo);
+    free(self->geometry);
+    free(self->rec);
+    free(self->vert);
+    free(self->order);
+    PyObject_Del(self);
+}
+
+static pyLineBuffer *sorting;
+
+static bool by_lineno(int a, int b) {
+    const struct linebuffer_record *r = sorting->rec;
+    if(r[a].lineno != r[b].lineno) return r[a].lineno < r[b].lineno;
+    return a < b;
+}
+
+static bool lineno_less(int a, int lineno) {
+    return sorting->rec[a].lineno < lineno;
+}
+
+// the records for 'lineno' are order[*first] to order[*last - 1]
+static bool LineBuffer_find(pyLineBuffer *self, int lineno,
+        int *first, int *last) {
+    sorting = self;
+    if(!self->order) {
+        self->order = (int *)malloc(max(self->nrec, 1) * sizeof(int));
+        if(!self->order) return false;
+        for(int i=0; i<self->nrec; i++) self->order[i] = i;
+        std::sort(self->order, self->order + self->nrec, by_lineno);
+    }
+    int *f = std::lower_bound(self->order, self->order + self->nrec,
+            lineno, lineno_less);
+    int *l = f;
+    while(l < self->order + self->nrec && self->rec[*l].lineno == lineno) l++;
+    *first = f - self->order;
+    *last = l - self->order;
+    return true;
+}
+
+static int LineBuffer_count(pyLineBuffer *self, int i) {
+    int next = i + 1 < self->nrec ? self->rec[i+1].first : self->nvert;
+    return next - self->rec[i].first;
+}
+
+// draw all the lines, or only those for one line number
+static PyObject *LineBuffer_draw(pyLineBuffer *self, PyObject *o) {
+    PyObject *lineno_obj = Py_None;
+    int lineno = 0, first = 0, last = 0;
+    if(!PyArg_ParseTuple(o, "|O:linebuffer.draw", &lineno_obj)) return NULL;
+    if(lineno_obj != Py_None) {
+        lineno = PyInt_AsLong(lineno_obj);
+        if(lineno == -1 && PyErr_Occurred()) return NULL;
+        if(!LineBuffer_find(self, lineno, &first, &last))
+            return PyErr_NoMemory();
+        if(first == last) Py_RETURN_NONE;
+    }
+    if(!self->nvert) Py_RETURN_NONE;
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    if(use_vbo()) {
+        if(!self->vbo) glGenBuffers(1, &self->vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, self->vbo);
+        if(self->uploaded != self->nvert) {
+            glBufferData(GL_ARRAY_BUFFER, self->nvert * 3 * sizeof(float),
+                self->vert, GL_STATIC_DRAW);
+            self->uploaded = self->nvert;
+        }
+        glVertexPointer(3, GL_FLOAT, 0, 0);
+    } else {
+        glVertexPointer(3, GL_FLOAT, 0, self->vert);
+    }
+    glEnableClientState(GL_VERTEX_ARRAY);
+    if(lineno_obj == Py_None) {
+        glDrawArrays(GL_LINES, 0, self->nvert);
+    } else {
+        for(int i=first; i<last; i++) {
+            int r = self->order[i];
+            glDrawArrays(GL_LINES, self->rec[r].first,
+                LineBuffer_count(self, r));
+        }
+    }
+    if(use_vbo()) glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glPopClientAttrib();
+    Py_RETURN_NONE;
+}
+
+// the start and end points of the lines for one line number
+static PyObject *LineBuffer_coords(pyLineBuffer *self, PyObject *o) {
+    int lineno, first, last;
+    if(!PyArg_ParseTuple(o, "i:linebuffer.coords", &lineno)) return NULL;
+    if(!LineBuffer_find(self, lineno, &first, &last))
+        return PyErr_NoMemory();
+    PyObject *result = PyList_New(0);
+    if(!result) return NULL;
+    for(int i=first; i<last; i++) {
+        const struct linebuffer_record *r = &self->rec[self->order[i]];
+        PyObject *p1 = Py_BuildValue("(ddd)",
+            (double)r->start[0], (double)r->start[1], (double)r->start[2]);
+        PyObject *p2 = Py_BuildValue("(ddd)",
+            (double)r->end[0], (double)r->end[1], (double)r->end[2]);
+        if(!p1 || !p2 || PyList_Append(result, p1) < 0
+                || PyList_Append(result, p2) < 0) {
+            Py_XDECREF(p1);
+            Py_XDECREF(p2);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(p1);
+        Py_DECREF(p2);
+    }
+    return result;
+}
+
+static PyMemberDef LineBuffer_members[] = {
+    {(char*)"count", T_INT, offsetof(pyLineBuffer, nrec), READONLY},
+    {0, 0, 0, 0},
+};
+
+static PyMethodDef LineBuffer_methods[] = {
+    {"update", (PyCFunction)LineBuffer_update, METH_VARARGS,
+        "Add the lines past the ones already in the buffer"},
+    {"draw", (PyCFunction)LineBuffer_draw, METH_VARARGS,
+        "Draw all the lines, or the lines for one line number"},
+    {"coords", (PyCFunction)LineBuffer_coords, METH_VARARGS,
+        "Return the start and end points of the lines for one line number"},
+    {NULL, NULL, 0, NULL},
+};
+
+static PyTypeObject LineBufferType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                      /*ob_size*/
+    "linuxcnc.linebuffer",  /*tp_name*/
+    sizeof(pyLineBuffer),   /*tp_basicsize*/
+    0,                      /*tp_itemsize*/
+    /* methods */
+    (destructor)LineBuffer_dealloc, /*tp_dealloc*/
+    0,                      /*tp_print*/
+    0,                      /*tp_getattr*/
+    0,                      /*tp_setattr*/
+    0,                      /*tp_compare*/
+    0,                      /*tp_repr*/
+    0,                      /*tp_as_number*/
+    0,                      /*tp_as_sequence*/
+    0,                      /*tp_as_mapping*/
+    0,                      /*tp_hash*/
+    0,                      /*tp_call*/
+    0,                      /*tp_str*/
+    0,                      /*tp_getattro*/
+    0,                      /*tp_setattro*/
+    0,                      /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+    0,                      /*tp_doc*/
+    0,                      /*tp_traverse*/
+    0,                      /*tp_clear*/
+    0,                      /*tp_richcompare*/
+    0,                      /*tp_weaklistoffset*/
+    0,                      /*tp_iter*/
+    0,                      /*tp_iternext*/
+    LineBuffer_methods,     /*tp_methods*/
+    LineBuffer_members,     /*tp_members*/
+    0,                      /*tp_getset*/
+    0,                      /*tp_base*/
+    0,                      /*tp_dict*/
+    0,                      /*tp_descr_get*/
+    0,                      /*tp_descr_set*/
+    0,                      /*tp_dictoffset*/
+    (initproc)LineBuffer_init, /*tp_init*/
+    0,                      /*tp_alloc*/
+    PyType_GenericNew,      /*tp_new*/
+    0,                      /*tp_free*/
+    0,                      /*tp_is_gc*/
+};
+
 struct color {
     unsigned char r, g, b, a;
     bool operator==(const color &o) const {
@@ -1804,11 +2349,13 @@ struct logger_point {
 };
 
 #define NUMCOLORS (6)
-#define MAX_POINTS (10000)
+#define MAX_POINTS (20000)
+#define LOGGER_LEVELS (4)
 typedef struct {
     PyObject_HEAD
     int npts, mpts, lpts;
     struct logger_point *p;
+    int level[LOGGER_LEVELS];	// where each part of the plot starts
     struct color colors[NUMCOLORS];
     bool exit, clear, changed;
     char *geometry;
@@ -1837,11 +2384,69 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 static void LOCK() { pthread_mutex_lock(&mutex); }
 static void UNLOCK() { pthread_mutex_unlock(&mutex); }
 
+/* The plot is kept in LOGGER_LEVELS parts, newest last.  Part 0 holds
+   every point; when the plot fills up the older half of each part that is
+   over its share is thinned to every other point and becomes the newest
+   end of the next part.  The last part is thinned in place, so a long job
+   is still shown whole, in less detail the further back it goes.  Points
+   where the color changes are kept except in the last part, where there
+   could otherwise be nothing left to drop. */
+
+// drop every other point in [lo, hi), hi < npts; returns where the kept
+// ones end
+static int Logger_thin(pyPositionLogger *s, int lo, int hi, bool colors) {
+    int j = lo + 1, lpts = s->lpts;
+    bool drop = true;
+    for(int i=lo+1; i<hi; i++) {
+        struct logger_point &p = s->p[i];
+        bool keep = colors &&
+            (p.c != s->p[i-1].c || p.c != s->p[i+1].c);
+        if(keep || !drop) s->p[j++] = p;
+        if(!keep) drop = !drop;
+        if(i == s->lpts - 1) lpts = j;
+    }
+    int removed = hi - j;
+    memmove(s->p + j, s->p + hi, sizeof(struct logger_point) * (s->npts - hi));
+    s->npts -= removed;
+    s->lpts = s->lpts >= hi ? s->lpts - removed : lpts;
+    for(int k=0; k<LOGGER_LEVELS; k++)
+        if(s->level[k] >= hi) s->level[k] -= removed;
+    return j;
+}
+
+// make room for at least 2 more points; called with the lock held
+static void Logger_make_room(pyPositionLogger *s) {
+    int npts = s->npts;
+    for(int k=0; k<LOGGER_LEVELS; k++) {
+        int lo = s->level[k], hi = k ? s->level[k-1] : s->npts;
+        if(k && hi - lo <= MAX_POINTS / LOGGER_LEVELS) break;
+        if(k == LOGGER_LEVELS-1) Logger_thin(s, lo, hi, false);
+        else s->level[k] = Logger_thin(s, lo, lo + (hi - lo) / 2, true);
+    }
+    if(npts - s->npts >= 2) return;
+
+    // nothing could be thinned, so forget the oldest points
+    int adjust = MAX_POINTS / 10;
+    if(adjust < 2) adjust = 2;
+    s->npts -= adjust;
+    memmove(s->p, s->p + adjust, sizeof(struct logger_point) * s->npts);
+    s->lpts = s->lpts > adjust ? s->lpts - adjust : 0;
+    for(int k=0; k<LOGGER_LEVELS; k++)
+        s->level[k] = s->level[k] > adjust ? s->level[k] - adjust : 0;
+}
+
 static int Logger_init(pyPositionLogger *self, PyObject *a, PyObject *k) {
     char *geometry;
     struct color *c = self->colors;
-    self->p = (logger_point*)malloc(0);
-    self->npts = self->mpts = 0;
+    free(self->p);
+    self->p = (logger_point*)malloc(sizeof(struct logger_point) * MAX_POINTS);
+    if(!self->p) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->npts = self->lpts = 0;
+    self->mpts = MAX_POINTS;
+    memset(self->level, 0, sizeof(self->level));
     self->exit = self->clear = 0;
     self->changed = 1;
     self->st = 0;
@@ -1899,12 +2504,14 @@ static PyObject *Logger_start(pyPositionLogger *s, PyObject *o) {
     s->exit = 0;
     s->clear = 0;
     s->npts = 0;
+    memset(s->level, 0, sizeof(s->level));
 
     Py_BEGIN_ALLOW_THREADS
     while(!s->exit) {
         if(s->clear) {
             s->npts = 0;
             s->lpts = 0;
+            memset(s->level, 0, sizeof(s->level));
             s->clear = 0;
         }
         if(s->st->c->valid() && s->st->c->peek() == EMC_STAT_TYPE) {
@@ -1963,18 +2570,7 @@ static PyObject *Logger_start(pyPositionLogger *s, PyObject *o) {
                 bool changed_color = s->npts && c != op->c;
                 if(s->npts+2 > s->mpts) {
                     LOCK();
-                    if(s->mpts >= MAX_POINTS) {
-                        int adjust = MAX_POINTS / 10;
-                        if(adjust < 2) adjust = 2;
-                        s->npts -= adjust;
-                        memmove(s->p, s->p + adjust, 
-                                sizeof(struct logger_point) * s->npts);
-                    } else {
-                        s->mpts = 2 * s->mpts + 2;
-                        s->changed = 1;
-                        s->p = (struct logger_point*) realloc(s->p,
-                                    sizeof(struct logger_point) * s->mpts);
-                    }
+                    Logger_make_room(s);
                     UNLOCK();
                     op = &s->p[s->npts-1];
                     oop = &s->p[s->npts-2];
@@ -2189,6 +2785,8 @@ initlinuxcnc(void) {
 
     PyType_Ready(&PositionLoggerType);
     PyModule_AddObject(m, "positionlogger", (PyObject*)&PositionLoggerType);
+    PyType_Ready(&LineBufferType);
+    PyModule_AddObject(m, "linebuffer", (PyObject*)&LineBufferType);
     pthread_mutex_init(&mutex, NULL);
 
     PyModule_AddStringConstant(m, "PREFIX", EMC2_HOME);
@@ -969,6 +969,7 @@ class AxisCanon(GLCanon, StatMixin):
         self.aborted = True
 
     def check_abort(self):
+        GLCanon.check_abort(self)
         root_window.update()
         if self.aborted: raise KeyboardInterrupt
 
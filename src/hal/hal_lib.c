@@ -149,7 +149,32 @@ static void free_funct_entry_struct(hal_funct_entry_t * funct_entry);
 static void free_thread_struct(hal_thread_t * thread);
 #endif /* RTAPI */
 
+/** The hash_xxx() functions maintain the name index (see hal_priv.h).
+    'hash_add()' indexes the struct at offset 'ptr' under 'name', and
+    'hash_del()' takes that entry out again; 'oldname' says whether
+    'name' is the original name of an aliased pin or param.  The
+    _pin and _param versions do both names of a pin or param.
+    'hash_find()' returns the offset of the struct of type 'kind'
+    called 'name', 0 if there is none, or -1 if the index is full and
+    the caller must search the list.  Structs must already be in their
+    list when they are added, since the index may be rebuilt from the
+    lists.  All of these assume the caller has the hal_data mutex.
+*/
+static void hash_add(int kind, const char *name, int ptr, int oldname);
+static void hash_del(int kind, const char *name, int ptr, int oldname);
+static int hash_find(int kind, const char *name);
+static void hash_add_pin(hal_pin_t * pin);
+static void hash_del_pin(hal_pin_t * pin);
+static void hash_add_param(hal_param_t * param);
+static void hash_del_param(hal_param_t * param);
+
 #ifdef RTAPI
+/** 'update_timing()' adds a run of 'runtime' to the statistics in
+    'timing', clearing them first if 'maxtime' is still 0.
+*/
+static void update_timing(hal_timing_t * timing, hal_s32_t runtime,
+    hal_s32_t maxtime);
+
 /** 'thread_task()' is a function that is invoked as a realtime task.
     It implements a thread, by running down the thread's function list
     and calling each function in turn.
@@ -689,6 +714,7 @@ int hal_pin_new(const char *name, hal_type_t type, hal_pin_dir_t dir,
 	    /* reached end of list, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
+	    hash_add(HAL_HASH_PIN, new->name, SHMOFF(new), 0);
 	    rtapi_mutex_give(&(hal_data->mutex));
 	    return 0;
 	}
@@ -698,6 +724,7 @@ int hal_pin_new(const char *name, hal_type_t type, hal_pin_dir_t dir,
 	    /* found the right place for it, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
+	    hash_add(HAL_HASH_PIN, new->name, SHMOFF(new), 0);
 	    rtapi_mutex_give(&(hal_data->mutex));
 	    return 0;
 	}
@@ -792,6 +819,8 @@ int hal_pin_alias(const char *pin_name, const char *alias)
 	prev = &(pin->next_ptr);
 	next = *prev;
     }
+    /* its names are about to change, take them out of the index */
+    hash_del_pin(pin);
     if ( alias != NULL ) {
 	/* adding a new alias */
 	if ( pin->oldname == 0 ) {
@@ -820,6 +849,7 @@ int hal_pin_alias(const char *pin_name, const char *alias)
 	    /* reached end of list, insert here */
 	    pin->next_ptr = next;
 	    *prev = SHMOFF(pin);
+	    hash_add_pin(pin);
 	    rtapi_mutex_give(&(hal_data->mutex));
 	    return 0;
 	}
@@ -829,6 +859,7 @@ int hal_pin_alias(const char *pin_name, const char *alias)
 	    /* found the right place for it, insert here */
 	    pin->next_ptr = next;
 	    *prev = SHMOFF(pin);
+	    hash_add_pin(pin);
 	    rtapi_mutex_give(&(hal_data->mutex));
 	    return 0;
 	}
@@ -938,6 +969,7 @@ int hal_signal_new(const char *name, hal_type_t type)
 	    /* reached end of list, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
+	    hash_add(HAL_HASH_SIG, new->name, SHMOFF(new), 0);
 	    rtapi_mutex_give(&(hal_data->mutex));
 	    return 0;
 	}
@@ -947,6 +979,7 @@ int hal_signal_new(const char *name, hal_type_t type)
 	    /* found the right place for it, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
+	    hash_add(HAL_HASH_SIG, new->name, SHMOFF(new), 0);
 	    rtapi_mutex_give(&(hal_data->mutex));
 	    return 0;
 	}
@@ -1107,6 +1140,7 @@ int hal_link(const char *pin_name, const char *sig_name)
     }
     /* and update the pin */
     pin->signal = SHMOFF(sig);
+    hal_data->generation++;
     /* done, release the mutex and return */
     rtapi_mutex_give(&(hal_data->mutex));
     return 0;
@@ -1328,6 +1362,7 @@ int hal_param_new(const char *name, hal_type_t type, hal_param_dir_t dir, void *
 	    /* reached end of list, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
+	    hash_add(HAL_HASH_PARAM, new->name, SHMOFF(new), 0);
 	    rtapi_mutex_give(&(hal_data->mutex));
 	    return 0;
 	}
@@ -1337,6 +1372,7 @@ int hal_param_new(const char *name, hal_type_t type, hal_param_dir_t dir, void *
 	    /* found the right place for it, insert here */
 	    new->next_ptr = next;
 	    *prev = SHMOFF(new);
+	    hash_add(HAL_HASH_PARAM, new->name, SHMOFF(new), 0);
 	    rtapi_mutex_give(&(hal_data->mutex));
 	    return 0;
 	}
@@ -1529,6 +1565,8 @@ int hal_param_alias(const char *param_name, const char *alias)
 	prev = &(param->next_ptr);
 	next = *prev;
     }
+    /* its names are about to change, take them out of the index */
+    hash_del_param(param);
     if ( alias != NULL ) {
 	/* adding a new alias */
 	if ( param->oldname == 0 ) {
@@ -1557,6 +1595,7 @@ int hal_param_alias(const char *param_name, const char *alias)
 	    /* reached end of list, insert here */
 	    param->next_ptr = next;
 	    *prev = SHMOFF(param);
+	    hash_add_param(param);
 	    rtapi_mutex_give(&(hal_data->mutex));
 	    return 0;
 	}
@@ -1566,6 +1605,7 @@ int hal_param_alias(const char *param_name, const char *alias)
 	    /* found the right place for it, insert here */
 	    param->next_ptr = next;
 	    *prev = SHMOFF(param);
+	    hash_add_param(param);
 	    rtapi_mutex_give(&(hal_data->mutex));
 	    return 0;
 	}
@@ -1680,11 +1720,13 @@ int hal_export_funct(const char *name, void (*funct) (void *, long),
 	prev = &(fptr->next_ptr);
 	next = *prev;
     }
+    hash_add(HAL_HASH_FUNCT, new->name, SHMOFF(new), 0);
     /* at this point we have a new function and can yield the mutex */
     rtapi_mutex_give(&(hal_data->mutex));
     /* init time logging variables */
     new->runtime = 0;
     new->maxtime = 0;
+    memset(&(new->timing), 0, sizeof(hal_timing_t));
     /* note that failure to successfully create the following params
        does not cause the "export_funct()" call to fail - they are
        for debugging and testing use only */
@@ -1845,6 +1887,7 @@ int hal_create_thread(const char *name, unsigned long period_nsec, int uses_fp)
     /* init time logging variables */
     new->runtime = 0;
     new->maxtime = 0;
+    memset(&(new->timing), 0, sizeof(hal_timing_t));
 /*! \todo Another #if 0 */
 #if 0
 /* These params need to be re-visited when I refactor HAL.  Right
@@ -2275,7 +2318,12 @@ hal_pin_t *halpr_find_pin_by_name(const char *name)
     hal_pin_t *pin;
     hal_oldname_t *oldname;
 
-    /* search pin list for 'name' */
+    /* look it up in the index */
+    next = hash_find(HAL_HASH_PIN, name);
+    if (next >= 0) {
+	return next ? SHMPTR(next) : 0;
+    }
+    /* index is full, search pin list for 'name' */
     next = hal_data->pin_list_ptr;
     while (next != 0) {
 	pin = SHMPTR(next);
@@ -2302,7 +2350,12 @@ hal_sig_t *halpr_find_sig_by_name(const char *name)
     int next;
     hal_sig_t *sig;
 
-    /* search signal list for 'name' */
+    /* look it up in the index */
+    next = hash_find(HAL_HASH_SIG, name);
+    if (next >= 0) {
+	return next ? SHMPTR(next) : 0;
+    }
+    /* index is full, search signal list for 'name' */
     next = hal_data->sig_list_ptr;
     while (next != 0) {
 	sig = SHMPTR(next);
@@ -2323,7 +2376,12 @@ hal_param_t *halpr_find_param_by_name(const char *name)
     hal_param_t *param;
     hal_oldname_t *oldname;
 
-    /* search parameter list for 'name' */
+    /* look it up in the index */
+    next = hash_find(HAL_HASH_PARAM, name);
+    if (next >= 0) {
+	return next ? SHMPTR(next) : 0;
+    }
+    /* index is full, search parameter list for 'name' */
     next = hal_data->param_list_ptr;
     while (next != 0) {
 	param = SHMPTR(next);
@@ -2370,7 +2428,12 @@ hal_funct_t *halpr_find_funct_by_name(const char *name)
     int next;
     hal_funct_t *funct;
 
-    /* search function list for 'name' */
+    /* look it up in the index */
+    next = hash_find(HAL_HASH_FUNCT, name);
+    if (next >= 0) {
+	return next ? SHMPTR(next) : 0;
+    }
+    /* index is full, search function list for 'name' */
     next = hal_data->funct_list_ptr;
     while (next != 0) {
 	funct = SHMPTR(next);
@@ -2655,6 +2718,28 @@ void rtapi_app_exit(void)
 	"HAL_LIB: kernel lib removed successfully\n");
 }
 
+static void update_timing(hal_timing_t * timing, hal_s32_t runtime,
+    hal_s32_t maxtime)
+{
+    int n;
+    hal_u32_t t;
+
+    if (maxtime == 0) {
+	/* first run, or somebody reset tmax: start over */
+	memset(timing, 0, sizeof(hal_timing_t));
+    }
+    timing->count++;
+    timing->total += runtime;
+    /* find the bucket, floor(log2(runtime)) */
+    t = runtime > 0 ? runtime : 0;
+    n = 0;
+    while (t > 1 && n < HAL_TIMING_BUCKETS - 1) {
+	t >>= 1;
+	n++;
+    }
+    timing->hist[n]++;
+}
+
 /* this is the task function that implements threads in realtime */
 
 static void thread_task(void *arg)
@@ -2685,6 +2770,8 @@ static void thread_task(void *arg)
 		funct = SHMPTR(funct_entry->funct_ptr);
 		/* update execution time data */
 		funct->runtime = (hal_s32_t)(end_time - start_time);
+		update_timing(&(funct->timing), funct->runtime,
+		    funct->maxtime);
 		if (funct->runtime > funct->maxtime) {
 		    funct->maxtime = funct->runtime;
 		}
@@ -2695,6 +2782,8 @@ static void thread_task(void *arg)
 	    }
 	    /* update thread execution time */
 	    thread->runtime = (hal_s32_t)(end_time - thread_start_time);
+	    update_timing(&(thread->timing), thread->runtime,
+		thread->maxtime);
 	    if (thread->runtime > thread->maxtime) {
 		thread->maxtime = thread->runtime;
 	    }
@@ -2746,6 +2835,12 @@ static int init_hal_data(void)
     list_init_entry(&(hal_data->funct_entry_free));
     hal_data->thread_free_ptr = 0;
     hal_data->exact_base_period = 0;
+    hal_data->generation = 0;
+    /* empty name index */
+    hal_data->hash_used = 0;
+    hal_data->hash_deleted = 0;
+    hal_data->hash_full = 0;
+    memset(hal_data->hash, 0, sizeof(hal_data->hash));
     /* set up for shmalloc_xx() */
     hal_data->shmem_bot = sizeof(hal_data_t);
     hal_data->shmem_top = HAL_SIZE;
@@ -2814,6 +2909,236 @@ static void *shmalloc_dn(long int size)
     return retval;
 }
 
+/* the index is rebuilt once this many slots are not empty, so there
+   are always empty slots to end a search */
+#define HAL_HASH_LIMIT (HAL_HASH_SIZE - HAL_HASH_SIZE / 4)
+
+/* if the shmem could hold more names than that, a full index would be
+   rebuilt on every add; fails to compile if HAL_SIZE outgrows it */
+typedef char hal_hash_size_check[HAL_HASH_LIMIT >
+    HAL_SIZE / ((sizeof(hal_param_t) + sizeof(hal_oldname_t)) / 2) ? 1 : -1];
+
+static unsigned int hash_name(int kind, const char *name)
+{
+    unsigned int h;
+
+    /* FNV-1a, seeded with the kind so a pin and a signal with the
+       same name don't start at the same slot */
+    h = 2166136261u ^ kind;
+    while (*name != '\0') {
+	h ^= (unsigned char) *name++;
+	h *= 16777619u;
+    }
+    return h;
+}
+
+static const char *hash_entry_name(hal_hash_entry_t * entry)
+{
+    hal_pin_t *pin;
+    hal_param_t *param;
+    hal_sig_t *sig;
+    hal_funct_t *funct;
+    hal_oldname_t *oldname;
+
+    switch (entry->kind) {
+    case HAL_HASH_PIN:
+	pin = SHMPTR(entry->ptr);
+	if (entry->oldname) {
+	    oldname = SHMPTR(pin->oldname);
+	    return oldname->name;
+	}
+	return pin->name;
+    case HAL_HASH_PARAM:
+	param = SHMPTR(entry->ptr);
+	if (entry->oldname) {
+	    oldname = SHMPTR(param->oldname);
+	    return oldname->name;
+	}
+	return param->name;
+    case HAL_HASH_SIG:
+	sig = SHMPTR(entry->ptr);
+	return sig->name;
+    default:
+	funct = SHMPTR(entry->ptr);
+	return funct->name;
+    }
+}
+
+/* put an entry in the index, unless it is already there.  Returns -1
+   if the index is too full to take it. */
+static int hash_put(int kind, const char *name, int ptr, int oldname)
+{
+    unsigned int n;
+    hal_hash_entry_t *entry, *slot;
+
+    slot = 0;
+    n = hash_name(kind, name) & (HAL_HASH_SIZE - 1);
+    while (hal_data->hash[n].ptr != 0) {
+	entry = &(hal_data->hash[n]);
+	if (entry->ptr == ptr && entry->kind == kind
+	    && entry->oldname == oldname) {
+	    /* already indexed */
+	    return 0;
+	}
+	if (entry->ptr == -1 && slot == 0) {
+	    /* first deleted slot, reuse it */
+	    slot = entry;
+	}
+	n = (n + 1) & (HAL_HASH_SIZE - 1);
+    }
+    if (slot != 0) {
+	hal_data->hash_deleted--;
+    } else {
+	/* have to use up an empty slot */
+	if (hal_data->hash_used >= HAL_HASH_LIMIT) {
+	    return -1;
+	}
+	slot = &(hal_data->hash[n]);
+	hal_data->hash_used++;
+    }
+    slot->ptr = ptr;
+    slot->kind = kind;
+    slot->oldname = oldname;
+    return 0;
+}
+
+static void hash_rebuild(void)
+{
+    int next, full;
+    hal_pin_t *pin;
+    hal_sig_t *sig;
+    hal_param_t *param;
+    hal_funct_t *funct;
+    hal_oldname_t *oldname;
+
+    memset(hal_data->hash, 0, sizeof(hal_data->hash));
+    hal_data->hash_used = 0;
+    hal_data->hash_deleted = 0;
+    full = 0;
+    for (next = hal_data->pin_list_ptr; next != 0; next = pin->next_ptr) {
+	pin = SHMPTR(next);
+	full |= hash_put(HAL_HASH_PIN, pin->name, next, 0);
+	if (pin->oldname != 0) {
+	    oldname = SHMPTR(pin->oldname);
+	    full |= hash_put(HAL_HASH_PIN, oldname->name, next, 1);
+	}
+    }
+    for (next = hal_data->sig_list_ptr; next != 0; next = sig->next_ptr) {
+	sig = SHMPTR(next);
+	full |= hash_put(HAL_HASH_SIG, sig->name, next, 0);
+    }
+    for (next = hal_data->param_list_ptr; next != 0; next = param->next_ptr) {
+	param = SHMPTR(next);
+	full |= hash_put(HAL_HASH_PARAM, param->name, next, 0);
+	if (param->oldname != 0) {
+	    oldname = SHMPTR(param->oldname);
+	    full |= hash_put(HAL_HASH_PARAM, oldname->name, next, 1);
+	}
+    }
+    for (next = hal_data->funct_list_ptr; next != 0; next = funct->next_ptr) {
+	funct = SHMPTR(next);
+	full |= hash_put(HAL_HASH_FUNCT, funct->name, next, 0);
+    }
+    hal_data->hash_full = (full != 0);
+}
+
+static void hash_add(int kind, const char *name, int ptr, int oldname)
+{
+    hal_data->generation++;
+    if (hash_put(kind, name, ptr, oldname) != 0) {
+	if (hal_data->hash_deleted > 0) {
+	    /* out of empty slots, squeeze out the deleted ones (this
+	       picks up the new entry from its list) */
+	    hash_rebuild();
+	} else {
+	    /* every slot holds a live name, so a rebuild wouldn't free
+	       any; let lookups fall back to the lists */
+	    hal_data->hash_full = 1;
+	}
+    }
+}
+
+static void hash_del(int kind, const char *name, int ptr, int oldname)
+{
+    unsigned int n;
+    hal_hash_entry_t *entry;
+
+    hal_data->generation++;
+    n = hash_name(kind, name) & (HAL_HASH_SIZE - 1);
+    while (hal_data->hash[n].ptr != 0) {
+	entry = &(hal_data->hash[n]);
+	if (entry->ptr == ptr && entry->kind == kind
+	    && entry->oldname == oldname) {
+	    /* leave a marker so searches go on past this slot */
+	    entry->ptr = -1;
+	    hal_data->hash_deleted++;
+	    return;
+	}
+	n = (n + 1) & (HAL_HASH_SIZE - 1);
+    }
+}
+
+static int hash_find(int kind, const char *name)
+{
+    unsigned int n;
+    hal_hash_entry_t *entry;
+
+    n = hash_name(kind, name) & (HAL_HASH_SIZE - 1);
+    while (hal_data->hash[n].ptr != 0) {
+	entry = &(hal_data->hash[n]);
+	if (entry->ptr > 0 && entry->kind == kind
+	    && strcmp(hash_entry_name(entry), name) == 0) {
+	    return entry->ptr;
+	}
+	n = (n + 1) & (HAL_HASH_SIZE - 1);
+    }
+    return hal_data->hash_full ? -1 : 0;
+}
+
+static void hash_add_pin(hal_pin_t * pin)
+{
+    hal_oldname_t *oldname;
+
+    hash_add(HAL_HASH_PIN, pin->name, SHMOFF(pin), 0);
+    if (pin->oldname != 0) {
+	oldname = SHMPTR(pin->oldname);
+	hash_add(HAL_HASH_PIN, oldname->name, SHMOFF(pin), 1);
+    }
+}
+
+static void hash_del_pin(hal_pin_t * pin)
+{
+    hal_oldname_t *oldname;
+
+    hash_del(HAL_HASH_PIN, pin->name, SHMOFF(pin), 0);
+    if (pin->oldname != 0) {
+	oldname = SHMPTR(pin->oldname);
+	hash_del(HAL_HASH_PIN, oldname->name, SHMOFF(pin), 1);
+    }
+}
+
+static void hash_add_param(hal_param_t * param)
+{
+    hal_oldname_t *oldname;
+
+    hash_add(HAL_HASH_PARAM, param->name, SHMOFF(param), 0);
+    if (param->oldname != 0) {
+	oldname = SHMPTR(param->oldname);
+	hash_add(HAL_HASH_PARAM, oldname->name, SHMOFF(param), 1);
+    }
+}
+
+static void hash_del_param(hal_param_t * param)
+{
+    hal_oldname_t *oldname;
+
+    hash_del(HAL_HASH_PARAM, param->name, SHMOFF(param), 0);
+    if (param->oldname != 0) {
+	oldname = SHMPTR(param->oldname);
+	hash_del(HAL_HASH_PARAM, oldname->name, SHMOFF(param), 1);
+    }
+}
+
 hal_comp_t *halpr_alloc_comp_struct(void)
 {
     hal_comp_t *p;
@@ -3135,12 +3460,14 @@ static void unlink_pin(hal_pin_t * pin)
 	}
 	/* mark pin as unlinked */
 	pin->signal = 0;
+	hal_data->generation++;
     }
 }
 
 static void free_pin_struct(hal_pin_t * pin)
 {
 
+    hash_del_pin(pin);
     unlink_pin(pin);
     /* clear contents of struct */
     if ( pin->oldname != 0 ) free_oldname_struct(SHMPTR(pin->oldname));
@@ -3160,6 +3487,7 @@ static void free_sig_struct(hal_sig_t * sig)
 {
     hal_pin_t *pin;
 
+    hash_del(HAL_HASH_SIG, sig->name, SHMOFF(sig), 0);
     /* look for pins linked to this signal */
     pin = halpr_find_pin_by_sig(sig, 0);
     while (pin != 0) {
@@ -3182,6 +3510,7 @@ static void free_sig_struct(hal_sig_t * sig)
 
 static void free_param_struct(hal_param_t * p)
 {
+    hash_del_param(p);
     /* clear contents of struct */
     if ( p->oldname != 0 ) free_oldname_struct(SHMPTR(p->oldname));
     p->data_ptr = 0;
@@ -3212,6 +3541,7 @@ static void free_funct_struct(hal_funct_t * funct)
 
 /*  int next_thread, next_entry;*/
 
+    hash_del(HAL_HASH_FUNCT, funct->name, SHMOFF(funct), 0);
     if (funct->users > 0) {
 	/* We can't casually delete the function, there are thread(s) which
 	   will call it.  So we must check all the threads and remove any
@@ -151,6 +151,36 @@ typedef struct {
     char name[HAL_NAME_LEN + 1];	/* the original name */
 } hal_oldname_t;
 
+/** HAL name index.
+    An open addressed hash table in the HAL shared memory block that
+    maps the names of pins, signals, parameters and functions (and the
+    original names of aliased pins and parameters) to their structs,
+    so the find-by-name functions don't have to walk the lists.  The
+    sorted lists are still the master copy: the index is rebuilt from
+    them when deleted slots pile up, and if it ever fills, 'hash_full'
+    is set and lookups that miss fall back to walking the lists.
+    It is sized so that live names can't fill it.  The smallest
+    share of shmem a name can have is 58 bytes, when a parameter and
+    the oldname struct of its alias hold two names between them, so
+    HAL_SIZE has room for fewer names than the 3/4 of the slots the
+    index fills before it is rebuilt.  hal_lib.c checks this when it
+    is compiled; make the index bigger along with HAL_SIZE.
+*/
+#define HAL_HASH_SIZE 8192	/* number of slots, must be a power of 2 */
+
+#define HAL_HASH_PIN	1
+#define HAL_HASH_SIG	2
+#define HAL_HASH_PARAM	3
+#define HAL_HASH_FUNCT	4
+
+typedef struct {
+    int ptr;			/* struct with this name, 0 = empty slot,
+				   -1 = deleted slot */
+    unsigned short kind;	/* HAL_HASH_PIN, HAL_HASH_SIG, etc */
+    unsigned short oldname;	/* set if this is the original name of
+				   an aliased pin or parameter */
+} hal_hash_entry_t;
+
 /* Master HAL data structure
    There is a single instance of this structure in the machine.
    It resides at the base of the HAL shared memory block, where it
@@ -190,6 +220,14 @@ typedef struct {
     int exact_base_period;      /* if set, pretend that rtapi satisfied our
 				   period request exactly */
     unsigned char lock;         /* hal locking, can be one of the HAL_LOCK_* types */
+    int hash_used;		/* name index slots not empty */
+    int hash_deleted;		/* name index slots marked deleted */
+    int hash_full;		/* name index couldn't hold every name */
+    unsigned int generation;	/* bumped when a pin, signal or param is
+				   added, removed, renamed, linked or
+				   unlinked, so users that cache lookups
+				   can tell their results are stale */
+    hal_hash_entry_t hash[HAL_HASH_SIZE];	/* name index */
 } hal_data_t;
 
 /** HAL 'component' data structure.
@@ -267,6 +305,20 @@ typedef struct {
     that identify the functions connected to that thread.
 */
 
+/** Run time statistics for a function or thread, in the same units as
+    'runtime'.  hist[n] counts the runs that took from 2^n up to
+    2^(n+1)-1 (hist[0] also gets runs of 0).  They are all cleared
+    when 'maxtime' is set back to 0, which is what 'setp xxx.tmax 0'
+    does.
+*/
+#define HAL_TIMING_BUCKETS 32
+
+typedef struct {
+    long long count;		/* number of runs */
+    long long total;		/* sum of run times, for the mean */
+    hal_u32_t hist[HAL_TIMING_BUCKETS];	/* log2 histogram of run times */
+} hal_timing_t;
+
 typedef struct {
     int next_ptr;		/* next function in linked list */
     int uses_fp;		/* floating point flag */
@@ -277,6 +329,7 @@ typedef struct {
     void (*funct) (void *, long);	/* ptr to function code */
     hal_s32_t runtime;		/* duration of last run, in nsec */
     hal_s32_t maxtime;		/* duration of longest run, in nsec */
+    hal_timing_t timing;	/* run time statistics */
     char name[HAL_NAME_LEN + 1];	/* function name */
 } hal_funct_t;
 
@@ -297,6 +350,7 @@ typedef struct {
     int task_id;		/* ID of the task that runs this thread */
     hal_s32_t runtime;		/* duration of last run, in nsec */
     hal_s32_t maxtime;		/* duration of longest run, in nsec */
+    hal_timing_t timing;	/* run time statistics */
     hal_list_t funct_list;	/* list of functions to run */
     char name[HAL_NAME_LEN + 1];	/* thread name */
 } hal_thread_t;
@@ -324,8 +378,8 @@ typedef struct {
 */
 
 #define HAL_KEY   0x48414C32	/* key used to open HAL shared memory */
-#define HAL_VER   0x0000000C	/* version code */
-#define HAL_SIZE  262000
+#define HAL_VER   0x00000010	/* version code */
+#define HAL_SIZE  327536	/* 262000 plus the name index */
 
 /* These pointers are set by hal_init() to point to the shmem block
    and to the master data structure. All access should use these
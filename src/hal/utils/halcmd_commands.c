@@ -67,6 +67,7 @@ static void print_script_sig_info(int type, char **patterns);
 static void print_param_info(int type, char **patterns);
 static void print_funct_info(char **patterns);
 static void print_thread_info(char **patterns);
+static void print_timing_info(char **patterns);
 static void print_comp_names(char **patterns);
 static void print_pin_names(char **patterns);
 static void print_sig_names(char **patterns);
@@ -987,6 +988,8 @@ int do_show_cmd(char *type, char **patterns)
 	print_funct_info(patterns);
     } else if (strcmp(type, "thread") == 0) {
 	print_thread_info(patterns);
+    } else if (strcmp(type, "timing") == 0) {
+	print_timing_info(patterns);
     } else if (strcmp(type, "alias") == 0) {
 	print_pin_aliases(patterns);
 	print_param_aliases(patterns);
@@ -1905,6 +1908,83 @@ static void print_thread_info(char **patterns)
     halcmd_output("\n");
 }
 
+/* returns the run time that 'frac' of the runs recorded in 'timing'
+   did not exceed, to the resolution of the histogram: the top of the
+   bucket holding that run, but never more than the max seen */
+static long timing_percentile(hal_timing_t * timing, long maxtime,
+    double frac)
+{
+    long long want, seen;
+    long upper;
+    int n;
+
+    want = (long long) (timing->count * frac + 0.999999);
+    seen = 0;
+    for (n = 0; n < HAL_TIMING_BUCKETS; n++) {
+	seen += timing->hist[n];
+	if (seen >= want) {
+	    break;
+	}
+    }
+    if (n >= HAL_TIMING_BUCKETS - 1) {
+	return maxtime;
+    }
+    upper = (2L << n) - 1;
+    return (upper < maxtime) ? upper : maxtime;
+}
+
+static void print_timing_line(const char *name, hal_timing_t * timing,
+    long maxtime)
+{
+    hal_timing_t t;
+    long mean;
+
+    /* the realtime side updates this without the mutex, so work from
+       a copy; a run may be off by one, which is close enough */
+    t = *timing;
+    mean = t.count ? (long) (t.total / t.count) : 0;
+    halcmd_output(((scriptmode == 0) ?
+	    "%10lld  %9ld  %9ld  %9ld  %9ld  %s\n" :
+	    "%lld %ld %ld %ld %ld %s\n"),
+	t.count, mean, timing_percentile(&t, maxtime, 0.99),
+	timing_percentile(&t, maxtime, 0.999), maxtime, name);
+}
+
+static void print_timing_info(char **patterns)
+{
+    int next_thread;
+    hal_thread_t *tptr;
+    hal_list_t *list_root, *list_entry;
+    hal_funct_entry_t *fentry;
+    hal_funct_t *funct;
+
+    if (scriptmode == 0) {
+	halcmd_output("Realtime Timing (CPU clocks):\n");
+	halcmd_output("     Count       Mean        p99      p99.9        Max  Name\n");
+    }
+    rtapi_mutex_get(&(hal_data->mutex));
+    next_thread = hal_data->thread_list_ptr;
+    while (next_thread != 0) {
+	tptr = SHMPTR(next_thread);
+	if ( match(patterns, tptr->name) ) {
+	    print_timing_line(tptr->name, &(tptr->timing),
+		(long)tptr->maxtime);
+	    list_root = &(tptr->funct_list);
+	    list_entry = list_next(list_root);
+	    while (list_entry != list_root) {
+		fentry = (hal_funct_entry_t *) list_entry;
+		funct = SHMPTR(fentry->funct_ptr);
+		print_timing_line(funct->name, &(funct->timing),
+		    (long)funct->maxtime);
+		list_entry = list_next(list_entry);
+	    }
+	}
+	next_thread = tptr->next_ptr;
+    }
+    rtapi_mutex_give(&(hal_data->mutex));
+    halcmd_output("\n");
+}
+
 static void print_comp_names(char **patterns)
 {
     int next;
@@ -2099,6 +2179,10 @@ static void print_mem_status()
     active = count_list(hal_data->thread_list_ptr);
     recycled = count_list(hal_data->thread_free_ptr);
     halcmd_output("  active/recycled threads:    %d/%d\n", active, recycled);
+    // name index
+    halcmd_output("  used/deleted index slots:   %d/%d%s\n", hal_data->hash_used,
+	hal_data->hash_deleted, hal_data->hash_full ? " (full)" : "");
+    halcmd_output("  generation:                 %u\n", hal_data->generation);
 }
 
 /* Switch function for pin/sig/param type for the print_*_list functions */
@@ -2751,10 +2835,13 @@ int do_help_cmd(char *command)
 	printf("show [type] [pattern]\n");
 	printf("  Prints info about HAL items of the specified type.\n");
 	printf("  'type' is 'comp', 'pin', 'sig', 'param', 'funct',\n");
-	printf("  'thread', or 'all'.  If 'type' is omitted, it assumes\n");
-	printf("  'all' with no pattern.  If 'pattern' is specified\n");
+	printf("  'thread', 'timing', or 'all'.  If 'type' is omitted, it\n");
+	printf("  assumes 'all' with no pattern.  If 'pattern' is specified\n");
 	printf("  it prints only those items whose names match the\n");
 	printf("  pattern, which may be a 'shell glob'.\n");
+	printf("  'timing' prints run time statistics for the threads\n");
+	printf("  matching 'pattern' and each function in them; setting\n");
+	printf("  a thread's or function's 'tmax' to 0 clears them.\n");
     } else if (strcmp(command, "list") == 0) {
 	printf("list type [pattern]\n");
 	printf("  Prints the names of HAL items of the specified type.\n");
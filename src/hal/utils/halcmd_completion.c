@@ -66,6 +66,7 @@ static const char *alias_table[] = {
 
 static const char *show_table[] = {
     "all", "alias", "comp", "pin", "sig", "param", "funct", "thread",
+    "timing",
     NULL,
 };
 
@@ -683,7 +684,7 @@ char **halcmd_completer(const char *text, int start, int end, hal_completer_func
                 result = func(text, parameter_generator);
             } else if (startswith(n, "funct")) {
                 result = func(text, funct_generator);
-            } else if (startswith(n, "thread")) {
+            } else if (startswith(n, "thread") || startswith(n, "timing")) {
                 result = func(text, thread_generator);
             }
         }
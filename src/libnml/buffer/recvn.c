@@ -3,7 +3,7 @@
 *   Provides a C file for the recvn function from the book Advanced
 *   Programming in the UNIX Environment by Richard Stevens.
 *   The recvn function is called repeatedly until n bytes have been
-*   received from the file descriptor. It uses select and FIONREAD
+*   received from the file descriptor. It uses poll and FIONREAD
 *   checks ahead of time to guarantee that even if the socket is
 *   blocking the timeout will be enforced. To retry a socket to for
 *   the data missed during past timeouts the application should pass
@@ -24,10 +24,10 @@
 #include "recvn.h"		/* recvn(int, void *, int, double) */
 #include <stddef.h>		/* size_t */
 #include <errno.h>		/* errno */
-#include <sys/types.h>		/* typedef fd_set, FD_ZERO, FD_SET */
+#include <sys/types.h>
+#include <poll.h>		/* poll() */
 #include <sys/ioctl.h>		/* FIONREAD */
 #include <sys/socket.h>		/* recv() */
-#include <sys/time.h>		/* struct timeval */
 #include <stdlib.h>		/* malloc(), free() */
 #include <string.h>		/* strerror() */
 #include <math.h>		/* modf() */
@@ -44,8 +44,7 @@ int recvn(int fd, void *vptr, int n, int flags, double _timeout,
     int nleft, nrecv;
     char *ptr;
     double start_time;
-    struct timeval timeout_tv;
-    fd_set recv_fd_set;
+    struct pollfd recv_pollfd;
     int bytes_ready;
     int bytes_to_read;
     if (etime_disabled) {
@@ -53,13 +52,8 @@ int recvn(int fd, void *vptr, int n, int flags, double _timeout,
     }
 
     bytes_ready = 0;
-    timeout_tv.tv_sec = (long) _timeout;
-    timeout_tv.tv_usec = (long) (_timeout * 1000000.0);
-    if (timeout_tv.tv_usec >= 1000000) {
-	timeout_tv.tv_usec = timeout_tv.tv_usec % 1000000;
-    }
-    FD_ZERO(&recv_fd_set);
-    FD_SET(fd, &recv_fd_set);
+    recv_pollfd.fd = fd;
+    recv_pollfd.events = POLLIN;
 
     recvn_timedout = 0;
     ptr = (char *) vptr;
@@ -105,15 +99,9 @@ int recvn(int fd, void *vptr, int n, int flags, double _timeout,
 		}
 		return -1;
 	    }
-	    timeout_tv.tv_sec = (long) timeleft;
-	    timeout_tv.tv_usec = (long) (timeleft * 1000000.0);
-	    if (timeout_tv.tv_usec >= 1000000) {
-		timeout_tv.tv_usec = timeout_tv.tv_usec % 1000000;
-	    }
-	    switch (select(fd + 1, &recv_fd_set, (fd_set *) NULL,
-		    (fd_set *) NULL, &timeout_tv)) {
+	    switch (poll(&recv_pollfd, 1, (int) (timeleft * 1000.0) + 1)) {
 	    case -1:
-		rcs_print_error("Error in select: %d -> %s\n", errno,
+		rcs_print_error("Error in poll: %d -> %s\n", errno,
 		    strerror(errno));
 		if (NULL == bytes_read_ptr) {
 		    rcs_print_error
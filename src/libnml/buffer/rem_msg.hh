@@ -104,6 +104,12 @@ struct REMOTE_READ_REQUEST:public REMOTE_CMS_REQUEST {
     /* to this client */
 };
 
+/* Set in the size sent with a read reply from a buffer with the delta
+   option when the data is only the parts that changed since the previous
+   reply from that buffer: the write_id of that reply, the full size, and
+   then (offset, length, bytes) for each changed range. */
+#define REMOTE_CMS_DELTA_REPLY 0x80000000
+
 /* Structure returned by server to client after a read. */
 struct REMOTE_READ_REPLY:public REMOTE_CMS_REPLY {
     int size;			/* size of message stored in data. */
@@ -194,7 +200,9 @@ struct REMOTE_LOGIN_REPLY:public REMOTE_CMS_REPLY {
 enum CMS_REMOTE_SUBSCRIPTION_REQUEST_TYPE {
     CMS_POLLED_SUBSCRIPTION = 1,
     CMS_NO_SUBSCRIPTION,
-    CMS_VARIABLE_SUBSCRIPTION
+    CMS_VARIABLE_SUBSCRIPTION,
+    CMS_CHANGE_SUBSCRIPTION	/* push each new message, poll_interval_millis
+				   apart at the least */
 };
 
 struct REMOTE_SET_SUBSCRIPTION_REQUEST:public REMOTE_CMS_REQUEST {
@@ -22,7 +22,7 @@
 #include <math.h>		/* fabs() */
 #include <sys/socket.h>		/* send(), recv(), socket(), accept(),
 				   bind(), listen() */
-#include <sys/time.h>		/* struct timeval */
+#include <poll.h>		/* poll() */
 #include "sendn.h"		/* sendn() */
 #include "rcs_print.hh"		/* rcs_print_error() */
 #include "_timer.h"		/* etime(), esleep() */
@@ -35,19 +35,13 @@ int sendn(int fd, const void *vptr, int n, int _flags, double _timeout)
 {
     int nleft;
     long nwritten;
-    int select_ret;
+    int poll_ret;
     double start_time;
     char *ptr;
-    struct timeval timeout_tv;
-    fd_set send_fd_set;
+    struct pollfd send_pollfd;
 
-    timeout_tv.tv_sec = (long) _timeout;
-    timeout_tv.tv_usec = (long) (_timeout * 1000000.0);
-    if (timeout_tv.tv_usec >= 1000000) {
-	timeout_tv.tv_usec = timeout_tv.tv_usec % 1000000;
-    }
-    FD_ZERO(&send_fd_set);
-    FD_SET(fd, &send_fd_set);
+    send_pollfd.fd = fd;
+    send_pollfd.events = POLLOUT;
 
     ptr = (char *) vptr;	/* can't do pointer arithmetic on void* */
     nleft = n;
@@ -66,22 +60,13 @@ int sendn(int fd, const void *vptr, int n, int _flags, double _timeout)
 		    sendn_timedout = 1;
 		    return -1;
 		}
-		timeout_tv.tv_sec = (long) timeleft;
-		timeout_tv.tv_usec = (long) (timeleft * 1000000.0);
-		if (timeout_tv.tv_usec >= 1000000) {
-		    timeout_tv.tv_usec = timeout_tv.tv_usec % 1000000;
-		}
-		select_ret =
-		    select(fd + 1, (fd_set *) NULL, &send_fd_set,
-		    (fd_set *) NULL, &timeout_tv);
+		poll_ret = poll(&send_pollfd, 1, (int) (timeleft * 1000.0) + 1);
 	    } else {
-		select_ret =
-		    select(fd + 1, (fd_set *) NULL, &send_fd_set,
-		    (fd_set *) NULL, NULL);
+		poll_ret = poll(&send_pollfd, 1, -1);
 	    }
-	    switch (select_ret) {
+	    switch (poll_ret) {
 	    case -1:
-		rcs_print_error("Error in select: %d -> %s\n", errno,
+		rcs_print_error("Error in poll: %d -> %s\n", errno,
 		    strerror(errno));
 		rcs_print_error
 		    ("sendn(fd=%d, vptr=%p, int n=%d, int _flags=%d, double _timeout=%f) failed.\n",
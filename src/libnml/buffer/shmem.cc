@@ -616,3 +616,54 @@ CMS_STATUS SHMEM::main_access(void *_local)
     second_read = 0;
     return (status);
 }
+
+/* Find the message in the shared memory segment itself rather than
+   copying it out.  No mutex is taken: the writer brackets each message
+   with was_read (see CMS::write_was_read()), and the token handed back
+   lets the caller ask check_in_place() whether what it looked at was
+   overwritten meanwhile.  Returns CMS_READ_OLD while a write is under
+   way; call peek() to wait for it instead. */
+CMS_STATUS SHMEM::peek_in_place(const void **_data, long *_token)
+{
+    volatile CMS_HEADER *hdr;
+
+    if (shm == NULL || (hdr = in_place_header(shm->addr)) == NULL) {
+	return CMS::peek_in_place(_data, _token);
+    }
+    if (!read_permission_flag) {
+	rcs_print_error("CMS: %s was not configured to read %s\n",
+	    ProcessName, BufferName);
+	return (status = CMS_PERMISSIONS_ERROR);
+    }
+
+    *_token = hdr->write_id;
+    __sync_synchronize();
+    if (hdr->was_read == CMS_HEADER_WRITING) {
+	return (status = CMS_READ_OLD);
+    }
+    if (hdr->in_buffer_size > max_message_size) {
+	rcs_print_error
+	    ("CMS:(%s) Message size of %ld exceeds maximum of %ld\n",
+	    BufferName, hdr->in_buffer_size, max_message_size);
+	return (status = CMS_INTERNAL_ACCESS_ERROR);
+    }
+    *_data = (const void *) (hdr + 1);
+    return (status = CMS_READ_OK);
+}
+
+/* Nonzero if nothing has been written since peek_in_place() gave out
+   _token. */
+int SHMEM::check_in_place(long _token)
+{
+    volatile CMS_HEADER *hdr;
+
+    if (shm == NULL || (hdr = in_place_header(shm->addr)) == NULL) {
+	return CMS::check_in_place(_token);
+    }
+    __sync_synchronize();
+    if (hdr->was_read == CMS_HEADER_WRITING) {
+	return 0;
+    }
+    __sync_synchronize();
+    return (hdr->write_id == _token);
+}
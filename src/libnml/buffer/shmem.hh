@@ -42,6 +42,8 @@ class SHMEM:public CMS {
     virtual ~ SHMEM();
 
     CMS_STATUS main_access(void *_local);
+    CMS_STATUS peek_in_place(const void **_data, long *_token);
+    int check_in_place(long _token);
 
   private:
 
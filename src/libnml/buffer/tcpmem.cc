@@ -23,6 +23,7 @@ extern "C" {
 #include <ctype.h>		// isdigit()
 #include <arpa/inet.h>		/* inet_ntoa */
 #include <sys/socket.h>
+#include <sys/ioctl.h>		/* ioctl(), FIONREAD */
 #include <sys/time.h>           /* struct timeval */
 #include <netdb.h>
 #include <math.h>		/* fmod() */
@@ -62,6 +63,10 @@ TCPMEM::TCPMEM(const char *_bufline, const char *_procline):CMS(_bufline, _procl
     old_handler = (void (*)(int)) SIG_ERR;
     sigpipe_count = 0;
     subscription_count = 0;
+    reply_is_delta = 0;
+    delta_base = NULL;
+    delta_base_length = 0;
+    delta_base_id = 0;
     read_serial_number = 0;
     write_serial_number = 0;
     read_socket_fd = 0;
@@ -85,6 +90,14 @@ TCPMEM::TCPMEM(const char *_bufline, const char *_procline):CMS(_bufline, _procl
 	    subscription_type = CMS_NO_SUBSCRIPTION;
 	} else if (!strncmp(sub_info_string + 4, "var", 3)) {
 	    subscription_type = CMS_VARIABLE_SUBSCRIPTION;
+	} else if (!strncmp(sub_info_string + 4, "change", 6)) {
+	    /* Optional minimum interval, e.g. sub=change:0.005 */
+	    poll_interval_millis = 0;
+	    if (sub_info_string[10] == ':') {
+		poll_interval_millis =
+		    ((int) (atof(sub_info_string + 11) * 1000.0));
+	    }
+	    subscription_type = CMS_CHANGE_SUBSCRIPTION;
 	} else {
 	    poll_interval_millis =
 		((int) (atof(sub_info_string + 4) * 1000.0));
@@ -192,7 +205,7 @@ void
     rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 	"TCPMEM sending request: fd = %d, serial_number=%ld, request_type=%d, buffer_number=%ld\n",
 	socket_fd, serial_number,
-	ntohl(*((u_long *) diag_info_buf + 1)), buffer_number);
+	getbe32(diag_info_buf + 4), buffer_number);
     reenable_sigpipe();
 
 }
@@ -220,7 +233,7 @@ void TCPMEM::verify_bufname()
     rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 	"TCPMEM sending request: fd = %d, serial_number=%ld, request_type=%d, buffer_number=%ld\n",
 	socket_fd, serial_number,
-	ntohl(*((u_long *) temp_buffer + 1)), buffer_number);
+	getbe32(temp_buffer + 4), buffer_number);
     if (recvn(socket_fd, temp_buffer, 40, 0, timeout, &recvd_bytes) < 0) {
 	if (recvn_timedout) {
 	    bytes_to_throw_away = 40;
@@ -241,7 +254,7 @@ void TCPMEM::verify_bufname()
 	status = CMS_MISC_ERROR;
 	return;
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
     if (status < 0) {
 	return;
     }
@@ -288,7 +301,7 @@ CMS_DIAGNOSTICS_INFO *TCPMEM::get_diagnostics_info()
     rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 	"TCPMEM sending request: fd = %d, serial_number=%ld, request_type=%d, buffer_number=%ld\n",
 	socket_fd, serial_number,
-	ntohl(*((u_long *) temp_buffer + 1)), buffer_number);
+	getbe32(temp_buffer + 4), buffer_number);
     if (recvn(socket_fd, temp_buffer, 32, 0, -1.0, &recvd_bytes) < 0) {
 	if (recvn_timedout) {
 	    bytes_to_throw_away = 32;
@@ -310,7 +323,7 @@ CMS_DIAGNOSTICS_INFO *TCPMEM::get_diagnostics_info()
 	status = CMS_MISC_ERROR;
 	return (NULL);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
     if (status < 0) {
 	return (NULL);
     }
@@ -322,14 +335,14 @@ CMS_DIAGNOSTICS_INFO *TCPMEM::get_diagnostics_info()
     }
     di->last_writer_dpi = NULL;
     di->last_reader_dpi = NULL;
-    di->last_writer = ntohl(*((u_long *) temp_buffer + 2));
-    di->last_reader = ntohl(*((u_long *) temp_buffer + 3));
+    di->last_writer = getbe32(temp_buffer + 8);
+    di->last_reader = getbe32(temp_buffer + 12);
     double server_time;
     memcpy(&server_time, temp_buffer + 16, 8);
     double local_time = etime();
     double diff_time = local_time - server_time;
-    int dpi_count = ntohl(*((u_long *) temp_buffer + 6));
-    int dpi_max_size = ntohl(*((u_long *) temp_buffer + 7));
+    int dpi_count = getbe32(temp_buffer + 24);
+    int dpi_max_size = getbe32(temp_buffer + 28);
     if (dpi_max_size > 32 && dpi_max_size < 0x2000) {
 	if (recvn
 	    (socket_fd, temp_buffer + 32, dpi_max_size - 32, 0, -1.0,
@@ -349,27 +362,27 @@ CMS_DIAGNOSTICS_INFO *TCPMEM::get_diagnostics_info()
 	    memcpy(cms_dpi.host_sysinfo, temp_buffer + dpi_offset, 32);
 	    dpi_offset += 32;
 	    cms_dpi.pid =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    memcpy(&(cms_dpi.rcslib_ver), temp_buffer + dpi_offset, 8);
 	    dpi_offset += 8;
 	    cms_dpi.access_type = (CMS_INTERNAL_ACCESS_TYPE)
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    cms_dpi.msg_id =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    cms_dpi.msg_size =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    cms_dpi.msg_type =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    cms_dpi.number_of_accesses =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    cms_dpi.number_of_new_messages =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    memcpy(&(cms_dpi.bytes_moved), temp_buffer + dpi_offset, 8);
 	    dpi_offset += 8;
@@ -392,14 +405,14 @@ CMS_DIAGNOSTICS_INFO *TCPMEM::get_diagnostics_info()
 	    dpi_offset += 8;
 	    di->dpis->store_at_tail(&cms_dpi, sizeof(CMS_DIAG_PROC_INFO), 1);
 	    int is_last_writer =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    if (is_last_writer) {
 		di->last_writer_dpi =
 		    (CMS_DIAG_PROC_INFO *) di->dpis->get_tail();
 	    }
 	    int is_last_reader =
-		ntohl(*((u_long *) ((char *) temp_buffer + dpi_offset)));
+		getbe32(temp_buffer + dpi_offset);
 	    dpi_offset += 4;
 	    if (is_last_reader) {
 		di->last_reader_dpi =
@@ -527,7 +540,7 @@ void TCPMEM::reconnect()
 	    rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 		"TCPMEM sending request: fd = %d, serial_number=%ld, request_type=%d, buffer_number=%ld\n",
 		socket_fd, serial_number,
-		ntohl(*((u_long *) temp_buffer + 1)), buffer_number);
+		getbe32(temp_buffer + 4), buffer_number);
 	    memset(temp_buffer, 0, 20);
 	    recvd_bytes = 0;
 	    if (recvn(socket_fd, temp_buffer, 8, 0, 30, &recvd_bytes) < 0) {
@@ -625,6 +638,10 @@ void TCPMEM::reconnect()
 TCPMEM::~TCPMEM()
 {
     disconnect();
+    if (NULL != delta_base) {
+	free(delta_base);
+	delta_base = NULL;
+    }
 }
 
 void TCPMEM::disconnect()
@@ -656,6 +673,113 @@ void TCPMEM::disconnect()
     }
 }
 
+/* For buffers with the delta option: keeps a copy of each whole message
+   received, and rebuilds the message from that copy when the server
+   sends only what has changed. Returns -1 if the changes are not against
+   the message kept. in_buffer_id is then cleared, so that the next read
+   request tells the server this client has nothing and gets a whole
+   message back. (Subscriptions do not send one, and get theirs with the
+   next keyframe.) */
+int TCPMEM::apply_delta(long message_size, long id)
+{
+    char *delta = (char *) encoded_data;
+    long base_id, full_size, pos, offset, length;
+
+    if (NULL == delta_base) {
+	delta_base = (char *) malloc(max_encoded_message_size);
+	if (NULL == delta_base) {
+	    rcs_print_error("TCPMEM: Can't allocate %ld bytes.\n",
+		max_encoded_message_size);
+	    return -1;
+	}
+	delta_base_id = 0;
+	delta_base_length = 0;
+    }
+    if (!reply_is_delta) {
+	memcpy(delta_base, encoded_data, message_size);
+	delta_base_length = message_size;
+	delta_base_id = id;
+	return 0;
+    }
+    if (message_size < 8) {
+	rcs_print_error("TCPMEM: Delta reply too short. (%ld)\n",
+	    message_size);
+	return -1;
+    }
+    base_id = getbe32(delta);
+    full_size = getbe32(delta + 4);
+    if (base_id != delta_base_id || full_size != delta_base_length) {
+	rcs_print_error
+	    ("TCPMEM: Delta against message %ld of %ld bytes, but have message %ld of %ld bytes.\n",
+	    base_id, full_size, delta_base_id, delta_base_length);
+	delta_base_id = 0;
+	in_buffer_id = 0;
+	return -1;
+    }
+    for (pos = 8; pos + 8 <= message_size; pos += 8 + length) {
+	offset = getbe32(delta + pos);
+	length = getbe32(delta + pos + 4);
+	if (offset + length > full_size || pos + 8 + length > message_size) {
+	    rcs_print_error("TCPMEM: Bad range in delta reply.\n");
+	    delta_base_id = 0;
+	    in_buffer_id = 0;
+	    return -1;
+	}
+	memcpy(delta_base + offset, delta + pos + 8, length);
+    }
+    delta_base_id = id;
+    memcpy(encoded_data, delta_base, full_size);
+    return 0;
+}
+
+/* Nonzero when a whole subscription reply is already sitting in the
+   socket, so reading it can not block. */
+int TCPMEM::newer_reply_waiting()
+{
+    char reply_header[20];
+    int bytes_ready = 0;
+
+    if (waiting_for_message || recvd_bytes != 0) {
+	return 0;
+    }
+    if (recv(socket_fd, reply_header, 20, MSG_PEEK | MSG_DONTWAIT) != 20) {
+	return 0;
+    }
+    if (ioctl(socket_fd, FIONREAD, &bytes_ready) < 0) {
+	return 0;
+    }
+    return (bytes_ready >= 20 + (long) (getbe32(reply_header + 8) &
+	    ~REMOTE_CMS_DELTA_REPLY));
+}
+
+/* The server may have pushed several updates since the last read, as it
+   does with sub=change. Only the newest one matters, so the rest are
+   read past rather than handed out one per call. */
+void TCPMEM::skip_to_newest_reply()
+{
+    while (status == CMS_READ_OK && newer_reply_waiting()) {
+	/* handle_old_replies() clears this once it has a reply. */
+	timedout_request = REMOTE_CMS_READ_REQUEST_TYPE;
+	handle_old_replies();
+	if (0 == timedout_request_writeid) {
+	    /* Nothing came after all; check_id(0) would forget the id of
+	       the reply already read. */
+	    if (status >= 0) {
+		status = CMS_READ_OK;
+	    }
+	    break;
+	}
+	check_id(timedout_request_writeid);
+	if (status == CMS_READ_OLD) {
+	    status = CMS_READ_OK;
+	    break;
+	}
+	if (status == CMS_READ_OK) {
+	    serial_number++;
+	}
+    }
+}
+
 CMS_STATUS TCPMEM::handle_old_replies()
 {
     long message_size;
@@ -706,11 +830,13 @@ CMS_STATUS TCPMEM::handle_old_replies()
 		    serial_number = returned_serial_number;
 		}
 	    }
-	    message_size = ntohl(*((u_long *) temp_buffer + 2));
+	    message_size = getbe32(temp_buffer + 8);
+	    reply_is_delta = ((message_size & REMOTE_CMS_DELTA_REPLY) != 0);
+	    message_size &= ~REMOTE_CMS_DELTA_REPLY;
 	    timedout_request_status =
-		(CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-	    timedout_request_writeid = ntohl(*((u_long *) temp_buffer + 3));
-	    header.was_read = ntohl(*((u_long *) temp_buffer + 4));
+		(CMS_STATUS) getbe32(temp_buffer + 4);
+	    timedout_request_writeid = getbe32(temp_buffer + 12);
+	    header.was_read = getbe32(temp_buffer + 16);
 	    if (message_size > max_encoded_message_size) {
 		rcs_print_error("Recieved message is too big. (%ld > %ld)\n",
 		    message_size, max_encoded_message_size);
@@ -757,6 +883,10 @@ CMS_STATUS TCPMEM::handle_old_replies()
 	    if (waiting_for_message) {
 		timedout_request_writeid = waiting_message_id;
 	    }
+	    if (delta_keyframe_interval > 0 &&
+		apply_delta(message_size, timedout_request_writeid) < 0) {
+		status = CMS_MISC_ERROR;
+	    }
 	}
 	break;
 
@@ -912,6 +1042,7 @@ CMS_STATUS TCPMEM::read()
 	if (status == CMS_READ_OK) {
 	    serial_number++;
 	}
+	skip_to_newest_reply();
 	subscription_count++;
 	reenable_sigpipe();
 	return status;
@@ -955,7 +1086,7 @@ CMS_STATUS TCPMEM::read()
 
     int send_header_size = 20;
     if (total_subdivisions > 1) {
-	*((u_long *) temp_buffer + 5) = htonl((u_long) current_subdivision);
+	putbe32(temp_buffer + 20, (u_long) current_subdivision);
 	send_header_size = 24;
     }
     if (sendn(socket_fd, temp_buffer, send_header_size, 0, timeout) < 0) {
@@ -969,7 +1100,7 @@ CMS_STATUS TCPMEM::read()
     rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 	"TCPMEM sending request: fd = %d, serial_number=%ld, request_type=%d, buffer_number=%ld\n",
 	socket_fd, serial_number,
-	ntohl(*((u_long *) temp_buffer + 1)), buffer_number);
+	getbe32(temp_buffer + 4), buffer_number);
 
     if (recvn(socket_fd, temp_buffer, 20, 0, timeout, &recvd_bytes) < 20) {
 	if (recvn_timedout) {
@@ -1006,10 +1137,12 @@ CMS_STATUS TCPMEM::read()
 	    return (status = CMS_MISC_ERROR);
 	}
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    message_size = ntohl(*((u_long *) temp_buffer + 2));
-    id = ntohl(*((u_long *) temp_buffer + 3));
-    header.was_read = ntohl(*((u_long *) temp_buffer + 4));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    message_size = getbe32(temp_buffer + 8);
+    reply_is_delta = ((message_size & REMOTE_CMS_DELTA_REPLY) != 0);
+    message_size &= ~REMOTE_CMS_DELTA_REPLY;
+    id = getbe32(temp_buffer + 12);
+    header.was_read = getbe32(temp_buffer + 16);
     if (message_size > max_encoded_message_size) {
 	rcs_print_error("Recieved message is too big. (%ld > %ld)\n",
 	    message_size, max_encoded_message_size);
@@ -1046,6 +1179,11 @@ CMS_STATUS TCPMEM::read()
 	}
     }
     recvd_bytes = 0;
+    if (message_size > 0 && delta_keyframe_interval > 0 &&
+	apply_delta(message_size, id) < 0) {
+	reenable_sigpipe();
+	return (status = CMS_MISC_ERROR);
+    }
     check_id(id);
     reenable_sigpipe();
     return (status);
@@ -1099,6 +1237,7 @@ CMS_STATUS TCPMEM::blocking_read(double _blocking_timeout)
 	if (status == CMS_READ_OK) {
 	    serial_number++;
 	}
+	skip_to_newest_reply();
 	subscription_count++;
 	reenable_sigpipe();
 	if (blocking_timeout < -1e-6 || blocking_timeout > 1e-6) {
@@ -1170,7 +1309,7 @@ CMS_STATUS TCPMEM::blocking_read(double _blocking_timeout)
 	"TCPMEM sending request: fd = %d, serial_number=%ld, "
 	"request_type=%d, buffer_number=%ld\n",
 	socket_fd, serial_number,
-	ntohl(*((u_long *) temp_buffer + 1)), buffer_number);
+	getbe32(temp_buffer + 4), buffer_number);
     if (recvn(socket_fd, temp_buffer, 20, 0, blocking_timeout, &recvd_bytes) <
 	0) {
 	print_recvn_timeout_errors = orig_print_recvn_timeout_errors;
@@ -1209,10 +1348,12 @@ CMS_STATUS TCPMEM::blocking_read(double _blocking_timeout)
 	    return (status = CMS_MISC_ERROR);
 	}
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    message_size = ntohl(*((u_long *) temp_buffer + 2));
-    id = ntohl(*((u_long *) temp_buffer + 3));
-    header.was_read = ntohl(*((u_long *) temp_buffer + 4));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    message_size = getbe32(temp_buffer + 8);
+    reply_is_delta = ((message_size & REMOTE_CMS_DELTA_REPLY) != 0);
+    message_size &= ~REMOTE_CMS_DELTA_REPLY;
+    id = getbe32(temp_buffer + 12);
+    header.was_read = getbe32(temp_buffer + 16);
     if (message_size > max_encoded_message_size) {
 	rcs_print_error("Recieved message is too big. (%ld > %ld)\n",
 	    message_size, max_encoded_message_size);
@@ -1249,6 +1390,11 @@ CMS_STATUS TCPMEM::blocking_read(double _blocking_timeout)
 	}
     }
     recvd_bytes = 0;
+    if (message_size > 0 && delta_keyframe_interval > 0 &&
+	apply_delta(message_size, id) < 0) {
+	reenable_sigpipe();
+	return (status = CMS_MISC_ERROR);
+    }
     check_id(id);
     reenable_sigpipe();
     return (status);
@@ -1308,6 +1454,7 @@ CMS_STATUS TCPMEM::peek()
 	if (status == CMS_READ_OK) {
 	    serial_number++;
 	}
+	skip_to_newest_reply();
 	reenable_sigpipe();
 	subscription_count++;
 	return status;
@@ -1350,7 +1497,7 @@ CMS_STATUS TCPMEM::peek()
     putbe32(temp_buffer + 16, (uint32_t) in_buffer_id);
     int send_header_size = 20;
     if (total_subdivisions > 1) {
-	*((u_long *) temp_buffer + 20) = htonl((u_long) current_subdivision);
+	putbe32(temp_buffer + 20, (uint32_t) current_subdivision);
 	send_header_size = 24;
     }
     if (sendn(socket_fd, temp_buffer, send_header_size, 0, timeout) < 0) {
@@ -1395,10 +1542,12 @@ CMS_STATUS TCPMEM::peek()
 	    return (status = CMS_MISC_ERROR);
 	}
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    message_size = ntohl(*((u_long *) temp_buffer + 2));
-    id = ntohl(*((u_long *) temp_buffer + 3));
-    header.was_read = ntohl(*((u_long *) temp_buffer + 4));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    message_size = getbe32(temp_buffer + 8);
+    reply_is_delta = ((message_size & REMOTE_CMS_DELTA_REPLY) != 0);
+    message_size &= ~REMOTE_CMS_DELTA_REPLY;
+    id = getbe32(temp_buffer + 12);
+    header.was_read = getbe32(temp_buffer + 16);
     if (message_size > max_encoded_message_size) {
 	reconnect_needed = 1;
 	rcs_print_error("Recieved message is too big. (%ld > %ld)\n",
@@ -1434,6 +1583,11 @@ CMS_STATUS TCPMEM::peek()
 	}
     }
     recvd_bytes = 0;
+    if (message_size > 0 && delta_keyframe_interval > 0 &&
+	apply_delta(message_size, id) < 0) {
+	reenable_sigpipe();
+	return (status = CMS_MISC_ERROR);
+    }
     check_id(id);
     reenable_sigpipe();
     return (status);
@@ -1554,8 +1708,8 @@ CMS_STATUS TCPMEM::write(void *user_data)
 		return (status = CMS_MISC_ERROR);
 	    }
 	}
-	status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-	header.was_read = ntohl(*((u_long *) temp_buffer + 2));
+	status = (CMS_STATUS) getbe32(temp_buffer + 4);
+	header.was_read = getbe32(temp_buffer + 8);
     } else {
 	header.was_read = 0;
 	status = CMS_WRITE_OK;
@@ -1673,8 +1827,8 @@ CMS_STATUS TCPMEM::write_if_read(void *user_data)
 		return (status = CMS_MISC_ERROR);
 	    }
 	}
-	status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-	header.was_read = ntohl(*((u_long *) temp_buffer + 2));
+	status = (CMS_STATUS) getbe32(temp_buffer + 4);
+	header.was_read = getbe32(temp_buffer + 8);
     } else {
 	header.was_read = 0;
 	status = CMS_WRITE_OK;
@@ -1758,8 +1912,8 @@ int TCPMEM::check_if_read()
 	reenable_sigpipe();
 	return (status = CMS_MISC_ERROR);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    header.was_read = ntohl(*((u_long *) temp_buffer + 2));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    header.was_read = getbe32(temp_buffer + 8);
     reenable_sigpipe();
     return (header.was_read);
 }
@@ -1838,8 +1992,8 @@ int TCPMEM::get_queue_length()
 	reenable_sigpipe();
 	return (status = CMS_MISC_ERROR);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    queuing_header.queue_length = ntohl(*((u_long *) temp_buffer + 2));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    queuing_header.queue_length = getbe32(temp_buffer + 8);
     reenable_sigpipe();
     return (queuing_header.queue_length);
 }
@@ -1918,8 +2072,8 @@ int TCPMEM::get_msg_count()
 	reenable_sigpipe();
 	return (status = CMS_MISC_ERROR);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    header.write_id = ntohl(*((u_long *) temp_buffer + 2));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    header.write_id = getbe32(temp_buffer + 8);
     reenable_sigpipe();
     return (header.write_id);
 }
@@ -1998,8 +2152,8 @@ int TCPMEM::get_space_available()
 	reenable_sigpipe();
 	return (status = CMS_MISC_ERROR);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    free_space = ntohl(*((u_long *) temp_buffer + 2));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    free_space = getbe32(temp_buffer + 8);
     reenable_sigpipe();
     return (free_space);
 }
@@ -2065,8 +2219,8 @@ CMS_STATUS TCPMEM::clear()
 	reconnect_needed = 1;
 	return (status = CMS_MISC_ERROR);
     }
-    status = (CMS_STATUS) ntohl(*((u_long *) temp_buffer + 1));
-    header.was_read = ntohl(*((u_long *) temp_buffer + 2));
+    status = (CMS_STATUS) getbe32(temp_buffer + 4);
+    header.was_read = getbe32(temp_buffer + 8);
     return (status);
 }
 /*! \todo Another #if 0 */
@@ -2093,10 +2247,9 @@ int TCPMEM::login(const char *name, const char *passwd)
 	return 0;
     }
     set_socket_fds(write_socket_fd);
-    *((u_long *) temp_buffer) = htonl((u_long) serial_number);
-    *((u_long *) temp_buffer + 1) =
-	htonl((u_long) REMOTE_CMS_GET_KEYS_REQUEST_TYPE);
-    *((u_long *) temp_buffer + 2) = htonl((u_long) buffer_number);
+    putbe32(temp_buffer, (u_long) serial_number);
+    putbe32(temp_buffer + 4, (u_long) REMOTE_CMS_GET_KEYS_REQUEST_TYPE);
+    putbe32(temp_buffer + 8, (u_long) buffer_number);
     if (sendn(socket_fd, temp_buffer, 20, 0, 30.0) < 0) {
 	return 0;
     }
@@ -2135,10 +2288,9 @@ int TCPMEM::login(const char *name, const char *passwd)
     char passwd_pass2[16];
     strncpy(passwd_pass2, crypt2_ret, 16);
 
-    *((u_long *) temp_buffer) = htonl((u_long) serial_number);
-    *((u_long *) temp_buffer + 1) =
-	htonl((u_long) REMOTE_CMS_LOGIN_REQUEST_TYPE);
-    *((u_long *) temp_buffer + 2) = htonl((u_long) buffer_number);
+    putbe32(temp_buffer, (u_long) serial_number);
+    putbe32(temp_buffer + 4, (u_long) REMOTE_CMS_LOGIN_REQUEST_TYPE);
+    putbe32(temp_buffer + 8, (u_long) buffer_number);
     if (sendn(socket_fd, temp_buffer, 20, 0, 30.0) < 0) {
 	return 0;
     }
@@ -2165,7 +2317,7 @@ int TCPMEM::login(const char *name, const char *passwd)
 	    returned_serial_number, serial_number);
 	return (status = CMS_MISC_ERROR);
     }
-    int success = ntohl(*((u_long *) temp_buffer + 1));
+    int success = getbe32(temp_buffer + 4);
     return (success);
 }
 #endif
@@ -48,6 +48,13 @@ class TCPMEM:public CMS {
 
   protected:
       CMS_STATUS handle_old_replies();
+    int newer_reply_waiting();
+    void skip_to_newest_reply();
+    int apply_delta(long message_size, long id);
+    int reply_is_delta;		/* data in the last reply is a delta */
+    char *delta_base;		/* last whole message, for deltas */
+    long delta_base_length;
+    long delta_base_id;
     void send_diag_info();
     char diag_info_buf[0x400];
     int recvd_bytes;
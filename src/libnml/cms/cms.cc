@@ -37,6 +37,7 @@ extern "C" {
 #include "cms_xup.hh"		/* class CMS_XDR_UPDATER */
 #include "cms_aup.hh"		/* class CMS_ASCII_UPDATER */
 #include "cms_dup.hh"		/* class CMS_DISPLAY_ASCII_UPDATER */
+#include "cms_pup.hh"		/* class CMS_PACKED_UPDATER */
 #include "rcs_print.hh"		/* rcs_print_error(), separate_words() */
 				/* rcs_print_debug() */
 #include "cmsdiag.hh"
@@ -137,6 +138,7 @@ CMS::CMS(long s)
     last_im = CMS_NOT_A_MODE;
     min_compatible_version = 0;
     confirm_write = 0;
+    delta_keyframe_interval = 0;
     disable_final_write_raw_for_dma = 0;
     subdiv_data = 0;
     enable_diagnostics = 0;
@@ -194,6 +196,7 @@ CMS::CMS(const char *bufline_in, const char *procline_in, int set_to_server)
     min_compatible_version = 0;
     force_raw = 0;
     confirm_write = 0;
+    delta_keyframe_interval = 0;
     disable_final_write_raw_for_dma = 0;
     /* Init string buffers */
     memset(BufferName, 0, CMS_CONFIG_LINELEN);
@@ -370,6 +373,10 @@ CMS::CMS(const char *bufline_in, const char *procline_in, int set_to_server)
 	    neutral_encoding_method = CMS_DISPLAY_ASCII_ENCODING;
 	    continue;
 	}
+	if (!strcmp(word[i], "PACKED")) {
+	    neutral_encoding_method = CMS_PACKED_ENCODING;
+	    continue;
+	}
 	if (!strcmp(buflineupper, "ASCII")) {
 	    neutral_encoding_method = CMS_ASCII_ENCODING;
 	    continue;
@@ -422,6 +429,16 @@ CMS::CMS(const char *bufline_in, const char *procline_in, int set_to_server)
 	    confirm_write = 1;
 	    continue;
 	}
+	if (!strcmp(word[i], "DELTA")) {
+	    delta_keyframe_interval = CMS_DEFAULT_DELTA_KEYFRAME_INTERVAL;
+	    continue;
+	}
+	char *delta_string;
+	if (NULL != (delta_string = strstr(word[i], "DELTA="))) {
+	    delta_keyframe_interval =
+		strtol(delta_string + 6, (char **) NULL, 0);
+	    continue;
+	}
 	if (!strcmp(word[i], "FORCE_RAW")) {
 	    force_raw = 1;
 	    continue;
@@ -431,6 +448,9 @@ CMS::CMS(const char *bufline_in, const char *procline_in, int set_to_server)
 	    continue;
 	}
     }
+    if (total_subdivisions > 1) {
+	delta_keyframe_interval = 0;
+    }
 
     /* Get parameters from the process's line in the config file. */
     if (use_autokey_for_connection_number) {
@@ -673,6 +693,10 @@ void CMS::open(void)
 	    updater = new CMS_DISPLAY_ASCII_UPDATER(this);
 	    break;
 
+	case CMS_PACKED_ENCODING:
+	    updater = new CMS_PACKED_UPDATER(this);
+	    break;
+
 	default:
 	    updater = (CMS_UPDATER *) NULL;
 	    status = CMS_UPDATE_ERROR;
@@ -1027,6 +1051,18 @@ CMS_STATUS CMS::peek()
     return (status);
 }
 
+/* Reading in place needs the buffer mapped into this process, so only
+   protocols that do that override these. */
+CMS_STATUS CMS::peek_in_place(const void **_data, long *_token)
+{
+    return (status = CMS_NO_IMPLEMENTATION_ERROR);
+}
+
+int CMS::check_in_place(long _token)
+{
+    return 0;
+}
+
 CMS_STATUS CMS::write(void *user_data)
 {
     internal_access_type = CMS_WRITE_ACCESS;
@@ -1117,6 +1153,10 @@ void CMS::set_temp_updater(CMS_NEUTRAL_ENCODING_METHOD temp_encoding_method)
 	    temp_updater = new CMS_DISPLAY_ASCII_UPDATER(this);
 	    break;
 
+	case CMS_PACKED_ENCODING:
+	    temp_updater = new CMS_PACKED_UPDATER(this);
+	    break;
+
 	default:
 	    temp_updater = (CMS_UPDATER *) NULL;
 	    status = CMS_UPDATE_ERROR;
@@ -147,6 +147,14 @@ struct CMS_HEADER {
     long in_buffer_size;	/* How much of the buffer is currently used. */
 };
 
+/* write_raw() keeps was_read at this value while it copies a message in,
+   so that readers that do not take the mutex can tell. */
+#define CMS_HEADER_WRITING (-1)
+
+/* With "delta" on the buffer line, every this many remote read replies
+   carries the whole message. "delta=N" sets another interval. */
+#define CMS_DEFAULT_DELTA_KEYFRAME_INTERVAL 100
+
 class CMS_DIAG_PROC_INFO;
 class CMS_DIAG_HEADER;
 class CMS_DIAGNOSTICS_INFO;
@@ -163,7 +171,8 @@ enum CMS_NEUTRAL_ENCODING_METHOD {
     CMS_NO_ENCODING,
     CMS_XDR_ENCODING,
     CMS_ASCII_ENCODING,
-    CMS_DISPLAY_ASCII_ENCODING
+    CMS_DISPLAY_ASCII_ENCODING,
+    CMS_PACKED_ENCODING
 };
 
 /* CMS class declaration. */
@@ -193,6 +202,9 @@ class CMS {
 							   wait for new data. 
 							 */
     virtual CMS_STATUS peek();	/* Read without setting flag. */
+    virtual CMS_STATUS peek_in_place(const void **_data, long *_token);
+					/* Find the message without copying. */
+    virtual int check_in_place(long _token);	/* Still the same message? */
     virtual CMS_STATUS write(void *user_data);	/* Write to buffer. */
     virtual CMS_STATUS write_if_read(void *user_data);	/* Write to buffer. */
     virtual int login(const char *name, const char *passwd);
@@ -224,6 +236,7 @@ class CMS {
     CMS_STATUS internal_access(PHYSMEM_HANDLE * _global, void *_local);
     CMS_STATUS internal_access(void *_global, long global_size, void *_local);
     CMS_STATUS internal_clear();	/* Zero the global memory.  */
+    CMS_HEADER *in_place_header(void *_global);	/* NULL if not raw. */
     int check_if_read_raw();
     int check_if_read_encoded();
     int get_msg_count_raw();
@@ -233,6 +246,8 @@ class CMS {
     CMS_STATUS peek_raw();	/* Read without setting flags. */
     CMS_STATUS peek_encoded();	/* Read without setting flags. */
     CMS_STATUS write_raw(void *user_data);	/* Write to raw buffers. */
+    int write_was_read(long _was_read);	/* Bracket a raw write. */
+    void restore_header(const CMS_HEADER * previous);	/* Undo a failed one. */
     CMS_STATUS write_encoded();	/* Write to neutrally encoded buffers. */
     CMS_STATUS write_if_read_raw(void *user_data);	/* Write if read. */
     CMS_STATUS write_if_read_encoded();	/* Write if read. */
@@ -442,6 +457,8 @@ class CMS {
     double blocking_timeout;
     double min_compatible_version;
     int confirm_write;
+    long delta_keyframe_interval;	/* remote reads send only changes,
+					   and the whole message this often */
     int disable_final_write_raw_for_dma;
     virtual const char *status_string(int);
 
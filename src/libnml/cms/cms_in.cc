@@ -278,6 +278,28 @@ CMS_STATUS CMS::internal_access(PHYSMEM_HANDLE * _global, void *_local)
     return (status);
 }
 
+/* Find the header of a raw, single message buffer mapped at _global, so
+   the message after it can be read in place.  This follows the offsets
+   internal_access() applies; buffers that need more than that, or
+   decoding, can only be read through a copy and give NULL. */
+CMS_HEADER *CMS::in_place_header(void *_global)
+{
+    char *ptr = (char *) _global;
+
+    if (NULL == ptr || neutral || queuing_enabled || split_buffer ||
+	enable_diagnostics) {
+	return NULL;
+    }
+    if (min_compatible_version > 2.58 || min_compatible_version < 1E-6) {
+	ptr += skip_area;
+    }
+    if (total_subdivisions >= 1 && current_subdivision > 0
+	&& current_subdivision < total_subdivisions) {
+	ptr += current_subdivision * subdiv_size;
+    }
+    return ((CMS_HEADER *) ptr);
+}
+
 /* Clear the shared or global memory. */
 CMS_STATUS CMS::internal_clear()
 {
@@ -1306,6 +1328,37 @@ CMS_STATUS CMS::queue_peek_encoded()
     return (status);
 }
 
+/* Store just the was_read word of the header at the current offset.  The
+   raw writes bracket each message with it so that readers which do not
+   take the mutex (SHMEM::peek_in_place()) can tell when they raced one:
+   CMS_HEADER_WRITING goes in before the header and message are touched,
+   and the final value only after both are complete. */
+int CMS::write_was_read(long _was_read)
+{
+    header.was_read = _was_read;
+    __sync_synchronize();
+    if (-1 == handle_to_global_data->write(&header.was_read,
+	    sizeof(header.was_read))) {
+	rcs_print_error("CMS:(%s) Error writing to global memory at %s:%d\n",
+	    BufferName, __FILE__, __LINE__);
+	return -1;
+    }
+    __sync_synchronize();
+    return 0;
+}
+
+/* Put back the header a raw write found, when it fails after
+   write_was_read(CMS_HEADER_WRITING), so that neither the mutex-free
+   readers nor the next writer are left looking at a half written
+   message. */
+void CMS::restore_header(const CMS_HEADER * previous)
+{
+    header = *previous;
+    header.was_read = CMS_HEADER_WRITING;
+    handle_to_global_data->write(&header, sizeof(header));
+    write_was_read(previous->was_read);
+}
+
 /* It takes several steps to perform a write operation. */
 /* 1. Read the header. */
 /* 2. Update the header. */
@@ -1315,6 +1368,7 @@ CMS_STATUS CMS::queue_peek_encoded()
 CMS_STATUS CMS::write_raw(void *user_data)
 {
     long current_header_in_buffer_size;
+    CMS_HEADER previous_header;
 
     /* Produce error message if process does not have permission to read. */
     if (!write_permission_flag) {
@@ -1350,8 +1404,12 @@ CMS_STATUS CMS::write_raw(void *user_data)
 	return (status = CMS_INTERNAL_ACCESS_ERROR);
     }
 
-    /* Update the header. */
-    header.was_read = 0;
+    /* Update the header.  Readers that do not take the mutex see was_read
+       at CMS_HEADER_WRITING until the message is complete. */
+    previous_header = header;
+    if (-1 == write_was_read(CMS_HEADER_WRITING)) {
+	return (status = CMS_INTERNAL_ACCESS_ERROR);
+    }
     header.write_id++;
     if (split_buffer) {
 	if ((header.write_id & 1) != toggle_bit) {
@@ -1362,6 +1420,7 @@ CMS_STATUS CMS::write_raw(void *user_data)
     if (-1 == handle_to_global_data->write(&header, sizeof(header))) {
 	rcs_print_error("CMS:(%s) Error writing to global memory at %s:%d\n",
 	    BufferName, __FILE__, __LINE__);
+	restore_header(&previous_header);
 	return (status = CMS_INTERNAL_ACCESS_ERROR);
     }
 
@@ -1374,8 +1433,14 @@ CMS_STATUS CMS::write_raw(void *user_data)
 		("CMS:(%s) Error writing %ld bytes to global memory at offset %p\n (See  %s line %d.)\n",
 		BufferName, header.in_buffer_size, user_data, __FILE__,
 		__LINE__);
+	    handle_to_global_data->offset -= sizeof(CMS_HEADER);
+	    restore_header(&previous_header);
 	    return (status = CMS_INTERNAL_ACCESS_ERROR);
 	}
+	handle_to_global_data->offset -= sizeof(CMS_HEADER);
+    }
+    if (-1 == write_was_read(0)) {
+	return (status = CMS_INTERNAL_ACCESS_ERROR);
     }
 
     return (status = CMS_WRITE_OK);
@@ -1742,6 +1807,7 @@ CMS_STATUS CMS::queue_write_encoded()
 CMS_STATUS CMS::write_if_read_raw(void *user_data)
 {
     CMS_HEADER current_header;
+    CMS_HEADER previous_header;
 
     /* Produce error message if process does not have permission to read. */
     if (!write_permission_flag) {
@@ -1781,8 +1847,11 @@ CMS_STATUS CMS::write_if_read_raw(void *user_data)
 	return (status = CMS_WRITE_WAS_BLOCKED);
     }
 
-    /* Update the header. */
-    header.was_read = 0;
+    /* Update the header, bracketing the message as write_raw() does. */
+    previous_header = header;
+    if (-1 == write_was_read(CMS_HEADER_WRITING)) {
+	return (status = CMS_INTERNAL_ACCESS_ERROR);
+    }
     header.write_id++;
     if (split_buffer && (header.write_id % 2) != toggle_bit) {
 	header.write_id++;
@@ -1791,6 +1860,7 @@ CMS_STATUS CMS::write_if_read_raw(void *user_data)
     if (-1 == handle_to_global_data->write(&header, sizeof(header))) {
 	rcs_print_error("CMS:(%s) Error writing to global memory at %s:%d\n",
 	    BufferName, __FILE__, __LINE__);
+	restore_header(&previous_header);
 	return (status = CMS_INTERNAL_ACCESS_ERROR);
     }
 
@@ -1800,6 +1870,12 @@ CMS_STATUS CMS::write_if_read_raw(void *user_data)
 	    (long) header.in_buffer_size)) {
 	rcs_print_error("CMS:(%s) Error writing to global memory at %s:%d\n",
 	    BufferName, __FILE__, __LINE__);
+	handle_to_global_data->offset -= sizeof(CMS_HEADER);
+	restore_header(&previous_header);
+	return (status = CMS_INTERNAL_ACCESS_ERROR);
+    }
+    handle_to_global_data->offset -= sizeof(CMS_HEADER);
+    if (-1 == write_was_read(0)) {
 	return (status = CMS_INTERNAL_ACCESS_ERROR);
     }
 
@@ -0,0 +1,286 @@
+/********************************************************************
+* Description: cms_pup.cc
+*   Provides the interface to CMS used by NML update functions
+*   including a CMS update function for all the basic C data types
+*   to pack NMLmsgs as they lie in memory.
+*   NOTES: Each value is copied with its native size and byte order, and
+*   arrays are copied in one go, so this is much cheaper than XDR. Both
+*   ends must agree on type sizes and be little-endian, as between any
+*   two x86-64 hosts. Select it with "packed" on the buffer line.
+*
+* Author:
+* License: LGPL Version 2
+* System: Linux
+*
+* Copyright (c) 2026 All rights reserved.
+*
+* Last change:
+********************************************************************/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>		/* memcpy() */
+#include <stdlib.h>		/* malloc(), free() */
+
+#ifdef __cplusplus
+}
+#endif
+#include "cms.hh"		/* class CMS */
+#include "cms_pup.hh"		/* class CMS_PACKED_UPDATER */
+#include "rcs_print.hh"		/* rcs_print_error() */
+
+/* Member functions for CMS_PACKED_UPDATER Class */
+
+CMS_PACKED_UPDATER::CMS_PACKED_UPDATER(CMS * _cms_parent):CMS_UPDATER
+(_cms_parent, 1, 1)
+{
+    const unsigned int one = 1;
+
+    begin_current = end_current = (char *) NULL;
+    max_length_current = 0;
+
+    /* Store and validate constructors arguments. */
+    cms_parent = _cms_parent;
+    if (NULL == cms_parent) {
+	rcs_print_error("CMS parent for updater is NULL.\n");
+	return;
+    }
+
+    /* A big-endian host would put out something the others can not
+       read, so refuse rather than garble the messages. */
+    if (*(const char *) &one != 1) {
+	rcs_print_error("CMS: packed encoding needs a little-endian host.\n");
+	status = CMS_CREATE_ERROR;
+	return;
+    }
+
+    /* Packed headers are exactly the size of the structures. */
+    encoded_header = malloc(sizeof(CMS_HEADER));
+    if (encoded_header == NULL) {
+	rcs_print_error("CMS:can't malloc encoded_header");
+	status = CMS_CREATE_ERROR;
+	return;
+    }
+    if (cms_parent->queuing_enabled) {
+	encoded_queuing_header = malloc(sizeof(CMS_QUEUING_HEADER));
+	if (encoded_queuing_header == NULL) {
+	    rcs_print_error("CMS:can't malloc encoded_queuing_header");
+	    status = CMS_CREATE_ERROR;
+	    return;
+	}
+    }
+}
+
+CMS_PACKED_UPDATER::~CMS_PACKED_UPDATER()
+{
+    if (NULL != encoded_data && !using_external_encoded_data) {
+	free(encoded_data);
+	encoded_data = NULL;
+    }
+    if (NULL != encoded_header) {
+	free(encoded_header);
+	encoded_header = NULL;
+    }
+    if (NULL != encoded_queuing_header) {
+	free(encoded_queuing_header);
+	encoded_queuing_header = NULL;
+    }
+}
+
+int CMS_PACKED_UPDATER::set_mode(CMS_UPDATER_MODE _mode)
+{
+    CMS_UPDATER::set_mode(_mode);
+    mode = _mode;
+    switch (mode) {
+    case CMS_NO_UPDATE:
+	begin_current = end_current = (char *) NULL;
+	max_length_current = 0;
+	break;
+
+    case CMS_ENCODE_DATA:
+    case CMS_DECODE_DATA:
+	begin_current = end_current = (char *) encoded_data;
+	max_length_current = encoded_data_size;
+	break;
+
+    case CMS_ENCODE_HEADER:
+    case CMS_DECODE_HEADER:
+	begin_current = end_current = (char *) encoded_header;
+	max_length_current = sizeof(CMS_HEADER);
+	break;
+
+    case CMS_ENCODE_QUEUING_HEADER:
+    case CMS_DECODE_QUEUING_HEADER:
+	begin_current = end_current = (char *) encoded_queuing_header;
+	max_length_current = sizeof(CMS_QUEUING_HEADER);
+	break;
+
+    default:
+	rcs_print_error("CMS updater in invalid mode.\n");
+	return (-1);
+    }
+    return (0);
+}
+
+int CMS_PACKED_UPDATER::check_pointer(char *_pointer, long _bytes)
+{
+    if (NULL == cms_parent || NULL == begin_current) {
+	rcs_print_error("CMS_PACKED_UPDATER: Required pointer is NULL.\n");
+	return (-1);
+    }
+    if ((end_current - begin_current) + _bytes > max_length_current) {
+	rcs_print_error
+	    ("CMS_PACKED_UPDATER: Encoded message buffer full. (pos=%ld,_bytes=%ld,max=%ld)\n",
+	    (long) (end_current - begin_current), _bytes,
+	    max_length_current);
+	return (-1);
+    }
+    return (cms_parent->check_pointer(_pointer, _bytes));
+}
+
+/* Repositions the data buffer to the very beginning */
+void CMS_PACKED_UPDATER::rewind()
+{
+    CMS_UPDATER::rewind();
+    end_current = begin_current;
+    if (NULL != cms_parent) {
+	cms_parent->format_size = 0;
+    }
+}
+
+int CMS_PACKED_UPDATER::get_encoded_msg_size()
+{
+    return ((int) (end_current - begin_current));
+}
+
+/* Every update function comes down to this copy. */
+CMS_STATUS CMS_PACKED_UPDATER::pack(void *x, long bytes)
+{
+    if (-1 == check_pointer((char *) x, bytes)) {
+	return (status = CMS_UPDATE_ERROR);
+    }
+    if (encoding) {
+	memcpy(end_current, x, bytes);
+    } else {
+	memcpy(x, end_current, bytes);
+    }
+    end_current += bytes;
+    return (status);
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(bool &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(char &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned char &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(short int &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned short int &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(int &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned int &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(long int &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned long int &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(float &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(double &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(long double &x)
+{
+    return pack(&x, sizeof(x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(char *x, unsigned int len)
+{
+    return pack(x, len * sizeof(*x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned char *x, unsigned int len)
+{
+    return pack(x, len * sizeof(*x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(short *x, unsigned int len)
+{
+    return pack(x, len * sizeof(*x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned short *x, unsigned int len)
+{
+    return pack(x, len * sizeof(*x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(int *x, unsigned int len)
+{
+    return pack(x, len * sizeof(*x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned int *x, unsigned int len)
+{
+    return pack(x, len * sizeof(*x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(long *x, unsigned int len)
+{
+    return pack(x, len * sizeof(*x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(unsigned long *x, unsigned int len)
+{
+    return pack(x, len * sizeof(*x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(float *x, unsigned int len)
+{
+    return pack(x, len * sizeof(*x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(double *x, unsigned int len)
+{
+    return pack(x, len * sizeof(*x));
+}
+
+CMS_STATUS CMS_PACKED_UPDATER::update(long double *x, unsigned int len)
+{
+    return pack(x, len * sizeof(*x));
+}
@@ -0,0 +1,57 @@
+/********************************************************************
+* Description: cms_pup.hh
+*
+* Author:
+* License: LGPL Version 2
+* System: Linux
+*
+* Copyright (c) 2026 All rights reserved.
+*
+* Last change:
+********************************************************************/
+
+#ifndef CMS_PUP_HH
+#define CMS_PUP_HH
+
+#include "cms_up.hh"		/* class CMS_UPDATER */
+
+class CMS_PACKED_UPDATER:public CMS_UPDATER {
+  public:
+    CMS_STATUS update(bool &x);
+    CMS_STATUS update(char &x);
+    CMS_STATUS update(unsigned char &x);
+    CMS_STATUS update(short int &x);
+    CMS_STATUS update(unsigned short int &x);
+    CMS_STATUS update(int &x);
+    CMS_STATUS update(unsigned int &x);
+    CMS_STATUS update(long int &x);
+    CMS_STATUS update(unsigned long int &x);
+    CMS_STATUS update(float &x);
+    CMS_STATUS update(double &x);
+    CMS_STATUS update(long double &x);
+    CMS_STATUS update(char *x, unsigned int len);
+    CMS_STATUS update(unsigned char *x, unsigned int len);
+    CMS_STATUS update(short *x, unsigned int len);
+    CMS_STATUS update(unsigned short *x, unsigned int len);
+    CMS_STATUS update(int *x, unsigned int len);
+    CMS_STATUS update(unsigned int *x, unsigned int len);
+    CMS_STATUS update(long *x, unsigned int len);
+    CMS_STATUS update(unsigned long *x, unsigned int len);
+    CMS_STATUS update(float *x, unsigned int len);
+    CMS_STATUS update(double *x, unsigned int len);
+    CMS_STATUS update(long double *x, unsigned int len);
+    int set_mode(CMS_UPDATER_MODE);
+    void rewind();
+    int get_encoded_msg_size();
+  protected:
+    int check_pointer(char *, long);
+    CMS_STATUS pack(void *x, long bytes);
+      CMS_PACKED_UPDATER(CMS *);
+      virtual ~ CMS_PACKED_UPDATER();
+    friend class CMS;
+    char *begin_current;	/* start of the area being coded */
+    char *end_current;		/* where the next item goes */
+    long max_length_current;
+};
+
+#endif
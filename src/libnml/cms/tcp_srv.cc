@@ -36,6 +36,7 @@ extern "C" {
 
 #include <sys/types.h>
 #include <sys/wait.h>		// waitpid
+#include <sys/epoll.h>		// epoll_create1(), epoll_wait()
 
 #include <arpa/inet.h>		/* inet_ntoa */
 #include "cms.hh"		/* class CMS */
@@ -58,6 +59,85 @@ int tcpsvr_threads_killed = 0;
 int tcpsvr_threads_exited = 0;
 int tcpsvr_threads_returned_early = 0;
 
+/* How often buffers with change subscriptions are looked at. Looking
+   costs a glance at the buffer header, so this can be short. */
+#define TCPSVR_CHANGE_WATCH_MILLIS 1
+
+/* Most events handled per call to epoll_wait(). */
+#define TCPSVR_MAX_EVENTS 64
+
+/* Most requests taken from one client before others get a turn. */
+#define TCPSVR_MAX_REQUESTS_PER_WAKEUP 16
+
+/* A client that lets this much output pile up is not reading it. */
+#define TCPSVR_MAX_PENDING_OUTPUT (4 * 1024 * 1024)
+
+/* Changed ranges closer together than this are sent as one, since each
+   range costs 8 bytes of offset and length. */
+#define TCPSVR_DELTA_MIN_GAP 8
+
+/* Longest wait, in seconds, for the rest of a request that has started
+   to arrive, plus a microsecond a byte for big writes over slow links.
+   Clients send each request in one write, and while the server waits
+   no other client is served. */
+#define TCPSVR_REQUEST_TIMEOUT 0.5
+
+static void putbe32(char *addr, uint32_t val) {
+    val = htonl(val);
+    memcpy(addr, &val, sizeof(val));
+}
+
+static uint32_t getbe32(char *addr) {
+    uint32_t val;
+    memcpy(&val, addr, sizeof(val));
+    return ntohl(val);
+}
+
+/* Puts each range where cur differs from base into out as offset, length
+   and the new bytes. Returns the number of bytes put in out, or -1 if
+   they would not fit in max. */
+static long tcpsvr_encode_delta(const char *base, const char *cur,
+    long size, char *out, long max)
+{
+    long pos = 0;
+    long out_len = 0;
+    long start, end;
+    uint64_t a, b;
+
+    while (pos < size) {
+	while (pos + 8 <= size) {
+	    memcpy(&a, base + pos, 8);
+	    memcpy(&b, cur + pos, 8);
+	    if (a != b) {
+		break;
+	    }
+	    pos += 8;
+	}
+	while (pos < size && base[pos] == cur[pos]) {
+	    pos++;
+	}
+	if (pos >= size) {
+	    break;
+	}
+	start = end = pos;
+	while (pos < size && pos - end < TCPSVR_DELTA_MIN_GAP) {
+	    if (base[pos] != cur[pos]) {
+		end = pos + 1;
+	    }
+	    pos++;
+	}
+	if (out_len + 8 + (end - start) > max) {
+	    return -1;
+	}
+	putbe32(out + out_len, (uint32_t) start);
+	putbe32(out + out_len + 4, (uint32_t) (end - start));
+	memcpy(out + out_len + 8, cur + start, end - start);
+	out_len += 8 + (end - start);
+	pos = end;
+    }
+    return out_len;
+}
+
 TCPSVR_BLOCKING_READ_REQUEST::TCPSVR_BLOCKING_READ_REQUEST()
 {
     access_type = CMS_READ_ACCESS;	/* read or just peek */
@@ -76,6 +156,19 @@ TCPSVR_BLOCKING_READ_REQUEST::TCPSVR_BLOCKING_READ_REQUEST()
     read_reply = NULL;
 }
 
+/* Read n bytes of a request from clnt.  There is no telling where the
+   next request starts after part of one is lost, so a client that
+   fails or stalls here is closed. */
+static int recv_request(CLIENT_TCP_PORT * clnt, void *buf, int n)
+{
+    if (recvn(clnt->socket_fd, buf, n, 0,
+	    TCPSVR_REQUEST_TIMEOUT + n * 1e-6, NULL) < 0) {
+	clnt->closing = 1;
+	return -1;
+    }
+    return 0;
+}
+
 static inline double tcp_svr_reverse_double(double in)
 {
     double out;
@@ -129,7 +222,12 @@ CMS_SERVER_REMOTE_PORT(_cms_server)
     client_ports = (LinkedList *) NULL;
     connection_socket = 0;
     connection_port = 0;
-    maxfdpl = 0;
+    epoll_fd = -1;
+    pending_output = 0;
+    read_cache = NULL;
+    read_cache_generation = 0;
+    delta_buf = NULL;
+    delta_buf_size = 0;
     dtimeout = 20.0;
 
     memset(&server_socket_address, 0, sizeof(server_socket_address));
@@ -143,13 +241,8 @@ CMS_SERVER_REMOTE_PORT(_cms_server)
 	return;
     }
     polling_enabled = 0;
-    memset(&select_timeout, 0, sizeof(select_timeout));
-    select_timeout.tv_sec = 30;
-    select_timeout.tv_usec = 30;
     subscription_buffers = NULL;
     current_poll_interval_millis = 30000;
-    memset(&read_fd_set, 0, sizeof(read_fd_set));
-    memset(&write_fd_set, 0, sizeof(write_fd_set));
 }
 
 CMS_SERVER_REMOTE_TCP_PORT::~CMS_SERVER_REMOTE_TCP_PORT()
@@ -208,6 +301,24 @@ void CMS_SERVER_REMOTE_TCP_PORT::unregister_port()
 	delete subscription_buffers;
 	subscription_buffers = NULL;
     }
+    if (NULL != read_cache) {
+	TCP_READ_CACHE_ENTRY *entry =
+	    (TCP_READ_CACHE_ENTRY *) read_cache->get_head();
+	while (NULL != entry) {
+	    delete entry;
+	    entry = (TCP_READ_CACHE_ENTRY *) read_cache->get_next();
+	}
+	delete read_cache;
+	read_cache = NULL;
+    }
+    if (NULL != delta_buf) {
+	free(delta_buf);
+	delta_buf = NULL;
+    }
+    if (epoll_fd >= 0) {
+	close(epoll_fd);
+	epoll_fd = -1;
+    }
     if (number_of_connected_clients > 0) {
 	esleep(2.0);
     }
@@ -279,7 +390,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::register_port()
 	    ntohs(server_socket_address.sin_port));
 	return;
     }
-    if (listen(connection_socket, 5) < 0) {
+    if (listen(connection_socket, SOMAXCONN) < 0) {
 	rcs_print_error("listen error: %d -- %s\n", errno, strerror(errno));
 	rcs_print_error("TCP Server: error on call to listen for port %d.\n",
 	    ntohs(server_socket_address.sin_port));
@@ -299,206 +410,535 @@ static void handle_pipe_error(int signum)
 
 void CMS_SERVER_REMOTE_TCP_PORT::run()
 {
-    unsigned long bytes_ready;
+    struct epoll_event ev, events[TCPSVR_MAX_EVENTS];
+    int bytes_ready;
     int ready_descriptors;
+    int requests_handled;
     if (NULL == client_ports) {
 	rcs_print_error("CMS_SERVER: List of client ports is NULL.\n");
 	return;
     }
-    CLIENT_TCP_PORT *new_client_port, *client_port_to_check;
-    FD_ZERO(&read_fd_set);
-    FD_ZERO(&write_fd_set);
-    FD_SET(connection_socket, &read_fd_set);
-    maxfdpl = connection_socket + 1;
+    CLIENT_TCP_PORT *client_port_to_check;
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+	rcs_print_error("epoll_create error: %d -- %s\n", errno,
+	    strerror(errno));
+	return;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;		/* NULL marks the connection socket */
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connection_socket, &ev) < 0) {
+	rcs_print_error("epoll_ctl error: %d -- %s\n", errno,
+	    strerror(errno));
+	return;
+    }
     signal(SIGPIPE, handle_pipe_error);
     rcs_print_debug(PRINT_CMS_CONFIG_INFO,
 	"running server for TCP port %d (connection_socket = %d).\n",
 	ntohs(server_socket_address.sin_port), connection_socket);
 
     cms_server_count++;
-    fd_set read_fd_set_copy, write_fd_set_copy;
-    FD_ZERO(&read_fd_set_copy);
-    FD_ZERO(&write_fd_set_copy);
-    FD_SET(connection_socket, &read_fd_set_copy);
 
     while (1) {
-	if (polling_enabled) {
-	    memcpy(&read_fd_set_copy, &read_fd_set, sizeof(fd_set));
-	    memcpy(&write_fd_set_copy, &write_fd_set, sizeof(fd_set));
-	    select_timeout.tv_sec = current_poll_interval_millis / 1000;
-	    select_timeout.tv_usec =
-		(current_poll_interval_millis % 1000) * 1000;
-	    ready_descriptors =
-		select(maxfdpl, &read_fd_set, &write_fd_set,
-		(fd_set *) NULL, (timeval *) & select_timeout);
-	    if (ready_descriptors == 0) {
-		update_subscriptions();
-		memcpy(&read_fd_set, &read_fd_set_copy, sizeof(fd_set));
-		memcpy(&write_fd_set, &write_fd_set_copy, sizeof(fd_set));
-		continue;
-	    }
-	} else {
-	    ready_descriptors =
-		select(maxfdpl, &read_fd_set, &write_fd_set,
-		(fd_set *) NULL, (timeval *) NULL);
-
-	}
+	ready_descriptors =
+	    epoll_wait(epoll_fd, events, TCPSVR_MAX_EVENTS,
+	    polling_enabled ? current_poll_interval_millis : -1);
 	if (ready_descriptors < 0) {
-	    rcs_print_error("server: select error.(errno = %d | %s)\n",
-		errno, strerror(errno));
-	}
-	if (NULL == client_ports) {
-	    rcs_print_error("CMS_SERVER: List of client ports is NULL.\n");
-	    return;
+	    if (errno != EINTR) {
+		rcs_print_error("server: epoll_wait error.(errno = %d | %s)\n",
+		    errno, strerror(errno));
+	    }
+	    continue;
 	}
-	client_port_to_check = (CLIENT_TCP_PORT *) client_ports->get_head();
-	while (NULL != client_port_to_check) {
-	    if (FD_ISSET(client_port_to_check->socket_fd, &read_fd_set)) {
+	/* Replies kept from the last pass may be out of date by now. */
+	read_cache_generation++;
+	for (int i = 0; i < ready_descriptors; i++) {
+	    client_port_to_check = (CLIENT_TCP_PORT *) events[i].data.ptr;
+	    if (NULL == client_port_to_check) {
+		accept_client();
+		continue;
+	    }
+	    if (events[i].events & EPOLLOUT) {
+		flush_client(client_port_to_check);
+		if (client_port_to_check->closing) {
+		    close_client(client_port_to_check);
+		    continue;
+		}
+	    }
+	    if (!(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+		continue;
+	    }
+	    /* Take every request the client has already sent so that all
+	       of the replies go back in one write. */
+	    requests_handled = 0;
+	    do {
+		bytes_ready = 0;
 		ioctl(client_port_to_check->socket_fd, FIONREAD,
 		    (caddr_t) & bytes_ready);
 		if (bytes_ready <= 0) {
-		    rcs_print_debug(PRINT_SOCKET_CONNECT,
-			"Socket closed by host with IP address %s.\n",
-			inet_ntoa(client_port_to_check->address.sin_addr));
-		    if (NULL != client_port_to_check->subscriptions) {
-			TCP_CLIENT_SUBSCRIPTION_INFO *clnt_sub_info =
-			    (TCP_CLIENT_SUBSCRIPTION_INFO *)
-			    client_port_to_check->subscriptions->get_head();
-			while (NULL != clnt_sub_info) {
-			    if (NULL != clnt_sub_info->sub_buf_info &&
-				clnt_sub_info->subscription_list_id >= 0) {
-				if (NULL !=
-				    clnt_sub_info->sub_buf_info->
-				    sub_clnt_info) {
-				    clnt_sub_info->sub_buf_info->
-					sub_clnt_info->
-					delete_node(clnt_sub_info->
-					subscription_list_id);
-				    if (clnt_sub_info->sub_buf_info->
-					sub_clnt_info->list_size < 1) {
-					delete clnt_sub_info->sub_buf_info->
-					    sub_clnt_info;
-					clnt_sub_info->sub_buf_info->
-					    sub_clnt_info = NULL;
-					if (NULL != subscription_buffers
-					    && clnt_sub_info->sub_buf_info->
-					    list_id >= 0) {
-					    subscription_buffers->
-						delete_node(clnt_sub_info->
-						sub_buf_info->list_id);
-					    delete clnt_sub_info->
-						sub_buf_info;
-					    clnt_sub_info->sub_buf_info =
-						NULL;
-					}
-				    }
-				    clnt_sub_info->sub_buf_info = NULL;
-				}
-				delete clnt_sub_info;
-				clnt_sub_info =
-				    (TCP_CLIENT_SUBSCRIPTION_INFO *)
-				    client_port_to_check->subscriptions->
-				    get_next();
-			    }
-			    delete client_port_to_check->subscriptions;
-			    client_port_to_check->subscriptions = NULL;
-			    recalculate_polling_interval();
-			}
+		    if (0 == requests_handled) {
+			rcs_print_debug(PRINT_SOCKET_CONNECT,
+			    "Socket closed by host with IP address %s.\n",
+			    inet_ntoa(client_port_to_check->address.sin_addr));
+			client_port_to_check->closing = 1;
 		    }
-		    if (client_port_to_check->threadId > 0
-			&& client_port_to_check->blocking) {
+		    break;
+		}
+		if (client_port_to_check->blocking) {
+		    if (client_port_to_check->threadId > 0) {
+			rcs_print_debug(PRINT_SERVER_THREAD_ACTIVITY,
+			    "Data recieved from %s:%d when it should be blocking (bytes_ready=%d).\n",
+			    inet_ntoa(client_port_to_check->address.sin_addr),
+			    client_port_to_check->socket_fd, bytes_ready);
+			rcs_print_debug(PRINT_SERVER_THREAD_ACTIVITY,
+			    "Killing handler %d.\n",
+			    client_port_to_check->threadId);
+
 			blocking_thread_kill(client_port_to_check->threadId);
+			client_port_to_check->threadId = 0;
+			client_port_to_check->blocking = 0;
 		    }
-		    close(client_port_to_check->socket_fd);
-		    FD_CLR(client_port_to_check->socket_fd, &read_fd_set);
-		    client_port_to_check->socket_fd = -1;
-		    delete client_port_to_check;
-		    client_ports->delete_current_node();
-		} else {
-		    if (client_port_to_check->blocking) {
-			if (client_port_to_check->threadId > 0) {
-			    rcs_print_debug(PRINT_SERVER_THREAD_ACTIVITY,
-				"Data recieved from %s:%d when it should be blocking (bytes_ready=%ld).\n",
-				inet_ntoa
-				(client_port_to_check->address.
-				    sin_addr),
-				client_port_to_check->socket_fd, bytes_ready);
-			    rcs_print_debug(PRINT_SERVER_THREAD_ACTIVITY,
-				"Killing handler %d.\n",
-				client_port_to_check->threadId);
-
-			    blocking_thread_kill
-				(client_port_to_check->threadId);
-#if 0
-			    *((u_long *) temp_buffer) =
-				htonl(client_port_to_check->serial_number);
-			    *((u_long *) temp_buffer + 1) =
-				htonl((unsigned long)
-				CMS_SERVER_SIDE_ERROR);
-			    putbe32(temp_buffer + 8, 0);	/* size
-									 */
-			    putbe32(temp_buffer + 12, 0);	/* write_id
-									 */
-			    putbe32(temp_buffer + 16, 0);	/* was_read
-									 */
-			    sendn(client_port_to_check->socket_fd,
-				temp_buffer, 20, 0, dtimeout);
-#endif
-			    client_port_to_check->threadId = 0;
-			    client_port_to_check->blocking = 0;
+		}
+		handle_request(client_port_to_check);
+		requests_handled++;
+	    } while (!client_port_to_check->closing
+		&& !client_port_to_check->blocking
+		&& requests_handled < TCPSVR_MAX_REQUESTS_PER_WAKEUP);
+	    if (client_port_to_check->closing) {
+		close_client(client_port_to_check);
+	    }
+	}
+	update_subscriptions();
+	flush_clients();
+    }
+}
+
+void CMS_SERVER_REMOTE_TCP_PORT::accept_client()
+{
+    struct epoll_event ev;
+    socklen_t client_address_length;
+    CLIENT_TCP_PORT *new_client_port = new CLIENT_TCP_PORT();
+    client_address_length = sizeof(new_client_port->address);
+    new_client_port->socket_fd = accept(connection_socket,
+	(struct sockaddr *) &new_client_port->address,
+	&client_address_length);
+    if (new_client_port->socket_fd < 0) {
+	rcs_print_error("server: accept error -- %d %s \n", errno,
+	    strerror(errno));
+	delete new_client_port;
+	return;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = new_client_port;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, new_client_port->socket_fd,
+	    &ev) < 0) {
+	rcs_print_error("epoll_ctl error: %d -- %s\n", errno,
+	    strerror(errno));
+	delete new_client_port;
+	return;
+    }
+    current_clients++;
+    if (current_clients > max_clients) {
+	max_clients = current_clients;
+    }
+    rcs_print_debug(PRINT_SOCKET_CONNECT,
+	"Socket opened by host with IP address %s.\n",
+	inet_ntoa(new_client_port->address.sin_addr));
+    new_client_port->serial_number = 0;
+    new_client_port->blocking = 0;
+    new_client_port->list_id =
+	client_ports->store_at_tail(new_client_port,
+	sizeof(new_client_port), 0);
+}
+
+void CMS_SERVER_REMOTE_TCP_PORT::close_client(CLIENT_TCP_PORT * clnt)
+{
+    struct epoll_event ev;
+
+    if (NULL != clnt->subscriptions) {
+	TCP_CLIENT_SUBSCRIPTION_INFO *clnt_sub_info =
+	    (TCP_CLIENT_SUBSCRIPTION_INFO *) clnt->subscriptions->get_head();
+	while (NULL != clnt_sub_info) {
+	    if (NULL != clnt_sub_info->sub_buf_info &&
+		clnt_sub_info->buffer_list_id >= 0) {
+		if (NULL != clnt_sub_info->sub_buf_info->sub_clnt_info) {
+		    clnt_sub_info->sub_buf_info->sub_clnt_info->
+			delete_node(clnt_sub_info->buffer_list_id);
+		    if (clnt_sub_info->sub_buf_info->sub_clnt_info->
+			list_size < 1) {
+			delete clnt_sub_info->sub_buf_info->sub_clnt_info;
+			clnt_sub_info->sub_buf_info->sub_clnt_info = NULL;
+			if (NULL != subscription_buffers
+			    && clnt_sub_info->sub_buf_info->list_id >= 0) {
+			    subscription_buffers->
+				delete_node(clnt_sub_info->sub_buf_info->
+				list_id);
+			    delete clnt_sub_info->sub_buf_info;
+			    clnt_sub_info->sub_buf_info = NULL;
 			}
 		    }
-		    handle_request(client_port_to_check);
+		    clnt_sub_info->sub_buf_info = NULL;
 		}
-		ready_descriptors--;
-	    } else {
-		FD_SET(client_port_to_check->socket_fd, &read_fd_set);
 	    }
-	    client_port_to_check =
-		(CLIENT_TCP_PORT *) client_ports->get_next();
-	}
-	if (FD_ISSET(connection_socket, &read_fd_set)
-	    && ready_descriptors > 0) {
-	    ready_descriptors--;
-	    socklen_t client_address_length;
-	    new_client_port = new CLIENT_TCP_PORT();
-	    client_address_length = sizeof(new_client_port->address);
-	    new_client_port->socket_fd = accept(connection_socket,
-		(struct sockaddr *)
-		&new_client_port->address, &client_address_length);
-	    current_clients++;
-	    if (current_clients > max_clients) {
-		max_clients = current_clients;
+	    delete clnt_sub_info;
+	    clnt_sub_info =
+		(TCP_CLIENT_SUBSCRIPTION_INFO *) clnt->subscriptions->
+		get_next();
+	}
+	delete clnt->subscriptions;
+	clnt->subscriptions = NULL;
+	recalculate_polling_interval();
+    }
+    if (clnt->threadId > 0 && clnt->blocking) {
+	blocking_thread_kill(clnt->threadId);
+    }
+    if (clnt->out_len > 0) {
+	pending_output--;
+    }
+    if (clnt->socket_fd >= 0) {
+	memset(&ev, 0, sizeof(ev));
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, clnt->socket_fd, &ev);
+	close(clnt->socket_fd);
+	clnt->socket_fd = -1;
+    }
+    current_clients--;
+    client_ports->delete_node(clnt->list_id);
+    delete clnt;
+}
+
+/* Replies are collected per client and written out together at the end
+   of each pass through the event loop, so a client that sends several
+   requests at once, or that gets several subscription updates, costs
+   one send() instead of one per reply. */
+int CMS_SERVER_REMOTE_TCP_PORT::queue_reply(CLIENT_TCP_PORT * clnt,
+    const void *data, long size)
+{
+    if (clnt->closing || clnt->socket_fd < 0) {
+	return -1;
+    }
+    if (size <= 0) {
+	return 0;
+    }
+    if (clnt->out_len + size > clnt->out_size) {
+	if (clnt->out_len + size > TCPSVR_MAX_PENDING_OUTPUT) {
+	    rcs_print_error
+		("Client on %s is not reading its replies - closing connection(%d)\n",
+		inet_ntoa(clnt->address.sin_addr), clnt->socket_fd);
+	    clnt->closing = 1;
+	    return -1;
+	}
+	long new_size = clnt->out_size > 0 ? clnt->out_size : 0x2000;
+	while (new_size < clnt->out_len + size) {
+	    new_size *= 2;
+	}
+	char *new_buf = (char *) realloc(clnt->out_buf, new_size);
+	if (NULL == new_buf) {
+	    rcs_print_error("Can not allocate %ld bytes for replies.\n",
+		new_size);
+	    return -1;
+	}
+	clnt->out_buf = new_buf;
+	clnt->out_size = new_size;
+    }
+    if (0 == clnt->out_len) {
+	pending_output++;
+    }
+    memcpy(clnt->out_buf + clnt->out_len, data, size);
+    clnt->out_len += size;
+    return size;
+}
+
+int CMS_SERVER_REMOTE_TCP_PORT::queue_read_reply(CLIENT_TCP_PORT * clnt,
+    long serial_number, REMOTE_READ_REPLY * read_reply,
+    CMS_SERVER * server, long buffer_number, long last_id_read)
+{
+    char header[20];
+    if (read_reply->size > 0 && NULL != read_reply->data) {
+	CMS_SERVER_LOCAL_PORT *local_port =
+	    server->find_local_port(buffer_number);
+	if (NULL != local_port && NULL != local_port->cms &&
+	    local_port->cms->delta_keyframe_interval > 0) {
+	    return queue_delta_reply(clnt, serial_number, read_reply,
+		buffer_number, last_id_read,
+		local_port->cms->delta_keyframe_interval);
+	}
+    }
+    putbe32(header, serial_number);
+    putbe32(header + 4, read_reply->status);
+    putbe32(header + 8, read_reply->size);
+    putbe32(header + 12, read_reply->write_id);
+    putbe32(header + 16, read_reply->was_read);
+    if (queue_reply(clnt, header, 20) < 0) {
+	return -1;
+    }
+    if (read_reply->size > 0) {
+	return queue_reply(clnt, read_reply->data, read_reply->size);
+    }
+    return 0;
+}
+
+/* Sends a read reply from a buffer with the delta option. If the client
+   still has the last message this client was sent from the buffer, only
+   the ranges that have changed since are sent; otherwise, and every
+   keyframe_interval replies, the whole message is. A last_id_read of -1
+   means the reply was not asked for (a subscription), so the client is
+   taken to have everything it was sent; a reply that could not be
+   queued, or a copy of it that could not be kept, makes the next one
+   whole. */
+int CMS_SERVER_REMOTE_TCP_PORT::queue_delta_reply(CLIENT_TCP_PORT * clnt,
+    long serial_number, REMOTE_READ_REPLY * read_reply,
+    long buffer_number, long last_id_read, long keyframe_interval)
+{
+    char header[20];
+    long delta_size = -1;
+    const void *body;
+    long body_size;
+    TCP_DELTA_BASE *base = NULL;
+
+    if (NULL == clnt->delta_bases) {
+	clnt->delta_bases = new LinkedList();
+    }
+    base = (TCP_DELTA_BASE *) clnt->delta_bases->get_head();
+    while (NULL != base && base->buffer_number != buffer_number) {
+	base = (TCP_DELTA_BASE *) clnt->delta_bases->get_next();
+    }
+    if (NULL == base) {
+	base = new TCP_DELTA_BASE();
+	base->buffer_number = buffer_number;
+	clnt->delta_bases->store_at_tail(base, sizeof(*base), 0);
+    }
+
+    if (base->valid && base->size == read_reply->size &&
+	read_reply->size > 16 &&
+	(last_id_read == -1 || last_id_read == base->write_id) &&
+	base->replies_since_keyframe + 1 < keyframe_interval) {
+	if (delta_buf_size < read_reply->size) {
+	    char *new_buf = (char *) realloc(delta_buf, read_reply->size);
+	    if (NULL != new_buf) {
+		delta_buf = new_buf;
+		delta_buf_size = read_reply->size;
 	    }
-	    if (new_client_port->socket_fd < 0) {
-		rcs_print_error("server: accept error -- %d %s \n", errno,
-		    strerror(errno));
+	}
+	if (delta_buf_size >= read_reply->size) {
+	    putbe32(delta_buf, (uint32_t) base->write_id);
+	    putbe32(delta_buf + 4, (uint32_t) read_reply->size);
+	    delta_size = tcpsvr_encode_delta((char *) base->data,
+		(char *) read_reply->data, read_reply->size, delta_buf + 8,
+		read_reply->size - 8);
+	}
+    }
+
+    putbe32(header, serial_number);
+    putbe32(header + 4, read_reply->status);
+    putbe32(header + 12, read_reply->write_id);
+    putbe32(header + 16, read_reply->was_read);
+    if (delta_size >= 0) {
+	putbe32(header + 8, (uint32_t) (delta_size + 8) |
+	    REMOTE_CMS_DELTA_REPLY);
+	body = delta_buf;
+	body_size = delta_size + 8;
+    } else {
+	putbe32(header + 8, read_reply->size);
+	body = read_reply->data;
+	body_size = read_reply->size;
+    }
+    if (queue_reply(clnt, header, 20) < 0) {
+	/* The client never gets this message, so the next one can't be a
+	   delta against it. */
+	base->valid = 0;
+	return -1;
+    }
+    if (queue_reply(clnt, body, body_size) < 0) {
+	/* A header without its message leaves the client unable to read
+	   anything after it. */
+	base->valid = 0;
+	clnt->closing = 1;
+	return -1;
+    }
+    if (delta_size >= 0) {
+	base->replies_since_keyframe++;
+    } else {
+	base->replies_since_keyframe = 0;
+    }
+
+    if (base->data_size < read_reply->size) {
+	void *new_data = realloc(base->data, read_reply->size);
+	if (NULL == new_data) {
+	    base->valid = 0;
+	    return 0;
+	}
+	base->data = new_data;
+	base->data_size = read_reply->size;
+    }
+    memcpy(base->data, read_reply->data, read_reply->size);
+    base->size = read_reply->size;
+    base->write_id = read_reply->write_id;
+    base->valid = 1;
+    return 0;
+}
+
+/* Used when a reply is sent some other way, so that the next one from
+   the buffer is sent whole. */
+void CMS_SERVER_REMOTE_TCP_PORT::forget_delta_base(CLIENT_TCP_PORT * clnt,
+    long buffer_number)
+{
+    if (NULL == clnt->delta_bases) {
+	return;
+    }
+    TCP_DELTA_BASE *base = (TCP_DELTA_BASE *) clnt->delta_bases->get_head();
+    while (NULL != base) {
+	if (base->buffer_number == buffer_number) {
+	    base->valid = 0;
+	}
+	base = (TCP_DELTA_BASE *) clnt->delta_bases->get_next();
+    }
+}
+
+/* Writes as much of the client's queued output as the socket will take
+   without blocking, and asks for EPOLLOUT to finish the rest. */
+int CMS_SERVER_REMOTE_TCP_PORT::flush_client(CLIENT_TCP_PORT * clnt)
+{
+    struct epoll_event ev;
+    long nwritten;
+    int retval = 0;
+
+    while (clnt->out_sent < clnt->out_len) {
+	nwritten = send(clnt->socket_fd, clnt->out_buf + clnt->out_sent,
+	    clnt->out_len - clnt->out_sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (nwritten < 0) {
+	    if (errno == EINTR) {
 		continue;
 	    }
-	    rcs_print_debug(PRINT_SOCKET_CONNECT,
-		"Socket opened by host with IP address %s.\n",
-		inet_ntoa(new_client_port->address.sin_addr));
-	    new_client_port->serial_number = 0;
-	    new_client_port->blocking = 0;
-	    if (NULL != client_ports) {
-		client_ports->store_at_tail(new_client_port,
-		    sizeof(new_client_port), 0);
-	    }
-	    if (maxfdpl < new_client_port->socket_fd + 1) {
-		maxfdpl = new_client_port->socket_fd + 1;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+		if (!clnt->waiting_for_write) {
+		    memset(&ev, 0, sizeof(ev));
+		    ev.events = EPOLLIN | EPOLLOUT;
+		    ev.data.ptr = clnt;
+		    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, clnt->socket_fd, &ev);
+		    clnt->waiting_for_write = 1;
+		}
+		return 0;
 	    }
-	    FD_SET(new_client_port->socket_fd, &read_fd_set);
-	} else {
-	    FD_SET(connection_socket, &read_fd_set);
+	    /* EPIPE, ECONNRESET and the like: the client is gone, and the
+	       rest of its replies can never be sent. */
+	    rcs_print_error("Send error: %d = %s\n", errno, strerror(errno));
+	    clnt->errors++;
+	    clnt->closing = 1;
+	    retval = -1;
+	    break;
 	}
-	if (0 != ready_descriptors) {
-	    rcs_print_error("%d descriptors ready but not serviced.\n",
-		ready_descriptors);
+	clnt->out_sent += nwritten;
+    }
+    if (clnt->out_len > 0) {
+	pending_output--;
+    }
+    clnt->out_len = 0;
+    clnt->out_sent = 0;
+    if (clnt->waiting_for_write) {
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = clnt;
+	epoll_ctl(epoll_fd, EPOLL_CTL_MOD, clnt->socket_fd, &ev);
+	clnt->waiting_for_write = 0;
+    }
+    return retval;
+}
+
+void CMS_SERVER_REMOTE_TCP_PORT::flush_clients()
+{
+    if (pending_output < 1) {
+	return;
+    }
+    CLIENT_TCP_PORT *clnt = (CLIENT_TCP_PORT *) client_ports->get_head();
+    while (NULL != clnt) {
+	if (!clnt->closing && clnt->out_len > 0 && !clnt->waiting_for_write) {
+	    flush_client(clnt);
 	}
-	update_subscriptions();
+	if (clnt->closing) {
+	    close_client(clnt);
+	}
+	clnt = (CLIENT_TCP_PORT *) client_ports->get_next();
     }
 }
 
+/* Reads of a buffer that has not been written since another client read
+   it in this pass of the event loop get a copy of that reply, instead of
+   reading and encoding the buffer again. The more clients there are, the
+   more their requests bunch up and the more reads are shared. */
+REMOTE_READ_REPLY *CMS_SERVER_REMOTE_TCP_PORT::shared_read(CMS_SERVER *
+    server, REMOTE_READ_REQUEST * req)
+{
+    REMOTE_READ_REPLY *read_reply;
+    TCP_READ_CACHE_ENTRY *entry = NULL;
+
+    /* Permissions and diagnostics are kept per request, and each reader
+       of a queue must get a message of its own. */
+    if (server->using_passwd_file || server->diag_enabled) {
+	return (REMOTE_READ_REPLY *) server->process_request(req);
+    }
+    CMS_SERVER_LOCAL_PORT *local_port =
+	server->find_local_port(req->buffer_number);
+    if (NULL == local_port || NULL == local_port->cms
+	|| local_port->cms->queuing_enabled) {
+	return (REMOTE_READ_REPLY *) server->process_request(req);
+    }
+
+    if (NULL == read_cache) {
+	read_cache = new LinkedList();
+    }
+    entry = (TCP_READ_CACHE_ENTRY *) read_cache->get_head();
+    while (NULL != entry) {
+	if (entry->buffer_number == req->buffer_number &&
+	    entry->subdiv == req->subdiv &&
+	    entry->access_type == req->access_type) {
+	    break;
+	}
+	entry = (TCP_READ_CACHE_ENTRY *) read_cache->get_next();
+    }
+    if (NULL != entry && entry->generation == read_cache_generation) {
+	if (req->last_id_read == entry->reply.write_id) {
+	    old_read_reply.status = CMS_READ_OLD;
+	    old_read_reply.size = 0;
+	    old_read_reply.data = NULL;
+	    old_read_reply.write_id = req->last_id_read;
+	    old_read_reply.was_read = 1;
+	    return &old_read_reply;
+	}
+	return &entry->reply;
+    }
+
+    read_reply = (REMOTE_READ_REPLY *) server->process_request(req);
+    if (NULL == read_reply || read_reply->status != CMS_READ_OK
+	|| read_reply->size <= 0 || NULL == read_reply->data) {
+	return read_reply;
+    }
+    if (NULL == entry) {
+	entry = new TCP_READ_CACHE_ENTRY();
+	entry->buffer_number = req->buffer_number;
+	entry->subdiv = req->subdiv;
+	entry->access_type = req->access_type;
+	read_cache->store_at_tail(entry, sizeof(*entry), 0);
+    }
+    if (entry->data_size < read_reply->size) {
+	void *new_data = realloc(entry->reply.data, read_reply->size);
+	if (NULL == new_data) {
+	    entry->generation = -1;
+	    return read_reply;
+	}
+	entry->reply.data = new_data;
+	entry->data_size = read_reply->size;
+    }
+    memcpy(entry->reply.data, read_reply->data, read_reply->size);
+    entry->reply.status = read_reply->status;
+    entry->reply.size = read_reply->size;
+    entry->reply.write_id = read_reply->write_id;
+    entry->reply.was_read = read_reply->was_read;
+    entry->generation = read_cache_generation;
+    return read_reply;
+}
+
 static int tcpsvr_handle_blocking_request_sigint_count = 0;
 static int tcpsvr_last_sig = 0;
 
@@ -508,17 +948,6 @@ void tcpsvr_handle_blocking_request_sigint_handler(int sig)
     tcpsvr_handle_blocking_request_sigint_count++;
 }
 
-static void putbe32(char *addr, uint32_t val) {
-    val = htonl(val);
-    memcpy(addr, &val, sizeof(val));
-}
-
-static uint32_t getbe32(char *addr) {
-    uint32_t val;
-    memcpy(&val, addr, sizeof(val));
-    return ntohl(val);
-}
-
 #if defined(POSIX_THREADS) || defined(NO_THREADS)
 void *tcpsvr_handle_blocking_request(void *_req)
 {
@@ -640,7 +1069,6 @@ void *tcpsvr_handle_blocking_request(void *_req)
 void CMS_SERVER_REMOTE_TCP_PORT::handle_request(CLIENT_TCP_PORT *
     _client_tcp_port)
 {
-    CLIENT_TCP_PORT *client_port_to_check = NULL;
     pid_t pid = getpid();
     pid_t tid = 0;
     CMS_SERVER *server;
@@ -659,23 +1087,11 @@ void CMS_SERVER_REMOTE_TCP_PORT::handle_request(CLIENT_TCP_PORT *
     if (_client_tcp_port->errors >= _client_tcp_port->max_errors) {
 	rcs_print_error("Too many errors - closing connection(%d)\n",
 	    _client_tcp_port->socket_fd);
-	client_port_to_check = (CLIENT_TCP_PORT *) client_ports->get_head();
-	while (NULL != client_port_to_check) {
-	    if (client_port_to_check->socket_fd ==
-		_client_tcp_port->socket_fd) {
-		delete client_port_to_check;
-		client_ports->delete_current_node();
-	    }
-	    client_port_to_check =
-		(CLIENT_TCP_PORT *) client_ports->get_next();
-	}
-	close(_client_tcp_port->socket_fd);
-	current_clients--;
-	FD_CLR(_client_tcp_port->socket_fd, &read_fd_set);
-	_client_tcp_port->socket_fd = -1;
+	_client_tcp_port->closing = 1;
+	return;
     }
 
-    if (recvn(_client_tcp_port->socket_fd, temp_buffer, 20, 0, -1, NULL) < 0) {
+    if (recv_request(_client_tcp_port, temp_buffer, 20) < 0) {
 	rcs_print_error("Can not read from client port (%d) from %s\n",
 	    _client_tcp_port->socket_fd,
 	    inet_ntoa(_client_tcp_port->address.sin_addr));
@@ -692,8 +1108,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::handle_request(CLIENT_TCP_PORT *
 	_client_tcp_port->errors++;
     }
     _client_tcp_port->serial_number++;
-    request_type = ntohl(*((u_long *) temp_buffer + 1));
-    buffer_number = ntohl(*((u_long *) temp_buffer + 2));
+    request_type = getbe32(temp_buffer + 4);
+    buffer_number = getbe32(temp_buffer + 8);
 
     rcs_print_debug(PRINT_ALL_SOCKET_REQUESTS,
 	"TCPSVR request recieved: fd = %d, serial_number=%ld, request_type=%ld, buffer_number=%ld\n",
@@ -729,7 +1145,6 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
     long request_type, long buffer_number, long received_serial_number)
 {
     int total_subdivisions = 1;
-    CLIENT_TCP_PORT *client_port_to_check = NULL;
     switch (request_type) {
     case REMOTE_CMS_SET_DIAG_INFO_REQUEST_TYPE:
 	{
@@ -737,9 +1152,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		_client_tcp_port->diag_info =
 		    new REMOTE_SET_DIAG_INFO_REQUEST();
 	    }
-	    if (recvn
-		(_client_tcp_port->socket_fd, server->set_diag_info_buf, 68,
-		    0, -1, NULL) < 0) {
+	    if (recv_request(_client_tcp_port, server->set_diag_info_buf,
+		    68) < 0) {
 		rcs_print_error
 		    ("Can not read from client port (%d) from %s\n",
 		    _client_tcp_port->socket_fd,
@@ -754,9 +1168,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    memcpy(_client_tcp_port->diag_info->host_sysinfo,
 		server->set_diag_info_buf + 16, 32);
 	    _client_tcp_port->diag_info->pid =
-		htonl(*((u_long *) (server->set_diag_info_buf + 48)));
+		getbe32(server->set_diag_info_buf + 48);
 	    _client_tcp_port->diag_info->c_num =
-		htonl(*((u_long *) (server->set_diag_info_buf + 52)));
+		getbe32(server->set_diag_info_buf + 52);
 	    memcpy(&(_client_tcp_port->diag_info->rcslib_ver),
 		server->set_diag_info_buf + 56, 8);
 	    _client_tcp_port->diag_info->reverse_flag =
@@ -780,9 +1194,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    if (NULL == diagreply) {
 		putbe32(temp_buffer, _client_tcp_port->serial_number);
 		putbe32(temp_buffer+4, CMS_SERVER_SIDE_ERROR);
-		if (sendn
-		    (_client_tcp_port->socket_fd, temp_buffer, 24, 0,
-			dtimeout) < 0) {
+		if (queue_reply(_client_tcp_port, temp_buffer, 24) < 0) {
 		    _client_tcp_port->errors++;
 		}
 		return;
@@ -790,9 +1202,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    if (NULL == diagreply->cdi) {
 		putbe32(temp_buffer, _client_tcp_port->serial_number);
 		putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
-		if (sendn
-		    (_client_tcp_port->socket_fd, temp_buffer, 24, 0,
-			dtimeout) < 0) {
+		if (queue_reply(_client_tcp_port, temp_buffer, 24) < 0) {
 		    _client_tcp_port->errors++;
 		}
 		return;
@@ -824,8 +1234,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		    dpi_offset += 16;
 		    memcpy(temp_buffer + dpi_offset, dpi->host_sysinfo, 32);
 		    dpi_offset += 32;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->pid);
+		    putbe32(temp_buffer + dpi_offset, dpi->pid);
 		    dpi_offset += 4;
 		    if (_client_tcp_port->diag_info->reverse_flag ==
 			0x44332211) {
@@ -838,23 +1247,17 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 			    8);
 		    }
 		    dpi_offset += 8;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->access_type);
+		    putbe32(temp_buffer + dpi_offset, dpi->access_type);
 		    dpi_offset += 4;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->msg_id);
+		    putbe32(temp_buffer + dpi_offset, dpi->msg_id);
 		    dpi_offset += 4;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->msg_size);
+		    putbe32(temp_buffer + dpi_offset, dpi->msg_size);
 		    dpi_offset += 4;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->msg_type);
+		    putbe32(temp_buffer + dpi_offset, dpi->msg_type);
 		    dpi_offset += 4;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->number_of_accesses);
+		    putbe32(temp_buffer + dpi_offset, dpi->number_of_accesses);
 		    dpi_offset += 4;
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(dpi->number_of_new_messages);
+		    putbe32(temp_buffer + dpi_offset, dpi->number_of_new_messages);
 		    dpi_offset += 4;
 		    if (_client_tcp_port->diag_info->reverse_flag ==
 			0x44332211) {
@@ -924,24 +1327,20 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		    dpi_offset += 8;
 		    int is_last_writer =
 			(dpi == diagreply->cdi->last_writer_dpi);
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(is_last_writer);
+		    putbe32(temp_buffer + dpi_offset, is_last_writer);
 		    dpi_offset += 4;
 		    int is_last_reader =
 			(dpi == diagreply->cdi->last_reader_dpi);
-		    *((u_long *) ((char *) temp_buffer + dpi_offset)) =
-			htonl(is_last_reader);
+		    putbe32(temp_buffer + dpi_offset, is_last_reader);
 		    dpi_offset += 4;
 		    dpi =
 			(CMS_DIAG_PROC_INFO *) diagreply->cdi->dpis->
 			get_next();
 		}
 	    }
-	    *((u_long *) temp_buffer + 6) = htonl(dpi_count);
-	    *((u_long *) temp_buffer + 7) = htonl(dpi_offset);
-	    if (sendn
-		(_client_tcp_port->socket_fd, temp_buffer, dpi_offset, 0,
-		    dtimeout) < 0) {
+	    putbe32(temp_buffer + 24, dpi_count);
+	    putbe32(temp_buffer + 28, dpi_offset);
+	    if (queue_reply(_client_tcp_port, temp_buffer, dpi_offset) < 0) {
 		_client_tcp_port->errors++;
 		return;
 	    }
@@ -961,18 +1360,14 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		putbe32(temp_buffer, _client_tcp_port->serial_number);
 		putbe32(temp_buffer + 4, namereply->status);
 		strncpy(temp_buffer + 8, namereply->name, 31);
-		if (sendn
-		    (_client_tcp_port->socket_fd, temp_buffer, 40, 0,
-			dtimeout) < 0) {
+		if (queue_reply(_client_tcp_port, temp_buffer, 40) < 0) {
 		    _client_tcp_port->errors++;
 		    return;
 		}
 	    } else {
 		putbe32(temp_buffer, _client_tcp_port->serial_number);
 		putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
-		if (sendn
-		    (_client_tcp_port->socket_fd, temp_buffer, 40, 0,
-			dtimeout) < 0) {
+		if (queue_reply(_client_tcp_port, temp_buffer, 40) < 0) {
 		    _client_tcp_port->errors++;
 		    return;
 		}
@@ -996,19 +1391,16 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 #endif
 	    blocking_read_req->buffer_number = buffer_number;
 	    blocking_read_req->access_type =
-		ntohl(*((u_long *) temp_buffer + 3));
+		getbe32(temp_buffer + 12);
 	    blocking_read_req->last_id_read =
-		ntohl(*((u_long *) temp_buffer + 4));
+		getbe32(temp_buffer + 16);
 	    total_subdivisions = 1;
 	    if (max_total_subdivisions > 1) {
 		total_subdivisions =
 		    server->get_total_subdivisions(buffer_number);
 	    }
 	    if (total_subdivisions > 1) {
-		if (recvn
-		    (_client_tcp_port->socket_fd,
-			(char *) (((u_long *) temp_buffer) + 5), 8, 0, -1,
-			NULL) < 0) {
+		if (recv_request(_client_tcp_port, temp_buffer + 20, 8) < 0) {
 		    rcs_print_error
 			("Can not read from client port (%d) from %s\n",
 			_client_tcp_port->socket_fd,
@@ -1017,12 +1409,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		    return;
 		}
 		blocking_read_req->subdiv =
-		    ntohl(*((u_long *) temp_buffer + 6));
+		    getbe32(temp_buffer + 24);
 	    } else {
-		if (recvn
-		    (_client_tcp_port->socket_fd,
-			(char *) (((u_long *) temp_buffer) + 5), 4, 0, -1,
-			NULL) < 0) {
+		if (recv_request(_client_tcp_port, temp_buffer + 20, 4) < 0) {
 		    rcs_print_error
 			("Can not read from client port (%d) from %s\n",
 			_client_tcp_port->socket_fd,
@@ -1032,11 +1421,24 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		}
 	    }
 	    blocking_read_req->timeout_millis =
-		ntohl(*((u_long *) temp_buffer + 5));
+		getbe32(temp_buffer + 20);
 	    blocking_read_req->server = server;
 	    blocking_read_req->remport = this;
 	    _client_tcp_port->blocking = 1;
 	    blocking_read_req->_client_tcp_port = _client_tcp_port;
+	    forget_delta_base(_client_tcp_port, buffer_number);
+	    /* The reply will be sent by the handler, so anything still
+	       queued for this client has to go out ahead of it. */
+	    if (_client_tcp_port->out_len > _client_tcp_port->out_sent) {
+		if (sendn(_client_tcp_port->socket_fd,
+			_client_tcp_port->out_buf + _client_tcp_port->out_sent,
+			_client_tcp_port->out_len - _client_tcp_port->out_sent,
+			0, dtimeout) < 0) {
+		    _client_tcp_port->errors++;
+		}
+		_client_tcp_port->out_sent = _client_tcp_port->out_len;
+		flush_client(_client_tcp_port);
+	    }
 #ifdef POSIX_THREADS
 	    int thr_retval = pthread_create(&(_client_tcp_port->threadId),	/* ptr to new-thread-id */
 		NULL,		// pthread_attr_t *, ptr to attributes
@@ -1049,15 +1451,12 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		    thr_retval);
 		rcs_print_error("pthread_create error: %d %s\n", errno,
 		    strerror(errno));
-		*((u_long *) temp_buffer) =
-		    htonl(_client_tcp_port->serial_number);
-		*((u_long *) temp_buffer + 1) =
-		    htonl((unsigned long) CMS_SERVER_SIDE_ERROR);
+		putbe32(temp_buffer, _client_tcp_port->serial_number);
+		putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
 		putbe32(temp_buffer + 8, 0);	/* size */
 		putbe32(temp_buffer + 12, 0);	/* write_id */
 		putbe32(temp_buffer + 16, 0);	/* was_read */
-		sendn(_client_tcp_port->socket_fd, temp_buffer, 20, 0,
-		    dtimeout);
+		queue_reply(_client_tcp_port, temp_buffer, 20);
 		return;
 	    }
 #else
@@ -1079,8 +1478,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		putbe32(temp_buffer + 8, 0);
 		putbe32(temp_buffer + 12, 0);
 		putbe32(temp_buffer + 16, 0);
-		sendn(_client_tcp_port->socket_fd, temp_buffer, 20, 0,
-		    dtimeout);
+		queue_reply(_client_tcp_port, temp_buffer, 20);
 		break;
 
 	    default:		// parent;
@@ -1090,14 +1488,12 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 #else
 	    rcs_print_error
 		("Blocking read not supported on this platform.\n");
-	    *((u_long *) temp_buffer) =
-		htonl(_client_tcp_port->serial_number);
-	    *((u_long *) temp_buffer + 1) =
-		htonl((unsigned long) CMS_SERVER_SIDE_ERROR);
+	    putbe32(temp_buffer, _client_tcp_port->serial_number);
+	    putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
 	    putbe32(temp_buffer + 8, 0);	/* size */
 	    putbe32(temp_buffer + 12, 0);	/* write_id */
 	    putbe32(temp_buffer + 16, 0);	/* was_read */
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 20, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 20);
 	    return;
 
 #endif
@@ -1108,19 +1504,14 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 
     case REMOTE_CMS_READ_REQUEST_TYPE:
 	server->read_req.buffer_number = buffer_number;
-	server->read_req.access_type = ntohl(*((u_long *) temp_buffer + 3));
-	server->read_req.last_id_read = ntohl(*((u_long *) temp_buffer + 4));
-	server->read_reply =
-	    (REMOTE_READ_REPLY *) server->process_request(&server->read_req);
+	server->read_req.access_type = getbe32(temp_buffer + 12);
+	server->read_req.last_id_read = getbe32(temp_buffer + 16);
 	if (max_total_subdivisions > 1) {
 	    total_subdivisions =
 		server->get_total_subdivisions(buffer_number);
 	}
 	if (total_subdivisions > 1) {
-	    if (recvn
-		(_client_tcp_port->socket_fd,
-		    (char *) (((u_long *) temp_buffer) + 5), 4, 0, -1,
-		    NULL) < 0) {
+	    if (recv_request(_client_tcp_port, temp_buffer + 20, 4) < 0) {
 		rcs_print_error
 		    ("Can not read from client port (%d) from %s\n",
 		    _client_tcp_port->socket_fd,
@@ -1128,10 +1519,11 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		_client_tcp_port->errors++;
 		return;
 	    }
-	    server->read_req.subdiv = ntohl(*((u_long *) temp_buffer + 5));
+	    server->read_req.subdiv = getbe32(temp_buffer + 20);
 	} else {
 	    server->read_req.subdiv = 0;
 	}
+	server->read_reply = shared_read(server, &server->read_req);
 	if (NULL == server->read_reply) {
 	    rcs_print_error("Server could not process request.\n");
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
@@ -1139,56 +1531,28 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    putbe32(temp_buffer + 8, 0);
 	    putbe32(temp_buffer + 12, 0);
 	    putbe32(temp_buffer + 16, 0);
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 20, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 20);
 	    return;
 	}
-	putbe32(temp_buffer, _client_tcp_port->serial_number);
-	putbe32(temp_buffer + 4, server->read_reply->status);
-	putbe32(temp_buffer + 8, server->read_reply->size);
-	putbe32(temp_buffer + 12, server->read_reply->write_id);
-	putbe32(temp_buffer + 16, server->read_reply->was_read);
-	if (server->read_reply->size < (0x2000 - 20)
-	    && server->read_reply->size > 0) {
-	    memcpy(temp_buffer + 20, server->read_reply->data,
-		server->read_reply->size);
-	    if (sendn
-		(_client_tcp_port->socket_fd, temp_buffer,
-		    20 + server->read_reply->size, 0, dtimeout) < 0) {
-		_client_tcp_port->errors++;
-		return;
-	    }
-	} else {
-	    if (sendn
-		(_client_tcp_port->socket_fd, temp_buffer, 20, 0,
-		    dtimeout) < 0) {
-		_client_tcp_port->errors++;
-		return;
-	    }
-	    if (server->read_reply->size > 0) {
-		if (sendn
-		    (_client_tcp_port->socket_fd, server->read_reply->data,
-			server->read_reply->size, 0, dtimeout) < 0) {
-		    _client_tcp_port->errors++;
-		    return;
-		}
-	    }
+	if (queue_read_reply(_client_tcp_port,
+		_client_tcp_port->serial_number, server->read_reply, server,
+		buffer_number, server->read_req.last_id_read) < 0) {
+	    _client_tcp_port->errors++;
+	    return;
 	}
 	break;
 
     case REMOTE_CMS_WRITE_REQUEST_TYPE:
 	server->write_req.buffer_number = buffer_number;
-	server->write_req.access_type = ntohl(*((u_long *) temp_buffer + 3));
-	server->write_req.size = ntohl(*((u_long *) temp_buffer + 4));
+	server->write_req.access_type = getbe32(temp_buffer + 12);
+	server->write_req.size = getbe32(temp_buffer + 16);
 	total_subdivisions = 1;
 	if (max_total_subdivisions > 1) {
 	    total_subdivisions =
 		server->get_total_subdivisions(buffer_number);
 	}
 	if (total_subdivisions > 1) {
-	    if (recvn
-		(_client_tcp_port->socket_fd,
-		    (char *) (((u_long *) temp_buffer) + 5), 4, 0, -1,
-		    NULL) < 0) {
+	    if (recv_request(_client_tcp_port, temp_buffer + 20, 4) < 0) {
 		rcs_print_error
 		    ("Can not read from client port (%d) from %s\n",
 		    _client_tcp_port->socket_fd,
@@ -1196,14 +1560,13 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		_client_tcp_port->errors++;
 		return;
 	    }
-	    server->write_req.subdiv = ntohl(*((u_long *) temp_buffer + 5));
+	    server->write_req.subdiv = getbe32(temp_buffer + 20);
 	} else {
 	    server->write_req.subdiv = 0;
 	}
 	if (server->write_req.size > 0) {
-	    if (recvn
-		(_client_tcp_port->socket_fd, server->write_req.data,
-		    server->write_req.size, 0, -1, NULL) < 0) {
+	    if (recv_request(_client_tcp_port, server->write_req.data,
+		    server->write_req.size) < 0) {
 		_client_tcp_port->errors++;
 		return;
 	    }
@@ -1211,22 +1574,20 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	server->write_reply =
 	    (REMOTE_WRITE_REPLY *) server->process_request(&server->
 	    write_req);
+	read_cache_generation++;
 	if (((min_compatible_version < 2.58) && (min_compatible_version > 1e-6)) || server->write_reply->confirm_write) {
 	    if (NULL == server->write_reply) {
 		rcs_print_error("Server could not process request.\n");
 		putbe32(temp_buffer, _client_tcp_port->serial_number);
 		putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
 		putbe32(temp_buffer + 8, 0);	/* was_read */
-		sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0,
-		    dtimeout);
+		queue_reply(_client_tcp_port, temp_buffer, 12);
 		return;
 	    }
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
 	    putbe32(temp_buffer + 4, server->write_reply->status);
 	    putbe32(temp_buffer + 8, server->write_reply->was_read);
-	    if (sendn
-		(_client_tcp_port->socket_fd, temp_buffer, 12, 0,
-		    dtimeout) < 0) {
+	    if (queue_reply(_client_tcp_port, temp_buffer, 12) < 0) {
 		_client_tcp_port->errors++;
 	    }
 	} else {
@@ -1239,7 +1600,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
     case REMOTE_CMS_CHECK_IF_READ_REQUEST_TYPE:
 	server->check_if_read_req.buffer_number = buffer_number;
 	server->check_if_read_req.subdiv =
-	    ntohl(*((u_long *) temp_buffer + 3));
+	    getbe32(temp_buffer + 12);
 	server->check_if_read_reply =
 	    (REMOTE_CHECK_IF_READ_REPLY *) server->process_request(&server->
 	    check_if_read_req);
@@ -1248,15 +1609,13 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
 	    putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
 	    putbe32(temp_buffer + 8, 0);	/* was_read */
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 12);
 	    return;
 	}
 	putbe32(temp_buffer, _client_tcp_port->serial_number);
-	*((u_long *) temp_buffer + 1) =
-	    htonl(server->check_if_read_reply->status);
-	*((u_long *) temp_buffer + 2) =
-	    htonl(server->check_if_read_reply->was_read);
-	if (sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout) <
+	putbe32(temp_buffer + 4, server->check_if_read_reply->status);
+	putbe32(temp_buffer + 8, server->check_if_read_reply->was_read);
+	if (queue_reply(_client_tcp_port, temp_buffer, 12) <
 	    0) {
 	    _client_tcp_port->errors++;
 	}
@@ -1265,7 +1624,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
     case REMOTE_CMS_GET_MSG_COUNT_REQUEST_TYPE:
 	server->get_msg_count_req.buffer_number = buffer_number;
 	server->get_msg_count_req.subdiv =
-	    ntohl(*((u_long *) temp_buffer + 3));
+	    getbe32(temp_buffer + 12);
 	server->get_msg_count_reply =
 	    (REMOTE_GET_MSG_COUNT_REPLY *) server->process_request(&server->
 	    get_msg_count_req);
@@ -1274,15 +1633,13 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
 	    putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
 	    putbe32(temp_buffer + 8, 0);	/* was_read */
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 12);
 	    return;
 	}
 	putbe32(temp_buffer, _client_tcp_port->serial_number);
-	*((u_long *) temp_buffer + 1) =
-	    htonl(server->get_msg_count_reply->status);
-	*((u_long *) temp_buffer + 2) =
-	    htonl(server->get_msg_count_reply->count);
-	if (sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout) <
+	putbe32(temp_buffer + 4, server->get_msg_count_reply->status);
+	putbe32(temp_buffer + 8, server->get_msg_count_reply->count);
+	if (queue_reply(_client_tcp_port, temp_buffer, 12) <
 	    0) {
 	    _client_tcp_port->errors++;
 	}
@@ -1291,7 +1648,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
     case REMOTE_CMS_GET_QUEUE_LENGTH_REQUEST_TYPE:
 	server->get_queue_length_req.buffer_number = buffer_number;
 	server->get_queue_length_req.subdiv =
-	    ntohl(*((u_long *) temp_buffer + 3));
+	    getbe32(temp_buffer + 12);
 	server->get_queue_length_reply =
 	    (REMOTE_GET_QUEUE_LENGTH_REPLY *) server->
 	    process_request(&server->get_queue_length_req);
@@ -1300,15 +1657,13 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
 	    putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
 	    putbe32(temp_buffer + 8, 0);	/* was_read */
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 12);
 	    return;
 	}
 	putbe32(temp_buffer, _client_tcp_port->serial_number);
-	*((u_long *) temp_buffer + 1) =
-	    htonl(server->get_queue_length_reply->status);
-	*((u_long *) temp_buffer + 2) =
-	    htonl(server->get_queue_length_reply->queue_length);
-	if (sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout) <
+	putbe32(temp_buffer + 4, server->get_queue_length_reply->status);
+	putbe32(temp_buffer + 8, server->get_queue_length_reply->queue_length);
+	if (queue_reply(_client_tcp_port, temp_buffer, 12) <
 	    0) {
 	    _client_tcp_port->errors++;
 	}
@@ -1317,7 +1672,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
     case REMOTE_CMS_GET_SPACE_AVAILABLE_REQUEST_TYPE:
 	server->get_space_available_req.buffer_number = buffer_number;
 	server->get_space_available_req.subdiv =
-	    ntohl(*((u_long *) temp_buffer + 3));
+	    getbe32(temp_buffer + 12);
 	server->get_space_available_reply =
 	    (REMOTE_GET_SPACE_AVAILABLE_REPLY *) server->
 	    process_request(&server->get_space_available_req);
@@ -1326,15 +1681,13 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
 	    putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
 	    putbe32(temp_buffer + 8, 0);	/* was_read */
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 12);
 	    return;
 	}
 	putbe32(temp_buffer, _client_tcp_port->serial_number);
-	*((u_long *) temp_buffer + 1) =
-	    htonl(server->get_space_available_reply->status);
-	*((u_long *) temp_buffer + 2) =
-	    htonl(server->get_space_available_reply->space_available);
-	if (sendn(_client_tcp_port->socket_fd, temp_buffer, 12, 0, dtimeout) <
+	putbe32(temp_buffer + 4, server->get_space_available_reply->status);
+	putbe32(temp_buffer + 8, server->get_space_available_reply->space_available);
+	if (queue_reply(_client_tcp_port, temp_buffer, 12) <
 	    0) {
 	    _client_tcp_port->errors++;
 	}
@@ -1342,20 +1695,21 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 
     case REMOTE_CMS_CLEAR_REQUEST_TYPE:
 	server->clear_req.buffer_number = buffer_number;
-	server->clear_req.subdiv = ntohl(*((u_long *) temp_buffer + 3));
+	server->clear_req.subdiv = getbe32(temp_buffer + 12);
 	server->clear_reply =
 	    (REMOTE_CLEAR_REPLY *) server->process_request(&server->
 	    clear_req);
+	read_cache_generation++;
 	if (NULL == server->clear_reply) {
 	    rcs_print_error("Server could not process request.\n");
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
 	    putbe32(temp_buffer + 4, CMS_SERVER_SIDE_ERROR);
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 8, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 8);
 	    return;
 	}
 	putbe32(temp_buffer, _client_tcp_port->serial_number);
 	putbe32(temp_buffer + 4, server->clear_reply->status);
-	if (sendn(_client_tcp_port->socket_fd, temp_buffer, 8, 0, dtimeout) <
+	if (queue_reply(_client_tcp_port, temp_buffer, 8) <
 	    0) {
 	    _client_tcp_port->errors++;
 	}
@@ -1367,30 +1721,12 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	break;
 
     case REMOTE_CMS_CLOSE_CHANNEL_REQUEST_TYPE:
-	client_port_to_check = (CLIENT_TCP_PORT *) client_ports->get_head();
-	while (NULL != client_port_to_check) {
-	    if (client_port_to_check->socket_fd ==
-		_client_tcp_port->socket_fd) {
-		break;
-	    }
-	    client_port_to_check =
-		(CLIENT_TCP_PORT *) client_ports->get_next();
-	}
-	FD_CLR(_client_tcp_port->socket_fd, &read_fd_set);
-	close(_client_tcp_port->socket_fd);
-	current_clients--;
-	if (NULL != _client_tcp_port->subscriptions) {
-	    remove_subscription_client(_client_tcp_port, buffer_number);
-	}
-	_client_tcp_port->socket_fd = -1;
-	delete _client_tcp_port;
-	client_ports->delete_current_node();
+	_client_tcp_port->closing = 1;
 	break;
 
     case REMOTE_CMS_GET_KEYS_REQUEST_TYPE:
 	server->get_keys_req.buffer_number = buffer_number;
-	if (recvn(_client_tcp_port->socket_fd,
-		server->get_keys_req.name, 16, 0, -1, NULL) < 0) {
+	if (recv_request(_client_tcp_port, server->get_keys_req.name, 16) < 0) {
 	    _client_tcp_port->errors++;
 	    return;
 	}
@@ -1403,7 +1739,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
 	    server->gen_random_key(((char *) temp_buffer) + 4, 2);
 	    server->gen_random_key(((char *) temp_buffer) + 12, 2);
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 20, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 20);
 	    return;
 	} else {
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
@@ -1412,20 +1748,18 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    memcpy(((char *) temp_buffer) + 12, server->get_keys_reply->key2,
 		8);
 	    /* successful ? */
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 20, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 20);
 	    return;
 	}
 	break;
 
     case REMOTE_CMS_LOGIN_REQUEST_TYPE:
 	server->login_req.buffer_number = buffer_number;
-	if (recvn(_client_tcp_port->socket_fd,
-		server->login_req.name, 16, 0, -1, NULL) < 0) {
+	if (recv_request(_client_tcp_port, server->login_req.name, 16) < 0) {
 	    _client_tcp_port->errors++;
 	    return;
 	}
-	if (recvn(_client_tcp_port->socket_fd,
-		server->login_req.passwd, 16, 0, -1, NULL) < 0) {
+	if (recv_request(_client_tcp_port, server->login_req.passwd, 16) < 0) {
 	    _client_tcp_port->errors++;
 	    return;
 	}
@@ -1436,13 +1770,13 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    rcs_print_error("Server could not process request.\n");
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
 	    putbe32(temp_buffer + 4, 0);	/* not successful */
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 8, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 8);
 	    return;
 	} else {
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
 	    putbe32(temp_buffer + 4, server->login_reply->success);
 	    /* successful ? */
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 8, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 8);
 	    return;
 	}
 	break;
@@ -1450,9 +1784,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
     case REMOTE_CMS_SET_SUBSCRIPTION_REQUEST_TYPE:
 	server->set_subscription_req.buffer_number = buffer_number;
 	server->set_subscription_req.subscription_type =
-	    ntohl(*((u_long *) temp_buffer + 3));
+	    getbe32(temp_buffer + 12);
 	server->set_subscription_req.poll_interval_millis =
-	    ntohl(*((u_long *) temp_buffer + 4));
+	    getbe32(temp_buffer + 16);
 	server->set_subscription_reply =
 	    (REMOTE_SET_SUBSCRIPTION_REPLY *) server->
 	    process_request(&server->set_subscription_req);
@@ -1460,14 +1794,16 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 	    rcs_print_error("Server could not process request.\n");
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
 	    putbe32(temp_buffer + 4, 0);	/* not successful */
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 8, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 8);
 	    return;
 	} else {
 	    if (server->set_subscription_reply->success) {
 		if (server->set_subscription_req.subscription_type ==
 		    CMS_POLLED_SUBSCRIPTION
 		    || server->set_subscription_req.subscription_type ==
-		    CMS_VARIABLE_SUBSCRIPTION) {
+		    CMS_VARIABLE_SUBSCRIPTION
+		    || server->set_subscription_req.subscription_type ==
+		    CMS_CHANGE_SUBSCRIPTION) {
 		    add_subscription_client(buffer_number,
 			server->set_subscription_req.
 			subscription_type,
@@ -1481,10 +1817,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::switch_function(CLIENT_TCP_PORT *
 		}
 	    }
 	    putbe32(temp_buffer, _client_tcp_port->serial_number);
-	    *((u_long *) temp_buffer + 1) =
-		htonl(server->set_subscription_reply->success);
+	    putbe32(temp_buffer + 4, server->set_subscription_reply->success);
 	    /* successful ? */
-	    sendn(_client_tcp_port->socket_fd, temp_buffer, 8, 0, dtimeout);
+	    queue_reply(_client_tcp_port, temp_buffer, 8);
 	    return;
 	}
 	break;
@@ -1549,7 +1884,8 @@ void CMS_SERVER_REMOTE_TCP_PORT::add_subscription_client(int buffer_number,
 	temp_clnt_info->subscription_list_id =
 	    clnt->subscriptions->store_at_tail(temp_clnt_info,
 	    sizeof(*temp_clnt_info), 0);
-	buf_info->sub_clnt_info->store_at_tail(temp_clnt_info,
+	temp_clnt_info->buffer_list_id =
+	    buf_info->sub_clnt_info->store_at_tail(temp_clnt_info,
 	    sizeof(*temp_clnt_info), 0);
     }
     temp_clnt_info->subscription_type = subscription_type;
@@ -1560,6 +1896,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::add_subscription_client(int buffer_number,
 void CMS_SERVER_REMOTE_TCP_PORT::remove_subscription_client(CLIENT_TCP_PORT *
     clnt, int buffer_number)
 {
+    if (NULL == clnt->subscriptions) {
+	return;
+    }
     TCP_CLIENT_SUBSCRIPTION_INFO *temp_clnt_info =
 	(TCP_CLIENT_SUBSCRIPTION_INFO *) clnt->subscriptions->get_head();
     while (temp_clnt_info != NULL) {
@@ -1567,7 +1906,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::remove_subscription_client(CLIENT_TCP_PORT *
 	    if (NULL != temp_clnt_info->sub_buf_info) {
 		if (NULL != temp_clnt_info->sub_buf_info->sub_clnt_info) {
 		    temp_clnt_info->sub_buf_info->sub_clnt_info->
-			delete_node(temp_clnt_info->subscription_list_id);
+			delete_node(temp_clnt_info->buffer_list_id);
 		    if (temp_clnt_info->sub_buf_info->sub_clnt_info->
 			list_size == 0) {
 			subscription_buffers->delete_node(temp_clnt_info->
@@ -1579,6 +1918,7 @@ void CMS_SERVER_REMOTE_TCP_PORT::remove_subscription_client(CLIENT_TCP_PORT *
 		    }
 		}
 	    }
+	    clnt->subscriptions->delete_current_node();
 	    delete temp_clnt_info;
 	    temp_clnt_info = NULL;
 	    break;
@@ -1592,7 +1932,12 @@ void CMS_SERVER_REMOTE_TCP_PORT::remove_subscription_client(CLIENT_TCP_PORT *
 void CMS_SERVER_REMOTE_TCP_PORT::recalculate_polling_interval()
 {
     int min_poll_interval_millis = 30000;
+    int watching_for_changes = 0;
     polling_enabled = 0;
+    if (NULL == subscription_buffers) {
+	current_poll_interval_millis = min_poll_interval_millis;
+	return;
+    }
     TCP_BUFFER_SUBSCRIPTION_INFO *buf_info =
 	(TCP_BUFFER_SUBSCRIPTION_INFO *) subscription_buffers->get_head();
     while (NULL != buf_info) {
@@ -1608,6 +1953,10 @@ void CMS_SERVER_REMOTE_TCP_PORT::recalculate_polling_interval()
 		    temp_clnt_info->poll_interval_millis;
 		polling_enabled = 1;
 	    }
+	    if (temp_clnt_info->subscription_type == CMS_CHANGE_SUBSCRIPTION) {
+		watching_for_changes = 1;
+		polling_enabled = 1;
+	    }
 	    temp_clnt_info = (TCP_CLIENT_SUBSCRIPTION_INFO *)
 		buf_info->sub_clnt_info->get_next();
 	}
@@ -1619,8 +1968,9 @@ void CMS_SERVER_REMOTE_TCP_PORT::recalculate_polling_interval()
     } else {
 	current_poll_interval_millis = ((int) (clk_tck() * 1000.0));
     }
-    select_timeout.tv_sec = current_poll_interval_millis / 1000;
-    select_timeout.tv_usec = (current_poll_interval_millis % 1000) * 1000;
+    if (watching_for_changes) {
+	current_poll_interval_millis = TCPSVR_CHANGE_WATCH_MILLIS;
+    }
     dtimeout = (current_poll_interval_millis + 10) * 1000.0;
     if (dtimeout < 0.5) {
 	dtimeout = 0.5;
@@ -1646,9 +1996,19 @@ void CMS_SERVER_REMOTE_TCP_PORT::update_subscriptions()
     TCP_BUFFER_SUBSCRIPTION_INFO *buf_info =
 	(TCP_BUFFER_SUBSCRIPTION_INFO *) subscription_buffers->get_head();
     while (NULL != buf_info) {
+	/* A subscriber held back by its interval doesn't count in
+	   min_last_id, so the buffer isn't read again every time round
+	   while it waits; it is read once more when the wait is over. */
+	int held_due = buf_info->next_held_time > 0.0 &&
+	    cur_time >= buf_info->next_held_time;
+	if (!held_due && buffer_unchanged(server, buf_info)) {
+	    buf_info = (TCP_BUFFER_SUBSCRIPTION_INFO *)
+		subscription_buffers->get_next();
+	    continue;
+	}
 	server->read_req.buffer_number = buf_info->buffer_number;
 	server->read_req.access_type = CMS_READ_ACCESS;
-	server->read_req.last_id_read = buf_info->min_last_id;
+	server->read_req.last_id_read = held_due ? 0 : buf_info->min_last_id;
 	server->read_reply =
 	    (REMOTE_READ_REPLY *) server->process_request(&server->read_req);
 	if (NULL == server->read_reply) {
@@ -1657,64 +2017,55 @@ void CMS_SERVER_REMOTE_TCP_PORT::update_subscriptions()
 		subscription_buffers->get_next();
 	    continue;
 	}
-	if (server->read_reply->write_id == buf_info->min_last_id ||
-	    server->read_reply->size < 1) {
+	if ((!held_due && server->read_reply->write_id ==
+		buf_info->min_last_id) || server->read_reply->size < 1) {
 	    buf_info = (TCP_BUFFER_SUBSCRIPTION_INFO *)
 		subscription_buffers->get_next();
 	    continue;
 	}
-	putbe32(temp_buffer, 0);
-	putbe32(temp_buffer + 4, server->read_reply->status);
-	putbe32(temp_buffer + 8, server->read_reply->size);
-	putbe32(temp_buffer + 12, server->read_reply->write_id);
-	putbe32(temp_buffer + 16, server->read_reply->was_read);
 	TCP_CLIENT_SUBSCRIPTION_INFO *temp_clnt_info =
 	    (TCP_CLIENT_SUBSCRIPTION_INFO *) buf_info->sub_clnt_info->
 	    get_head();
 	buf_info->min_last_id = server->read_reply->write_id;
+	buf_info->next_held_time = 0.0;
 	while (temp_clnt_info != NULL) {
 	    double time_diff = cur_time - temp_clnt_info->last_sub_sent_time;
 	    int time_diff_millis = (int) ((double) time_diff * 1000.0);
+	    int wait_millis = 0;
 	    rcs_print_debug(PRINT_SERVER_SUBSCRIPTION_ACTIVITY,
 		"Subscription time_diff_millis=%d\n", time_diff_millis);
-	    if (((temp_clnt_info->subscription_type == CMS_POLLED_SUBSCRIPTION
-			&& time_diff_millis + 10 >=
-			temp_clnt_info->poll_interval_millis)
-		    || temp_clnt_info->subscription_type ==
-		    CMS_VARIABLE_SUBSCRIPTION)
-		&& temp_clnt_info->last_id_read !=
-		server->read_reply->write_id) {
+	    if (temp_clnt_info->subscription_type == CMS_POLLED_SUBSCRIPTION) {
+		wait_millis = temp_clnt_info->poll_interval_millis - 10;
+	    } else if (temp_clnt_info->subscription_type ==
+		CMS_CHANGE_SUBSCRIPTION) {
+		wait_millis = temp_clnt_info->poll_interval_millis;
+	    } else if (temp_clnt_info->subscription_type !=
+		CMS_VARIABLE_SUBSCRIPTION) {
+		wait_millis = -1;
+	    }
+	    if (temp_clnt_info->last_id_read == server->read_reply->write_id
+		|| wait_millis < 0) {
+		/* up to date, or not subscribed */
+	    } else if (time_diff_millis >= wait_millis) {
 		temp_clnt_info->last_id_read = server->read_reply->write_id;
 		temp_clnt_info->last_sub_sent_time = cur_time;
 		temp_clnt_info->clnt_port->serial_number++;
-		putbe32(temp_buffer, temp_clnt_info->clnt_port->serial_number);
-		if (server->read_reply->size < 0x2000 - 20
-		    && server->read_reply->size > 0) {
-		    memcpy(temp_buffer + 20, server->read_reply->data,
-			server->read_reply->size);
-		    if (sendn
-			(temp_clnt_info->clnt_port->socket_fd, temp_buffer,
-			    20 + server->read_reply->size, 0, dtimeout) < 0) {
-			temp_clnt_info->clnt_port->errors++;
-			return;
-		    }
-		} else {
-		    if (sendn(temp_clnt_info->clnt_port->socket_fd,
-			    temp_buffer, 20, 0, dtimeout) < 0) {
-			temp_clnt_info->clnt_port->errors++;
-			return;
-		    }
-		    if (server->read_reply->size > 0) {
-			if (sendn(temp_clnt_info->clnt_port->socket_fd,
-				server->read_reply->data,
-				server->read_reply->size, 0, dtimeout) < 0) {
-			    temp_clnt_info->clnt_port->errors++;
-			    return;
-			}
-		    }
+		if (queue_read_reply(temp_clnt_info->clnt_port,
+			temp_clnt_info->clnt_port->serial_number,
+			server->read_reply, server, buf_info->buffer_number,
+			-1) < 0) {
+		    temp_clnt_info->clnt_port->errors++;
+		}
+	    } else {
+		double held_time = temp_clnt_info->last_sub_sent_time +
+		    wait_millis / 1000.0;
+		if (buf_info->next_held_time <= 0.0 ||
+		    held_time < buf_info->next_held_time) {
+		    buf_info->next_held_time = held_time;
 		}
 	    }
-	    if (temp_clnt_info->last_id_read < buf_info->min_last_id) {
+	    if (wait_millis < 0 &&
+		temp_clnt_info->last_id_read < buf_info->min_last_id) {
 		buf_info->min_last_id = temp_clnt_info->last_id_read;
 	    }
 	    temp_clnt_info = (TCP_CLIENT_SUBSCRIPTION_INFO *)
@@ -1725,10 +2076,78 @@ void CMS_SERVER_REMOTE_TCP_PORT::update_subscriptions()
     }
 }
 
+/* Nonzero when every subscriber already has the message in the buffer,
+   which for a buffer that can be looked at in place is found from its
+   header without locking or copying anything. */
+int CMS_SERVER_REMOTE_TCP_PORT::buffer_unchanged(CMS_SERVER * server,
+    TCP_BUFFER_SUBSCRIPTION_INFO * buf_info)
+{
+    const void *data;
+    long write_id;
+
+    if (buf_info->min_last_id == 0) {
+	return 0;
+    }
+    CMS_SERVER_LOCAL_PORT *local_port =
+	server->find_local_port(buf_info->buffer_number);
+    if (NULL == local_port || NULL == local_port->cms) {
+	return 0;
+    }
+    if (local_port->cms->peek_in_place(&data, &write_id) != CMS_READ_OK) {
+	return 0;
+    }
+    return (write_id == buf_info->min_last_id);
+}
+
+TCP_READ_CACHE_ENTRY::TCP_READ_CACHE_ENTRY()
+{
+    buffer_number = -1;
+    subdiv = 0;
+    access_type = 0;
+    generation = -1;
+    reply.status = 0;
+    reply.size = 0;
+    reply.write_id = 0;
+    reply.was_read = 0;
+    reply.data = NULL;
+    data_size = 0;
+}
+
+TCP_READ_CACHE_ENTRY::~TCP_READ_CACHE_ENTRY()
+{
+    if (NULL != reply.data) {
+	free(reply.data);
+	reply.data = NULL;
+    }
+    data_size = 0;
+}
+
+TCP_DELTA_BASE::TCP_DELTA_BASE()
+{
+    buffer_number = -1;
+    valid = 0;
+    write_id = 0;
+    size = 0;
+    data_size = 0;
+    data = NULL;
+    replies_since_keyframe = 0;
+}
+
+TCP_DELTA_BASE::~TCP_DELTA_BASE()
+{
+    if (NULL != data) {
+	free(data);
+	data = NULL;
+    }
+    data_size = 0;
+    valid = 0;
+}
+
 TCP_BUFFER_SUBSCRIPTION_INFO::TCP_BUFFER_SUBSCRIPTION_INFO()
 {
     buffer_number = -1;
     min_last_id = 0;
+    next_held_time = 0.0;
     list_id = -1;
     sub_clnt_info = NULL;
 }
@@ -1754,6 +2173,7 @@ TCP_CLIENT_SUBSCRIPTION_INFO::TCP_CLIENT_SUBSCRIPTION_INFO()
     subscription_paused = 0;
     last_id_read = 0;
     sub_buf_info = NULL;
+    buffer_list_id = -1;
     clnt_port = NULL;
 }
 
@@ -1767,6 +2187,7 @@ TCP_CLIENT_SUBSCRIPTION_INFO::~TCP_CLIENT_SUBSCRIPTION_INFO()
     subscription_paused = 0;
     last_id_read = 0;
     sub_buf_info = NULL;
+    buffer_list_id = -1;
     clnt_port = NULL;
 }
 
@@ -1785,6 +2206,14 @@ CLIENT_TCP_PORT::CLIENT_TCP_PORT()
     blocking_read_req = NULL;
     threadId = 0;
     diag_info = NULL;
+    list_id = -1;
+    closing = 0;
+    waiting_for_write = 0;
+    out_buf = NULL;
+    out_len = 0;
+    out_sent = 0;
+    out_size = 0;
+    delta_bases = NULL;
 }
 
 CLIENT_TCP_PORT::~CLIENT_TCP_PORT()
@@ -1814,4 +2243,17 @@ CLIENT_TCP_PORT::~CLIENT_TCP_PORT()
 	delete diag_info;
 	diag_info = NULL;
     }
+    if (NULL != out_buf) {
+	free(out_buf);
+	out_buf = NULL;
+    }
+    if (NULL != delta_bases) {
+	TCP_DELTA_BASE *base = (TCP_DELTA_BASE *) delta_bases->get_head();
+	while (NULL != base) {
+	    delete base;
+	    base = (TCP_DELTA_BASE *) delta_bases->get_next();
+	}
+	delete delta_bases;
+	delta_bases = NULL;
+    }
 }
@@ -43,6 +43,7 @@ extern "C" {
 
 #define MAX_TCP_BUFFER_SIZE 16
 class CLIENT_TCP_PORT;
+class TCP_BUFFER_SUBSCRIPTION_INFO;
 
 class CMS_SERVER_REMOTE_TCP_PORT:public CMS_SERVER_REMOTE_PORT {
   public:
@@ -54,10 +55,26 @@ class CMS_SERVER_REMOTE_TCP_PORT:public CMS_SERVER_REMOTE_PORT {
     void unregister_port();
     double dtimeout;
   protected:
-      fd_set read_fd_set, write_fd_set;
     void handle_request(CLIENT_TCP_PORT *);
-    int maxfdpl;
+    void accept_client();
+    void close_client(CLIENT_TCP_PORT *);
+    int queue_reply(CLIENT_TCP_PORT *, const void *, long);
+    int queue_read_reply(CLIENT_TCP_PORT *, long, REMOTE_READ_REPLY *,
+	CMS_SERVER *, long buffer_number, long last_id_read);
+    int queue_delta_reply(CLIENT_TCP_PORT *, long, REMOTE_READ_REPLY *,
+	long buffer_number, long last_id_read, long keyframe_interval);
+    void forget_delta_base(CLIENT_TCP_PORT *, long buffer_number);
+    int flush_client(CLIENT_TCP_PORT *);
+    void flush_clients();
+    REMOTE_READ_REPLY *shared_read(CMS_SERVER *, REMOTE_READ_REQUEST *);
+    int epoll_fd;
+    int pending_output;
     LinkedList *client_ports;
+    LinkedList *read_cache;
+    long read_cache_generation;
+    REMOTE_READ_REPLY old_read_reply;
+    char *delta_buf;		/* where delta replies are put together */
+    long delta_buf_size;
     LinkedList *subscription_buffers;
     int connection_socket;
     long connection_port;
@@ -66,8 +83,8 @@ class CMS_SERVER_REMOTE_TCP_PORT:public CMS_SERVER_REMOTE_PORT {
     char temp_buffer[0x2000];
     int current_poll_interval_millis;
     int polling_enabled;
-    struct timeval select_timeout;
     void update_subscriptions();
+    int buffer_unchanged(CMS_SERVER *, TCP_BUFFER_SUBSCRIPTION_INFO *);
     void add_subscription_client(int buffer_number, int subscription_type,
 	int poll_interval_millis, CLIENT_TCP_PORT * clnt);
     void remove_subscription_client(CLIENT_TCP_PORT * clnt,
@@ -79,12 +96,45 @@ class CMS_SERVER_REMOTE_TCP_PORT:public CMS_SERVER_REMOTE_PORT {
 	received_serial_number);
 };
 
+/* The last read reply for a buffer, kept so that other clients asking
+   for the same buffer in the same pass of the event loop can be
+   answered without another read and encode. */
+class TCP_READ_CACHE_ENTRY {
+  public:
+    TCP_READ_CACHE_ENTRY();
+    ~TCP_READ_CACHE_ENTRY();
+    long buffer_number;
+    int subdiv;
+    int access_type;
+    long generation;
+    REMOTE_READ_REPLY reply;
+    long data_size;
+};
+
+/* The last message sent to a client from a buffer with the delta
+   option, which the next reply from that buffer is a delta against. */
+class TCP_DELTA_BASE {
+  public:
+    TCP_DELTA_BASE();
+    ~TCP_DELTA_BASE();
+    long buffer_number;
+    int valid;
+    long write_id;
+    long size;
+    long data_size;
+    void *data;
+    long replies_since_keyframe;
+};
+
 class TCP_BUFFER_SUBSCRIPTION_INFO {
   public:
     TCP_BUFFER_SUBSCRIPTION_INFO();
     ~TCP_BUFFER_SUBSCRIPTION_INFO();
     int buffer_number;
     int min_last_id;
+    double next_held_time;	/* when the first subscriber held back by
+				   its interval may be sent the newest
+				   message, 0 if none is */
     int list_id;
     LinkedList *sub_clnt_info;
 };
@@ -101,6 +151,7 @@ class TCP_CLIENT_SUBSCRIPTION_INFO {
     int subscription_paused;
     int last_id_read;
     TCP_BUFFER_SUBSCRIPTION_INFO *sub_buf_info;
+    int buffer_list_id;		/* id in sub_buf_info->sub_clnt_info */
     CLIENT_TCP_PORT *clnt_port;
 };
 
@@ -125,7 +176,12 @@ class CLIENT_TCP_PORT {
 #endif
     TCPSVR_BLOCKING_READ_REQUEST *blocking_read_req;
     REMOTE_SET_DIAG_INFO_REQUEST *diag_info;
-
+    int list_id;
+    int closing;		/* close once the current request is done */
+    int waiting_for_write;	/* socket full, EPOLLOUT requested */
+    char *out_buf;		/* replies not yet written to the socket */
+    long out_len, out_sent, out_size;
+    LinkedList *delta_bases;	/* TCP_DELTA_BASE for each delta buffer */
 };
 
 class TCPSVR_BLOCKING_READ_REQUEST:public REMOTE_BLOCKING_READ_REQUEST {
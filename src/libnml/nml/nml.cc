@@ -1383,6 +1383,83 @@ NMLTYPE NML::peek()
 
 }
 
+/***********************************************************
+* NML Member Function: peek_in_place()
+* Purpose: Finds the message in the buffer without copying it, for
+* large status messages that several processes poll.
+* Parameters:
+* msg - set to point at the message, which stays in the buffer.
+* token - set to a value to hand to check_in_place() once done.
+* Returns:
+*  0 Nothing has been written to the buffer yet.
+*  -1 The message can not be read in place right now.
+*  o.w. The type of the message in the buffer.
+* Notes:
+*   1. Only raw buffers in shared memory mapped by this process can
+* be read in place. For the others, or while a write is under way,
+* -1 is returned with error_type left at NML_NO_ERROR, and the
+* caller should use peek() instead.
+*   2. A writer may overwrite the message at any time. Copy out what
+* is needed, then call check_in_place(token), and discard the copy if
+* it returns 0. Tokens of successive messages differ, so comparing one
+* with the last tells whether the message is new.
+*   3. The was_read flag is not set and messages missed are not
+* counted.
+***********************************************************/
+NMLTYPE NML::peek_in_place(const NMLmsg ** msg, long *token)
+{
+    const void *data;
+
+    error_type = NML_NO_ERROR;
+    if (NULL == cms) {
+	if (error_type != NML_INVALID_CONFIGURATION) {
+	    error_type = NML_INVALID_CONFIGURATION;
+	    rcs_print_error("NML::peek_in_place: CMS not configured.\n");
+	}
+	return (-1);
+    }
+    if (cms->is_phantom) {
+	return (-1);
+    }
+
+    switch (cms->peek_in_place(&data, token)) {
+    case CMS_READ_OK:
+	break;
+    case CMS_READ_OLD:
+    case CMS_NO_IMPLEMENTATION_ERROR:
+	return (-1);
+    default:
+	set_error();
+	return (-1);
+    }
+    if (0 == *token) {
+	return (0);
+    }
+    *msg = (const NMLmsg *) data;
+    if ((*msg)->type <= 0) {
+	rcs_print_error("NML: Message in buffer has invalid type %d.\n",
+	    (int) (*msg)->type);
+	return (-1);
+    }
+    return ((*msg)->type);
+}
+
+/***********************************************************
+* NML Member Function: check_in_place()
+* Purpose: Checks that the message peek_in_place() pointed at was
+* not overwritten.
+* Returns:
+*  1 Nothing was written since peek_in_place() handed out token.
+*  0 Something was, or the buffer can not be read in place.
+***********************************************************/
+int NML::check_in_place(long token)
+{
+    if (NULL == cms) {
+	return 0;
+    }
+    return cms->check_in_place(token);
+}
+
 /***********************************************************
 * NML Member Function: format_output()
 * Purpose: Formats the data read from a CMS buffer as required
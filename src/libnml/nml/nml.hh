@@ -97,6 +97,8 @@ class NML:public virtual CMS_USER {
     NMLTYPE peek();		/* Read buffer without changing was_read */
     NMLTYPE read(void *, long);
     NMLTYPE peek(void *, long);
+    NMLTYPE peek_in_place(const NMLmsg ** msg, long *token);
+    int check_in_place(long token);	/* Was msg left intact? */
     int write(NMLmsg & nml_msg);	/* Write a message. (Use reference) */
     int write(NMLmsg * nml_msg);	/* Write a message. (Use pointer) */
     int write_if_read(NMLmsg & nml_msg);	/* Write only if buffer
@@ -296,4 +296,14 @@ static __inline__ int test_and_clear_bit(unsigned long nr,
 #else
 #error The header file <asm/bitops.h> is not usable and rtapi does not yet have support for your CPU
 #endif
+
+/**
+ * rtapi_smp_mb - full memory barrier
+ *
+ * Orders the loads and stores of lock-free structures which are shared
+ * between realtime code and user space, such as single-producer/single-
+ * consumer rings, so that an index is never seen to advance before the
+ * data it covers.
+ */
+#define rtapi_smp_mb() __sync_synchronize()
 #endif
@@ -207,6 +207,9 @@ int rtapi_get_msg_level() {
 
 long long rtapi_get_time(void) {
     struct timeval tv;
+#ifdef SIM_VIRTUAL_TIME
+    if(use_virtual_time()) return virtual_time_ns;
+#endif
     gettimeofday(&tv, 0);
     return tv.tv_sec * 1000 * 1000 * 1000 + tv.tv_usec * 1000;
 }
@@ -225,6 +228,9 @@ long long rtapi_get_clocks(void)
 {
     long long int retval;
 
+#ifdef SIM_VIRTUAL_TIME
+    if(use_virtual_time()) return virtual_time_ns;
+#endif
     rdtscll(retval);
     return retval;    
 }
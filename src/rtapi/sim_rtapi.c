@@ -11,6 +11,7 @@
 * Last change: 
 ********************************************************************/
 
+#define _GNU_SOURCE		/* CPU_SET, pthread_attr_setaffinity_np() */
 #include <stdio.h>		/* vprintf() */
 #include <stdlib.h>		/* malloc(), sizeof() */
 #include <stdarg.h>		/* va_* */
@@ -20,6 +21,11 @@
 #include <sys/shm.h>		/* shmget() */
 #include <time.h>               /* gettimeofday */
 #include <sys/time.h>           /* gettimeofday */
+#include <sys/mman.h>		/* mlockall() */
+#include <sys/select.h>		/* select() */
+#include <pthread.h>		/* pthread_* */
+#include <limits.h>		/* PTHREAD_STACK_MIN */
+#include <sched.h>		/* SCHED_FIFO */
 #include "rtapi.h"		/* these decls */
 #include <errno.h>
 #include <string.h>
@@ -41,12 +47,78 @@ struct rtapi_task {
   int ratio;
   void *arg;
   void (*taskcode) (void*);	/* pointer to task function */
+  pthread_t thread;		/* posix mode: the task's own thread */
+  int thread_started;
+  int cpu;			/* posix mode: CPU to run on, or -1 */
+  struct timespec deadline;	/* posix mode: start of next period */
+  int overruns;
 };
 
 static struct timeval schedule;
 static int base_periods;
 static pth_uctx_t main_ctx, this_ctx;
 
+/* With RTAPI_THREADS=posix in the environment each task gets its own
+   SCHED_FIFO pthread which sleeps to absolute deadlines, instead of
+   all tasks sharing one thread as pth coroutines.  RTAPI_CPUS may hold
+   a comma separated list of CPUs; tasks are pinned to them in the order
+   they are started, which for HAL is fastest thread first. */
+static int posix_mode = -1;
+static __thread struct rtapi_task *posix_task;
+static int posix_cpus_used;
+
+/* In virtual time mode (rtapi_app --virtual-time, or RTAPI_VIRTUAL_TIME=1
+   in the environment) the base period never sleeps.  Each one advances
+   a simulated clock by the period, and rtapi_get_time()/rtapi_get_clocks()
+   return that clock, so the realtime side runs as fast as the CPU allows
+   and gives the same results every time.  Tasks always run as pth
+   coroutines in this mode. */
+static int virtual_time = -1;
+static long long virtual_time_ns;
+
+void sim_rtapi_set_virtual_time(int on)
+{
+  virtual_time = on;
+}
+
+static int use_virtual_time(void)
+{
+  const char *env;
+
+  if(virtual_time < 0) {
+    env = getenv("RTAPI_VIRTUAL_TIME");
+    virtual_time = env && *env && strcmp(env, "0");
+  }
+  return virtual_time;
+}
+
+static int use_posix(void)
+{
+  const char *env;
+
+  if(posix_mode < 0) {
+    env = getenv("RTAPI_THREADS");
+    posix_mode = env && !strcmp(env, "posix") && !use_virtual_time();
+  }
+  return posix_mode;
+}
+
+/* returns the CPU for the n'th task started, or -1 to let it float */
+static int posix_task_cpu(int n)
+{
+  const char *env = getenv("RTAPI_CPUS");
+  char *end;
+  long cpu = -1;
+
+  while(env && *env) {
+    cpu = strtol(env, &end, 10);
+    if(end == env) return -1;
+    if(n-- == 0) return cpu;
+    env = (*end == ',') ? end + 1 : end;
+  }
+  return -1;
+}
+
 #define MODULE_MAGIC  30812
 #define TASK_MAGIC    21979	/* random numbers used as signatures */
 #define SHMEM_MAGIC   25453
@@ -104,6 +176,8 @@ int rtapi_clock_set_period(unsigned long int nsecs)
   }
   period = nsecs;
   gettimeofday(&schedule, NULL);
+  /* start the simulated clock at the real time, so it looks sane */
+  virtual_time_ns = schedule.tv_sec * 1000000000LL + schedule.tv_usec * 1000LL;
   return period;
 }
 
@@ -140,6 +214,9 @@ int rtapi_task_new(void (*taskcode) (void*), void *arg,
   task->stacksize = stacksize;
   task->taskcode = taskcode;
   task->prio = prio;
+  task->thread_started = 0;
+  task->cpu = -1;
+  task->overruns = 0;
 
   /* and return handle to the caller */
 
@@ -147,6 +224,20 @@ int rtapi_task_new(void (*taskcode) (void*), void *arg,
 }
 
 
+static void task_stop(struct rtapi_task *task)
+{
+  if(task->thread_started) {
+    /* the task is cancelled in clock_nanosleep() in rtapi_wait() */
+    pthread_cancel(task->thread);
+    pthread_join(task->thread, NULL);
+    task->thread_started = 0;
+  } else if(task->ctx) {
+    pth_uctx_destroy(task->ctx);
+    task->ctx = NULL;
+  }
+}
+
+
 int rtapi_task_delete(int id) {
   struct rtapi_task *task;
 
@@ -157,7 +248,7 @@ int rtapi_task_delete(int id) {
   if (task->magic != TASK_MAGIC)
     return -EINVAL;
 
-  pth_uctx_destroy(task->ctx);
+  task_stop(task);
   
   task->magic = 0;
   return 0;
@@ -182,6 +273,76 @@ static void wrapper(void *arg)
 }
 
 
+static void *posix_wrapper(void *arg)
+{
+  struct rtapi_task *task;
+
+  task = (struct rtapi_task*)arg;
+  posix_task = task;
+  /* only ever cancelled while sleeping in rtapi_wait(), never in the
+     middle of a HAL function */
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+  rtapi_print_msg(RTAPI_MSG_INFO, "task %p period = %d cpu = %d\n",
+	  task, task->period, task->cpu);
+
+  /* the first period starts now */
+  clock_gettime(CLOCK_MONOTONIC, &task->deadline);
+  (task->taskcode) (task->arg);
+
+  rtapi_print("ERROR: reached end of wrapper for task %d\n", (int)(task - task_array));
+  return NULL;
+}
+
+static int posix_task_start(struct rtapi_task *task)
+{
+  pthread_attr_t attr;
+  struct sched_param param;
+  cpu_set_t cpuset;
+  int retval;
+
+  /* page faults are the biggest source of latency left once the
+     tasks are SCHED_FIFO, so lock everything down; failing that
+     (no privileges) the tasks still run, just with more jitter */
+  if(posix_cpus_used == 0 && mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+    rtapi_print_msg(RTAPI_MSG_WARN,
+	"RTAPI: mlockall failed, realtime tasks may page fault\n");
+  }
+  task->cpu = posix_task_cpu(posix_cpus_used++);
+
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, task->stacksize < PTHREAD_STACK_MIN ?
+	  PTHREAD_STACK_MIN : task->stacksize);
+  if(task->cpu >= 0) {
+    CPU_ZERO(&cpuset);
+    CPU_SET(task->cpu, &cpuset);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+  }
+  /* RTAPI priority 0 is the highest */
+  pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+  param.sched_priority = sched_get_priority_max(SCHED_FIFO) - task->prio;
+  pthread_attr_setschedparam(&attr, &param);
+
+  retval = pthread_create(&task->thread, &attr, posix_wrapper, task);
+  if(retval == EPERM) {
+    rtapi_print_msg(RTAPI_MSG_WARN,
+	"RTAPI: no permission for SCHED_FIFO, task %d runs at normal "
+	"priority\n", (int)(task - task_array));
+    pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+    retval = pthread_create(&task->thread, &attr, posix_wrapper, task);
+  }
+  pthread_attr_destroy(&attr);
+  if(retval != 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR,
+	"RTAPI: could not create thread for task %d (cpu %d): %s\n",
+	(int)(task - task_array), task->cpu, strerror(retval));
+    return -retval;
+  }
+  task->thread_started = 1;
+  return 0;
+}
+
+
 int rtapi_task_start(int task_id, unsigned long int period_nsec)
 {
   struct rtapi_task *task;
@@ -199,6 +360,9 @@ int rtapi_task_start(int task_id, unsigned long int period_nsec)
   task->period = period_nsec;
   task->ratio = period_nsec / period;
 
+  if(use_posix())
+    return posix_task_start(task);
+
   /* create the thread - use the wrapper function, pass it a pointer
      to the task structure so it can call the actual task function */
   retval = pth_uctx_create(&task->ctx);
@@ -224,7 +388,7 @@ int rtapi_task_stop(int task_id)
   if (task->magic != TASK_MAGIC)
     return -EINVAL;
 
-  pth_uctx_destroy(task->ctx);
+  task_stop(task);
 
   return 0;
 }
@@ -275,8 +439,41 @@ int rtapi_task_set_period(int task_id,
   return 0;
 }
 
+static void posix_wait(struct rtapi_task *task)
+{
+  struct timespec now;
+
+  task->deadline.tv_nsec += task->period;
+  while(task->deadline.tv_nsec >= 1000000000) {
+    task->deadline.tv_nsec -= 1000000000;
+    task->deadline.tv_sec++;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if(now.tv_sec > task->deadline.tv_sec
+	  || (now.tv_sec == task->deadline.tv_sec
+	      && now.tv_nsec > task->deadline.tv_nsec)) {
+    /* missed the deadline; start a fresh schedule rather than
+       running back to back trying to catch up */
+    if(task->overruns++ == 0)
+      rtapi_print_msg(RTAPI_MSG_ERR,
+	  "RTAPI: task %d missed its deadline, period %d ns\n",
+	  (int)(task - task_array), task->period);
+    task->deadline = now;
+  }
+  pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+  pthread_testcancel();
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &task->deadline,
+	      NULL) == EINTR)
+    ;
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+}
+
 int rtapi_wait(void)
 {
+  if(posix_task) {
+    posix_wait(posix_task);
+    return 0;
+  }
   pth_uctx_switch(this_ctx, main_ctx);
   return 0;
 }
@@ -308,6 +505,16 @@ static int maybe_sleep(int fd) {
 	FD_SET(fd, &fds);
 
 	return select(fd+1, &fds, NULL, NULL, NULL);
+    } else if(use_virtual_time()) {
+	/* no sleeping, just see whether a command is waiting */
+	fd_set fds;
+	struct timeval zero = {0, 0};
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+
+	virtual_time_ns += period;
+	if(base_periods % MIN_RUNS) return 0;
+	return select(fd+1, &fds, NULL, NULL, &zero);
     } else {
 	schedule.tv_usec += period / 1000;
 	if(schedule.tv_usec > 1000000) {
@@ -351,6 +558,13 @@ static int maybe_sleep(int fd) {
 
 int sim_rtapi_run_threads(int fd) {
     static int first_time = 1;
+    if(use_posix()) {
+	/* the tasks run on their own threads, just wait for a command */
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+	return select(fd+1, &fds, NULL, NULL, NULL);
+    }
     if(first_time) {
 	int result = pth_uctx_create(&main_ctx);
 	if(result == FALSE) _exit(1);
@@ -378,4 +592,5 @@ int sim_rtapi_run_threads(int fd) {
 }
 
 
+#define SIM_VIRTUAL_TIME
 #include "rtapi/sim_common.h"
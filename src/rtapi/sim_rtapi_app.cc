@@ -42,6 +42,7 @@
 #include "hal/hal_priv.h"
 
 extern "C" int sim_rtapi_run_threads(int fd);
+extern "C" void sim_rtapi_set_virtual_time(int on);
 
 using namespace std;
 
@@ -374,7 +375,13 @@ static int master(int fd, vector<string> args) {
 
 int main(int argc, char **argv) {
     vector<string> args;
-    for(int i=1; i<argc; i++) { args.push_back(string(argv[i])); }
+    int i = 1;
+    // only matters if this rtapi_app ends up being the master
+    if(i < argc && strcmp(argv[i], "--virtual-time") == 0) {
+        sim_rtapi_set_virtual_time(1);
+        i++;
+    }
+    for(; i<argc; i++) { args.push_back(string(argv[i])); }
 
 become_master:
     int fd = socket(PF_UNIX, SOCK_STREAM, 0);
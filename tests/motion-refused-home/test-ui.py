@@ -0,0 +1,92 @@
+#!/usr/bin/env python
+
+# Motion refuses these home and unhome commands part way through
+# handling them.  It must still finish publishing its status, or every
+# status read after that times out and task never sees a joint home.
+
+import linuxcnc
+import sys
+import time
+
+
+# this is how long we wait for linuxcnc to do our bidding
+timeout = 5.0
+
+c = linuxcnc.command()
+s = linuxcnc.stat()
+e = linuxcnc.error_channel()
+
+
+def wait_for(what, done):
+    start = time.time()
+    while (time.time() - start) < timeout:
+        s.poll()
+        if done():
+            return
+        time.sleep(0.1)
+    print "timed out waiting for", what
+    sys.exit(1)
+
+
+def expect_error(text):
+    start = time.time()
+    while (time.time() - start) < timeout:
+        error = e.poll()
+        if error:
+            kind, msg = error
+            if text in msg:
+                print "refused:", msg
+                return
+            print "unexpected error:", msg
+        time.sleep(0.1)
+    print "motion didn't say '%s'" % text
+    sys.exit(1)
+
+
+c.state(linuxcnc.STATE_ESTOP_RESET)
+c.wait_complete()
+c.state(linuxcnc.STATE_ON)
+c.wait_complete()
+c.mode(linuxcnc.MODE_MANUAL)
+c.wait_complete()
+
+for j in range(0, 3):
+    c.home(j)
+    c.wait_complete()
+    wait_for("joint %d to home" % j, lambda: s.homed[j])
+print "all joints homed"
+
+# HOME is only for joint mode
+c.teleop_enable(1)
+c.wait_complete()
+wait_for("teleop mode", lambda: s.motion_mode == linuxcnc.TRAJ_MODE_TELEOP)
+c.home(0)
+expect_error("must be in joint mode to home")
+c.teleop_enable(0)
+c.wait_complete()
+wait_for("joint mode", lambda: s.motion_mode == linuxcnc.TRAJ_MODE_FREE)
+
+# so is UNHOME, and auto mode puts motion in coordinated mode
+c.mode(linuxcnc.MODE_AUTO)
+c.wait_complete()
+wait_for("coordinated mode", lambda: s.motion_mode == linuxcnc.TRAJ_MODE_COORD)
+c.unhome(0)
+expect_error("must be in joint mode or disabled to unhome")
+c.mode(linuxcnc.MODE_MANUAL)
+c.wait_complete()
+wait_for("joint mode", lambda: s.motion_mode == linuxcnc.TRAJ_MODE_FREE)
+
+# there are only 3 joints
+c.unhome(5)
+expect_error("Cannot unhome invalid joint 5")
+
+# status still comes through: unhome and home a joint and watch it
+c.unhome(0)
+c.wait_complete()
+wait_for("joint 0 to unhome", lambda: not s.homed[0])
+c.home(0)
+c.wait_complete()
+wait_for("joint 0 to home again", lambda: s.homed[0])
+print "joint 0 unhomed and homed again"
+
+sys.exit(0)
@@ -0,0 +1,81 @@
+#!/usr/bin/env python
+
+# Task doesn't wait for motion to take each move of a program, so a
+# move motion refuses mid-program has to stop the program anyway,
+# without motion going on to the moves after it.
+
+import linuxcnc
+import sys
+import time
+
+
+# this is how long we wait for linuxcnc to do our bidding
+timeout = 10.0
+
+c = linuxcnc.command()
+s = linuxcnc.stat()
+e = linuxcnc.error_channel()
+
+
+def wait_for(what, done):
+    start = time.time()
+    while (time.time() - start) < timeout:
+        s.poll()
+        if done():
+            return
+        time.sleep(0.1)
+    print "timed out waiting for", what
+    sys.exit(1)
+
+
+def expect_error(text):
+    start = time.time()
+    while (time.time() - start) < timeout:
+        error = e.poll()
+        if error:
+            kind, msg = error
+            if text in msg:
+                print "refused:", msg
+                return
+            print "unexpected error:", msg
+        time.sleep(0.1)
+    print "motion didn't say '%s'" % text
+    sys.exit(1)
+
+
+c.state(linuxcnc.STATE_ESTOP_RESET)
+c.wait_complete()
+c.state(linuxcnc.STATE_ON)
+c.wait_complete()
+c.mode(linuxcnc.MODE_MANUAL)
+c.wait_complete()
+
+for j in range(0, 3):
+    c.home(j)
+    c.wait_complete()
+    wait_for("joint %d to home" % j, lambda: s.homed[j])
+
+c.mode(linuxcnc.MODE_AUTO)
+c.wait_complete()
+c.program_open("test.ngc")
+c.auto(linuxcnc.AUTO_RUN, 0)
+
+expect_error("would exceed joint 0's positive limit")
+wait_for("the program to stop",
+    lambda: s.interp_state == linuxcnc.INTERP_IDLE and s.inpos)
+
+# the moves after the refused one must not have been made
+if s.position[0] > 1.0 + 1e-6:
+    print "went on to X%f after the refused move" % s.position[0]
+    sys.exit(1)
+print "stopped at X%.3f" % s.position[0]
+
+# and once task has aborted, motion takes moves again
+c.mode(linuxcnc.MODE_MDI)
+c.wait_complete()
+c.mdi("G1 X0.5 F100")
+c.wait_complete()
+wait_for("the MDI move", lambda: abs(s.position[0] - 0.5) < 1e-6)
+print "MDI move to X0.5 done"
+
+sys.exit(0)
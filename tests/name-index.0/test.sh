@@ -0,0 +1,52 @@
+#!/bin/sh
+# sig-a, sig-1273 and sig-3868 start at the same slot of the HAL name
+# index, and so do pin-a, pin-1846 and pin-20656
+realtime start
+
+gen() {
+    halcmd status mem | sed -n 's/^ *generation: *//p'
+}
+
+g=$(gen)
+step() {
+    halcmd "$@" || echo "$*: failed"
+    n=$(gen)
+    if [ "$n" = "$g" ]; then
+	echo "$*: same generation"
+    else
+	echo "$*: new generation"
+    fi
+    g=$n
+}
+
+step newsig sig-a bit
+step newsig sig-1273 s32
+step newsig sig-3868 float
+step sets sig-3868 2.5
+step delsig sig-a
+step gets sig-3868
+step gets sig-1273
+step newsig sig-a u32
+step sets sig-a 7
+step delsig sig-1273
+step gets sig-3868
+step gets sig-a
+
+step loadrt and2
+step alias pin and2.0.in0 pin-a
+step alias pin and2.0.in1 pin-1846
+step alias pin and2.0.out pin-20656
+step net both pin-a pin-1846
+step sets both 1
+step getp pin-1846
+step getp pin-20656
+step unalias pin pin-a
+step getp pin-1846
+step getp and2.0.in0
+step unloadrt and2
+step loadrt and2
+step getp and2.0.in1
+step alias pin and2.0.in1 pin-1846
+step getp pin-1846
+
+realtime stop
@@ -0,0 +1,161 @@
+// Sends a message through a buffer with the delta option, changing a
+// little or a lot of it each time, and checks that remote readers
+// rebuild every version exactly.
+#include "nml.hh"
+#include "nmlmsg.hh"
+#include "nml_srv.hh"
+#include "cms.hh"
+#include "rcs_print.hh"
+#include "timer.hh"
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DELTA_MSG_TYPE ((NMLTYPE) 9804)
+#define DELTA_MSG_DOUBLES 300
+
+class DELTA_MSG:public NMLmsg {
+  public:
+    DELTA_MSG():NMLmsg(DELTA_MSG_TYPE, sizeof(DELTA_MSG)) {
+    };
+    void update(CMS * cms);
+
+    int count;
+    double data[DELTA_MSG_DOUBLES];
+    char tail[5];
+};
+
+void DELTA_MSG::update(CMS * cms)
+{
+    cms->update(count);
+    cms->update(data, DELTA_MSG_DOUBLES);
+    cms->update(tail, sizeof(tail));
+}
+
+static int deltaFormat(NMLTYPE type, void *buffer, CMS * cms)
+{
+    if (type == DELTA_MSG_TYPE) {
+	((DELTA_MSG *) buffer)->update(cms);
+	return 1;
+    }
+    return 0;
+}
+
+static int same(NML * reader, const DELTA_MSG * sent)
+{
+    const DELTA_MSG *got = (const DELTA_MSG *) reader->get_address();
+    return got->count == sent->count &&
+	!memcmp(got->data, sent->data, sizeof(sent->data)) &&
+	!memcmp(got->tail, sent->tail, sizeof(sent->tail));
+}
+
+static NML *connect(const char *process, const char *file)
+{
+    for (int tries = 0; tries < 50; tries++) {
+	esleep(0.1);
+	NML *nml = new NML(deltaFormat, "delta", process, file);
+	if (nml->valid()) {
+	    return nml;
+	}
+	delete nml;
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+	fprintf(stderr, "usage: %s NMLFILE\n", argv[0]);
+	return 1;
+    }
+    set_rcs_print_destination(RCS_PRINT_TO_NULL);
+
+    NML writer(deltaFormat, "delta", "writer", argv[1]);
+    if (!writer.valid()) {
+	fprintf(stderr, "can't open the delta buffer\n");
+	return 1;
+    }
+    DELTA_MSG msg;
+    NMLTYPE type;
+    int i, step;
+
+    msg.count = 0;
+    for (i = 0; i < DELTA_MSG_DOUBLES; i++) {
+	msg.data[i] = i;
+    }
+    strcpy(msg.tail, "abcd");
+    writer.write(msg);
+
+    pid_t server = fork();
+    if (0 == server) {
+	NML nml(deltaFormat, "delta", "server", argv[1]);
+	run_nml_servers();
+	_exit(0);
+    }
+
+    int status = 1;
+    NML *reader = connect("reader", argv[1]);
+    NML *subscriber = connect("subscriber", argv[1]);
+    if (NULL == reader || NULL == subscriber) {
+	printf("can't connect to the server\n");
+	goto done;
+    }
+    type = reader->read();
+    printf("first read: %d, same %d\n", (int) type, same(reader, &msg));
+    esleep(0.2);
+    type = subscriber->read();
+    printf("first subscriber read: %d, same %d\n", (int) type,
+	same(subscriber, &msg));
+
+    // past several keyframes, with the delta option at 4
+    for (step = 1; step <= 12; step++) {
+	msg.count = step;
+	switch (step % 6) {
+	case 0:		/* nothing else */
+	    break;
+	case 1:		/* one value */
+	    msg.data[step] += 0.5;
+	    break;
+	case 2:		/* two ranges far apart */
+	    msg.data[3] = -step;
+	    msg.data[DELTA_MSG_DOUBLES - 3] = step * 1e10;
+	    break;
+	case 3:		/* the odd bytes at the end */
+	    msg.tail[3] = 'A' + step;
+	    break;
+	case 4:		/* everything */
+	    for (i = 0; i < DELTA_MSG_DOUBLES; i++) {
+		msg.data[i] = step * 1000 + i * 0.25;
+	    }
+	    msg.tail[0] = 'a' + step;
+	    break;
+	case 5:		/* many ranges close together */
+	    for (i = 10; i < DELTA_MSG_DOUBLES; i += 7) {
+		msg.data[i] = -i;
+	    }
+	    break;
+	}
+	writer.write(msg);
+	type = reader->read();
+	printf("step %d: %d, same %d\n", step, (int) type,
+	    same(reader, &msg));
+    }
+
+    // the subscriber fell behind; it has to skip the delta replies
+    // queued up and rebuild the newest message
+    esleep(0.5);
+    type = subscriber->read();
+    printf("subscriber read: %d, same %d\n", (int) type,
+	same(subscriber, &msg));
+    printf("next subscriber read: %d\n", (int) subscriber->read());
+    status = 0;
+
+  done:
+    delete reader;
+    delete subscriber;
+    kill(server, SIGINT);
+    waitpid(server, NULL, 0);
+    return status;
+}
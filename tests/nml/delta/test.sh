@@ -0,0 +1,4 @@
+#!/bin/bash
+set -e
+. ../nmltest.sh
+nml_test delta.cc delta.nml
@@ -0,0 +1,33 @@
+# Sourced by the test.sh of each NML test, which then calls
+#     nml_test prog.cc prog.nml
+# to build the test program and run it on a copy of prog.nml where
+# @KEY@ and @PORT@ are replaced by a shared memory key and a TCP port
+# that nothing is using, so the tests can't collide with each other,
+# with a test left running, or with a LinuxCNC on the same machine.
+
+# shared memory (and semaphore) keys in use, in hex
+free_key() {
+    local key=$((0x4e4d0000 + $$ % 0x10000 * 4))
+    while ipcs -m -s | grep -qi "^0x0*$(printf %x $key) "; do
+	key=$((key + 1))
+    done
+    echo $key
+}
+
+# TCP ports in use, local or remote
+free_port() {
+    local port=$((20000 + $$ % 20000))
+    while cat /proc/net/tcp /proc/net/tcp6 2>/dev/null |
+	    grep -qi ":$(printf %04x $port) "; do
+	port=$((port + 1))
+    done
+    echo $port
+}
+
+nml_test() {
+    local prog=$(mktemp) nml=$(mktemp)
+    trap "rm -f $prog $nml" 0
+    g++ -I $EMC2_HOME/include $1 -L $EMC2_HOME/lib -lnml -o $prog
+    sed -e "s/@KEY@/$(free_key)/" -e "s/@PORT@/$(free_port)/" $2 > $nml
+    $prog $nml
+}
@@ -0,0 +1,152 @@
+// Writes a message with one of each type CMS_PACKED_UPDATER codes
+// through a packed neutral buffer and checks what is read back.
+#include "nml.hh"
+#include "nmlmsg.hh"
+#include "cms.hh"
+#include "rcs_print.hh"
+#include <stdio.h>
+#include <string.h>
+
+#define PACKED_MSG_TYPE ((NMLTYPE) 9802)
+
+class PACKED_MSG:public NMLmsg {
+  public:
+    PACKED_MSG():NMLmsg(PACKED_MSG_TYPE, sizeof(PACKED_MSG)) {
+    };
+    void update(CMS * cms);
+
+    bool b;
+    char c;
+    unsigned char uc;
+    short s;
+    unsigned short us;
+    int i;
+    unsigned int ui;
+    long l;
+    unsigned long ul;
+    float f;
+    double d;
+    long double ld;
+    char text[13];
+    unsigned char bytes[3];
+    short shorts[3];
+    unsigned short ushorts[3];
+    int ints[3];
+    unsigned int uints[3];
+    long longs[3];
+    unsigned long ulongs[3];
+    float floats[3];
+    double doubles[3];
+    long double ldoubles[3];
+};
+
+void PACKED_MSG::update(CMS * cms)
+{
+    cms->update(b);
+    cms->update(c);
+    cms->update(uc);
+    cms->update(s);
+    cms->update(us);
+    cms->update(i);
+    cms->update(ui);
+    cms->update(l);
+    cms->update(ul);
+    cms->update(f);
+    cms->update(d);
+    cms->update(ld);
+    cms->update(text, sizeof(text));
+    cms->update(bytes, 3);
+    cms->update(shorts, 3);
+    cms->update(ushorts, 3);
+    cms->update(ints, 3);
+    cms->update(uints, 3);
+    cms->update(longs, 3);
+    cms->update(ulongs, 3);
+    cms->update(floats, 3);
+    cms->update(doubles, 3);
+    cms->update(ldoubles, 3);
+}
+
+static int packedFormat(NMLTYPE type, void *buffer, CMS * cms)
+{
+    if (type == PACKED_MSG_TYPE) {
+	((PACKED_MSG *) buffer)->update(cms);
+	return 1;
+    }
+    return 0;
+}
+
+static void show(const PACKED_MSG * m)
+{
+    int k;
+
+    printf("scalars: %d %d %u %d %u %d %u %ld %lu %g %.17g %.21Lg\n",
+	m->b, m->c, m->uc, m->s, m->us, m->i, m->ui, m->l, m->ul, m->f,
+	m->d, m->ld);
+    printf("text: %s\n", m->text);
+    for (k = 0; k < 3; k++) {
+	printf("[%d]: %u %d %u %d %u %ld %lu %g %.17g %.21Lg\n", k,
+	    m->bytes[k], m->shorts[k], m->ushorts[k], m->ints[k],
+	    m->uints[k], m->longs[k], m->ulongs[k], m->floats[k],
+	    m->doubles[k], m->ldoubles[k]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+	fprintf(stderr, "usage: %s NMLFILE\n", argv[0]);
+	return 1;
+    }
+    set_rcs_print_destination(RCS_PRINT_TO_NULL);
+    NML writer(packedFormat, "packed", "writer", argv[1]);
+    NML reader(packedFormat, "packed", "reader", argv[1]);
+    if (!writer.valid() || !reader.valid()) {
+	fprintf(stderr, "can't open the packed buffer\n");
+	return 1;
+    }
+
+    PACKED_MSG out;
+    int k;
+
+    memset(&out, 0, sizeof(out));
+    out.size = sizeof(out);
+    out.type = PACKED_MSG_TYPE;
+    out.b = true;
+    out.c = -7;
+    out.uc = 250;
+    out.s = -30000;
+    out.us = 65000;
+    out.i = -2000000000;
+    out.ui = 4000000000u;
+    out.l = -9000000000000000000L;
+    out.ul = 18000000000000000000UL;
+    out.f = 1.5f;
+    out.d = 0.1;
+    out.ld = 1.0L / 3;
+    strcpy(out.text, "hello packed");
+    for (k = 0; k < 3; k++) {
+	out.bytes[k] = 200 + k;
+	out.shorts[k] = -1000 * (k + 1);
+	out.ushorts[k] = 60000 + k;
+	out.ints[k] = -100000 * (k + 1);
+	out.uints[k] = 3000000000u + k;
+	out.longs[k] = -5000000000L * (k + 1);
+	out.ulongs[k] = 10000000000000000000UL + k;
+	out.floats[k] = 0.25f * (k + 1);
+	out.doubles[k] = 1.0 / (k + 3);
+	out.ldoubles[k] = 1.0L / (k + 7);
+    }
+
+    if (writer.write(out) != 0) {
+	printf("write failed\n");
+	return 1;
+    }
+    if (reader.read() != PACKED_MSG_TYPE) {
+	printf("read failed\n");
+	return 1;
+    }
+    const PACKED_MSG *in = (const PACKED_MSG *) reader.get_address();
+    show(in);
+    return 0;
+}
@@ -0,0 +1,4 @@
+#!/bin/bash
+set -e
+. ../nmltest.sh
+nml_test packed.cc packed.nml
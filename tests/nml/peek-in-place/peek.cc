@@ -0,0 +1,98 @@
+// Reads messages in place from a shared memory buffer while they are
+// written, including after a write that fails part way through.
+#include "nml.hh"
+#include "nmlmsg.hh"
+#include "cms.hh"
+#include "rcs_print.hh"
+#include <stdio.h>
+#include <string.h>
+
+#define PEEK_MSG_TYPE ((NMLTYPE) 9801)
+
+class PEEK_MSG:public NMLmsg {
+  public:
+    PEEK_MSG():NMLmsg(PEEK_MSG_TYPE, sizeof(PEEK_MSG)) {
+    };
+    void update(CMS * cms);
+
+    int count;
+    char text[64];
+};
+
+void PEEK_MSG::update(CMS * cms)
+{
+    cms->update(count);
+    cms->update(text, sizeof(text));
+}
+
+static int peekFormat(NMLTYPE type, void *buffer, CMS * cms)
+{
+    if (type == PEEK_MSG_TYPE) {
+	((PEEK_MSG *) buffer)->update(cms);
+	return 1;
+    }
+    return 0;
+}
+
+static void show(NML * reader, long *token)
+{
+    const NMLmsg *msg;
+    NMLTYPE type = reader->peek_in_place(&msg, token);
+
+    if (type != PEEK_MSG_TYPE) {
+	printf("peek_in_place: %ld\n", (long) type);
+	return;
+    }
+    const PEEK_MSG *peek = (const PEEK_MSG *) msg;
+    printf("peek_in_place: %d %s, unchanged %d\n", peek->count, peek->text,
+	reader->check_in_place(*token));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+	fprintf(stderr, "usage: %s NMLFILE\n", argv[0]);
+	return 1;
+    }
+    set_rcs_print_destination(RCS_PRINT_TO_NULL);
+    NML writer(peekFormat, "peek", "writer", argv[1]);
+    NML reader(peekFormat, "peek", "reader", argv[1]);
+    if (!writer.valid() || !reader.valid()) {
+	fprintf(stderr, "can't open the peek buffer\n");
+	return 1;
+    }
+
+    PEEK_MSG msg;
+    long token, first;
+    const NMLmsg *in_place;
+
+    printf("nothing written: %ld\n",
+	(long) reader.peek_in_place(&in_place, &token));
+
+    msg.count = 1;
+    strcpy(msg.text, "first");
+    writer.write(msg);
+    show(&reader, &first);
+
+    msg.count = 2;
+    strcpy(msg.text, "second");
+    writer.write(msg);
+    printf("first unchanged after second write: %d\n",
+	reader.check_in_place(first));
+    show(&reader, &token);
+
+    // a message too big for the buffer fails once its header is
+    // written, and must not leave the buffer looking half written
+    msg.count = 3;
+    strcpy(msg.text, "too big");
+    msg.size = 1 << 20;
+    printf("write too big: %d\n", writer.write(msg));
+    show(&reader, &token);
+
+    msg.count = 4;
+    strcpy(msg.text, "fourth");
+    msg.size = sizeof(msg);
+    printf("write: %d\n", writer.write(msg));
+    show(&reader, &token);
+    return 0;
+}
@@ -0,0 +1,102 @@
+// A sub=change subscriber that reads only after many updates were
+// pushed to it must get the newest one, not the oldest still queued.
+#include "nml.hh"
+#include "nmlmsg.hh"
+#include "nml_srv.hh"
+#include "cms.hh"
+#include "rcs_print.hh"
+#include "timer.hh"
+#include <stdio.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define SLOW_MSG_TYPE ((NMLTYPE) 9803)
+
+class SLOW_MSG:public NMLmsg {
+  public:
+    SLOW_MSG():NMLmsg(SLOW_MSG_TYPE, sizeof(SLOW_MSG)) {
+    };
+    void update(CMS * cms);
+
+    int count;
+};
+
+void SLOW_MSG::update(CMS * cms)
+{
+    cms->update(count);
+}
+
+static int slowFormat(NMLTYPE type, void *buffer, CMS * cms)
+{
+    if (type == SLOW_MSG_TYPE) {
+	((SLOW_MSG *) buffer)->update(cms);
+	return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+	fprintf(stderr, "usage: %s NMLFILE\n", argv[0]);
+	return 1;
+    }
+    set_rcs_print_destination(RCS_PRINT_TO_NULL);
+
+    NML writer(slowFormat, "slow", "writer", argv[1]);
+    if (!writer.valid()) {
+	fprintf(stderr, "can't open the slow buffer\n");
+	return 1;
+    }
+    SLOW_MSG msg;
+    msg.count = 0;
+    writer.write(msg);
+
+    pid_t server = fork();
+    if (0 == server) {
+	NML nml(slowFormat, "slow", "server", argv[1]);
+	run_nml_servers();
+	_exit(0);
+    }
+
+    int status = 1;
+    NML *reader = NULL;
+    for (int tries = 0; tries < 50; tries++) {
+	esleep(0.1);
+	reader = new NML(slowFormat, "slow", "reader", argv[1]);
+	if (reader->valid()) {
+	    break;
+	}
+	delete reader;
+	reader = NULL;
+    }
+    if (NULL == reader) {
+	printf("can't connect to the server\n");
+	goto done;
+    }
+    printf("first read: %d\n", (int) reader->read());
+
+    // fall behind while the server pushes every write
+    for (msg.count = 1; msg.count <= 50; msg.count++) {
+	writer.write(msg);
+	esleep(0.005);
+    }
+    esleep(0.5);
+
+    if (reader->read() != SLOW_MSG_TYPE) {
+	printf("no new message\n");
+	goto done;
+    }
+    printf("newest: %d, same id as the writer: %d\n",
+	((SLOW_MSG *) reader->get_address())->count,
+	reader->cms->in_buffer_id == writer.cms->header.write_id);
+    printf("next read: %d\n", (int) reader->read());
+    status = 0;
+
+  done:
+    delete reader;
+    kill(server, SIGINT);
+    waitpid(server, NULL, 0);
+    return status;
+}
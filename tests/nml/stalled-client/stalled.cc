@@ -0,0 +1,144 @@
+// A client that sends part of a request and then stalls must not hold
+// up the server's other clients, and must be disconnected.
+#include "nml.hh"
+#include "nmlmsg.hh"
+#include "nml_srv.hh"
+#include "cms.hh"
+#include "rcs_print.hh"
+#include "timer.hh"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#define STALLED_MSG_TYPE ((NMLTYPE) 9805)
+
+class STALLED_MSG:public NMLmsg {
+  public:
+    STALLED_MSG():NMLmsg(STALLED_MSG_TYPE, sizeof(STALLED_MSG)) {
+    };
+    void update(CMS * cms);
+
+    int count;
+};
+
+void STALLED_MSG::update(CMS * cms)
+{
+    cms->update(count);
+}
+
+static int stalledFormat(NMLTYPE type, void *buffer, CMS * cms)
+{
+    if (type == STALLED_MSG_TYPE) {
+	((STALLED_MSG *) buffer)->update(cms);
+	return 1;
+    }
+    return 0;
+}
+
+// the TCP= port of the buffer line in the .nml file
+static int tcp_port(const char *file)
+{
+    char line[256], *p;
+    int port = 0;
+    FILE *f = fopen(file, "r");
+
+    while (f && fgets(line, sizeof(line), f)) {
+	if (line[0] == 'B' && (p = strstr(line, "TCP="))) {
+	    port = atoi(p + 4);
+	}
+    }
+    if (f) {
+	fclose(f);
+    }
+    return port;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+	fprintf(stderr, "usage: %s NMLFILE\n", argv[0]);
+	return 1;
+    }
+    set_rcs_print_destination(RCS_PRINT_TO_NULL);
+
+    NML writer(stalledFormat, "stalled", "writer", argv[1]);
+    if (!writer.valid()) {
+	fprintf(stderr, "can't open the stalled buffer\n");
+	return 1;
+    }
+    STALLED_MSG msg;
+    msg.count = 0;
+    writer.write(msg);
+
+    pid_t server = fork();
+    if (0 == server) {
+	NML nml(stalledFormat, "stalled", "server", argv[1]);
+	run_nml_servers();
+	_exit(0);
+    }
+
+    int status = 1, got = 0, sock = -1;
+    struct sockaddr_in addr;
+    struct pollfd pfd;
+    char buf[20];
+    NML *reader = NULL;
+    for (int tries = 0; tries < 50; tries++) {
+	esleep(0.1);
+	reader = new NML(stalledFormat, "stalled", "reader", argv[1]);
+	if (reader->valid()) {
+	    break;
+	}
+	delete reader;
+	reader = NULL;
+    }
+    if (NULL == reader) {
+	printf("can't connect to the server\n");
+	goto done;
+    }
+    reader->read();
+
+    // send 8 of the 20 bytes of a request header, then nothing more
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(tcp_port(argv[1]));
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+	printf("can't connect the stalled client\n");
+	goto done;
+    }
+    memset(buf, 0, sizeof(buf));
+    send(sock, buf, 8, 0);
+    esleep(0.1);
+
+    for (msg.count = 1; msg.count <= 10; msg.count++) {
+	writer.write(msg);
+	if (reader->read() == STALLED_MSG_TYPE &&
+	    ((STALLED_MSG *) reader->get_address())->count == msg.count) {
+	    got++;
+	}
+    }
+    printf("reads that got the new message: %d of 10\n", got);
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    printf("stalled client disconnected: %d\n",
+	poll(&pfd, 1, 5000) == 1 && recv(sock, buf, sizeof(buf), 0) == 0);
+    status = 0;
+
+  done:
+    if (sock >= 0) {
+	close(sock);
+    }
+    delete reader;
+    kill(server, SIGINT);
+    waitpid(server, NULL, 0);
+    return status;
+}
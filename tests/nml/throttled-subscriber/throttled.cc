@@ -0,0 +1,112 @@
+// A sub=change subscriber held back by its interval must be sent the
+// newest message once the interval is up, even if nothing else is
+// written in the meantime.
+#include "nml.hh"
+#include "nmlmsg.hh"
+#include "nml_srv.hh"
+#include "cms.hh"
+#include "rcs_print.hh"
+#include "timer.hh"
+#include <stdio.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define THROTTLED_MSG_TYPE ((NMLTYPE) 9806)
+
+class THROTTLED_MSG:public NMLmsg {
+  public:
+    THROTTLED_MSG():NMLmsg(THROTTLED_MSG_TYPE, sizeof(THROTTLED_MSG)) {
+    };
+    void update(CMS * cms);
+
+    int count;
+};
+
+void THROTTLED_MSG::update(CMS * cms)
+{
+    cms->update(count);
+}
+
+static int throttledFormat(NMLTYPE type, void *buffer, CMS * cms)
+{
+    if (type == THROTTLED_MSG_TYPE) {
+	((THROTTLED_MSG *) buffer)->update(cms);
+	return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+	fprintf(stderr, "usage: %s NMLFILE\n", argv[0]);
+	return 1;
+    }
+    set_rcs_print_destination(RCS_PRINT_TO_NULL);
+
+    NML writer(throttledFormat, "throttled", "writer", argv[1]);
+    if (!writer.valid()) {
+	fprintf(stderr, "can't open the throttled buffer\n");
+	return 1;
+    }
+    THROTTLED_MSG msg;
+    msg.count = 0;
+    writer.write(msg);
+
+    pid_t server = fork();
+    if (0 == server) {
+	NML nml(throttledFormat, "throttled", "server", argv[1]);
+	run_nml_servers();
+	_exit(0);
+    }
+
+    int status = 1;
+    NML *reader = NULL;
+    for (int tries = 0; tries < 50; tries++) {
+	esleep(0.1);
+	reader = new NML(throttledFormat, "throttled", "reader", argv[1]);
+	if (reader->valid()) {
+	    break;
+	}
+	delete reader;
+	reader = NULL;
+    }
+    if (NULL == reader) {
+	printf("can't connect to the server\n");
+	goto done;
+    }
+    for (int tries = 0; tries < 20 && reader->read() == 0; tries++) {
+	esleep(0.1);
+    }
+    printf("first: %d\n", ((THROTTLED_MSG *) reader->get_address())->count);
+
+    // once the interval is up a write is pushed at once, and the one
+    // right after it has to wait
+    esleep(0.6);
+    msg.count = 1;
+    writer.write(msg);
+    esleep(0.1);
+    printf("pushed: %d\n", (int) reader->read());
+    msg.count = 2;
+    writer.write(msg);
+    esleep(0.1);
+    printf("held back: %d\n", (int) reader->read());
+
+    esleep(1.0);
+    if (reader->read() != THROTTLED_MSG_TYPE) {
+	printf("no new message\n");
+	goto done;
+    }
+    printf("newest: %d, same id as the writer: %d\n",
+	((THROTTLED_MSG *) reader->get_address())->count,
+	reader->cms->in_buffer_id == writer.cms->header.write_id);
+    printf("next read: %d\n", (int) reader->read());
+    status = 0;
+
+  done:
+    delete reader;
+    kill(server, SIGINT);
+    waitpid(server, NULL, 0);
+    return status;
+}
@@ -0,0 +1,10 @@
+#!/bin/bash
+# each move has to end where it should, slowing to a stop only once,
+# without the jerk going over the limit
+status=0
+for ngc in one.ngc short.ngc random.ngc ../tpsim/test.ngc; do
+    echo "$ngc:"
+    rs274 -g $ngc | tpsim -v 2 -a 10 -j 100 -l 20 | grep -v tpRunCycle
+    [ ${PIPESTATUS[1]} = 0 ] || status=1
+done
+exit $status
@@ -0,0 +1,3 @@
+#!/bin/bash
+rs274 -g test.ngc | tpsim -v 2 -a 10 -l 20 | grep -v tpRunCycle
+exit ${PIPESTATUS[1]}